@@ -0,0 +1,1120 @@
+#include<vector>
+#include<array>
+#include<string>
+#include<string_view>
+#include<memory>
+#include<functional>
+#include<cmath>
+#include<cctype>
+#include<cstring>
+#include<cstdlib>
+#include<algorithm>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<format>
+#include<thread>
+#include<barrier>
+#include<random>
+
+#include<vulkan/vulkan.h>
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Scenarios.h"
+#include"../Common/MeshOptimiser.h"
+#include"../Common/ComputePrimitives.h"
+
+//Headless benchmark of the three scenarios. Nothing needs a window or real
+//hardware, so it runs against Mesa lavapipe or the Vulkan mock ICD on CI
+//machines without a GPU. Every scenario is set up once, warmed up, then timed
+//per iteration: the host time up to the last submission and the time until
+//the work has completed are reported as separate distributions.
+//
+//Only the valid variants are timed, the point is to measure the paths, not
+//to reproduce the driver crashes.
+//
+//--mesh-optimiser times the MeshOptimiser stages on the host instead and
+//reports what each one does to the vertex cache, vertex fetch and overdraw.
+//--dispatch times recording draws through the loader against the device
+//dispatch table.
+//--pipelines times creating the pipelines scenario's state on every path,
+//shader objects, monolithic pipelines and graphics pipeline libraries.
+//Bind and draw cost of the same paths are the pipelines/* scenarios.
+//--primitives times the compute primitives' reduce, scan, compaction and
+//sort in elements per second, each checked against its CPU reference first.
+//--all-devices runs the scenarios on every device that matches --device and
+//--driver at once, each from its own thread with a context of its own.
+
+//*************** Options ***********************
+#pragma region Options
+struct Options{
+  std::string deviceName;
+  std::string driver;
+  std::vector<std::string> scenarios;
+  uint32_t iterations=1000;
+  uint32_t warmup=100;
+  std::filesystem::path shaderPath;
+  std::filesystem::path glslPath;
+  std::filesystem::path shaderCachePath;
+  bool optimiseSpirv=false;
+  bool compareSpirv=false;
+  bool meshOptimiser=false;
+  std::filesystem::path meshPath;
+  bool dispatch=false;
+  bool memory=false;
+  bool pipelines=false;
+  std::filesystem::path pipelineCachePath;
+  bool primitives=false;
+  uint32_t elements=1u<<22;
+  bool allDevices=false;
+  std::filesystem::path jsonPath;
+  bool list=false;
+  bool validation=false;
+};
+
+static void PrintUsage(){
+  std::cout<<
+    "Usage: Benchmark [options]\n"
+    "  --list              List the devices and exit\n"
+    "  --device <name>     First device whose name contains <name>, e.g. Mock for the mock ICD\n"
+    "  --driver <id>       VkDriverId number or lavapipe, radv, amdvlk, amd, nvidia, nvk, anv, venus\n"
+    "  --scenario <name>   compute, draw or shaders, or scenario/variant such as draw/indexed,\n"
+    "                      repeatable, all valid variants by default\n"
+    "  --iterations <n>    Timed iterations per scenario, 1000 by default\n"
+    "  --warmup <n>        Untimed iterations before timing, 100 by default\n"
+    "  --shaders <dir>     Directory holding the compiled .spv files\n"
+    "  --glsl <dir>        Compile the GLSL under <dir>, the repository root, instead\n"
+    "                      of loading the .spv files. SPIR-V is cached in ShaderCache\n"
+    "  --optimise-spirv    Strip debug info, dead code and unused variables from the SPIR-V\n"
+    "                      before creating shaders, changes what the repros exercise\n"
+    "  --compare-spirv     --optimise-spirv and time vkCreateShadersEXT on both versions\n"
+    "  --mesh-optimiser    Time the mesh optimiser stages instead of running the scenarios\n"
+    "  --mesh <file>       Wavefront OBJ for --mesh-optimiser, generated spheres by default\n"
+    "  --dispatch          Time recording through the loader exports against the dispatch\n"
+    "                      table instead of running the scenarios, rounds set by\n"
+    "                      --iterations and --warmup\n"
+    "  --memory            Run a defragmentation pass between timed iterations, outside\n"
+    "                      the timing, and print heap budgets and usage by tag after\n"
+    "                      each scenario\n"
+    "  --pipelines         Time creating shader objects, monolithic pipelines and pipeline\n"
+    "                      libraries for the pipelines scenario instead of running it\n"
+    "  --pipeline-cache <dir>\n"
+    "                      Directory the VkPipelineCache is kept in between runs,\n"
+    "                      PipelineCache next to the executable by default\n"
+    "  --primitives        Time the compute primitives in elements per second instead\n"
+    "                      of running the scenarios\n"
+    "  --elements <n>      Elements --primitives works on, 4194304 by default\n"
+    "  --all-devices       Run the scenarios on every device matching --device and\n"
+    "                      --driver concurrently, one thread per device\n"
+    "  --json <file>       Also write the results as JSON\n"
+    "  --validation        Enable VK_LAYER_KHRONOS_validation\n";
+}
+
+static Options ParseOptions(int argc,char **argv){
+  Options options;
+  options.shaderPath=std::filesystem::absolute(argv[0]).parent_path()/"Shaders";
+  options.shaderCachePath=std::filesystem::absolute(argv[0]).parent_path()/"ShaderCache";
+  options.pipelineCachePath=std::filesystem::absolute(argv[0]).parent_path()/"PipelineCache";
+
+  for(int index=1;index<argc;index++){
+    std::string_view argument=argv[index];
+    auto Value=[&]()->std::string{
+      if(index+1>=argc)
+        throw std::runtime_error(std::format("Missing value for {}",argument));
+      return argv[++index];
+    };
+    auto Count=[&]()->uint32_t{
+      auto value=Value();
+      if(value.empty()||!std::all_of(value.begin(),value.end(),[](char c){return std::isdigit((unsigned char)c)!=0;}))
+        throw std::runtime_error(std::format("Expected a number for {}",argument));
+      return (uint32_t)std::stoul(value);
+    };
+
+    if(argument=="--list")
+      options.list=true;
+    else if(argument=="--device")
+      options.deviceName=Value();
+    else if(argument=="--driver")
+      options.driver=Value();
+    else if(argument=="--scenario")
+      options.scenarios.push_back(Value());
+    else if(argument=="--iterations")
+      options.iterations=Count();
+    else if(argument=="--warmup")
+      options.warmup=Count();
+    else if(argument=="--shaders")
+      options.shaderPath=Value();
+    else if(argument=="--glsl")
+      options.glslPath=Value();
+    else if(argument=="--optimise-spirv")
+      options.optimiseSpirv=true;
+    else if(argument=="--compare-spirv")
+      options.optimiseSpirv=options.compareSpirv=true;
+    else if(argument=="--mesh-optimiser")
+      options.meshOptimiser=true;
+    else if(argument=="--mesh")
+      options.meshPath=Value();
+    else if(argument=="--dispatch")
+      options.dispatch=true;
+    else if(argument=="--memory")
+      options.memory=true;
+    else if(argument=="--pipelines")
+      options.pipelines=true;
+    else if(argument=="--pipeline-cache")
+      options.pipelineCachePath=Value();
+    else if(argument=="--primitives")
+      options.primitives=true;
+    else if(argument=="--elements")
+      options.elements=Count();
+    else if(argument=="--all-devices")
+      options.allDevices=true;
+    else if(argument=="--json")
+      options.jsonPath=Value();
+    else if(argument=="--validation")
+      options.validation=true;
+    else if(argument=="--help"||argument=="-h"){
+      PrintUsage();
+      std::exit(0);
+    }else{
+      PrintUsage();
+      throw std::runtime_error(std::format("Unknown option {}",argument));
+    }
+  }
+
+  if(options.iterations==0)
+    throw std::runtime_error("At least one iteration is required");
+  if(options.elements==0)
+    throw std::runtime_error("--elements needs at least one element");
+  if(options.allDevices&&(options.dispatch||options.pipelines||options.primitives||options.meshOptimiser))
+    throw std::runtime_error("--all-devices only runs the scenarios");
+  return options;
+}
+#pragma endregion
+
+//************** Statistics *********************
+#pragma region Statistics
+struct Distribution{
+  double min=0.0;
+  double mean=0.0;
+  double stddev=0.0;
+  double p50=0.0;
+  double p90=0.0;
+  double p99=0.0;
+  double max=0.0;
+};
+
+struct Result{
+  std::string scenario;
+  uint32_t iterations=0;
+  double seconds=0.0;
+  //Iterations per second of wall time
+  double throughput=0.0;
+  Distribution cpu;
+  Distribution total;
+};
+
+//Nearest rank percentiles over the sorted samples
+static Distribution Summarise(std::vector<double> samples){
+  Distribution distribution;
+  if(samples.empty())
+    return distribution;
+
+  std::sort(samples.begin(),samples.end());
+  auto Percentile=[&](double percent){
+    auto rank=(size_t)std::ceil(percent/100.0*samples.size());
+    return samples[std::clamp<size_t>(rank,1,samples.size())-1];
+  };
+
+  double sum=0.0;
+  for(auto sample:samples)
+    sum+=sample;
+  distribution.mean=sum/samples.size();
+
+  double variance=0.0;
+  for(auto sample:samples)
+    variance+=(sample-distribution.mean)*(sample-distribution.mean);
+  distribution.stddev=std::sqrt(variance/samples.size());
+
+  distribution.min=samples.front();
+  distribution.p50=Percentile(50.0);
+  distribution.p90=Percentile(90.0);
+  distribution.p99=Percentile(99.0);
+  distribution.max=samples.back();
+  return distribution;
+}
+
+//start is called between the warm-up and the timed iterations
+static Result RunScenario(const ScenarioEntry &entry,HeadlessDevice &context,const Options &options,
+  const std::function<void()> &start={}){
+
+  auto scenario=entry.create(context);
+
+  for(uint32_t iteration=0;iteration<options.warmup;iteration++)
+    scenario->Iterate();
+  if(start)
+    start();
+
+  std::vector<double> cpu,total;
+  cpu.reserve(options.iterations);
+  total.reserve(options.iterations);
+
+  //Defragmentation stands in for the idle time between frames, it is kept
+  //out of the samples and the throughput
+  double idleMs=0.0;
+  auto begin=Clock::now();
+  for(uint32_t iteration=0;iteration<options.iterations;iteration++){
+    auto sample=scenario->Iterate();
+    cpu.push_back(sample.cpuMs);
+    total.push_back(sample.totalMs);
+    if(options.memory){
+      auto idleBegin=Clock::now();
+      context.dispatch.vkDeviceWaitIdle(context.device);
+      context.memory->Idle();
+      idleMs+=Milliseconds(idleBegin,Clock::now());
+    }
+  }
+  auto end=Clock::now();
+
+  if(options.memory)
+    std::cout<<std::format("{}\nDefragmentation {:.3f} ms between iterations\n",context.memory->Report(),idleMs);
+
+  Result result;
+  result.scenario=strcmp(entry.variant,"valid")==0?entry.scenario:std::format("{}/{}",entry.scenario,entry.variant);
+  result.iterations=options.iterations;
+  result.seconds=(Milliseconds(begin,end)-idleMs)/1000.0;
+  result.throughput=result.seconds>0.0?options.iterations/result.seconds:0.0;
+  result.cpu=Summarise(std::move(cpu));
+  result.total=Summarise(std::move(total));
+  return result;
+}
+
+static void PrintResults(const std::vector<Result> &results){
+  std::cout<<std::format("{:<14}{:>10}{:>12}  {:<6}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}\n",
+    "scenario","iters","iter/s","ms","min","mean","stddev","p50","p90","p99","max");
+  for(auto &result:results){
+    auto Row=[&](const char *label,const Distribution &distribution,bool first){
+      std::cout<<std::format("{:<14}{:>10}{:>12}  {:<6}{:>10.4f}{:>10.4f}{:>10.4f}{:>10.4f}{:>10.4f}{:>10.4f}{:>10.4f}\n",
+        first?result.scenario:"",first?std::format("{}",result.iterations):"",
+        first?std::format("{:.1f}",result.throughput):"",label,
+        distribution.min,distribution.mean,distribution.stddev,
+        distribution.p50,distribution.p90,distribution.p99,distribution.max);
+    };
+    Row("cpu",result.cpu,true);
+    Row("total",result.total,false);
+  }
+}
+
+static std::string DistributionJson(const Distribution &distribution){
+  return std::format("{{\"min\":{},\"mean\":{},\"stddev\":{},\"p50\":{},\"p90\":{},\"p99\":{},\"max\":{}}}",
+    distribution.min,distribution.mean,distribution.stddev,
+    distribution.p50,distribution.p90,distribution.p99,distribution.max);
+}
+
+static std::string Escape(std::string_view text){
+  std::string escaped;
+  for(char c:text){
+    if(c=='"'||c=='\\')
+      escaped+='\\';
+    if((unsigned char)c>=0x20)
+      escaped+=c;
+  }
+  return escaped;
+}
+
+//error is what stopped the device early under --all-devices
+static std::string DeviceJson(const DeviceInfo &device,const Options &options,const std::vector<Result> &results,
+  std::string_view error={}){
+
+  auto json=std::format("{{\"device\":\"{}\",\"driver\":\"{}\",\"driverID\":{},\"warmup\":{},\"results\":[",
+    Escape(device.properties.deviceName),Escape(device.driver.driverName),
+    (uint32_t)device.driver.driverID,options.warmup);
+  for(size_t index=0;index<results.size();index++){
+    auto &result=results[index];
+    json+=std::format("{}\n{{\"scenario\":\"{}\",\"iterations\":{},\"seconds\":{},\"throughput\":{},\"cpuMs\":{},\"totalMs\":{}}}",
+      index>0?",":"",result.scenario,result.iterations,result.seconds,result.throughput,
+      DistributionJson(result.cpu),DistributionJson(result.total));
+  }
+  json+="\n]";
+  if(!error.empty())
+    json+=std::format(",\"error\":\"{}\"",Escape(error));
+  return json+"}";
+}
+
+static void WriteJson(const std::filesystem::path &path,const DeviceInfo &device,
+  const Options &options,const std::vector<Result> &results){
+
+  std::ofstream file(path);
+  if(!file.is_open())
+    throw std::runtime_error("Unable to open benchmark output");
+  file<<DeviceJson(device,options,results)<<"\n";
+}
+#pragma endregion
+
+//*************** Mesh optimiser ****************
+#pragma region Mesh optimiser
+//Each stage is timed on copies of its input, the best run is reported
+static constexpr uint32_t MeshRuns=5;
+
+static void RunMeshOptimiser(const Options &options){
+  auto mesh=options.meshPath.empty()?ShuffledSpheres(8,48,96):LoadObj(options.meshPath);
+  //Interleaved full precision, binding 0 holds every attribute
+  auto stride=VertexPacker::Pack(mesh.data,{}).bindings[0].stride;
+  std::cout<<std::format("Mesh {}: {} vertices, {} triangles, {} byte vertices\n",
+    options.meshPath.empty()?"spheres":options.meshPath.string(),mesh.VertexCount(),mesh.indices.size()/3,stride);
+
+  struct Stage{
+    const char *name;
+    std::function<void(IndexedMesh &)> run;
+  };
+  std::array<Stage,3> stages={{
+    {"vertex cache",[](IndexedMesh &mesh){MeshOptimiser::OptimiseVertexCache(mesh);}},
+    {"overdraw",[](IndexedMesh &mesh){MeshOptimiser::OptimiseOverdraw(mesh);}},
+    {"vertex fetch",[](IndexedMesh &mesh){MeshOptimiser::OptimiseVertexFetch(mesh);}}
+  }};
+
+  struct Metrics{
+    VertexCacheStats cache;
+    VertexFetchStats fetch;
+    OverdrawStats overdraw;
+  };
+  auto Analyse=[&](const IndexedMesh &mesh)->Metrics{
+    return {
+      MeshOptimiser::AnalyseVertexCache(mesh),
+      MeshOptimiser::AnalyseVertexFetch(mesh,stride),
+      MeshOptimiser::AnalyseOverdraw(mesh)
+    };
+  };
+  auto Row=[](const char *stage,double ms,const Metrics &metrics){
+    std::cout<<std::format("{:<14}{:>10.3f}{:>10.3f}{:>10.3f}{:>10.3f}{:>10.3f}\n",
+      stage,ms,metrics.cache.acmr,metrics.cache.atvr,metrics.fetch.overfetch,metrics.overdraw.overdraw);
+  };
+  auto Change=[](float before,float after){
+    return before>0.0f?(after-before)/before*100.0f:0.0f;
+  };
+
+  auto input=Analyse(mesh);
+  std::cout<<std::format("{:<14}{:>10}{:>10}{:>10}{:>10}{:>10}\n","stage","ms","ACMR","ATVR","overfetch","overdraw");
+  Row("input",0.0,input);
+  for(auto &stage:stages){
+    double best=0.0;
+    IndexedMesh result;
+    for(uint32_t run=0;run<MeshRuns;run++){
+      result=mesh;
+      auto begin=Clock::now();
+      stage.run(result);
+      auto elapsed=Milliseconds(begin,Clock::now());
+      best=run==0?elapsed:std::min(best,elapsed);
+    }
+    mesh=std::move(result);
+    Row(stage.name,best,Analyse(mesh));
+  }
+
+  auto output=Analyse(mesh);
+  std::cout<<std::format("ACMR {:+.1f}%, ATVR {:+.1f}%, overfetch {:+.1f}%, overdraw {:+.1f}%\n",
+    Change(input.cache.acmr,output.cache.acmr),Change(input.cache.atvr,output.cache.atvr),
+    Change(input.fetch.overfetch,output.fetch.overfetch),Change(input.overdraw.overdraw,output.overdraw.overdraw));
+}
+#pragma endregion
+
+//*************** Dispatch **********************
+#pragma region Dispatch
+//Draws recorded per round, each with five state changes in front of it
+static constexpr uint32_t DispatchDraws=256;
+static constexpr uint32_t DispatchCommands=6;
+
+//Times recording the hot loop of a draw pass, vkCmdSet* and vkCmdDraw,
+//through the loader exports and through context.dispatch. Rounds alternate
+//between the two so drift on the machine hits both alike, every round is
+//submitted and waited on so the command buffers stay valid.
+static void RunDispatch(HeadlessDevice &context,const Options &options){
+  static constexpr uint32_t Size=64;
+
+  ResourceTracker tracker(&context.dispatch);
+  RenderTargetPool renderTargets(context.device,context.allocator,tracker,context.memory.get());
+  auto &framebuffer=renderTargets.Acquire({
+    .extent={Size,Size},
+    .format=VK_FORMAT_R8G8B8A8_UNORM,
+    .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+    .samples=VK_SAMPLE_COUNT_1_BIT
+  });
+  FrameGraph frameGraph(context.device,context.allocator,tracker,&context.dispatch);
+
+  auto vertShaderCode=context.Shader("VertexBindingVert.spv");
+  auto fragShaderCode=context.Shader("VertexBindingFrag.spv");
+  std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+    .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+    .pNext=nullptr,
+    .flags=0,
+    .stage=VK_SHADER_STAGE_VERTEX_BIT,
+    .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+    .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+    .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+    .pCode=vertShaderCode.data(),
+    .pName="main",
+    .setLayoutCount=0,
+    .pSetLayouts=nullptr,
+    .pushConstantRangeCount=0,
+    .pPushConstantRanges=nullptr,
+    .pSpecializationInfo=nullptr
+  },{
+    .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+    .pNext=nullptr,
+    .flags=0,
+    .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+    .nextStage=0,
+    .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+    .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+    .pCode=fragShaderCode.data(),
+    .pName="main",
+    .setLayoutCount=0,
+    .pSetLayouts=nullptr,
+    .pushConstantRangeCount=0,
+    .pPushConstantRanges=nullptr,
+    .pSpecializationInfo=nullptr
+  }}};
+  std::array<VkShaderEXT,2> shaders={};
+  auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+  if(result!=VK_SUCCESS)
+    throw std::runtime_error("Failed to create shader objects");
+
+  auto mesh=VertexPacker::Pack({
+    .positions={{0.0f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+    .normals={},
+    .texCoords={}
+  },{});
+  VmaAllocation vertexAllocation=nullptr;
+  VmaAllocationInfo vertexInfo={};
+  auto vertexBuffer=context.CreateBuffer(1024,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,vertexAllocation,vertexInfo);
+  memcpy(vertexInfo.pMappedData,mesh.streams[0].data(),mesh.streams[0].size());
+
+  //Every call through the exports takes the loader's trampoline like a
+  //plain vkCmd* call in the source would
+  auto &loader=DeviceDispatch::Exports();
+  auto Round=[&](const DeviceDispatch &calls)->double{
+    double elapsed=0.0;
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkRenderingAttachmentInfo attachmentInfo{
+          .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext=nullptr,
+          .imageView=framebuffer.view,
+          .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode=VK_RESOLVE_MODE_NONE,
+          .resolveImageView=VK_NULL_HANDLE,
+          .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue={.color={0.0,0.0,0.0,0.0}}
+        };
+        VkRenderingInfo renderingInfo={
+          .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext=nullptr,
+          .flags=0,
+          .renderArea={
+            .offset={0,0},
+            .extent={Size,Size}
+          },
+          .layerCount=1,
+          .viewMask=0,
+          .colorAttachmentCount=1,
+          .pColorAttachments=&attachmentInfo,
+          .pDepthAttachment=nullptr,
+          .pStencilAttachment=nullptr
+        };
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        //The state the timed loop leaves alone is set once up front
+        calls.vkCmdBeginRendering(CMDBuffer,&renderingInfo);
+        commands.SetRasterizerDiscardEnable(VK_FALSE);
+        commands.SetDepthWriteEnable(VK_FALSE);
+        commands.SetDepthBiasEnable(VK_FALSE);
+        commands.SetDepthBoundsTestEnable(VK_FALSE);
+        commands.SetStencilTestEnable(VK_FALSE);
+        commands.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        commands.SetPrimitiveRestartEnable(VK_FALSE);
+        commands.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+        VkSampleMask sampleMask=~0u;
+        commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+        commands.SetAlphaToCoverageEnable(VK_FALSE);
+        VkBool32 blendEnable=VK_FALSE;
+        commands.SetColorBlendEnable(0,1,&blendEnable);
+        VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+          VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+        commands.SetColorWriteMask(0,1,&writeMask);
+        std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+        commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+        commands.SetVertexInput((uint32_t)mesh.bindings.size(),mesh.bindings.data(),
+          (uint32_t)mesh.attributes.size(),mesh.attributes.data());
+        std::vector<VkDeviceSize> offsets,sizes,strides;
+        mesh.BindRanges(0,offsets,sizes,strides);
+        commands.BindVertexBuffers(0,1,&vertexBuffer,offsets.data(),sizes.data(),strides.data());
+
+        auto begin=Clock::now();
+        for(uint32_t draw=0;draw<DispatchDraws;draw++){
+          calls.vkCmdSetCullMode(CMDBuffer,draw&1?VK_CULL_MODE_BACK_BIT:VK_CULL_MODE_NONE);
+          calls.vkCmdSetFrontFace(CMDBuffer,VK_FRONT_FACE_COUNTER_CLOCKWISE);
+          calls.vkCmdSetDepthTestEnable(CMDBuffer,VK_FALSE);
+          calls.vkCmdSetViewportWithCount(CMDBuffer,1,&viewPort);
+          calls.vkCmdSetScissorWithCount(CMDBuffer,1,&scissor);
+          calls.vkCmdDraw(CMDBuffer,mesh.vertexCount,1,0,0);
+        }
+        elapsed=std::chrono::duration<double,std::nano>(Clock::now()-begin).count();
+        calls.vkCmdEndRendering(CMDBuffer);
+      });
+
+    for(auto &point:frameGraph.Submit(*context.queues))
+      context.queues->Wait(point);
+    return elapsed/(DispatchDraws*DispatchCommands);
+  };
+
+  for(uint32_t round=0;round<options.warmup;round++){
+    Round(loader);
+    Round(context.dispatch);
+  }
+  std::vector<double> loaderSamples,dispatchSamples;
+  for(uint32_t round=0;round<options.iterations;round++){
+    loaderSamples.push_back(Round(loader));
+    dispatchSamples.push_back(Round(context.dispatch));
+  }
+
+  context.dispatch.vkDeviceWaitIdle(context.device);
+  frameGraph.Reset();
+  renderTargets.Release(framebuffer);
+  renderTargets.Clear();
+  context.DestroyBuffer(vertexBuffer,vertexAllocation);
+  for(auto shader:shaders)
+    context.DestroyShader(shader);
+
+  auto loaderNs=Summarise(std::move(loaderSamples));
+  auto dispatchNs=Summarise(std::move(dispatchSamples));
+  std::cout<<std::format("{} rounds of {} draws, ns per command\n",options.iterations,DispatchDraws);
+  std::cout<<std::format("{:<14}{:>10}{:>10}{:>10}{:>10}\n","entry","min","mean","p50","p99");
+  for(auto [label,distribution]:{std::pair{"loader",&loaderNs},std::pair{"dispatch",&dispatchNs}}){
+    std::cout<<std::format("{:<14}{:>10.2f}{:>10.2f}{:>10.2f}{:>10.2f}\n",
+      label,distribution->min,distribution->mean,distribution->p50,distribution->p99);
+  }
+  std::cout<<std::format("Saving {:.2f} ns per command at the median, {:.1f}%\n",loaderNs.p50-dispatchNs.p50,
+    loaderNs.p50>0.0?(loaderNs.p50-dispatchNs.p50)/loaderNs.p50*100.0:0.0);
+}
+#pragma endregion
+
+//*************** Pipelines *********************
+#pragma region Pipelines
+//Pipeline creation is far slower than recording, a round creates everything
+//the pipelines scenario draws with on every path
+static constexpr uint32_t PipelineRounds=20;
+
+struct PipelineTiming{
+  const char *path;
+  uint32_t objects=0;
+  std::vector<double> ms;
+};
+
+//Times getting ready to draw every state of the pipelines scenario: the
+//shader object pair, StateCount monolithic pipelines with and without the
+//pipeline cache, and the library parts with the fast and the link time
+//optimised link. Each round starts from new GraphicsPipelines, so only the
+//pipeline cache carries over between rounds; "cold" bypasses it, a driver
+//with a disk cache of its own can still make it warm.
+static void RunPipelines(HeadlessDevice &context){
+  auto vertShaderCode=context.Shader("VertexBindingVert.spv");
+  auto fragShaderCode=context.Shader("VertexBindingFrag.spv");
+  std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+    .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+    .pNext=nullptr,
+    .flags=0,
+    .stage=VK_SHADER_STAGE_VERTEX_BIT,
+    .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+    .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+    .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+    .pCode=vertShaderCode.data(),
+    .pName="main",
+    .setLayoutCount=0,
+    .pSetLayouts=nullptr,
+    .pushConstantRangeCount=0,
+    .pPushConstantRanges=nullptr,
+    .pSpecializationInfo=nullptr
+  },{
+    .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+    .pNext=nullptr,
+    .flags=0,
+    .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+    .nextStage=0,
+    .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+    .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+    .pCode=fragShaderCode.data(),
+    .pName="main",
+    .setLayoutCount=0,
+    .pSetLayouts=nullptr,
+    .pushConstantRangeCount=0,
+    .pPushConstantRanges=nullptr,
+    .pSpecializationInfo=nullptr
+  }}};
+
+  auto mesh=VertexPacker::Pack({
+    .positions={{0.0f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+    .normals={},
+    .texCoords={}
+  },{});
+  auto states=PipelineScenario::States(VK_FORMAT_R8G8B8A8_UNORM,mesh);
+  auto layout=context.CreatePipelineLayout({});
+
+  std::vector<PipelineTiming> timings={
+    {.path="shader-objects"},
+    {.path="monolithic-cold"},
+    {.path="monolithic-cached"},
+    {.path="library-parts"},
+    {.path="library-link"},
+    {.path="library-link-lto"}
+  };
+  auto Pipelines=[&](PipelineBackend backend,const PipelineOptions &pipelineOptions){
+    GraphicsPipelines pipelines(context,backend,layout,vertShaderCode,fragShaderCode,pipelineOptions);
+    for(auto &state:states)
+      pipelines.Get(state);
+    return pipelines.Stats();
+  };
+  auto Round=[&](bool timed){
+    auto Record=[&](size_t path,uint32_t objects,double ms){
+      if(!timed)
+        return;
+      timings[path].objects=objects;
+      timings[path].ms.push_back(ms);
+    };
+
+    std::array<VkShaderEXT,2> shaders={};
+    auto begin=Clock::now();
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    auto shaderMs=Milliseconds(begin,Clock::now());
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+    for(auto shader:shaders)
+      context.DestroyShader(shader);
+    Record(0,(uint32_t)shaders.size(),shaderMs);
+
+    auto cold=Pipelines(PipelineBackend::Monolithic,{.optimise=false,.cached=false});
+    Record(1,cold.pipelines,cold.pipelineMs);
+    auto cached=Pipelines(PipelineBackend::Monolithic,{});
+    Record(2,cached.pipelines,cached.pipelineMs);
+    if(!context.pipelineLibrary)
+      return;
+    auto library=Pipelines(PipelineBackend::Library,{});
+    Record(3,library.libraries,library.libraryMs);
+    Record(4,library.pipelines,library.pipelineMs);
+    auto optimised=Pipelines(PipelineBackend::Library,{.optimise=true,.cached=true});
+    Record(5,optimised.pipelines,optimised.pipelineMs);
+  };
+
+  //Untimed, fills the pipeline cache when the run started without one
+  Round(false);
+  for(uint32_t round=0;round<PipelineRounds;round++)
+    Round(true);
+  context.dispatch.vkDestroyPipelineLayout(context.device,layout,nullptr);
+
+  std::cout<<std::format("{} rounds, {} states\n",PipelineRounds,states.size());
+  std::cout<<std::format("{:<20}{:>8}{:>12}{:>12}{:>12}\n","path","objects","ms/object","p50 ms","p99 ms");
+  for(auto &timing:timings){
+    if(timing.ms.empty()){
+      std::cout<<std::format("{:<20}{:>8}\n",timing.path,"-");
+      continue;
+    }
+    auto total=Summarise(timing.ms);
+    std::cout<<std::format("{:<20}{:>8}{:>12.4f}{:>12.4f}{:>12.4f}\n",timing.path,timing.objects,
+      timing.objects>0?total.mean/timing.objects:0.0,total.p50,total.p99);
+  }
+
+  //What it takes to draw every state at the median, the library path is its
+  //parts and the fast link
+  auto Median=[&](size_t path){
+    return Summarise(timings[path].ms).p50;
+  };
+  std::vector<std::pair<const char *,double>> ready;
+  ready.push_back({"shader objects",Median(0)});
+  ready.push_back({"monolithic pipelines",Median(2)});
+  if(context.pipelineLibrary)
+    ready.push_back({"pipeline libraries",Median(3)+Median(4)});
+  else
+    std::cout<<"No VK_EXT_graphics_pipeline_library, library paths skipped\n";
+  auto fastest=std::min_element(ready.begin(),ready.end(),[](auto &a,auto &b){
+    return a.second<b.second;
+  });
+  std::cout<<std::format("Fastest to create: {}, {:.4f} ms for every state\n",fastest->first,fastest->second);
+}
+#pragma endregion
+
+//*************** Primitives ********************
+#pragma region Primitives
+//Timed rounds of every primitive, after one untimed round that is checked
+static constexpr uint32_t PrimitiveRounds=20;
+
+struct PrimitiveTiming{
+  std::string name;
+  bool correct=false;
+  std::vector<double> ms;
+};
+
+//Each primitive over the same random values, timed from submission to
+//completion of its graph. The buffers are the host visible ones every
+//scenario uses, on a discrete GPU without resizable BAR that is system
+//memory and the numbers are a floor. Returns false when a result differs
+//from the CPU reference.
+static bool RunPrimitives(HeadlessDevice &context,const Options &options){
+  auto count=options.elements;
+  VkDeviceSize bytes=(VkDeviceSize)count*sizeof(uint32_t);
+
+  std::vector<std::unique_ptr<ComputePrimitives>> scans;
+  scans.push_back(std::make_unique<ComputePrimitives>(context,count,ScanMethod::ReduceThenScan));
+  if(context.int64Atomics)
+    scans.push_back(std::make_unique<ComputePrimitives>(context,count,ScanMethod::LookBack));
+  else
+    std::cout<<"No shaderBufferInt64Atomics, look-back scan skipped\n";
+  auto &primitives=*scans.back();
+
+  VmaAllocation inputAllocation=nullptr,outputAllocation=nullptr,keptAllocation=nullptr;
+  VmaAllocationInfo inputInfo={},outputInfo={},keptInfo={};
+  auto inputBuffer=context.CreateBuffer(bytes,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,inputAllocation,inputInfo);
+  auto outputBuffer=context.CreateBuffer(bytes,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,outputAllocation,outputInfo);
+  auto keptBuffer=context.CreateBuffer(16,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,keptAllocation,keptInfo);
+  auto output=reinterpret_cast<uint32_t *>(outputInfo.pMappedData);
+  auto kept=reinterpret_cast<uint32_t *>(keptInfo.pMappedData);
+
+  std::mt19937 random(1234);
+  std::vector<uint32_t> values(count);
+  for(auto &value:values)
+    value=random();
+  memcpy(inputInfo.pMappedData,values.data(),bytes);
+  //Compaction keeps the even values, about half
+  constexpr uint32_t CompactMask=1;
+  constexpr uint32_t CompactMatch=0;
+
+  ResourceTracker tracker(&context.dispatch);
+  FrameGraph frameGraph(context.device,context.allocator,tracker,&context.dispatch);
+  frameGraph.Trace(context.trace);
+
+  struct Buffers{
+    PrimitiveBuffer input;
+    PrimitiveBuffer output;
+    PrimitiveBuffer kept;
+  };
+  auto Time=[&](ComputePrimitives &target,const std::function<void(const Buffers &)> &add){
+    frameGraph.Reset();
+    Buffers buffers={
+      .input={frameGraph.ImportBuffer("Input",inputBuffer),inputBuffer,bytes},
+      .output={frameGraph.ImportBuffer("Output",outputBuffer),outputBuffer,bytes},
+      .kept={frameGraph.ImportBuffer("Kept",keptBuffer),keptBuffer,16}
+    };
+    target.Begin(frameGraph);
+    add(buffers);
+    frameGraph.Export(buffers.output.resource,VK_PIPELINE_STAGE_2_HOST_BIT,VK_ACCESS_2_HOST_READ_BIT);
+    frameGraph.Export(buffers.kept.resource,VK_PIPELINE_STAGE_2_HOST_BIT,VK_ACCESS_2_HOST_READ_BIT);
+
+    auto begin=Clock::now();
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    return Milliseconds(begin,Clock::now());
+  };
+  auto Equal=[&](const std::vector<uint32_t> &expected){
+    return std::equal(expected.begin(),expected.end(),output);
+  };
+
+  std::vector<PrimitiveTiming> timings;
+  //check runs after the first round, prepare before every round outside the timing
+  auto Measure=[&](std::string name,ComputePrimitives &target,const std::function<void(const Buffers &)> &add,
+    const std::function<bool()> &check,const std::function<void()> &prepare={}){
+
+    PrimitiveTiming timing={.name=std::move(name)};
+    for(uint32_t round=0;round<=PrimitiveRounds;round++){
+      if(prepare)
+        prepare();
+      auto ms=Time(target,add);
+      if(round==0)
+        timing.correct=check();
+      else
+        timing.ms.push_back(ms);
+    }
+    timings.push_back(std::move(timing));
+  };
+
+  auto reduced=ReduceReference(values);
+  Measure("reduce",primitives,[&](const Buffers &buffers){
+    primitives.Reduce(buffers.input,buffers.output,count);
+  },[&]{
+    return output[0]==reduced;
+  });
+
+  auto scanned=ExclusiveScanReference(values);
+  for(auto &scan:scans){
+    auto &target=*scan;
+    Measure(target.Method()==ScanMethod::LookBack?"scan look-back":"scan reduce-then-scan",target,[&](const Buffers &buffers){
+      target.ExclusiveScan(buffers.input,buffers.output,count);
+    },[&]{
+      return Equal(scanned);
+    });
+  }
+
+  auto compacted=CompactReference(values,CompactMask,CompactMatch);
+  Measure("compact",primitives,[&](const Buffers &buffers){
+    primitives.Compact(buffers.input,buffers.output,buffers.kept,count,CompactMask,CompactMatch);
+  },[&]{
+    return kept[0]==compacted.size()&&Equal(compacted);
+  });
+
+  //Sorted in place, every round starts again from the random values
+  auto sorted=SortReference(values);
+  Measure("sort",primitives,[&](const Buffers &buffers){
+    primitives.Sort(buffers.output,count);
+  },[&]{
+    return Equal(sorted);
+  },[&]{
+    memcpy(output,values.data(),bytes);
+  });
+
+  frameGraph.Reset();
+  scans.clear();
+  context.DestroyBuffer(inputBuffer,inputAllocation);
+  context.DestroyBuffer(outputBuffer,outputAllocation);
+  context.DestroyBuffer(keptBuffer,keptAllocation);
+
+  std::cout<<std::format("{} elements, {} rounds, full subgroups of {}\n",count,PrimitiveRounds,context.subgroupSize);
+  std::cout<<std::format("{:<24}{:>16}{:>12}{:>12}  {}\n","primitive","Melements/s","p50 ms","p99 ms","check");
+  bool correct=true;
+  for(auto &timing:timings){
+    auto total=Summarise(timing.ms);
+    std::cout<<std::format("{:<24}{:>16.1f}{:>12.4f}{:>12.4f}  {}\n",timing.name,
+      total.p50>0.0?count/(total.p50*1000.0):0.0,total.p50,total.p99,timing.correct?"ok":"MISMATCH");
+    correct=correct&&timing.correct;
+  }
+  return correct;
+}
+#pragma endregion
+
+//*************** Devices ***********************
+#pragma region Devices
+struct DeviceRun{
+  std::unique_ptr<HeadlessDevice> context;
+  std::unique_ptr<SpirvOptimiser> optimiser;
+  std::unique_ptr<PipelineCache> pipelineCache;
+  std::vector<Result> results;
+  std::string error;
+};
+
+//Opens a context per device in indices and runs the scenarios on all of them
+//at once, one thread per device. The threads meet after every warm-up so the
+//timed iterations overlap and the devices' rates add up; a device that fails
+//drops out and the others carry on. Devices that cannot be opened, e.g.
+//without VK_EXT_shader_object, are skipped. Returns false when a device
+//failed.
+static bool RunAllDevices(const std::vector<size_t> &indices,const std::vector<const ScenarioEntry *> &selected,
+  ShaderCompiler *compiler,const Options &options){
+
+  std::vector<DeviceRun> runs;
+  for(auto index:indices){
+    DeviceRun run;
+    run.context=std::make_unique<HeadlessDevice>(options.validation);
+    auto &context=*run.context;
+    try{
+      context.Open(context.devices[index]);
+    }catch(const std::exception &exception){
+      std::cout<<std::format("Skipping {}: {}\n",Describe(context.devices[index]),exception.what());
+      continue;
+    }
+    context.shaderPath=options.shaderPath;
+    context.compiler=compiler;
+    if(options.optimiseSpirv){
+      run.optimiser=std::make_unique<SpirvOptimiser>(SpirvPasses{},options.compareSpirv);
+      context.optimiser=run.optimiser.get();
+    }
+    run.pipelineCache=std::make_unique<PipelineCache>(context.device,context.dispatch,context.info.properties,
+      options.pipelineCachePath);
+    context.pipelineCache=run.pipelineCache.get();
+    std::cout<<std::format("Device {}: {}\n",runs.size(),Describe(context.info));
+    runs.push_back(std::move(run));
+  }
+  if(runs.empty())
+    throw std::runtime_error("None of the matching devices could be opened");
+
+  std::cout<<std::format("Running {} scenarios on {} devices: {} warm-up, {} timed\n",
+    selected.size(),runs.size(),options.warmup,options.iterations);
+  std::barrier start((std::ptrdiff_t)runs.size());
+  std::vector<std::thread> threads;
+  auto begin=Clock::now();
+  for(auto &run:runs){
+    threads.emplace_back([&]{
+      try{
+        for(auto entry:selected){
+          run.results.push_back(RunScenario(*entry,*run.context,options,[&]{
+            start.arrive_and_wait();
+          }));
+        }
+      }catch(const std::exception &exception){
+        run.error=exception.what();
+        start.arrive_and_drop();
+      }
+    });
+  }
+  for(auto &thread:threads)
+    thread.join();
+  auto seconds=Milliseconds(begin,Clock::now())/1000.0;
+
+  bool passed=true;
+  for(size_t index=0;index<runs.size();index++){
+    auto &run=runs[index];
+    std::cout<<std::format("\nDevice {}: {}\n",index,Describe(run.context->info));
+    if(!run.results.empty())
+      PrintResults(run.results);
+    if(!run.error.empty()){
+      std::cout<<std::format("Failed: {}\n",run.error);
+      passed=false;
+    }
+    if(run.optimiser)
+      std::cout<<run.optimiser->Report()<<"\n";
+    run.pipelineCache->Save();
+  }
+
+  std::cout<<std::format("\n{:<14}{:>10}{:>12}\n","scenario","devices","iter/s");
+  for(size_t scenario=0;scenario<selected.size();scenario++){
+    const Result *first=nullptr;
+    uint32_t count=0;
+    double throughput=0.0;
+    for(auto &run:runs){
+      if(scenario>=run.results.size())
+        continue;
+      first=first?first:&run.results[scenario];
+      count++;
+      throughput+=run.results[scenario].throughput;
+    }
+    if(first)
+      std::cout<<std::format("{:<14}{:>10}{:>12.1f}\n",first->scenario,count,throughput);
+  }
+  std::cout<<std::format("{} devices in {:.2f} s\n",runs.size(),seconds);
+
+  if(!options.jsonPath.empty()){
+    std::ofstream file(options.jsonPath);
+    if(!file.is_open())
+      throw std::runtime_error("Unable to open benchmark output");
+    file<<std::format("{{\"seconds\":{},\"devices\":[",seconds);
+    for(size_t index=0;index<runs.size();index++){
+      auto &run=runs[index];
+      file<<std::format("{}\n{}",index>0?",":"",DeviceJson(run.context->info,options,run.results,run.error));
+    }
+    file<<"\n]}\n";
+  }
+  return passed;
+}
+#pragma endregion
+
+int main(int argc,char **argv){
+  try{
+    auto options=ParseOptions(argc,argv);
+    if(options.meshOptimiser){
+      RunMeshOptimiser(options);
+      return 0;
+    }
+
+    auto entries=ScenarioEntries();
+    std::erase_if(entries,[](const ScenarioEntry &entry){
+      return !entry.valid;
+    });
+
+    std::vector<const ScenarioEntry *> selected;
+    for(auto &name:options.scenarios){
+      auto count=selected.size();
+      for(auto &entry:entries){
+        if(name==entry.scenario||name==std::format("{}/{}",entry.scenario,entry.variant))
+          selected.push_back(&entry);
+      }
+      if(selected.size()==count)
+        throw std::runtime_error(std::format("Unknown scenario {}",name));
+    }
+    if(selected.empty()){
+      for(auto &entry:entries)
+        selected.push_back(&entry);
+    }
+
+    HeadlessDevice context(options.validation);
+    if(options.list){
+      for(size_t index=0;index<context.devices.size();index++)
+        std::cout<<std::format("{}: {}\n",index,Describe(context.devices[index]));
+      return 0;
+    }
+
+    std::unique_ptr<ShaderCompiler> compiler;
+    if(!options.glslPath.empty()){
+      compiler=std::make_unique<ShaderCompiler>(options.glslPath,options.shaderCachePath);
+      compiler->CompileScenarioShaders();
+      std::cout<<std::format("Shaders: {}\n",compiler->Stats());
+    }
+
+    if(options.allDevices){
+      auto indices=context.Matching(options.deviceName,options.driver);
+      if(indices.empty())
+        throw std::runtime_error("No device matches the name/driver filter");
+      return RunAllDevices(indices,selected,compiler.get(),options)?0:1;
+    }
+
+    context.Open(options.deviceName,options.driver);
+    context.shaderPath=options.shaderPath;
+    context.compiler=compiler.get();
+    std::unique_ptr<SpirvOptimiser> optimiser;
+    if(options.optimiseSpirv){
+      optimiser=std::make_unique<SpirvOptimiser>(SpirvPasses{},options.compareSpirv);
+      context.optimiser=optimiser.get();
+    }
+    std::cout<<std::format("Device {}\n",Describe(context.info));
+    std::cout<<std::format("Async compute {}\n",context.queues->AsyncCompute());
+    PipelineCache pipelineCache(context.device,context.dispatch,context.info.properties,options.pipelineCachePath);
+    context.pipelineCache=&pipelineCache;
+    std::cout<<std::format("Pipeline cache {} bytes loaded from {}\n",pipelineCache.LoadedBytes(),pipelineCache.Path().string());
+    if(options.dispatch){
+      RunDispatch(context,options);
+      return 0;
+    }
+    if(options.pipelines){
+      RunPipelines(context);
+      std::cout<<std::format("Pipeline cache {} bytes saved\n",pipelineCache.Save());
+      return 0;
+    }
+    if(options.primitives)
+      return RunPrimitives(context,options)?0:1;
+
+    std::vector<Result> results;
+    for(auto entry:selected){
+      std::cout<<std::format("Running {}/{}: {} warm-up, {} timed\n",entry->scenario,entry->variant,options.warmup,options.iterations);
+      results.push_back(RunScenario(*entry,context,options));
+    }
+
+    PrintResults(results);
+    pipelineCache.Save();
+    if(optimiser)
+      std::cout<<optimiser->Report()<<"\n";
+    if(!options.jsonPath.empty())
+      WriteJson(options.jsonPath,context.info,options,results);
+  }catch(const std::exception &exception){
+    std::cerr<<exception.what()<<"\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"HeadlessDevice.h"
+#include"TracedCommands.h"
+
+//One descriptor buffer holding every sampled image, sampler and storage
+//buffer the shaders can reach, as set 0 of a single layout:
+//
+//  binding 0  texture2D images[]    partially bound
+//  binding 1  sampler samplers[]    partially bound
+//  binding 2  buffer buffers[]      partially bound, variable count
+//
+//A resource gets an index into its array when it is added and keeps it until
+//it is removed, shaders take the indices from push constants and declare the
+//arrays unsized with GL_EXT_nonuniform_qualifier. The heap is bound once per
+//command buffer, drawing with another material after that is a
+//vkCmdPushConstants, no rebind and no new offset.
+//
+//Descriptors go straight into the mapped heap with vkGetDescriptorEXT. Only
+//the last binding of a layout may have a variable count, so the image and
+//sampler arrays are sized to their capacity and rely on partial binding.
+//Overwriting a slot the device may still read is up to the caller, as with
+//any mapped buffer.
+
+enum class BindlessArray:uint32_t{
+  Images=0,
+  Samplers=1,
+  Buffers=2
+};
+
+struct BindlessCapacity{
+  uint32_t images=1024;
+  uint32_t samplers=32;
+  uint32_t buffers=1024;
+};
+
+class BindlessHeap{
+  struct Array{
+    VkDescriptorType type;
+    uint32_t capacity;
+    VkDeviceSize offset=0;
+    size_t descriptorSize=0;
+    //Never handed out so far, everything below is in use or in free
+    uint32_t next=0;
+    std::vector<uint32_t> free;
+  };
+
+  HeadlessDevice &context;
+  std::array<Array,3> arrays;
+  VkPushConstantRange pushConstants;
+  VkDescriptorSetLayout setLayout=nullptr;
+  VkPipelineLayout pipelineLayout=nullptr;
+  VkBuffer buffer=nullptr;
+  VmaAllocation allocation=nullptr;
+  VmaAllocationInfo allocationInfo={};
+  VkDeviceAddress address=0;
+  VkDeviceSize size=0;
+
+  static constexpr VkBufferUsageFlags Usage=
+    VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT|VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+
+  uint32_t Allocate(BindlessArray kind){
+    auto &array=arrays[(uint32_t)kind];
+    if(!array.free.empty()){
+      auto index=array.free.back();
+      array.free.pop_back();
+      return index;
+    }
+    if(array.next==array.capacity)
+      throw std::runtime_error(std::format("Bindless heap array {} is full at {} descriptors",(uint32_t)kind,array.capacity));
+    return array.next++;
+  }
+
+  void Write(BindlessArray kind,uint32_t index,const VkDescriptorGetInfoEXT &info){
+    auto &array=arrays[(uint32_t)kind];
+    context.GetDescriptor(info,array.descriptorSize,buffer,allocationInfo,array.offset+index*array.descriptorSize);
+  }
+
+public:
+  //pushConstantSize bytes of push constants, visible to every stage, come
+  //with the heap's pipeline layout
+  BindlessHeap(HeadlessDevice &context,uint32_t pushConstantSize,const BindlessCapacity &capacity={}):
+    context(context),
+    arrays({{
+      {.type=VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,.capacity=capacity.images},
+      {.type=VK_DESCRIPTOR_TYPE_SAMPLER,.capacity=capacity.samplers},
+      {.type=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,.capacity=capacity.buffers}
+    }}),
+    pushConstants({
+      .stageFlags=VK_SHADER_STAGE_ALL,
+      .offset=0,
+      .size=pushConstantSize
+    }){
+    if(!context.bindless)
+      throw std::runtime_error("Device does not support runtime descriptor arrays with partially bound, variable count bindings");
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    std::vector<VkDescriptorBindingFlags> bindingFlags;
+    for(uint32_t binding=0;binding<arrays.size();binding++){
+      bindings.push_back({
+        .binding=binding,
+        .descriptorType=arrays[binding].type,
+        .descriptorCount=arrays[binding].capacity,
+        .stageFlags=VK_SHADER_STAGE_ALL,
+        .pImmutableSamplers=nullptr
+      });
+      bindingFlags.push_back(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
+    }
+    bindingFlags.back()|=VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    setLayout=context.CreateSetLayout(bindings,VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT,bindingFlags);
+    pipelineLayout=context.CreatePipelineLayout({setLayout},pushConstantSize>0?
+      std::vector<VkPushConstantRange>{pushConstants}:std::vector<VkPushConstantRange>{});
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceProperties2 deviceProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext=&descriptorBufferProperties
+    };
+    vkGetPhysicalDeviceProperties2(context.physicalDevice,&deviceProperties);
+    arrays[(uint32_t)BindlessArray::Images].descriptorSize=descriptorBufferProperties.sampledImageDescriptorSize;
+    arrays[(uint32_t)BindlessArray::Samplers].descriptorSize=descriptorBufferProperties.samplerDescriptorSize;
+    arrays[(uint32_t)BindlessArray::Buffers].descriptorSize=descriptorBufferProperties.storageBufferDescriptorSize;
+
+    //Sized for the variable count binding at its capacity
+    context.dispatch.vkGetDescriptorSetLayoutSizeEXT(context.device,setLayout,&size);
+    for(uint32_t binding=0;binding<arrays.size();binding++)
+      context.dispatch.vkGetDescriptorSetLayoutBindingOffsetEXT(context.device,setLayout,binding,&arrays[binding].offset);
+
+    buffer=context.CreateBuffer(std::max<VkDeviceSize>(size,256),Usage,allocation,allocationInfo);
+    address=context.BufferAddress(buffer);
+  }
+
+  BindlessHeap(const BindlessHeap &)=delete;
+  BindlessHeap &operator=(const BindlessHeap &)=delete;
+
+  ~BindlessHeap(){
+    context.DestroyBuffer(buffer,allocation);
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+    context.dispatch.vkDestroyDescriptorSetLayout(context.device,setLayout,nullptr);
+  }
+
+  //For VkShaderCreateInfoEXT, shaders reading the heap take both
+  VkDescriptorSetLayout SetLayout()const{
+    return setLayout;
+  }
+
+  const VkPushConstantRange &PushConstants()const{
+    return pushConstants;
+  }
+
+  VkPipelineLayout PipelineLayout()const{
+    return pipelineLayout;
+  }
+
+  VkDeviceSize Bytes()const{
+    return size;
+  }
+
+  uint32_t AddImage(VkImageView view,VkImageLayout layout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+    auto index=Allocate(BindlessArray::Images);
+    VkDescriptorImageInfo imageInfo={
+      .sampler=VK_NULL_HANDLE,
+      .imageView=view,
+      .imageLayout=layout
+    };
+    Write(BindlessArray::Images,index,{
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+      .data={.pSampledImage=&imageInfo}
+    });
+    return index;
+  }
+
+  uint32_t AddSampler(VkSampler sampler){
+    auto index=Allocate(BindlessArray::Samplers);
+    Write(BindlessArray::Samplers,index,{
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=VK_DESCRIPTOR_TYPE_SAMPLER,
+      .data={.pSampler=&sampler}
+    });
+    return index;
+  }
+
+  uint32_t AddBuffer(VkDeviceAddress bufferAddress,VkDeviceSize range){
+    auto index=Allocate(BindlessArray::Buffers);
+    VkDescriptorAddressInfoEXT addressInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+      .pNext=nullptr,
+      .address=bufferAddress,
+      .range=range,
+      .format=VK_FORMAT_UNDEFINED
+    };
+    Write(BindlessArray::Buffers,index,{
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .data={.pStorageBuffer=&addressInfo}
+    });
+    return index;
+  }
+
+  //The slot keeps its old descriptor until it is handed out again, shaders
+  //must not index it in the meantime
+  void Remove(BindlessArray kind,uint32_t index){
+    arrays[(uint32_t)kind].free.push_back(index);
+  }
+
+  //Binds the heap as set 0 of every shader using PipelineLayout()
+  void Bind(TracedCommands &commands,VkPipelineBindPoint bindPoint)const{
+    VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+      .pNext=nullptr,
+      .address=address,
+      .usage=Usage
+    };
+    commands.BindDescriptorBuffers(1,&bufferBindingInfo);
+
+    uint32_t bufferIndice=0;
+    VkDeviceSize bufferOffset=0;
+    commands.SetDescriptorBufferOffsets(bindPoint,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
+  }
+};
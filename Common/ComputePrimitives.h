@@ -0,0 +1,493 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<algorithm>
+#include<utility>
+#include<cstdint>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"HeadlessDevice.h"
+#include"DescriptorLayout.h"
+#include"FrameGraph.h"
+#include"TracedCommands.h"
+
+//Reduction, exclusive scan, stream compaction and radix sort over storage
+//buffers of uint32_t. Each primitive adds a chain of compute passes to a
+//frame graph, which orders them and puts the barriers between them:
+//
+//  graph.Reset();
+//  auto values=graph.ImportBuffer("Values",buffer);
+//  primitives.Begin(graph);
+//  primitives.ExclusiveScan({values,buffer,size},{offsets,offsetBuffer,size},count);
+//  graph.Submit(queues);
+//
+//The kernels are PrimitivesComp.glsl. A workgroup reduces or scans a tile of
+//1024 elements with subgroup arithmetic. Longer scans either reduce every
+//tile, scan the tile sums the same way and scan every tile again from its
+//offset, or, with 64 bit buffer atomics, run as one pass in which each tile
+//looks back at the sums its predecessors published. Compaction keeps the
+//values with (value&mask)==match in their order and writes how many it kept
+//to a buffer of its own. The sort is a stable LSD radix sort of 4 bits a
+//pass: a digit histogram per tile, a scan of all the histograms, a scatter.
+//
+//Every dispatch writes its descriptors into the primitives' descriptor
+//buffer when it is added, the graph of the previous Begin() has to have
+//completed by then. Sums wrap around at 2^32, as do the CPU references at the
+//end of the file.
+
+//A buffer of uint32_t the primitives read or write, imported into the graph
+//by the caller. The descriptor covers size bytes.
+struct PrimitiveBuffer{
+  FrameGraphResource resource;
+  VkBuffer buffer;
+  VkDeviceSize size;
+};
+
+enum class ScanMethod{
+  //Tile sums, their scan and a second pass over every tile, recursing while
+  //the sums fill more than one tile
+  ReduceThenScan,
+  //One pass with decoupled look-back, needs HeadlessDevice::int64Atomics
+  LookBack
+};
+
+class ComputePrimitives{
+  //Input, output, offsets from an earlier scan, and the look-back status or
+  //the compacted count
+  using PrimitiveSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<2,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<3,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>>;
+
+  enum class Kernel{
+    Reduce,
+    Scan,
+    ScanLookBack,
+    Clear,
+    Compact,
+    Histogram,
+    Scatter,
+    Count
+  };
+
+  static constexpr std::array<const char *,(size_t)Kernel::Count> KernelShaders={
+    "PrimitiveReduce.spv",
+    "PrimitiveScan.spv",
+    "PrimitiveScanLookBack.spv",
+    "PrimitiveClear.spv",
+    "PrimitiveCompact.spv",
+    "PrimitiveHistogram.spv",
+    "PrimitiveScatter.spv"
+  };
+
+  //As in PrimitivesComp.glsl
+  static constexpr uint32_t WorkgroupSize=256;
+  static constexpr uint32_t Tile=1024;
+  static constexpr uint32_t RadixBits=4;
+  static constexpr uint32_t Radix=1u<<RadixBits;
+  static constexpr uint32_t MinSubgroupSize=4;
+  static constexpr uint32_t FlagPredicate=1;
+  static constexpr uint32_t FlagOffsets=2;
+  //maxComputeWorkGroupCount[0] every device has
+  static constexpr uint32_t MaxTiles=65535;
+  //Dispatches from one Begin() to the next, each takes one set instance of
+  //the descriptor buffer. A sort of the largest capacity needs under 100.
+  static constexpr uint32_t MaxDispatches=256;
+
+  //The push constants
+  struct Parameters{
+    uint32_t count=0;
+    uint32_t shift=0;
+    uint32_t mask=0;
+    uint32_t match=0;
+    uint32_t flags=0;
+  };
+
+  struct Scratch{
+    VkBuffer buffer=nullptr;
+    VmaAllocation allocation=nullptr;
+    VkDeviceSize size=0;
+    FrameGraphResource resource;
+  };
+
+  HeadlessDevice &context;
+  uint32_t capacity;
+  ScanMethod method;
+  DescriptorLayout<PrimitiveSet> setLayout;
+  VkPipelineLayout pipelineLayout=nullptr;
+  std::array<VkShaderEXT,(size_t)Kernel::Count> shaders={};
+
+  VkBuffer descriptorBuffer=nullptr;
+  VmaAllocation descriptorAllocation=nullptr;
+  VmaAllocationInfo descriptorInfo={};
+  VkDeviceAddress descriptorBufferAddress=0;
+  uint32_t dispatches=0;
+
+  //Per level of the reduce-then-scan recursion the tile sums and their scan
+  std::vector<Scratch> sums;
+  std::vector<Scratch> sumOffsets;
+  //The sort's second key buffer, digit counts per tile and their scan
+  Scratch sortKeys;
+  Scratch histogram;
+  Scratch histogramOffsets;
+  //Look-back tile counter and published sums
+  Scratch status;
+  //What the bindings a kernel does not use point at
+  Scratch unused;
+  FrameGraph *graph=nullptr;
+
+  static uint32_t Tiles(uint32_t count){
+    return (count+Tile-1)/Tile;
+  }
+
+  Scratch Allocate(uint32_t words){
+    Scratch scratch;
+    VmaAllocationInfo allocationInfo={};
+    scratch.size=std::max<VkDeviceSize>(words,4)*sizeof(uint32_t);
+    scratch.buffer=context.CreateBuffer(scratch.size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,scratch.allocation,allocationInfo);
+    return scratch;
+  }
+
+  void Free(Scratch &scratch){
+    if(scratch.buffer)
+      context.DestroyBuffer(scratch.buffer,scratch.allocation);
+    scratch={};
+  }
+
+  void Import(Scratch &scratch,const char *name){
+    if(scratch.buffer)
+      scratch.resource=graph->ImportBuffer(name,scratch.buffer);
+  }
+
+  static PrimitiveBuffer View(const Scratch &scratch){
+    return {scratch.resource,scratch.buffer,scratch.size};
+  }
+
+  //One kernel as a pass of its own, bindings without a buffer get the unused
+  //scratch buffer
+  void Dispatch(const char *name,Kernel kernel,uint32_t groups,const Parameters &parameters,
+    const PrimitiveBuffer *input,const PrimitiveBuffer *output,
+    const PrimitiveBuffer *offsets=nullptr,const PrimitiveBuffer *extra=nullptr){
+
+    if(!graph)
+      throw std::runtime_error("ComputePrimitives used before Begin()");
+    if(dispatches>=MaxDispatches)
+      throw std::runtime_error(std::format("More than {} primitive dispatches since Begin()",MaxDispatches));
+
+    VkDeviceSize descriptorOffset=dispatches++*setLayout.Stride();
+    auto placeholder=View(unused);
+    auto Address=[&](const PrimitiveBuffer *buffer){
+      return context.BufferAddress((buffer?buffer:&placeholder)->buffer);
+    };
+    auto Range=[&](const PrimitiveBuffer *buffer){
+      return (buffer?buffer:&placeholder)->size;
+    };
+    auto writer=setLayout.Writer(descriptorBuffer,descriptorInfo,descriptorOffset);
+    writer.Buffer<0>(Address(input),Range(input));
+    writer.Buffer<1>(Address(output),Range(output));
+    writer.Buffer<2>(Address(offsets),Range(offsets));
+    writer.Buffer<3>(Address(extra),Range(extra));
+
+    auto shader=shaders[(size_t)kernel];
+    graph->AddPass(name,QueueType::Compute,
+      [&](FrameGraph::PassBuilder &pass){
+        if(input)
+          pass.Read(input->resource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+        if(offsets)
+          pass.Read(offsets->resource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+        if(output)
+          pass.Write(output->resource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        if(extra)
+          pass.Write(extra->resource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT|VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+      },
+      [this,shader,descriptorOffset,parameters,groups](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+        commands.BindShaders(1,&stageFlags,&shader);
+
+        VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+          .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+          .pNext=nullptr,
+          .address=descriptorBufferAddress,
+          .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+        };
+        commands.BindDescriptorBuffers(1,&bufferBindingInfo);
+        uint32_t bufferIndice=0;
+        commands.SetDescriptorBufferOffsets(VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&descriptorOffset);
+        commands.PushConstants(pipelineLayout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(parameters),&parameters);
+        commands.Dispatch(groups,1,1);
+      });
+  }
+
+  //Reduce-then-scan from the sums of the given recursion level on
+  void ScanLevels(const PrimitiveBuffer &input,const PrimitiveBuffer &output,uint32_t count,size_t level){
+    if(count<=Tile){
+      Dispatch("Scan",Kernel::Scan,1,{.count=count},&input,&output);
+      return;
+    }
+    auto tiles=Tiles(count);
+    auto tileSums=View(sums[level]);
+    auto tileOffsets=View(sumOffsets[level]);
+    Dispatch("Scan tile sums",Kernel::Reduce,tiles,{.count=count},&input,&tileSums);
+    ScanLevels(tileSums,tileOffsets,tiles,level+1);
+    Dispatch("Scan tiles",Kernel::Scan,tiles,{.count=count,.flags=FlagOffsets},&input,&output,&tileOffsets);
+  }
+
+  void ScanLookBack(const PrimitiveBuffer &input,const PrimitiveBuffer &output,uint32_t count){
+    auto tiles=Tiles(count);
+    //The tile counter, its padding and a 64 bit word per tile start at zero
+    uint32_t words=2+2*tiles;
+    auto tileStatus=View(status);
+    Dispatch("Clear look-back",Kernel::Clear,(words+WorkgroupSize-1)/WorkgroupSize,{.count=words},
+      nullptr,nullptr,nullptr,&tileStatus);
+    Dispatch("Scan look-back",Kernel::ScanLookBack,tiles,{.count=count},&input,&output,nullptr,&tileStatus);
+  }
+
+  void Scan(const PrimitiveBuffer &input,const PrimitiveBuffer &output,uint32_t count,size_t level){
+    if(method==ScanMethod::LookBack&&count>Tile)
+      ScanLookBack(input,output,count);
+    else
+      ScanLevels(input,output,count,level);
+  }
+
+  void CheckCount(uint32_t count)const{
+    if(count>capacity)
+      throw std::runtime_error(std::format("{} elements is more than the primitives' capacity of {}",count,capacity));
+  }
+
+public:
+  //The method ExclusiveScan() uses unless told otherwise
+  static ScanMethod Preferred(const HeadlessDevice &context){
+    return context.int64Atomics?ScanMethod::LookBack:ScanMethod::ReduceThenScan;
+  }
+
+  ComputePrimitives(HeadlessDevice &context,uint32_t capacity):
+    ComputePrimitives(context,capacity,Preferred(context)){
+  }
+
+  //Scratch memory is allocated for up to capacity elements
+  ComputePrimitives(HeadlessDevice &context,uint32_t capacity,ScanMethod method):
+    context(context),capacity(capacity),method(method),setLayout(context){
+
+    constexpr VkSubgroupFeatureFlags required=VK_SUBGROUP_FEATURE_BASIC_BIT|VK_SUBGROUP_FEATURE_ARITHMETIC_BIT|
+      VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    if((context.subgroupOperations&required)!=required)
+      throw std::runtime_error("Device lacks basic, arithmetic or ballot subgroup operations in compute shaders");
+    //The kernels order elements by subgroup and need every subgroup full,
+    //so they are created with full subgroups of the device's default size
+    if(!context.fullSubgroups)
+      throw std::runtime_error("Device does not support subgroupSizeControl and computeFullSubgroups in compute shaders");
+    if(context.subgroupSize<MinSubgroupSize)
+      throw std::runtime_error(std::format("Subgroups of {} invocations are narrower than the {} the primitives need",
+        context.subgroupSize,MinSubgroupSize));
+    if(WorkgroupSize%context.subgroupSize!=0||WorkgroupSize>context.maxComputeWorkgroupSubgroups*context.subgroupSize)
+      throw std::runtime_error(std::format("Workgroups of {} cannot be split into full subgroups of {}",
+        WorkgroupSize,context.subgroupSize));
+    if(method==ScanMethod::LookBack&&!context.int64Atomics)
+      throw std::runtime_error("Device does not support shaderInt64 and shaderBufferInt64Atomics, look-back scans need them");
+
+    //Longest scan: the input, or the sort's histograms of every tile
+    uint32_t scanCapacity=std::max(capacity,Radix*Tiles(capacity));
+    if(capacity==0||Tiles(scanCapacity)>MaxTiles)
+      throw std::runtime_error(std::format("Capacity of {} elements is outside 1 to {}",capacity,MaxTiles*Tile));
+
+    VkPushConstantRange pushConstants={
+      .stageFlags=VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset=0,
+      .size=sizeof(Parameters)
+    };
+    auto setLayoutHandle=setLayout.Handle();
+    pipelineLayout=context.CreatePipelineLayout({setLayoutHandle},{pushConstants});
+
+    for(size_t kernel=0;kernel<KernelShaders.size();kernel++){
+      bool lookBack=kernel==(size_t)Kernel::ScanLookBack||kernel==(size_t)Kernel::Clear;
+      if(lookBack&&method!=ScanMethod::LookBack)
+        continue;
+      auto code=context.Shader(KernelShaders[kernel]);
+      PrimitiveSet::Check(code,0);
+      VkShaderRequiredSubgroupSizeCreateInfoEXT requiredSubgroupSize={
+        .sType=VK_STRUCTURE_TYPE_SHADER_REQUIRED_SUBGROUP_SIZE_CREATE_INFO_EXT,
+        .pNext=nullptr,
+        .requiredSubgroupSize=context.subgroupSize
+      };
+      VkShaderCreateInfoEXT shaderCreateInfo={
+        .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+        .pNext=&requiredSubgroupSize,
+        .flags=VK_SHADER_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT,
+        .stage=VK_SHADER_STAGE_COMPUTE_BIT,
+        .nextStage=0,
+        .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+        .codeSize=code.size()*sizeof(uint32_t),
+        .pCode=code.data(),
+        .pName="main",
+        .setLayoutCount=1,
+        .pSetLayouts=&setLayoutHandle,
+        .pushConstantRangeCount=1,
+        .pPushConstantRanges=&pushConstants,
+        .pSpecializationInfo=nullptr
+      };
+      auto result=context.CreateShaders(1,&shaderCreateInfo,&shaders[kernel]);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error(std::format("Failed to create shader object {}",KernelShaders[kernel]));
+    }
+
+    descriptorBuffer=context.CreateBuffer(MaxDispatches*setLayout.Stride(),
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,descriptorAllocation,descriptorInfo);
+    descriptorBufferAddress=context.BufferAddress(descriptorBuffer);
+
+    //Level 0 always exists, compaction keeps its tile counts there
+    uint32_t count=scanCapacity;
+    do{
+      count=Tiles(count);
+      sums.push_back(Allocate(count));
+      sumOffsets.push_back(Allocate(count));
+    }while(count>Tile);
+    sortKeys=Allocate(capacity);
+    histogram=Allocate(Radix*Tiles(capacity));
+    histogramOffsets=Allocate(Radix*Tiles(capacity));
+    if(method==ScanMethod::LookBack)
+      status=Allocate(2+2*Tiles(scanCapacity));
+    unused=Allocate(4);
+  }
+
+  ComputePrimitives(const ComputePrimitives &)=delete;
+  ComputePrimitives &operator=(const ComputePrimitives &)=delete;
+
+  ~ComputePrimitives(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    for(auto &scratch:sums)
+      Free(scratch);
+    for(auto &scratch:sumOffsets)
+      Free(scratch);
+    Free(sortKeys);
+    Free(histogram);
+    Free(histogramOffsets);
+    Free(status);
+    Free(unused);
+    context.DestroyBuffer(descriptorBuffer,descriptorAllocation);
+    for(auto shader:shaders){
+      if(shader)
+        context.DestroyShader(shader);
+    }
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+  }
+
+  ScanMethod Method()const{
+    return method;
+  }
+
+  uint32_t Capacity()const{
+    return capacity;
+  }
+
+  //Imports the scratch buffers into a graph that was just reset and starts
+  //writing descriptors from the front of the descriptor buffer again
+  void Begin(FrameGraph &frameGraph){
+    graph=&frameGraph;
+    dispatches=0;
+    for(auto &scratch:sums)
+      Import(scratch,"Tile sums");
+    for(auto &scratch:sumOffsets)
+      Import(scratch,"Tile offsets");
+    Import(sortKeys,"Sort keys");
+    Import(histogram,"Digit counts");
+    Import(histogramOffsets,"Digit offsets");
+    Import(status,"Look-back status");
+    Import(unused,"Unused");
+  }
+
+  //Sum of the first count values to output[0]
+  void Reduce(const PrimitiveBuffer &input,const PrimitiveBuffer &output,uint32_t count){
+    CheckCount(count);
+    auto source=input;
+    size_t level=0;
+    while(count>Tile){
+      auto tiles=Tiles(count);
+      auto target=View(sums[level++]);
+      Dispatch("Reduce tiles",Kernel::Reduce,tiles,{.count=count},&source,&target);
+      source=target;
+      count=tiles;
+    }
+    Dispatch("Reduce",Kernel::Reduce,1,{.count=count},&source,&output);
+  }
+
+  //output[i] is the sum of input[0] to input[i-1]
+  void ExclusiveScan(const PrimitiveBuffer &input,const PrimitiveBuffer &output,uint32_t count){
+    CheckCount(count);
+    if(count>0)
+      Scan(input,output,count,0);
+  }
+
+  //Writes the values with (value&mask)==match to output in their order and
+  //their number to kept[0]
+  void Compact(const PrimitiveBuffer &input,const PrimitiveBuffer &output,const PrimitiveBuffer &kept,
+    uint32_t count,uint32_t mask,uint32_t match){
+
+    CheckCount(count);
+    auto tiles=std::max(Tiles(count),1u);
+    auto tileCounts=View(sums[0]);
+    auto tileOffsets=View(sumOffsets[0]);
+    Dispatch("Compact count",Kernel::Reduce,tiles,{.count=count,.mask=mask,.match=match,.flags=FlagPredicate},
+      &input,&tileCounts);
+    Scan(tileCounts,tileOffsets,tiles,1);
+    Dispatch("Compact",Kernel::Compact,tiles,{.count=count,.mask=mask,.match=match},
+      &input,&output,&tileOffsets,&kept);
+  }
+
+  //Sorts the first count keys in place, ascending and stable
+  void Sort(const PrimitiveBuffer &keys,uint32_t count){
+    CheckCount(count);
+    if(count==0)
+      return;
+    auto tiles=Tiles(count);
+    auto temporary=View(sortKeys);
+    auto counts=View(histogram);
+    auto positions=View(histogramOffsets);
+    //An even number of passes, the last one scatters back into keys
+    const PrimitiveBuffer *source=&keys;
+    const PrimitiveBuffer *target=&temporary;
+    for(uint32_t shift=0;shift<32;shift+=RadixBits){
+      Dispatch("Sort histogram",Kernel::Histogram,tiles,{.count=count,.shift=shift},source,&counts);
+      Scan(counts,positions,tiles*Radix,0);
+      Dispatch("Sort scatter",Kernel::Scatter,tiles,{.count=count,.shift=shift},source,target,&positions);
+      std::swap(source,target);
+    }
+  }
+};
+
+//What the primitives compute, on the host
+
+inline uint32_t ReduceReference(const std::vector<uint32_t> &values){
+  uint32_t sum=0;
+  for(auto value:values)
+    sum+=value;
+  return sum;
+}
+
+inline std::vector<uint32_t> ExclusiveScanReference(const std::vector<uint32_t> &values){
+  std::vector<uint32_t> prefixes(values.size());
+  uint32_t sum=0;
+  for(size_t index=0;index<values.size();index++){
+    prefixes[index]=sum;
+    sum+=values[index];
+  }
+  return prefixes;
+}
+
+inline std::vector<uint32_t> CompactReference(const std::vector<uint32_t> &values,uint32_t mask,uint32_t match){
+  std::vector<uint32_t> kept;
+  for(auto value:values){
+    if((value&mask)==match)
+      kept.push_back(value);
+  }
+  return kept;
+}
+
+inline std::vector<uint32_t> SortReference(std::vector<uint32_t> values){
+  std::sort(values.begin(),values.end());
+  return values;
+}
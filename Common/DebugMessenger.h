@@ -0,0 +1,288 @@
+#pragma once
+#include<array>
+#include<atomic>
+#include<thread>
+#include<vector>
+#include<string>
+#include<cstring>
+#include<cstdint>
+#include<iostream>
+#include<format>
+#include<iterator>
+#include<utility>
+#include<vulkan/vulkan.h>
+
+//Debug messenger sink that keeps the callback cheap. Validation calls back
+//from inside driver entry points on whatever thread made the call, so the
+//callback only copies the message into a fixed ring buffer and returns; a
+//background thread formats and writes everything to std::cerr in batches.
+//
+//Nothing is allocated and no lock is taken on the callback path. Messages
+//with a messageIdNumber already seen are only counted, the counts are
+//printed when the sink shuts down. A full ring makes producers wait for the
+//drain thread instead of dropping messages.
+//
+//The sink has to outlive the instance and every messenger created with it.
+//The ring is about a megabyte, allocate the sink on the heap.
+class DebugMessenger{
+public:
+  static constexpr size_t Capacity=256;
+  static constexpr size_t MessageSize=4096;
+  static constexpr size_t IdNameSize=128;
+  static constexpr size_t DedupSize=1024;
+
+private:
+  struct Message{
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+    VkDebugUtilsMessageTypeFlagsEXT types;
+    //Slot in the dedup table, ~0u for messages that are never deduplicated
+    uint32_t dedupIndex;
+    bool truncated;
+    char idName[IdNameSize];
+    char text[MessageSize];
+  };
+
+  struct Slot{
+    std::atomic<uint64_t> sequence;
+    Message message;
+  };
+
+  static constexpr int64_t EmptyKey=INT64_MIN;
+
+  //Bounded MPSC queue: a slot is free for position p once its sequence is p,
+  //and holds a message for the consumer once it is p+1
+  std::array<Slot,Capacity> slots;
+  alignas(64) std::atomic<uint64_t> tail=0;
+  alignas(64) uint64_t head=0;
+  std::atomic<bool> sleeping=false;
+  std::atomic<bool> running=true;
+
+  //Open addressed messageIdNumber -> count table shared by all producers
+  std::array<std::atomic<int64_t>,DedupSize> keys;
+  std::array<std::atomic<uint32_t>,DedupSize> counts;
+  //Written by the drain thread only
+  std::array<std::array<char,IdNameSize>,DedupSize> names={};
+
+  std::atomic<uint64_t> received=0;
+  std::atomic<uint64_t> written=0;
+  std::vector<char> output;
+  std::thread drain;
+
+  static void Copy(char *target,size_t size,const char *source,bool *truncated=nullptr){
+    if(!source)
+      source="";
+    size_t length=strnlen(source,size);
+    if(length==size)
+      length=size-1;
+    memcpy(target,source,length);
+    target[length]='\0';
+    if(truncated)
+      *truncated=source[length]!='\0';
+  }
+
+  static const char *SeverityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity){
+    switch(severity){
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+      return "Verbose";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+      return "Info";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+      return "Warning";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
+      return "Error";
+    default:
+      return "Unknown";
+    }
+  }
+
+  //A message can carry several type bits, each is written after the severity
+  void AppendTypes(VkDebugUtilsMessageTypeFlagsEXT types){
+    static constexpr std::array<std::pair<VkDebugUtilsMessageTypeFlagsEXT,const char *>,4> TypeNames={{
+      {VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT,"General"},
+      {VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT,"Validation"},
+      {VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,"Performance"},
+      {VK_DEBUG_UTILS_MESSAGE_TYPE_DEVICE_ADDRESS_BINDING_BIT_EXT,"Device address binding"}
+    }};
+    for(auto &[bit,name]:TypeNames){
+      if(types&bit)
+        std::format_to(std::back_inserter(output),", {}",name);
+    }
+  }
+
+  //Returns true when the message should be queued, false when it is a
+  //repeat that has only been counted. Id 0 is used by the loader and layers
+  //for unrelated general messages, those are never deduplicated.
+  bool Count(int32_t messageIdNumber,uint32_t &dedupIndex){
+    dedupIndex=~0u;
+    if(messageIdNumber==0)
+      return true;
+
+    uint32_t hash=(uint32_t)messageIdNumber*2654435761u;
+    for(uint32_t probe=0;probe<DedupSize;probe++){
+      uint32_t index=(hash+probe)&(DedupSize-1);
+      int64_t key=keys[index].load(std::memory_order_acquire);
+      //A failed claim leaves the winner's id in key
+      if(key==EmptyKey&&keys[index].compare_exchange_strong(key,messageIdNumber,std::memory_order_acq_rel))
+        key=messageIdNumber;
+      if(key!=messageIdNumber)
+        continue;
+
+      dedupIndex=index;
+      return counts[index].fetch_add(1,std::memory_order_relaxed)==0;
+    }
+
+    //Table full, fall back to passing everything through
+    return true;
+  }
+
+  void Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity,VkDebugUtilsMessageTypeFlagsEXT types,
+    const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,uint32_t dedupIndex){
+
+    uint64_t position=tail.load(std::memory_order_relaxed);
+    Slot *slot=nullptr;
+    for(;;){
+      slot=&slots[position%Capacity];
+      uint64_t sequence=slot->sequence.load(std::memory_order_acquire);
+      int64_t difference=(int64_t)(sequence-position);
+      if(difference==0){
+        if(tail.compare_exchange_weak(position,position+1,std::memory_order_relaxed))
+          break;
+      }else if(difference<0){
+        //Full, give the drain thread a chance to catch up
+        Wake();
+        std::this_thread::yield();
+        position=tail.load(std::memory_order_relaxed);
+      }else{
+        position=tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    auto &message=slot->message;
+    message.severity=severity;
+    message.types=types;
+    message.dedupIndex=dedupIndex;
+    Copy(message.idName,IdNameSize,pCallbackData->pMessageIdName);
+    Copy(message.text,MessageSize,pCallbackData->pMessage,&message.truncated);
+    slot->sequence.store(position+1,std::memory_order_release);
+
+    Wake();
+  }
+
+  //Pairs with the fence in Run(), either the producer sees the drain thread
+  //going to sleep or the drain thread sees the published slot
+  void Wake(){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_relaxed)&&sleeping.exchange(false,std::memory_order_acq_rel))
+      sleeping.notify_one();
+  }
+
+  //Formats everything queued so far into one write, returns false if the
+  //queue was empty
+  bool DrainOnce(){
+    output.clear();
+    uint64_t count=0;
+
+    for(;;){
+      auto &slot=slots[head%Capacity];
+      if(slot.sequence.load(std::memory_order_acquire)!=head+1)
+        break;
+
+      auto &message=slot.message;
+      if(message.dedupIndex!=~0u)
+        memcpy(names[message.dedupIndex].data(),message.idName,IdNameSize);
+      std::format_to(std::back_inserter(output),"Validation Layer: [{}",SeverityName(message.severity));
+      AppendTypes(message.types);
+      std::format_to(std::back_inserter(output),"] {}{}\n",message.text,message.truncated?" (truncated)":"");
+
+      slot.sequence.store(head+Capacity,std::memory_order_release);
+      head++;
+      count++;
+    }
+
+    if(count==0)
+      return false;
+
+    std::cerr.write(output.data(),output.size());
+    std::cerr.flush();
+    written.fetch_add(count,std::memory_order_release);
+    return true;
+  }
+
+  void Run(){
+    while(running.load(std::memory_order_acquire)){
+      if(DrainOnce())
+        continue;
+
+      //Publish the intent to sleep, then check once more so a message pushed
+      //in between is not left waiting
+      sleeping.store(true,std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(DrainOnce()){
+        sleeping.store(false,std::memory_order_relaxed);
+        continue;
+      }
+      if(!running.load(std::memory_order_seq_cst))
+        break;
+      sleeping.wait(true,std::memory_order_acquire);
+    }
+    DrainOnce();
+  }
+
+public:
+  DebugMessenger(){
+    for(uint64_t index=0;index<Capacity;index++)
+      slots[index].sequence.store(index,std::memory_order_relaxed);
+    for(uint32_t index=0;index<DedupSize;index++){
+      keys[index].store(EmptyKey,std::memory_order_relaxed);
+      counts[index].store(0,std::memory_order_relaxed);
+    }
+    output.reserve(Capacity*256);
+    drain=std::thread(&DebugMessenger::Run,this);
+  }
+
+  DebugMessenger(const DebugMessenger &)=delete;
+  DebugMessenger &operator=(const DebugMessenger &)=delete;
+
+  ~DebugMessenger(){
+    running.store(false,std::memory_order_seq_cst);
+    sleeping.store(false,std::memory_order_seq_cst);
+    sleeping.notify_one();
+    drain.join();
+
+    std::string summary;
+    for(uint32_t index=0;index<DedupSize;index++){
+      auto count=counts[index].load(std::memory_order_relaxed);
+      if(count>1)
+        summary+=std::format("Validation Layer: {} (0x{:08x}) repeated {} times\n",
+          names[index].data(),(uint32_t)keys[index].load(std::memory_order_relaxed),count-1);
+    }
+    std::cerr<<summary;
+    std::cerr.flush();
+  }
+
+  static VKAPI_ATTR VkBool32 VKAPI_CALL Callback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    VkDebugUtilsMessageTypeFlagsEXT messageType,
+    const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
+    void *pUserData){
+
+    auto sink=reinterpret_cast<DebugMessenger *>(pUserData);
+    sink->received.fetch_add(1,std::memory_order_relaxed);
+
+    uint32_t dedupIndex;
+    if(sink->Count(pCallbackData->messageIdNumber,dedupIndex))
+      sink->Push(messageSeverity,messageType,pCallbackData,dedupIndex);
+
+    return VK_FALSE; // Return VK_TRUE to terminate the application
+  }
+
+  //Messages seen by the callback, repeats included
+  uint64_t Received()const{
+    return received.load(std::memory_order_relaxed);
+  }
+
+  //Messages written out by the drain thread, repeats excluded
+  uint64_t Written()const{
+    return written.load(std::memory_order_acquire);
+  }
+};
@@ -0,0 +1,317 @@
+#pragma once
+#include<array>
+#include<algorithm>
+#include<vector>
+#include<cstdint>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"DeviceDispatch.h"
+#include"Spirv.h"
+
+class HeadlessDevice;
+class TraceWriter;
+
+//Descriptor set layouts declared as C++ types instead of binding literals:
+//
+//  using ComputeSet=DescriptorSet<
+//    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+//    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>>;
+//
+//The binding array and a hash of it are built at compile time, duplicate
+//binding numbers do not compile. DescriptorLayout<ComputeSet> creates the
+//VkDescriptorSetLayout and reads every binding's offset and descriptor size
+//once; its writers then write a binding with the offset and the descriptor
+//type fixed by the template argument, so writing binding 1 is a
+//vkGetDescriptorEXT to base+offset with nothing looked up. Writing a binding
+//the set does not have, or a buffer to an image binding, does not compile.
+//
+//Check() compares the set against the bindings a shader declares, so the
+//layout and the GLSL cannot drift apart unnoticed.
+//
+//The layout is created either for a HeadlessDevice, that constructor lives in
+//HeadlessDevice.h, or for the raw VkDevice the standalone repros have. Size,
+//offsets and writers are only there for descriptor buffer layouts.
+
+template<uint32_t Index,VkDescriptorType Type,uint32_t Count,VkShaderStageFlags Stages>
+struct DescriptorBinding{
+  static constexpr VkDescriptorSetLayoutBinding Layout={
+    .binding=Index,
+    .descriptorType=Type,
+    .descriptorCount=Count,
+    .stageFlags=Stages,
+    .pImmutableSamplers=nullptr
+  };
+};
+
+template<typename... Bindings>
+struct DescriptorSet{
+  static constexpr size_t Count=sizeof...(Bindings);
+  static constexpr std::array<VkDescriptorSetLayoutBinding,Count> Layout={Bindings::Layout...};
+
+  //Position of a binding number in Layout, Count when the set has none
+  static constexpr size_t Find(uint32_t binding){
+    for(size_t index=0;index<Count;index++){
+      if(Layout[index].binding==binding)
+        return index;
+    }
+    return Count;
+  }
+
+  static constexpr bool Unique(){
+    for(size_t index=0;index<Count;index++){
+      if(Find(Layout[index].binding)!=index)
+        return false;
+    }
+    return true;
+  }
+  static_assert(Unique(),"Descriptor set declares a binding number twice");
+
+  //FNV-1a over every field of every binding, equal sets hash equal
+  static constexpr uint64_t Hash=[]{
+    uint64_t hash=0xcbf29ce484222325ull;
+    auto Mix=[&](uint32_t value){
+      for(int byte=0;byte<4;byte++){
+        hash^=(value>>(byte*8))&0xff;
+        hash*=0x100000001b3ull;
+      }
+    };
+    for(auto &binding:Layout){
+      Mix(binding.binding);
+      Mix((uint32_t)binding.descriptorType);
+      Mix(binding.descriptorCount);
+      Mix(binding.stageFlags);
+    }
+    return hash;
+  }();
+
+  template<uint32_t Binding>
+  static constexpr size_t Slot(){
+    constexpr auto slot=Find(Binding);
+    static_assert(slot<Count,"Descriptor set has no such binding");
+    return slot;
+  }
+
+  template<uint32_t Binding>
+  static constexpr VkDescriptorType Type(){
+    return Layout[Slot<Binding>()].descriptorType;
+  }
+
+  //Throws when the SPIR-V declares a resource in set that the type does not
+  //have. Resources the shader does not use are fine.
+  static void Check(const std::vector<uint32_t> &code,uint32_t set){
+    SpirvModule module(code);
+    for(auto &variable:module.variables){
+      auto descriptorSet=module.Find(variable.id,SpirvModule::DecorationDescriptorSet);
+      auto binding=module.Find(variable.id,SpirvModule::DecorationBinding);
+      if(!descriptorSet||!binding||descriptorSet->value!=set)
+        continue;
+      if(Find(binding->value)==Count)
+        throw std::runtime_error(std::format("Shader declares set {} binding {}, which the layout {:016x} does not have",
+          set,binding->value,Hash));
+    }
+  }
+};
+
+template<typename Set>
+class DescriptorLayout;
+
+//Writes one instance of the set placed at offset in a mapped descriptor
+//buffer from HeadlessDevice::CreateBuffer
+template<typename Set>
+class DescriptorWriter{
+  const DescriptorLayout<Set> &layout;
+  VkBuffer buffer;
+  const VmaAllocationInfo &allocationInfo;
+  VkDeviceSize offset;
+
+  template<uint32_t Binding>
+  void Write(const VkDescriptorDataEXT &data,uint32_t element){
+    constexpr auto slot=Set::template Slot<Binding>();
+    auto size=layout.descriptorSizes[slot];
+    VkDescriptorGetInfoEXT info={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=Set::Layout[slot].descriptorType,
+      .data=data
+    };
+    auto target=offset+layout.offsets[slot]+element*size;
+    if(layout.trace)
+      layout.trace->Descriptor(info,size,buffer,target);
+    layout.dispatch.vkGetDescriptorEXT(layout.device,&info,size,(uint8_t *)allocationInfo.pMappedData+target);
+  }
+
+public:
+  DescriptorWriter(const DescriptorLayout<Set> &layout,VkBuffer buffer,const VmaAllocationInfo &allocationInfo,VkDeviceSize offset):
+    layout(layout),
+    buffer(buffer),
+    allocationInfo(allocationInfo),
+    offset(offset){
+  }
+
+  template<uint32_t Binding>
+  void Buffer(VkDeviceAddress address,VkDeviceSize range,uint32_t element=0){
+    constexpr auto type=Set::template Type<Binding>();
+    static_assert(type==VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER||type==VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      "Binding does not hold buffers");
+    VkDescriptorAddressInfoEXT addressInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+      .pNext=nullptr,
+      .address=address,
+      .range=range,
+      .format=VK_FORMAT_UNDEFINED
+    };
+    VkDescriptorDataEXT data={};
+    if constexpr(type==VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+      data.pUniformBuffer=&addressInfo;
+    else
+      data.pStorageBuffer=&addressInfo;
+    Write<Binding>(data,element);
+  }
+
+  template<uint32_t Binding>
+  void Image(VkImageView view,VkImageLayout imageLayout,uint32_t element=0,VkSampler sampler=VK_NULL_HANDLE){
+    constexpr auto type=Set::template Type<Binding>();
+    static_assert(type==VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE||type==VK_DESCRIPTOR_TYPE_STORAGE_IMAGE||
+      type==VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,"Binding does not hold images");
+    VkDescriptorImageInfo imageInfo={
+      .sampler=sampler,
+      .imageView=view,
+      .imageLayout=imageLayout
+    };
+    VkDescriptorDataEXT data={};
+    if constexpr(type==VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE)
+      data.pSampledImage=&imageInfo;
+    else if constexpr(type==VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+      data.pStorageImage=&imageInfo;
+    else
+      data.pCombinedImageSampler=&imageInfo;
+    Write<Binding>(data,element);
+  }
+
+  template<uint32_t Binding>
+  void Sampler(VkSampler sampler,uint32_t element=0){
+    static_assert(Set::template Type<Binding>()==VK_DESCRIPTOR_TYPE_SAMPLER,"Binding does not hold samplers");
+    VkDescriptorDataEXT data={};
+    data.pSampler=&sampler;
+    Write<Binding>(data,element);
+  }
+};
+
+//The VkDescriptorSetLayout of a DescriptorSet type, for descriptor buffers
+template<typename Set>
+class DescriptorLayout{
+  friend class DescriptorWriter<Set>;
+
+  VkDevice device;
+  const DeviceDispatch &dispatch;
+  //Records the layout and every descriptor written through it when set
+  TraceWriter *trace;
+  VkDescriptorSetLayout layout=nullptr;
+  VkDeviceSize size=0;
+  VkDeviceSize stride=0;
+  std::array<VkDeviceSize,Set::Count> offsets={};
+  std::array<size_t,Set::Count> descriptorSizes={};
+
+  static size_t DescriptorSize(const VkPhysicalDeviceDescriptorBufferPropertiesEXT &properties,VkDescriptorType type){
+    switch(type){
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+      return properties.samplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      return properties.combinedImageSamplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      return properties.sampledImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      return properties.storageImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      return properties.uniformBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      return properties.storageBufferDescriptorSize;
+    default:
+      throw std::runtime_error(std::format("Descriptor type {} is not supported in typed layouts",(uint32_t)type));
+    }
+  }
+
+public:
+  //Without a dispatch table the loader exports are used, which is enough for
+  //anything but a descriptor buffer layout. Only layouts made from a
+  //HeadlessDevice are traced.
+  DescriptorLayout(VkDevice device,VkPhysicalDevice physicalDevice,
+    VkDescriptorSetLayoutCreateFlags flags=VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT,
+    const DeviceDispatch *dispatch=nullptr):
+    device(device),
+    dispatch(dispatch?*dispatch:DeviceDispatch::Exports()),
+    trace(nullptr){
+
+    bool descriptorBuffer=flags&VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+    if(descriptorBuffer&&!this->dispatch.vkGetDescriptorSetLayoutSizeEXT)
+      throw std::runtime_error("Descriptor buffer layouts need the device's dispatch table");
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(Set::Layout.begin(),Set::Layout.end());
+    VkDescriptorSetLayoutCreateInfo descriptorSetInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=flags,
+      .bindingCount=(uint32_t)bindings.size(),
+      .pBindings=bindings.data()
+    };
+    if(this->dispatch.vkCreateDescriptorSetLayout(device,&descriptorSetInfo,nullptr,&layout)!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create descriptor set layout");
+
+    if(!descriptorBuffer)
+      return;
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceProperties2 deviceProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext=&descriptorBufferProperties
+    };
+    vkGetPhysicalDeviceProperties2(physicalDevice,&deviceProperties);
+
+    this->dispatch.vkGetDescriptorSetLayoutSizeEXT(device,layout,&size);
+    auto alignment=std::max<VkDeviceSize>(descriptorBufferProperties.descriptorBufferOffsetAlignment,1);
+    stride=(size+alignment-1)/alignment*alignment;
+    for(size_t slot=0;slot<Set::Count;slot++){
+      this->dispatch.vkGetDescriptorSetLayoutBindingOffsetEXT(device,layout,Set::Layout[slot].binding,&offsets[slot]);
+      descriptorSizes[slot]=DescriptorSize(descriptorBufferProperties,Set::Layout[slot].descriptorType);
+    }
+  }
+
+  //Defined in HeadlessDevice.h, records into the context's trace
+  explicit DescriptorLayout(HeadlessDevice &context,
+    VkDescriptorSetLayoutCreateFlags flags=VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+  DescriptorLayout(const DescriptorLayout &)=delete;
+  DescriptorLayout &operator=(const DescriptorLayout &)=delete;
+
+  ~DescriptorLayout(){
+    dispatch.vkDestroyDescriptorSetLayout(device,layout,nullptr);
+  }
+
+  VkDescriptorSetLayout Handle()const{
+    return layout;
+  }
+
+  //Bytes of descriptor buffer one instance of the set takes
+  VkDeviceSize Size()const{
+    return size;
+  }
+
+  //Distance between instances of the set placed back to back in one
+  //descriptor buffer, Size() rounded up to descriptorBufferOffsetAlignment
+  VkDeviceSize Stride()const{
+    return stride;
+  }
+
+  template<uint32_t Binding>
+  VkDeviceSize Offset()const{
+    return offsets[Set::template Slot<Binding>()];
+  }
+
+  DescriptorWriter<Set> Writer(VkBuffer buffer,const VmaAllocationInfo &allocationInfo,VkDeviceSize offset=0)const{
+    return DescriptorWriter<Set>(*this,buffer,allocationInfo,offset);
+  }
+};
@@ -0,0 +1,377 @@
+#pragma once
+#include<string>
+#include<vulkan/vulkan.h>
+
+//Generated by GenerateDispatch.py from vk.xml, edit its Commands list and
+//rerun instead of editing this file.
+//
+//Device level entry points resolved once per VkDevice with
+//vkGetDeviceProcAddr. Calls through the table go straight to the driver,
+//the exported functions go through the loader's trampoline and its
+//dispatch first.
+struct DeviceDispatch{
+  //VK_VERSION_1_0
+  PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout=nullptr;
+  PFN_vkDestroyDescriptorSetLayout vkDestroyDescriptorSetLayout=nullptr;
+  PFN_vkCreatePipelineLayout vkCreatePipelineLayout=nullptr;
+  PFN_vkDestroyPipelineLayout vkDestroyPipelineLayout=nullptr;
+  PFN_vkCreateSampler vkCreateSampler=nullptr;
+  PFN_vkDestroySampler vkDestroySampler=nullptr;
+  PFN_vkCreateBuffer vkCreateBuffer=nullptr;
+  PFN_vkDestroyBuffer vkDestroyBuffer=nullptr;
+  PFN_vkDeviceWaitIdle vkDeviceWaitIdle=nullptr;
+  PFN_vkCreateShaderModule vkCreateShaderModule=nullptr;
+  PFN_vkDestroyShaderModule vkDestroyShaderModule=nullptr;
+  PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines=nullptr;
+  PFN_vkDestroyPipeline vkDestroyPipeline=nullptr;
+  PFN_vkCreatePipelineCache vkCreatePipelineCache=nullptr;
+  PFN_vkDestroyPipelineCache vkDestroyPipelineCache=nullptr;
+  PFN_vkGetPipelineCacheData vkGetPipelineCacheData=nullptr;
+  PFN_vkGetBufferMemoryRequirements vkGetBufferMemoryRequirements=nullptr;
+  PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers=nullptr;
+  PFN_vkResetCommandBuffer vkResetCommandBuffer=nullptr;
+  PFN_vkBeginCommandBuffer vkBeginCommandBuffer=nullptr;
+  PFN_vkEndCommandBuffer vkEndCommandBuffer=nullptr;
+  PFN_vkCreateQueryPool vkCreateQueryPool=nullptr;
+  PFN_vkDestroyQueryPool vkDestroyQueryPool=nullptr;
+  PFN_vkGetQueryPoolResults vkGetQueryPoolResults=nullptr;
+  PFN_vkCmdBeginQuery vkCmdBeginQuery=nullptr;
+  PFN_vkCmdEndQuery vkCmdEndQuery=nullptr;
+  PFN_vkCmdBindPipeline vkCmdBindPipeline=nullptr;
+  PFN_vkCmdPushConstants vkCmdPushConstants=nullptr;
+  PFN_vkCmdBindIndexBuffer vkCmdBindIndexBuffer=nullptr;
+  PFN_vkCmdDispatch vkCmdDispatch=nullptr;
+  PFN_vkCmdDraw vkCmdDraw=nullptr;
+  PFN_vkCmdDrawIndexed vkCmdDrawIndexed=nullptr;
+  //VK_VERSION_1_2
+  PFN_vkGetBufferDeviceAddress vkGetBufferDeviceAddress=nullptr;
+  PFN_vkWaitSemaphores vkWaitSemaphores=nullptr;
+  PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue=nullptr;
+  PFN_vkResetQueryPool vkResetQueryPool=nullptr;
+  //VK_VERSION_1_3
+  PFN_vkQueueSubmit2 vkQueueSubmit2=nullptr;
+  PFN_vkCmdWriteTimestamp2 vkCmdWriteTimestamp2=nullptr;
+  PFN_vkCmdPipelineBarrier2 vkCmdPipelineBarrier2=nullptr;
+  PFN_vkCmdBeginRendering vkCmdBeginRendering=nullptr;
+  PFN_vkCmdEndRendering vkCmdEndRendering=nullptr;
+  PFN_vkCmdBindVertexBuffers2 vkCmdBindVertexBuffers2=nullptr;
+  PFN_vkCmdSetViewportWithCount vkCmdSetViewportWithCount=nullptr;
+  PFN_vkCmdSetScissorWithCount vkCmdSetScissorWithCount=nullptr;
+  PFN_vkCmdSetRasterizerDiscardEnable vkCmdSetRasterizerDiscardEnable=nullptr;
+  PFN_vkCmdSetCullMode vkCmdSetCullMode=nullptr;
+  PFN_vkCmdSetFrontFace vkCmdSetFrontFace=nullptr;
+  PFN_vkCmdSetDepthTestEnable vkCmdSetDepthTestEnable=nullptr;
+  PFN_vkCmdSetDepthWriteEnable vkCmdSetDepthWriteEnable=nullptr;
+  PFN_vkCmdSetDepthBiasEnable vkCmdSetDepthBiasEnable=nullptr;
+  PFN_vkCmdSetDepthBoundsTestEnable vkCmdSetDepthBoundsTestEnable=nullptr;
+  PFN_vkCmdSetStencilTestEnable vkCmdSetStencilTestEnable=nullptr;
+  PFN_vkCmdSetPrimitiveTopology vkCmdSetPrimitiveTopology=nullptr;
+  PFN_vkCmdSetPrimitiveRestartEnable vkCmdSetPrimitiveRestartEnable=nullptr;
+  //VK_EXT_shader_object
+  PFN_vkCreateShadersEXT vkCreateShadersEXT=nullptr;
+  PFN_vkDestroyShaderEXT vkDestroyShaderEXT=nullptr;
+  PFN_vkCmdBindShadersEXT vkCmdBindShadersEXT=nullptr;
+  PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT=nullptr;
+  PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT=nullptr;
+  PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamplesEXT=nullptr;
+  PFN_vkCmdSetSampleMaskEXT vkCmdSetSampleMaskEXT=nullptr;
+  PFN_vkCmdSetAlphaToCoverageEnableEXT vkCmdSetAlphaToCoverageEnableEXT=nullptr;
+  PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnableEXT=nullptr;
+  PFN_vkCmdSetColorWriteMaskEXT vkCmdSetColorWriteMaskEXT=nullptr;
+  PFN_vkCmdSetDepthClampEnableEXT vkCmdSetDepthClampEnableEXT=nullptr;
+  //Needs VK_EXT_provoking_vertex, may stay null
+  PFN_vkCmdSetProvokingVertexModeEXT vkCmdSetProvokingVertexModeEXT=nullptr;
+  //VK_EXT_descriptor_buffer
+  PFN_vkGetDescriptorSetLayoutSizeEXT vkGetDescriptorSetLayoutSizeEXT=nullptr;
+  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT vkGetDescriptorSetLayoutBindingOffsetEXT=nullptr;
+  PFN_vkGetDescriptorEXT vkGetDescriptorEXT=nullptr;
+  PFN_vkCmdBindDescriptorBuffersEXT vkCmdBindDescriptorBuffersEXT=nullptr;
+  PFN_vkCmdSetDescriptorBufferOffsetsEXT vkCmdSetDescriptorBufferOffsetsEXT=nullptr;
+  //VK_KHR_maintenance5, optional
+  PFN_vkCmdBindIndexBuffer2KHR vkCmdBindIndexBuffer2KHR=nullptr;
+
+  void Load(VkDevice device,PFN_vkGetDeviceProcAddr getDeviceProcAddr){
+    vkCreateDescriptorSetLayout=reinterpret_cast<PFN_vkCreateDescriptorSetLayout>(getDeviceProcAddr(device,"vkCreateDescriptorSetLayout"));
+    vkDestroyDescriptorSetLayout=reinterpret_cast<PFN_vkDestroyDescriptorSetLayout>(getDeviceProcAddr(device,"vkDestroyDescriptorSetLayout"));
+    vkCreatePipelineLayout=reinterpret_cast<PFN_vkCreatePipelineLayout>(getDeviceProcAddr(device,"vkCreatePipelineLayout"));
+    vkDestroyPipelineLayout=reinterpret_cast<PFN_vkDestroyPipelineLayout>(getDeviceProcAddr(device,"vkDestroyPipelineLayout"));
+    vkCreateSampler=reinterpret_cast<PFN_vkCreateSampler>(getDeviceProcAddr(device,"vkCreateSampler"));
+    vkDestroySampler=reinterpret_cast<PFN_vkDestroySampler>(getDeviceProcAddr(device,"vkDestroySampler"));
+    vkCreateBuffer=reinterpret_cast<PFN_vkCreateBuffer>(getDeviceProcAddr(device,"vkCreateBuffer"));
+    vkDestroyBuffer=reinterpret_cast<PFN_vkDestroyBuffer>(getDeviceProcAddr(device,"vkDestroyBuffer"));
+    vkDeviceWaitIdle=reinterpret_cast<PFN_vkDeviceWaitIdle>(getDeviceProcAddr(device,"vkDeviceWaitIdle"));
+    vkCreateShaderModule=reinterpret_cast<PFN_vkCreateShaderModule>(getDeviceProcAddr(device,"vkCreateShaderModule"));
+    vkDestroyShaderModule=reinterpret_cast<PFN_vkDestroyShaderModule>(getDeviceProcAddr(device,"vkDestroyShaderModule"));
+    vkCreateGraphicsPipelines=reinterpret_cast<PFN_vkCreateGraphicsPipelines>(getDeviceProcAddr(device,"vkCreateGraphicsPipelines"));
+    vkDestroyPipeline=reinterpret_cast<PFN_vkDestroyPipeline>(getDeviceProcAddr(device,"vkDestroyPipeline"));
+    vkCreatePipelineCache=reinterpret_cast<PFN_vkCreatePipelineCache>(getDeviceProcAddr(device,"vkCreatePipelineCache"));
+    vkDestroyPipelineCache=reinterpret_cast<PFN_vkDestroyPipelineCache>(getDeviceProcAddr(device,"vkDestroyPipelineCache"));
+    vkGetPipelineCacheData=reinterpret_cast<PFN_vkGetPipelineCacheData>(getDeviceProcAddr(device,"vkGetPipelineCacheData"));
+    vkGetBufferMemoryRequirements=reinterpret_cast<PFN_vkGetBufferMemoryRequirements>(getDeviceProcAddr(device,"vkGetBufferMemoryRequirements"));
+    vkAllocateCommandBuffers=reinterpret_cast<PFN_vkAllocateCommandBuffers>(getDeviceProcAddr(device,"vkAllocateCommandBuffers"));
+    vkResetCommandBuffer=reinterpret_cast<PFN_vkResetCommandBuffer>(getDeviceProcAddr(device,"vkResetCommandBuffer"));
+    vkBeginCommandBuffer=reinterpret_cast<PFN_vkBeginCommandBuffer>(getDeviceProcAddr(device,"vkBeginCommandBuffer"));
+    vkEndCommandBuffer=reinterpret_cast<PFN_vkEndCommandBuffer>(getDeviceProcAddr(device,"vkEndCommandBuffer"));
+    vkCreateQueryPool=reinterpret_cast<PFN_vkCreateQueryPool>(getDeviceProcAddr(device,"vkCreateQueryPool"));
+    vkDestroyQueryPool=reinterpret_cast<PFN_vkDestroyQueryPool>(getDeviceProcAddr(device,"vkDestroyQueryPool"));
+    vkGetQueryPoolResults=reinterpret_cast<PFN_vkGetQueryPoolResults>(getDeviceProcAddr(device,"vkGetQueryPoolResults"));
+    vkCmdBeginQuery=reinterpret_cast<PFN_vkCmdBeginQuery>(getDeviceProcAddr(device,"vkCmdBeginQuery"));
+    vkCmdEndQuery=reinterpret_cast<PFN_vkCmdEndQuery>(getDeviceProcAddr(device,"vkCmdEndQuery"));
+    vkCmdBindPipeline=reinterpret_cast<PFN_vkCmdBindPipeline>(getDeviceProcAddr(device,"vkCmdBindPipeline"));
+    vkCmdPushConstants=reinterpret_cast<PFN_vkCmdPushConstants>(getDeviceProcAddr(device,"vkCmdPushConstants"));
+    vkCmdBindIndexBuffer=reinterpret_cast<PFN_vkCmdBindIndexBuffer>(getDeviceProcAddr(device,"vkCmdBindIndexBuffer"));
+    vkCmdDispatch=reinterpret_cast<PFN_vkCmdDispatch>(getDeviceProcAddr(device,"vkCmdDispatch"));
+    vkCmdDraw=reinterpret_cast<PFN_vkCmdDraw>(getDeviceProcAddr(device,"vkCmdDraw"));
+    vkCmdDrawIndexed=reinterpret_cast<PFN_vkCmdDrawIndexed>(getDeviceProcAddr(device,"vkCmdDrawIndexed"));
+    vkGetBufferDeviceAddress=reinterpret_cast<PFN_vkGetBufferDeviceAddress>(getDeviceProcAddr(device,"vkGetBufferDeviceAddress"));
+    vkWaitSemaphores=reinterpret_cast<PFN_vkWaitSemaphores>(getDeviceProcAddr(device,"vkWaitSemaphores"));
+    vkGetSemaphoreCounterValue=reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(getDeviceProcAddr(device,"vkGetSemaphoreCounterValue"));
+    vkResetQueryPool=reinterpret_cast<PFN_vkResetQueryPool>(getDeviceProcAddr(device,"vkResetQueryPool"));
+    vkQueueSubmit2=reinterpret_cast<PFN_vkQueueSubmit2>(getDeviceProcAddr(device,"vkQueueSubmit2"));
+    vkCmdWriteTimestamp2=reinterpret_cast<PFN_vkCmdWriteTimestamp2>(getDeviceProcAddr(device,"vkCmdWriteTimestamp2"));
+    vkCmdPipelineBarrier2=reinterpret_cast<PFN_vkCmdPipelineBarrier2>(getDeviceProcAddr(device,"vkCmdPipelineBarrier2"));
+    vkCmdBeginRendering=reinterpret_cast<PFN_vkCmdBeginRendering>(getDeviceProcAddr(device,"vkCmdBeginRendering"));
+    vkCmdEndRendering=reinterpret_cast<PFN_vkCmdEndRendering>(getDeviceProcAddr(device,"vkCmdEndRendering"));
+    vkCmdBindVertexBuffers2=reinterpret_cast<PFN_vkCmdBindVertexBuffers2>(getDeviceProcAddr(device,"vkCmdBindVertexBuffers2"));
+    vkCmdSetViewportWithCount=reinterpret_cast<PFN_vkCmdSetViewportWithCount>(getDeviceProcAddr(device,"vkCmdSetViewportWithCount"));
+    vkCmdSetScissorWithCount=reinterpret_cast<PFN_vkCmdSetScissorWithCount>(getDeviceProcAddr(device,"vkCmdSetScissorWithCount"));
+    vkCmdSetRasterizerDiscardEnable=reinterpret_cast<PFN_vkCmdSetRasterizerDiscardEnable>(getDeviceProcAddr(device,"vkCmdSetRasterizerDiscardEnable"));
+    vkCmdSetCullMode=reinterpret_cast<PFN_vkCmdSetCullMode>(getDeviceProcAddr(device,"vkCmdSetCullMode"));
+    vkCmdSetFrontFace=reinterpret_cast<PFN_vkCmdSetFrontFace>(getDeviceProcAddr(device,"vkCmdSetFrontFace"));
+    vkCmdSetDepthTestEnable=reinterpret_cast<PFN_vkCmdSetDepthTestEnable>(getDeviceProcAddr(device,"vkCmdSetDepthTestEnable"));
+    vkCmdSetDepthWriteEnable=reinterpret_cast<PFN_vkCmdSetDepthWriteEnable>(getDeviceProcAddr(device,"vkCmdSetDepthWriteEnable"));
+    vkCmdSetDepthBiasEnable=reinterpret_cast<PFN_vkCmdSetDepthBiasEnable>(getDeviceProcAddr(device,"vkCmdSetDepthBiasEnable"));
+    vkCmdSetDepthBoundsTestEnable=reinterpret_cast<PFN_vkCmdSetDepthBoundsTestEnable>(getDeviceProcAddr(device,"vkCmdSetDepthBoundsTestEnable"));
+    vkCmdSetStencilTestEnable=reinterpret_cast<PFN_vkCmdSetStencilTestEnable>(getDeviceProcAddr(device,"vkCmdSetStencilTestEnable"));
+    vkCmdSetPrimitiveTopology=reinterpret_cast<PFN_vkCmdSetPrimitiveTopology>(getDeviceProcAddr(device,"vkCmdSetPrimitiveTopology"));
+    vkCmdSetPrimitiveRestartEnable=reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnable>(getDeviceProcAddr(device,"vkCmdSetPrimitiveRestartEnable"));
+    vkCreateShadersEXT=reinterpret_cast<PFN_vkCreateShadersEXT>(getDeviceProcAddr(device,"vkCreateShadersEXT"));
+    vkDestroyShaderEXT=reinterpret_cast<PFN_vkDestroyShaderEXT>(getDeviceProcAddr(device,"vkDestroyShaderEXT"));
+    vkCmdBindShadersEXT=reinterpret_cast<PFN_vkCmdBindShadersEXT>(getDeviceProcAddr(device,"vkCmdBindShadersEXT"));
+    vkCmdSetVertexInputEXT=reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(getDeviceProcAddr(device,"vkCmdSetVertexInputEXT"));
+    vkCmdSetPolygonModeEXT=reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(getDeviceProcAddr(device,"vkCmdSetPolygonModeEXT"));
+    vkCmdSetRasterizationSamplesEXT=reinterpret_cast<PFN_vkCmdSetRasterizationSamplesEXT>(getDeviceProcAddr(device,"vkCmdSetRasterizationSamplesEXT"));
+    vkCmdSetSampleMaskEXT=reinterpret_cast<PFN_vkCmdSetSampleMaskEXT>(getDeviceProcAddr(device,"vkCmdSetSampleMaskEXT"));
+    vkCmdSetAlphaToCoverageEnableEXT=reinterpret_cast<PFN_vkCmdSetAlphaToCoverageEnableEXT>(getDeviceProcAddr(device,"vkCmdSetAlphaToCoverageEnableEXT"));
+    vkCmdSetColorBlendEnableEXT=reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(getDeviceProcAddr(device,"vkCmdSetColorBlendEnableEXT"));
+    vkCmdSetColorWriteMaskEXT=reinterpret_cast<PFN_vkCmdSetColorWriteMaskEXT>(getDeviceProcAddr(device,"vkCmdSetColorWriteMaskEXT"));
+    vkCmdSetDepthClampEnableEXT=reinterpret_cast<PFN_vkCmdSetDepthClampEnableEXT>(getDeviceProcAddr(device,"vkCmdSetDepthClampEnableEXT"));
+    vkCmdSetProvokingVertexModeEXT=reinterpret_cast<PFN_vkCmdSetProvokingVertexModeEXT>(getDeviceProcAddr(device,"vkCmdSetProvokingVertexModeEXT"));
+    vkGetDescriptorSetLayoutSizeEXT=reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(getDeviceProcAddr(device,"vkGetDescriptorSetLayoutSizeEXT"));
+    vkGetDescriptorSetLayoutBindingOffsetEXT=reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(getDeviceProcAddr(device,"vkGetDescriptorSetLayoutBindingOffsetEXT"));
+    vkGetDescriptorEXT=reinterpret_cast<PFN_vkGetDescriptorEXT>(getDeviceProcAddr(device,"vkGetDescriptorEXT"));
+    vkCmdBindDescriptorBuffersEXT=reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(getDeviceProcAddr(device,"vkCmdBindDescriptorBuffersEXT"));
+    vkCmdSetDescriptorBufferOffsetsEXT=reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(getDeviceProcAddr(device,"vkCmdSetDescriptorBufferOffsetsEXT"));
+    vkCmdBindIndexBuffer2KHR=reinterpret_cast<PFN_vkCmdBindIndexBuffer2KHR>(getDeviceProcAddr(device,"vkCmdBindIndexBuffer2KHR"));
+  }
+
+  //The loader exports of the core commands, for code that records on a
+  //raw VkDevice without a table of its own. Extension commands stay null.
+  static const DeviceDispatch &Exports(){
+    static const DeviceDispatch exports=[]{
+      DeviceDispatch table;
+      table.vkCreateDescriptorSetLayout=&::vkCreateDescriptorSetLayout;
+      table.vkDestroyDescriptorSetLayout=&::vkDestroyDescriptorSetLayout;
+      table.vkCreatePipelineLayout=&::vkCreatePipelineLayout;
+      table.vkDestroyPipelineLayout=&::vkDestroyPipelineLayout;
+      table.vkCreateSampler=&::vkCreateSampler;
+      table.vkDestroySampler=&::vkDestroySampler;
+      table.vkCreateBuffer=&::vkCreateBuffer;
+      table.vkDestroyBuffer=&::vkDestroyBuffer;
+      table.vkDeviceWaitIdle=&::vkDeviceWaitIdle;
+      table.vkCreateShaderModule=&::vkCreateShaderModule;
+      table.vkDestroyShaderModule=&::vkDestroyShaderModule;
+      table.vkCreateGraphicsPipelines=&::vkCreateGraphicsPipelines;
+      table.vkDestroyPipeline=&::vkDestroyPipeline;
+      table.vkCreatePipelineCache=&::vkCreatePipelineCache;
+      table.vkDestroyPipelineCache=&::vkDestroyPipelineCache;
+      table.vkGetPipelineCacheData=&::vkGetPipelineCacheData;
+      table.vkGetBufferMemoryRequirements=&::vkGetBufferMemoryRequirements;
+      table.vkAllocateCommandBuffers=&::vkAllocateCommandBuffers;
+      table.vkResetCommandBuffer=&::vkResetCommandBuffer;
+      table.vkBeginCommandBuffer=&::vkBeginCommandBuffer;
+      table.vkEndCommandBuffer=&::vkEndCommandBuffer;
+      table.vkCreateQueryPool=&::vkCreateQueryPool;
+      table.vkDestroyQueryPool=&::vkDestroyQueryPool;
+      table.vkGetQueryPoolResults=&::vkGetQueryPoolResults;
+      table.vkCmdBeginQuery=&::vkCmdBeginQuery;
+      table.vkCmdEndQuery=&::vkCmdEndQuery;
+      table.vkCmdBindPipeline=&::vkCmdBindPipeline;
+      table.vkCmdPushConstants=&::vkCmdPushConstants;
+      table.vkCmdBindIndexBuffer=&::vkCmdBindIndexBuffer;
+      table.vkCmdDispatch=&::vkCmdDispatch;
+      table.vkCmdDraw=&::vkCmdDraw;
+      table.vkCmdDrawIndexed=&::vkCmdDrawIndexed;
+      table.vkGetBufferDeviceAddress=&::vkGetBufferDeviceAddress;
+      table.vkWaitSemaphores=&::vkWaitSemaphores;
+      table.vkGetSemaphoreCounterValue=&::vkGetSemaphoreCounterValue;
+      table.vkResetQueryPool=&::vkResetQueryPool;
+      table.vkQueueSubmit2=&::vkQueueSubmit2;
+      table.vkCmdWriteTimestamp2=&::vkCmdWriteTimestamp2;
+      table.vkCmdPipelineBarrier2=&::vkCmdPipelineBarrier2;
+      table.vkCmdBeginRendering=&::vkCmdBeginRendering;
+      table.vkCmdEndRendering=&::vkCmdEndRendering;
+      table.vkCmdBindVertexBuffers2=&::vkCmdBindVertexBuffers2;
+      table.vkCmdSetViewportWithCount=&::vkCmdSetViewportWithCount;
+      table.vkCmdSetScissorWithCount=&::vkCmdSetScissorWithCount;
+      table.vkCmdSetRasterizerDiscardEnable=&::vkCmdSetRasterizerDiscardEnable;
+      table.vkCmdSetCullMode=&::vkCmdSetCullMode;
+      table.vkCmdSetFrontFace=&::vkCmdSetFrontFace;
+      table.vkCmdSetDepthTestEnable=&::vkCmdSetDepthTestEnable;
+      table.vkCmdSetDepthWriteEnable=&::vkCmdSetDepthWriteEnable;
+      table.vkCmdSetDepthBiasEnable=&::vkCmdSetDepthBiasEnable;
+      table.vkCmdSetDepthBoundsTestEnable=&::vkCmdSetDepthBoundsTestEnable;
+      table.vkCmdSetStencilTestEnable=&::vkCmdSetStencilTestEnable;
+      table.vkCmdSetPrimitiveTopology=&::vkCmdSetPrimitiveTopology;
+      table.vkCmdSetPrimitiveRestartEnable=&::vkCmdSetPrimitiveRestartEnable;
+      return table;
+    }();
+    return exports;
+  }
+
+  //Required commands the device did not return, each preceded by a space
+  std::string Missing()const{
+    std::string missing;
+    if(!vkCreateDescriptorSetLayout)
+      missing+=" vkCreateDescriptorSetLayout";
+    if(!vkDestroyDescriptorSetLayout)
+      missing+=" vkDestroyDescriptorSetLayout";
+    if(!vkCreatePipelineLayout)
+      missing+=" vkCreatePipelineLayout";
+    if(!vkDestroyPipelineLayout)
+      missing+=" vkDestroyPipelineLayout";
+    if(!vkCreateSampler)
+      missing+=" vkCreateSampler";
+    if(!vkDestroySampler)
+      missing+=" vkDestroySampler";
+    if(!vkCreateBuffer)
+      missing+=" vkCreateBuffer";
+    if(!vkDestroyBuffer)
+      missing+=" vkDestroyBuffer";
+    if(!vkDeviceWaitIdle)
+      missing+=" vkDeviceWaitIdle";
+    if(!vkCreateShaderModule)
+      missing+=" vkCreateShaderModule";
+    if(!vkDestroyShaderModule)
+      missing+=" vkDestroyShaderModule";
+    if(!vkCreateGraphicsPipelines)
+      missing+=" vkCreateGraphicsPipelines";
+    if(!vkDestroyPipeline)
+      missing+=" vkDestroyPipeline";
+    if(!vkCreatePipelineCache)
+      missing+=" vkCreatePipelineCache";
+    if(!vkDestroyPipelineCache)
+      missing+=" vkDestroyPipelineCache";
+    if(!vkGetPipelineCacheData)
+      missing+=" vkGetPipelineCacheData";
+    if(!vkGetBufferMemoryRequirements)
+      missing+=" vkGetBufferMemoryRequirements";
+    if(!vkAllocateCommandBuffers)
+      missing+=" vkAllocateCommandBuffers";
+    if(!vkResetCommandBuffer)
+      missing+=" vkResetCommandBuffer";
+    if(!vkBeginCommandBuffer)
+      missing+=" vkBeginCommandBuffer";
+    if(!vkEndCommandBuffer)
+      missing+=" vkEndCommandBuffer";
+    if(!vkCreateQueryPool)
+      missing+=" vkCreateQueryPool";
+    if(!vkDestroyQueryPool)
+      missing+=" vkDestroyQueryPool";
+    if(!vkGetQueryPoolResults)
+      missing+=" vkGetQueryPoolResults";
+    if(!vkCmdBeginQuery)
+      missing+=" vkCmdBeginQuery";
+    if(!vkCmdEndQuery)
+      missing+=" vkCmdEndQuery";
+    if(!vkCmdBindPipeline)
+      missing+=" vkCmdBindPipeline";
+    if(!vkCmdPushConstants)
+      missing+=" vkCmdPushConstants";
+    if(!vkCmdBindIndexBuffer)
+      missing+=" vkCmdBindIndexBuffer";
+    if(!vkCmdDispatch)
+      missing+=" vkCmdDispatch";
+    if(!vkCmdDraw)
+      missing+=" vkCmdDraw";
+    if(!vkCmdDrawIndexed)
+      missing+=" vkCmdDrawIndexed";
+    if(!vkGetBufferDeviceAddress)
+      missing+=" vkGetBufferDeviceAddress";
+    if(!vkWaitSemaphores)
+      missing+=" vkWaitSemaphores";
+    if(!vkGetSemaphoreCounterValue)
+      missing+=" vkGetSemaphoreCounterValue";
+    if(!vkResetQueryPool)
+      missing+=" vkResetQueryPool";
+    if(!vkQueueSubmit2)
+      missing+=" vkQueueSubmit2";
+    if(!vkCmdWriteTimestamp2)
+      missing+=" vkCmdWriteTimestamp2";
+    if(!vkCmdPipelineBarrier2)
+      missing+=" vkCmdPipelineBarrier2";
+    if(!vkCmdBeginRendering)
+      missing+=" vkCmdBeginRendering";
+    if(!vkCmdEndRendering)
+      missing+=" vkCmdEndRendering";
+    if(!vkCmdBindVertexBuffers2)
+      missing+=" vkCmdBindVertexBuffers2";
+    if(!vkCmdSetViewportWithCount)
+      missing+=" vkCmdSetViewportWithCount";
+    if(!vkCmdSetScissorWithCount)
+      missing+=" vkCmdSetScissorWithCount";
+    if(!vkCmdSetRasterizerDiscardEnable)
+      missing+=" vkCmdSetRasterizerDiscardEnable";
+    if(!vkCmdSetCullMode)
+      missing+=" vkCmdSetCullMode";
+    if(!vkCmdSetFrontFace)
+      missing+=" vkCmdSetFrontFace";
+    if(!vkCmdSetDepthTestEnable)
+      missing+=" vkCmdSetDepthTestEnable";
+    if(!vkCmdSetDepthWriteEnable)
+      missing+=" vkCmdSetDepthWriteEnable";
+    if(!vkCmdSetDepthBiasEnable)
+      missing+=" vkCmdSetDepthBiasEnable";
+    if(!vkCmdSetDepthBoundsTestEnable)
+      missing+=" vkCmdSetDepthBoundsTestEnable";
+    if(!vkCmdSetStencilTestEnable)
+      missing+=" vkCmdSetStencilTestEnable";
+    if(!vkCmdSetPrimitiveTopology)
+      missing+=" vkCmdSetPrimitiveTopology";
+    if(!vkCmdSetPrimitiveRestartEnable)
+      missing+=" vkCmdSetPrimitiveRestartEnable";
+    if(!vkCreateShadersEXT)
+      missing+=" vkCreateShadersEXT";
+    if(!vkDestroyShaderEXT)
+      missing+=" vkDestroyShaderEXT";
+    if(!vkCmdBindShadersEXT)
+      missing+=" vkCmdBindShadersEXT";
+    if(!vkCmdSetVertexInputEXT)
+      missing+=" vkCmdSetVertexInputEXT";
+    if(!vkCmdSetPolygonModeEXT)
+      missing+=" vkCmdSetPolygonModeEXT";
+    if(!vkCmdSetRasterizationSamplesEXT)
+      missing+=" vkCmdSetRasterizationSamplesEXT";
+    if(!vkCmdSetSampleMaskEXT)
+      missing+=" vkCmdSetSampleMaskEXT";
+    if(!vkCmdSetAlphaToCoverageEnableEXT)
+      missing+=" vkCmdSetAlphaToCoverageEnableEXT";
+    if(!vkCmdSetColorBlendEnableEXT)
+      missing+=" vkCmdSetColorBlendEnableEXT";
+    if(!vkCmdSetColorWriteMaskEXT)
+      missing+=" vkCmdSetColorWriteMaskEXT";
+    if(!vkCmdSetDepthClampEnableEXT)
+      missing+=" vkCmdSetDepthClampEnableEXT";
+    if(!vkGetDescriptorSetLayoutSizeEXT)
+      missing+=" vkGetDescriptorSetLayoutSizeEXT";
+    if(!vkGetDescriptorSetLayoutBindingOffsetEXT)
+      missing+=" vkGetDescriptorSetLayoutBindingOffsetEXT";
+    if(!vkGetDescriptorEXT)
+      missing+=" vkGetDescriptorEXT";
+    if(!vkCmdBindDescriptorBuffersEXT)
+      missing+=" vkCmdBindDescriptorBuffersEXT";
+    if(!vkCmdSetDescriptorBufferOffsetsEXT)
+      missing+=" vkCmdSetDescriptorBufferOffsetsEXT";
+    return missing;
+  }
+};
@@ -0,0 +1,342 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<algorithm>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"DeviceDispatch.h"
+
+//Discovers the queue families of a physical device and creates one queue per
+//distinct family. Compute and transfer get dedicated families when the device
+//exposes them (compute without graphics, transfer without either), otherwise
+//they point at the graphics queue and everything runs on a single queue.
+//
+//Every queue owns a timeline semaphore, each submission signals the next
+//value so other queues and the host can wait on it. Requires the
+//timelineSemaphore and synchronization2 features.
+//
+//Recording and submission go through the dispatch table given to Create(),
+//the standalone repros pass none and use the loader exports.
+class DeviceQueues{
+public:
+  struct Queue{
+    uint32_t family=0;
+    VkQueue queue=nullptr;
+    VkCommandPool commandPool=nullptr;
+    VkSemaphore timeline=nullptr;
+    //Last value signaled by a submission
+    uint64_t value=0;
+    std::vector<std::pair<uint64_t,VkCommandBuffer>> inFlight;
+    std::vector<VkCommandBuffer> available;
+  };
+
+  //Point in a queue's timeline, reached once the submission that signaled it is done
+  struct SyncPoint{
+    Queue *queue=nullptr;
+    uint64_t value=0;
+  };
+
+private:
+  VkDevice device=nullptr;
+  const DeviceDispatch *dispatch=&DeviceDispatch::Exports();
+  std::array<Queue,3> queues;
+  uint32_t queueCount=0;
+  std::vector<VkDeviceQueueCreateInfo> createInfos;
+  float priority=1.0f;
+
+  Queue *AddFamily(uint32_t family){
+    for(uint32_t index=0;index<queueCount;index++){
+      if(queues[index].family==family)
+        return &queues[index];
+    }
+
+    queues[queueCount].family=family;
+    createInfos.push_back({
+      .sType=VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .queueFamilyIndex=family,
+      .queueCount=1,
+      .pQueuePriorities=&priority
+    });
+    return &queues[queueCount++];
+  }
+
+public:
+  Queue *graphics=nullptr;
+  Queue *compute=nullptr;
+  Queue *transfer=nullptr;
+
+  DeviceQueues(VkPhysicalDevice physicalDevice){
+    uint32_t familyCount=0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,families.data());
+
+    auto Find=[&](VkQueueFlags required,VkQueueFlags excluded)->uint32_t{
+      for(uint32_t family=0;family<familyCount;family++){
+        auto flags=families[family].queueFlags;
+        if((flags&required)==required&&(flags&excluded)==0&&families[family].queueCount>0)
+          return family;
+      }
+      return ~0u;
+    };
+
+    uint32_t graphicsFamily=Find(VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT,0);
+    if(graphicsFamily==~0u)
+      throw std::runtime_error("Unable to find a graphics queue family");
+    uint32_t computeFamily=Find(VK_QUEUE_COMPUTE_BIT,VK_QUEUE_GRAPHICS_BIT);
+    uint32_t transferFamily=Find(VK_QUEUE_TRANSFER_BIT,VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT);
+
+    graphics=AddFamily(graphicsFamily);
+    compute=computeFamily==~0u?graphics:AddFamily(computeFamily);
+    transfer=transferFamily==~0u?graphics:AddFamily(transferFamily);
+  }
+
+  DeviceQueues(const DeviceQueues &)=delete;
+  DeviceQueues &operator=(const DeviceQueues &)=delete;
+
+  ~DeviceQueues(){
+    Destroy();
+  }
+
+  //Goes into VkDeviceCreateInfo, stays valid for the lifetime of the object
+  const std::vector<VkDeviceQueueCreateInfo> &CreateInfos()const{
+    return createInfos;
+  }
+
+  Queue *FromFamily(uint32_t family){
+    for(uint32_t index=0;index<queueCount;index++){
+      if(queues[index].family==family)
+        return &queues[index];
+    }
+    return nullptr;
+  }
+
+  bool AsyncCompute()const{
+    return compute!=graphics;
+  }
+
+  //Fetches the queues and creates their command pools and timelines
+  void Create(VkDevice device,const DeviceDispatch *dispatch=nullptr){
+    this->device=device;
+    if(dispatch)
+      this->dispatch=dispatch;
+
+    for(uint32_t index=0;index<queueCount;index++){
+      auto &queue=queues[index];
+      vkGetDeviceQueue(device,queue.family,0,&queue.queue);
+
+      VkCommandPoolCreateInfo commandPoolInfo={
+        .sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext=nullptr,
+        .flags=VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex=queue.family
+      };
+      auto result=vkCreateCommandPool(device,&commandPoolInfo,nullptr,&queue.commandPool);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to create command pool");
+
+      VkSemaphoreTypeCreateInfo semaphoreTypeInfo={
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext=nullptr,
+        .semaphoreType=VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue=0
+      };
+      VkSemaphoreCreateInfo semaphoreInfo={
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext=&semaphoreTypeInfo,
+        .flags=0
+      };
+      result=vkCreateSemaphore(device,&semaphoreInfo,nullptr,&queue.timeline);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to create timeline semaphore");
+    }
+  }
+
+  //Waits for all queues, destroying the pools frees their command buffers.
+  //Does not throw so it is safe from destructors, a lost device is torn
+  //down all the same.
+  void Destroy(){
+    if(!device)
+      return;
+
+    dispatch->vkDeviceWaitIdle(device);
+    for(uint32_t index=0;index<queueCount;index++){
+      auto &queue=queues[index];
+      vkDestroyCommandPool(device,queue.commandPool,nullptr);
+      vkDestroySemaphore(device,queue.timeline,nullptr);
+      queue.inFlight.clear();
+      queue.available.clear();
+    }
+    device=nullptr;
+  }
+
+  uint64_t Completed(const Queue &queue)const{
+    uint64_t value=0;
+    dispatch->vkGetSemaphoreCounterValue(device,queue.timeline,&value);
+    return value;
+  }
+
+  //Returns a primary command buffer in the recording state, buffers whose
+  //submission has completed are recycled before allocating new ones
+  VkCommandBuffer Begin(Queue &queue){
+    auto completed=Completed(queue);
+    std::erase_if(queue.inFlight,[&](const std::pair<uint64_t,VkCommandBuffer> &entry){
+      if(entry.first>completed)
+        return false;
+      queue.available.push_back(entry.second);
+      return true;
+    });
+
+    VkCommandBuffer CMDBuffer=nullptr;
+    if(queue.available.empty()){
+      VkCommandBufferAllocateInfo bufferAllocatorInfo={
+        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext=nullptr,
+        .commandPool=queue.commandPool,
+        .level=VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount=1
+      };
+      auto result=dispatch->vkAllocateCommandBuffers(device,&bufferAllocatorInfo,&CMDBuffer);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate command buffer");
+    }else{
+      CMDBuffer=queue.available.back();
+      queue.available.pop_back();
+      dispatch->vkResetCommandBuffer(CMDBuffer,0);
+    }
+
+    VkCommandBufferBeginInfo bufferBeginInfo={
+      .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext=nullptr,
+      .flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo=nullptr
+    };
+    dispatch->vkBeginCommandBuffer(CMDBuffer,&bufferBeginInfo);
+    return CMDBuffer;
+  }
+
+  //Ends and submits a buffer from Begin(). Waits on other queues' timelines
+  //are added to the submission, waits on the same queue are already covered
+  //by submission order and dropped.
+  SyncPoint Submit(Queue &queue,VkCommandBuffer CMDBuffer,const std::vector<SyncPoint> &waits={}){
+    dispatch->vkEndCommandBuffer(CMDBuffer);
+
+    std::vector<VkSemaphoreSubmitInfo> waitInfos;
+    for(auto &wait:waits){
+      if(wait.queue==&queue||wait.value==0)
+        continue;
+
+      //One wait per timeline, the highest value covers the lower ones
+      auto existing=std::find_if(waitInfos.begin(),waitInfos.end(),[&](const VkSemaphoreSubmitInfo &info){
+        return info.semaphore==wait.queue->timeline;
+      });
+      if(existing!=waitInfos.end()){
+        existing->value=std::max(existing->value,wait.value);
+        continue;
+      }
+      waitInfos.push_back({
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext=nullptr,
+        .semaphore=wait.queue->timeline,
+        .value=wait.value,
+        .stageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex=0
+      });
+    }
+
+    VkSemaphoreSubmitInfo signalInfo={
+      .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .pNext=nullptr,
+      .semaphore=queue.timeline,
+      .value=queue.value+1,
+      .stageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .deviceIndex=0
+    };
+    VkCommandBufferSubmitInfo commandBufferInfo={
+      .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .pNext=nullptr,
+      .commandBuffer=CMDBuffer,
+      .deviceMask=0
+    };
+    VkSubmitInfo2 submitInfo={
+      .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .pNext=nullptr,
+      .flags=0,
+      .waitSemaphoreInfoCount=(uint32_t)waitInfos.size(),
+      .pWaitSemaphoreInfos=waitInfos.data(),
+      .commandBufferInfoCount=1,
+      .pCommandBufferInfos=&commandBufferInfo,
+      .signalSemaphoreInfoCount=1,
+      .pSignalSemaphoreInfos=&signalInfo
+    };
+
+    auto result=dispatch->vkQueueSubmit2(queue.queue,1,&submitInfo,nullptr);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to submit command buffer");
+
+    queue.value++;
+    queue.inFlight.push_back({queue.value,CMDBuffer});
+    return {&queue,queue.value};
+  }
+
+  void Wait(SyncPoint point){
+    if(!point.queue||point.value==0)
+      return;
+
+    VkSemaphoreWaitInfo waitInfo={
+      .sType=VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .semaphoreCount=1,
+      .pSemaphores=&point.queue->timeline,
+      .pValues=&point.value
+    };
+    //Fails with VK_ERROR_DEVICE_LOST once the device is gone
+    auto result=dispatch->vkWaitSemaphores(device,&waitInfo,UINT64_MAX);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to wait for timeline semaphore");
+  }
+
+  //Returns once at least one of the points is reached, a single
+  //vkWaitSemaphores with VK_SEMAPHORE_WAIT_ANY_BIT across the timelines
+  void WaitAny(const std::vector<SyncPoint> &points){
+    std::vector<VkSemaphore> semaphores;
+    std::vector<uint64_t> values;
+    for(auto &point:points){
+      if(!point.queue||point.value==0)
+        return;
+
+      //The earliest point of a timeline is the first to be reached
+      auto existing=std::find(semaphores.begin(),semaphores.end(),point.queue->timeline);
+      if(existing!=semaphores.end()){
+        auto &value=values[existing-semaphores.begin()];
+        value=std::min(value,point.value);
+        continue;
+      }
+      semaphores.push_back(point.queue->timeline);
+      values.push_back(point.value);
+    }
+    if(semaphores.empty())
+      return;
+
+    VkSemaphoreWaitInfo waitInfo={
+      .sType=VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .pNext=nullptr,
+      .flags=VK_SEMAPHORE_WAIT_ANY_BIT,
+      .semaphoreCount=(uint32_t)semaphores.size(),
+      .pSemaphores=semaphores.data(),
+      .pValues=values.data()
+    };
+    auto result=dispatch->vkWaitSemaphores(device,&waitInfo,UINT64_MAX);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to wait for timeline semaphores");
+  }
+
+  //Waits for every submission made so far on all queues
+  void WaitIdle(){
+    for(uint32_t index=0;index<queueCount;index++)
+      Wait({&queues[index],queues[index].value});
+  }
+};
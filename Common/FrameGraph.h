@@ -0,0 +1,617 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<functional>
+#include<algorithm>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"ResourceTracker.h"
+#include"DeviceQueues.h"
+#include"GpuProfiler.h"
+#include"Trace.h"
+
+enum class QueueType{
+  Graphics,
+  Compute
+};
+
+struct FrameGraphResource{
+  uint32_t index=~0u;
+};
+
+//Passes declare the resources they read and write, Compile() orders them,
+//places transient buffers with non-overlapping lifetimes in shared memory and
+//Execute() records them with the barriers the ResourceTracker works out.
+//
+//Dependencies follow declaration order: a pass depends on the last earlier
+//writer of everything it touches and, when it writes, on the readers since.
+//Independent passes are free to move, the longest chain is scheduled first.
+//
+//Execute() records everything into one command buffer. Submit() instead
+//splits the schedule at every queue change and submits each run on the queue
+//its passes asked for, so compute passes overlap graphics when the device has
+//a dedicated compute family.
+//
+//With a trace set the graph records its resources and passes as they are
+//declared and brackets the commands of every pass it records, a replay
+//rebuilds the same graph and submits it.
+class FrameGraph{
+public:
+  class PassBuilder;
+
+private:
+  struct Resource{
+    std::string name;
+    bool isImage=false;
+    bool transient=false;
+    VkBuffer buffer=nullptr;
+    VkImage image=nullptr;
+    VkImageAspectFlags aspect=0;
+    VkBufferCreateInfo bufferInfo={};
+    VkMemoryRequirements requirements={};
+    uint32_t firstPass=~0u;
+    uint32_t lastPass=0;
+    //Resource previously living in the same memory, ~0u if none
+    uint32_t aliasOf=~0u;
+  };
+
+  struct Use{
+    uint32_t resource;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    bool discard=false;
+  };
+
+  struct Pass{
+    std::string name;
+    QueueType queue;
+    std::vector<Use> uses;
+    std::function<void(VkCommandBuffer)> execute;
+    std::vector<uint32_t> dependencies;
+    uint32_t priority=0;
+  };
+
+  struct MemorySlot{
+    VmaAllocation allocation=nullptr;
+    VkMemoryRequirements requirements={};
+    uint32_t lastPass=0;
+    uint32_t lastResource=~0u;
+  };
+
+  VkDevice device=nullptr;
+  VmaAllocator allocator=nullptr;
+  ResourceTracker &tracker;
+  const DeviceDispatch *dispatch;
+
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<Use> exports;
+  std::vector<uint32_t> order;
+  std::vector<MemorySlot> slots;
+  GpuProfiler *profiler=nullptr;
+  TraceWriter *trace=nullptr;
+  bool compiled=false;
+
+  void DestroyTransients(){
+    for(auto &resource:resources){
+      if(resource.transient&&resource.buffer){
+        tracker.Forget(resource.buffer);
+        dispatch->vkDestroyBuffer(device,resource.buffer,nullptr);
+        resource.buffer=nullptr;
+      }
+    }
+    for(auto &slot:slots)
+      vmaFreeMemory(allocator,slot.allocation);
+    slots.clear();
+  }
+
+  void BuildDependencies(){
+    std::vector<uint32_t> lastWriter(resources.size(),~0u);
+    std::vector<std::vector<uint32_t>> readers(resources.size());
+
+    for(uint32_t passIndex=0;passIndex<passes.size();passIndex++){
+      auto &pass=passes[passIndex];
+      pass.dependencies.clear();
+
+      for(auto &use:pass.uses){
+        auto writer=lastWriter[use.resource];
+        if(writer!=~0u&&writer!=passIndex)
+          pass.dependencies.push_back(writer);
+
+        if(use.access&ResourceTracker::WriteAccess){
+          for(auto reader:readers[use.resource]){
+            if(reader!=passIndex)
+              pass.dependencies.push_back(reader);
+          }
+          readers[use.resource].clear();
+        }
+      }
+
+      //Update after all uses so a pass reading and writing the same
+      //resource does not depend on itself
+      for(auto &use:pass.uses){
+        if(use.access&ResourceTracker::WriteAccess)
+          lastWriter[use.resource]=passIndex;
+        else
+          readers[use.resource].push_back(passIndex);
+      }
+
+      std::sort(pass.dependencies.begin(),pass.dependencies.end());
+      pass.dependencies.erase(std::unique(pass.dependencies.begin(),pass.dependencies.end()),pass.dependencies.end());
+    }
+
+    //Edges only point to earlier passes, walking backwards gives each pass
+    //the length of the longest chain that waits on it
+    for(auto &pass:passes)
+      pass.priority=0;
+    for(uint32_t passIndex=(uint32_t)passes.size();passIndex-->0;){
+      for(auto dependency:passes[passIndex].dependencies)
+        passes[dependency].priority=std::max(passes[dependency].priority,passes[passIndex].priority+1);
+    }
+  }
+
+  void Schedule(){
+    std::vector<uint32_t> pending(passes.size(),0);
+    std::vector<std::vector<uint32_t>> dependents(passes.size());
+    for(uint32_t passIndex=0;passIndex<passes.size();passIndex++){
+      pending[passIndex]=(uint32_t)passes[passIndex].dependencies.size();
+      for(auto dependency:passes[passIndex].dependencies)
+        dependents[dependency].push_back(passIndex);
+    }
+
+    std::vector<uint32_t> ready;
+    for(uint32_t passIndex=0;passIndex<passes.size();passIndex++){
+      if(pending[passIndex]==0)
+        ready.push_back(passIndex);
+    }
+
+    order.clear();
+    while(!ready.empty()){
+      //Longest remaining chain first, declaration order breaks ties
+      auto next=std::min_element(ready.begin(),ready.end(),[&](uint32_t a,uint32_t b){
+        if(passes[a].priority!=passes[b].priority)
+          return passes[a].priority>passes[b].priority;
+        return a<b;
+      });
+      uint32_t passIndex=*next;
+      ready.erase(next);
+      order.push_back(passIndex);
+
+      for(auto dependent:dependents[passIndex]){
+        if(--pending[dependent]==0)
+          ready.push_back(dependent);
+      }
+    }
+  }
+
+  void AllocateTransients(){
+    for(auto &resource:resources){
+      resource.firstPass=~0u;
+      resource.lastPass=0;
+      resource.aliasOf=~0u;
+    }
+    for(uint32_t position=0;position<order.size();position++){
+      for(auto &use:passes[order[position]].uses){
+        auto &resource=resources[use.resource];
+        resource.firstPass=std::min(resource.firstPass,position);
+        resource.lastPass=std::max(resource.lastPass,position);
+      }
+    }
+
+    std::vector<uint32_t> transients;
+    for(uint32_t resourceIndex=0;resourceIndex<resources.size();resourceIndex++){
+      auto &resource=resources[resourceIndex];
+      if(!resource.transient||resource.firstPass==~0u)
+        continue;
+
+      auto result=dispatch->vkCreateBuffer(device,&resource.bufferInfo,nullptr,&resource.buffer);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to create transient buffer");
+      dispatch->vkGetBufferMemoryRequirements(device,resource.buffer,&resource.requirements);
+      transients.push_back(resourceIndex);
+    }
+
+    std::sort(transients.begin(),transients.end(),[&](uint32_t a,uint32_t b){
+      return resources[a].firstPass<resources[b].firstPass;
+    });
+
+    //Greedy interval packing, a slot is reused once its last occupant is done
+    std::vector<uint32_t> slotOf(resources.size(),~0u);
+    for(auto resourceIndex:transients){
+      auto &resource=resources[resourceIndex];
+      MemorySlot *target=nullptr;
+      for(auto &slot:slots){
+        if(slot.lastPass<resource.firstPass&&
+           (slot.requirements.memoryTypeBits&resource.requirements.memoryTypeBits)!=0){
+          target=&slot;
+          break;
+        }
+      }
+      if(!target){
+        slots.push_back({.allocation=nullptr,.requirements=resource.requirements,.lastPass=0,.lastResource=~0u});
+        target=&slots.back();
+      }
+
+      target->requirements.size=std::max(target->requirements.size,resource.requirements.size);
+      target->requirements.alignment=std::max(target->requirements.alignment,resource.requirements.alignment);
+      target->requirements.memoryTypeBits&=resource.requirements.memoryTypeBits;
+      resource.aliasOf=target->lastResource;
+      target->lastPass=resource.lastPass;
+      target->lastResource=resourceIndex;
+      slotOf[resourceIndex]=(uint32_t)(target-slots.data());
+    }
+
+    VmaAllocationCreateInfo allocateInfo={
+      .flags=0,
+      .usage=VMA_MEMORY_USAGE_AUTO,
+      .requiredFlags=VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      .preferredFlags=0,
+      .memoryTypeBits=0,
+      .pool=nullptr,
+      .pUserData=nullptr,
+      .priority=0.0f
+    };
+    for(auto &slot:slots){
+      auto result=vmaAllocateMemory(allocator,&slot.requirements,&allocateInfo,&slot.allocation,nullptr);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate transient memory");
+    }
+
+    for(auto resourceIndex:transients){
+      auto result=vmaBindBufferMemory(allocator,slots[slotOf[resourceIndex]].allocation,resources[resourceIndex].buffer);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to bind transient buffer");
+    }
+  }
+
+  void Declare(const Use &use){
+    auto &resource=resources[use.resource];
+    if(resource.isImage)
+      tracker.UseImage(resource.image,resource.aspect,use.layout,use.stage,use.access,use.discard);
+    else
+      tracker.UseBuffer(resource.buffer,use.stage,use.access);
+  }
+
+  uint32_t Owner(const Resource &resource)const{
+    return resource.isImage?tracker.Owner(resource.image):tracker.Owner(resource.buffer);
+  }
+
+  void Release(const Resource &resource,uint32_t family,VkImageLayout layout){
+    if(resource.isImage)
+      tracker.Release(resource.image,family,layout);
+    else
+      tracker.Release(resource.buffer,family);
+  }
+
+  void RecordPass(uint32_t position,VkCommandBuffer CMDBuffer,uint32_t family){
+    auto &pass=passes[order[position]];
+
+    for(auto &use:pass.uses){
+      auto &resource=resources[use.resource];
+      //Memory handed over from another transient needs the previous
+      //occupant to be finished before it is overwritten, the barrier on the
+      //new buffer waits for its last uses. Across queues the semaphore wait
+      //already orders the two.
+      if(resource.transient&&resource.firstPass==position&&resource.aliasOf!=~0u){
+        auto aliasOwner=tracker.Owner(resources[resource.aliasOf].buffer);
+        if(aliasOwner==VK_QUEUE_FAMILY_IGNORED||aliasOwner==family)
+          tracker.Alias(resources[resource.aliasOf].buffer,resource.buffer);
+      }
+      Declare(use);
+    }
+    tracker.Flush(CMDBuffer);
+
+    //Barriers stay outside the timed range, they belong to no single pass
+    if(profiler)
+      profiler->BeginPass(CMDBuffer,pass.name,family);
+    if(trace)
+      trace->PassBegin(order[position]);
+    pass.execute(CMDBuffer);
+    if(trace)
+      trace->PassEnd();
+    if(profiler)
+      profiler->EndPass(CMDBuffer);
+  }
+
+  //Layout of the resource's first use at or after position, the release
+  //moves images there so the acquire can repeat the transition
+  const Use *NextUse(uint32_t resourceIndex,uint32_t position,uint32_t &usePosition)const{
+    for(;position<order.size();position++){
+      for(auto &use:passes[order[position]].uses){
+        if(use.resource==resourceIndex){
+          usePosition=position;
+          return &use;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  class PassBuilder{
+    friend class FrameGraph;
+    Pass &pass;
+    const std::vector<Resource> &resources;
+    PassBuilder(Pass &pass,const std::vector<Resource> &resources):pass(pass),resources(resources){}
+
+    //Read and Write have no layout to give, an image would be used as UNDEFINED
+    void RequireBuffer(FrameGraphResource resource)const{
+      if(resources[resource.index].isImage)
+        throw std::runtime_error(std::format("Image {} has to be declared with Image() and its layout",resources[resource.index].name));
+    }
+
+  public:
+    PassBuilder &Read(FrameGraphResource resource,VkPipelineStageFlags2 stage,VkAccessFlags2 access){
+      RequireBuffer(resource);
+      if(access&ResourceTracker::WriteAccess)
+        throw std::runtime_error("Read declared with write access");
+      pass.uses.push_back({resource.index,stage,access,VK_IMAGE_LAYOUT_UNDEFINED});
+      return *this;
+    }
+
+    PassBuilder &Write(FrameGraphResource resource,VkPipelineStageFlags2 stage,VkAccessFlags2 access){
+      RequireBuffer(resource);
+      if(!(access&ResourceTracker::WriteAccess))
+        throw std::runtime_error("Write declared without write access");
+      pass.uses.push_back({resource.index,stage,access,VK_IMAGE_LAYOUT_UNDEFINED});
+      return *this;
+    }
+
+    //Images carry the layout the pass expects them in, discard drops the
+    //previous contents for passes that clear or fully overwrite the image
+    PassBuilder &Image(FrameGraphResource resource,VkImageLayout layout,VkPipelineStageFlags2 stage,VkAccessFlags2 access,bool discard=false){
+      pass.uses.push_back({resource.index,stage,access,layout,discard});
+      return *this;
+    }
+  };
+
+  //Without a dispatch table transient buffers are created through the
+  //loader exports, as the standalone repros do
+  FrameGraph(VkDevice device,VmaAllocator allocator,ResourceTracker &tracker,const DeviceDispatch *dispatch=nullptr):
+    device(device),allocator(allocator),tracker(tracker),dispatch(dispatch?dispatch:&DeviceDispatch::Exports()){}
+  FrameGraph(const FrameGraph &)=delete;
+  FrameGraph &operator=(const FrameGraph &)=delete;
+
+  ~FrameGraph(){
+    DestroyTransients();
+  }
+
+  //Drops every pass and resource and frees transient memory
+  void Reset(){
+    DestroyTransients();
+    resources.clear();
+    passes.clear();
+    exports.clear();
+    order.clear();
+    compiled=false;
+  }
+
+  //Times every pass recorded from now on. The caller brackets each frame
+  //with BeginFrame() and Submitted() on the profiler.
+  void Profile(GpuProfiler *profiler){
+    this->profiler=profiler;
+  }
+
+  //Records every graph built from now on into the trace
+  void Trace(TraceWriter *trace){
+    this->trace=trace;
+  }
+
+  FrameGraphResource ImportBuffer(const char *name,VkBuffer buffer){
+    Resource resource;
+    resource.name=name;
+    resource.buffer=buffer;
+    resources.push_back(resource);
+    if(trace)
+      trace->GraphBuffer(buffer);
+    return {(uint32_t)resources.size()-1};
+  }
+
+  FrameGraphResource ImportImage(const char *name,VkImage image,VkImageAspectFlags aspect){
+    Resource resource;
+    resource.name=name;
+    resource.isImage=true;
+    resource.image=image;
+    resource.aspect=aspect;
+    resources.push_back(resource);
+    if(trace)
+      trace->GraphImage(image,aspect);
+    return {(uint32_t)resources.size()-1};
+  }
+
+  //Transient buffers only live inside the graph, their memory is shared with
+  //other transients whose lifetimes do not overlap
+  FrameGraphResource CreateBuffer(const char *name,VkDeviceSize size,VkBufferUsageFlags usage){
+    Resource resource;
+    resource.name=name;
+    resource.transient=true;
+    resource.bufferInfo={
+      .sType=VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .size=size,
+      .usage=usage,
+      .sharingMode=VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount=0,
+      .pQueueFamilyIndices=nullptr
+    };
+    resources.push_back(resource);
+    if(trace)
+      trace->GraphTransient(size,usage);
+    return {(uint32_t)resources.size()-1};
+  }
+
+  void AddPass(const char *name,QueueType queue,
+    const std::function<void(PassBuilder &)> &setup,
+    std::function<void(VkCommandBuffer)> execute){
+
+    passes.push_back({.name=name,.queue=queue,.uses={},.execute=std::move(execute),.dependencies={},.priority=0});
+    PassBuilder builder(passes.back(),resources);
+    setup(builder);
+    compiled=false;
+
+    if(trace){
+      trace->Pass(name,(uint32_t)queue);
+      for(auto &use:passes.back().uses)
+        trace->Use(TraceOp::Use,use.resource,use.stage,use.access,use.layout,use.discard);
+    }
+  }
+
+  //Access the resource is left in once the graph has run, e.g. host reads
+  void Export(FrameGraphResource resource,VkPipelineStageFlags2 stage,VkAccessFlags2 access,
+    VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED){
+    exports.push_back({resource.index,stage,access,layout});
+    if(trace)
+      trace->Use(TraceOp::Export,resource.index,stage,access,layout,false);
+  }
+
+  void Compile(){
+    DestroyTransients();
+    BuildDependencies();
+    Schedule();
+    AllocateTransients();
+    compiled=true;
+  }
+
+  void Execute(VkCommandBuffer CMDBuffer){
+    if(!compiled)
+      Compile();
+
+    for(uint32_t position=0;position<order.size();position++)
+      RecordPass(position,CMDBuffer,VK_QUEUE_FAMILY_IGNORED);
+
+    for(auto &use:exports)
+      Declare(use);
+    tracker.Flush(CMDBuffer);
+    if(trace)
+      trace->Submit();
+  }
+
+  //Returns the last submission made on every queue used, waiting on all of
+  //them completes the graph. Exports are recorded on the queue that last
+  //touched the resource.
+  std::vector<DeviceQueues::SyncPoint> Submit(DeviceQueues &queues){
+    if(!compiled)
+      Compile();
+
+    auto QueueOf=[&](uint32_t position){
+      return passes[order[position]].queue==QueueType::Compute?queues.compute:queues.graphics;
+    };
+
+    std::vector<uint32_t> positionOf(passes.size());
+    std::vector<uint32_t> batchOf(order.size());
+    std::vector<uint32_t> batchStart;
+    for(uint32_t position=0;position<order.size();position++){
+      positionOf[order[position]]=position;
+      if(position==0||QueueOf(position)!=QueueOf(position-1))
+        batchStart.push_back(position);
+      batchOf[position]=(uint32_t)batchStart.size()-1;
+    }
+    uint32_t batchCount=(uint32_t)batchStart.size();
+    batchStart.push_back((uint32_t)order.size());
+
+    //Batches a batch has to wait on, always earlier ones
+    std::vector<std::vector<uint32_t>> waits(batchCount);
+    for(uint32_t position=0;position<order.size();position++){
+      for(auto dependency:passes[order[position]].dependencies)
+        waits[batchOf[position]].push_back(batchOf[positionOf[dependency]]);
+    }
+    for(auto &resource:resources){
+      if(resource.transient&&resource.firstPass!=~0u&&resource.aliasOf!=~0u)
+        waits[batchOf[resource.firstPass]].push_back(batchOf[resources[resource.aliasOf].lastPass]);
+    }
+
+    //Resources left on another family by an earlier submission are released
+    //by a handover submission on their owner before the first batch using them
+    std::vector<DeviceQueues::SyncPoint> handovers;
+    for(uint32_t resourceIndex=0;resourceIndex<resources.size();resourceIndex++){
+      auto &resource=resources[resourceIndex];
+      uint32_t position=0;
+      auto use=NextUse(resourceIndex,0,position);
+      if(!use)
+        continue;
+      uint32_t owner=Owner(resource);
+      uint32_t family=QueueOf(position)->family;
+      auto ownerQueue=queues.FromFamily(owner);
+      if(owner==VK_QUEUE_FAMILY_IGNORED||owner==family||!ownerQueue)
+        continue;
+
+      auto CMDBuffer=queues.Begin(*ownerQueue);
+      tracker.BeginQueue(owner);
+      Release(resource,family,use->layout);
+      tracker.Flush(CMDBuffer);
+      handovers.push_back(queues.Submit(*ownerQueue,CMDBuffer));
+    }
+
+    std::vector<DeviceQueues::SyncPoint> signaled(batchCount);
+    for(uint32_t batch=0;batch<batchCount;batch++){
+      auto &queue=*QueueOf(batchStart[batch]);
+      auto CMDBuffer=queues.Begin(queue);
+      tracker.BeginQueue(queue.family);
+
+      for(uint32_t position=batchStart[batch];position<batchStart[batch+1];position++)
+        RecordPass(position,CMDBuffer,queue.family);
+
+      //Hand everything the next user wants on another family over to it
+      for(uint32_t resourceIndex=0;resourceIndex<resources.size();resourceIndex++){
+        auto &resource=resources[resourceIndex];
+        if(resource.firstPass==~0u||resource.firstPass>=batchStart[batch+1]||resource.lastPass<batchStart[batch])
+          continue;
+
+        uint32_t position=0;
+        auto use=NextUse(resourceIndex,batchStart[batch+1],position);
+        if(!use||QueueOf(position)->family==queue.family)
+          continue;
+        Release(resource,QueueOf(position)->family,use->layout);
+        waits[batchOf[position]].push_back(batch);
+      }
+
+      for(auto &use:exports){
+        auto &resource=resources[use.resource];
+        uint32_t lastBatch=resource.firstPass==~0u?batchCount-1:batchOf[resource.lastPass];
+        if(lastBatch==batch)
+          Declare(use);
+      }
+      tracker.Flush(CMDBuffer);
+
+      std::vector<DeviceQueues::SyncPoint> batchWaits=handovers;
+      for(auto waitBatch:waits[batch])
+        batchWaits.push_back(signaled[waitBatch]);
+      signaled[batch]=queues.Submit(queue,CMDBuffer,batchWaits);
+    }
+    tracker.BeginQueue(VK_QUEUE_FAMILY_IGNORED);
+    if(trace)
+      trace->Submit();
+
+    std::vector<DeviceQueues::SyncPoint> last;
+    for(auto &point:signaled){
+      auto it=std::find_if(last.begin(),last.end(),[&](const DeviceQueues::SyncPoint &other){
+        return other.queue==point.queue;
+      });
+      if(it==last.end())
+        last.push_back(point);
+      else
+        *it=point;
+    }
+    return last;
+  }
+
+  VkBuffer Buffer(FrameGraphResource resource)const{
+    return resources[resource.index].buffer;
+  }
+
+  QueueType Queue(uint32_t position)const{
+    return passes[order[position]].queue;
+  }
+
+  const std::string &PassName(uint32_t position)const{
+    return passes[order[position]].name;
+  }
+
+  size_t PassCount()const{
+    return order.size();
+  }
+};
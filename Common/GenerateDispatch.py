@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+#Generates DeviceDispatch.h from the Vulkan registry:
+#
+#  python3 Common/GenerateDispatch.py $VULKAN_SDK/share/vulkan/registry/vk.xml Common/DeviceDispatch.h
+#
+#or cmake --build build --target DeviceDispatch. The output is checked in so
+#the Visual Studio solution and machines without the registry build as is.
+#
+#Commands lists what the headless tools call through the table, add an entry
+#and rerun to use another command. Each one is checked against the registry:
+#it has to exist, take a VkDevice, VkQueue or VkCommandBuffer and come from
+#Vulkan 1.3 or one of Extensions. Entries are grouped by the first of those
+#that provides them, commands of Optional extensions may stay null. So may
+#those the extension only provides together with another one, e.g.
+#vkCmdSetProvokingVertexModeEXT needs VK_EXT_provoking_vertex as well.
+#
+#Exports() fills the core commands with the loader's exported functions for
+#the standalone repros, which only have a raw VkDevice. Extensions have no
+#exports and stay null there.
+
+import sys
+import xml.etree.ElementTree as ElementTree
+
+Commands=[
+  #Setup
+  "vkCreateDescriptorSetLayout",
+  "vkDestroyDescriptorSetLayout",
+  "vkCreatePipelineLayout",
+  "vkDestroyPipelineLayout",
+  "vkCreateSampler",
+  "vkDestroySampler",
+  "vkCreateBuffer",
+  "vkDestroyBuffer",
+  "vkGetBufferDeviceAddress",
+  "vkDeviceWaitIdle",
+  "vkCreateShadersEXT",
+  "vkDestroyShaderEXT",
+  "vkGetDescriptorSetLayoutSizeEXT",
+  "vkGetDescriptorSetLayoutBindingOffsetEXT",
+  "vkGetDescriptorEXT",
+  "vkCreateShaderModule",
+  "vkDestroyShaderModule",
+  "vkCreateGraphicsPipelines",
+  "vkDestroyPipeline",
+  "vkCreatePipelineCache",
+  "vkDestroyPipelineCache",
+  "vkGetPipelineCacheData",
+  "vkGetBufferMemoryRequirements",
+
+  #Submission
+  "vkAllocateCommandBuffers",
+  "vkResetCommandBuffer",
+  "vkBeginCommandBuffer",
+  "vkEndCommandBuffer",
+  "vkQueueSubmit2",
+  "vkWaitSemaphores",
+  "vkGetSemaphoreCounterValue",
+
+  #Profiling
+  "vkCreateQueryPool",
+  "vkDestroyQueryPool",
+  "vkResetQueryPool",
+  "vkGetQueryPoolResults",
+  "vkCmdWriteTimestamp2",
+  "vkCmdBeginQuery",
+  "vkCmdEndQuery",
+
+  #Recording
+  "vkCmdPipelineBarrier2",
+  "vkCmdBeginRendering",
+  "vkCmdEndRendering",
+  "vkCmdBindShadersEXT",
+  "vkCmdBindPipeline",
+  "vkCmdBindDescriptorBuffersEXT",
+  "vkCmdSetDescriptorBufferOffsetsEXT",
+  "vkCmdPushConstants",
+  "vkCmdSetVertexInputEXT",
+  "vkCmdBindVertexBuffers2",
+  "vkCmdBindIndexBuffer",
+  "vkCmdBindIndexBuffer2KHR",
+  "vkCmdSetViewportWithCount",
+  "vkCmdSetScissorWithCount",
+  "vkCmdSetRasterizerDiscardEnable",
+  "vkCmdSetCullMode",
+  "vkCmdSetFrontFace",
+  "vkCmdSetDepthTestEnable",
+  "vkCmdSetDepthWriteEnable",
+  "vkCmdSetDepthBiasEnable",
+  "vkCmdSetDepthBoundsTestEnable",
+  "vkCmdSetStencilTestEnable",
+  "vkCmdSetPrimitiveTopology",
+  "vkCmdSetPrimitiveRestartEnable",
+  "vkCmdSetPolygonModeEXT",
+  "vkCmdSetRasterizationSamplesEXT",
+  "vkCmdSetSampleMaskEXT",
+  "vkCmdSetAlphaToCoverageEnableEXT",
+  "vkCmdSetColorBlendEnableEXT",
+  "vkCmdSetColorWriteMaskEXT",
+  "vkCmdSetDepthClampEnableEXT",
+  "vkCmdSetProvokingVertexModeEXT",
+  "vkCmdDispatch",
+  "vkCmdDraw",
+  "vkCmdDrawIndexed"
+]
+
+Versions=["VK_VERSION_1_0","VK_VERSION_1_1","VK_VERSION_1_2","VK_VERSION_1_3"]
+Extensions=["VK_EXT_shader_object","VK_EXT_descriptor_buffer","VK_KHR_maintenance5"]
+Optional=["VK_KHR_maintenance5"]
+DispatchableTypes=["VkDevice","VkQueue","VkCommandBuffer"]
+
+def Vulkan(element):
+  #vulkansc only entries do not exist in the Vulkan headers
+  return "vulkan" in element.get("api","vulkan").split(",")
+
+def Load(path):
+  registry=ElementTree.parse(path).getroot()
+
+  firstParameters={}
+  aliases={}
+  for command in registry.findall("commands/command"):
+    if not Vulkan(command):
+      continue
+    if command.get("alias"):
+      aliases[command.get("name")]=command.get("alias")
+      continue
+    name=command.find("proto/name").text
+    firstParameters[name]=command.find("param/type").text
+
+  origins={}
+  #Commands whose first require also depends on another extension
+  conditions={}
+  groups=[]
+  for feature in registry.findall("feature"):
+    if feature.get("name") in Versions and Vulkan(feature):
+      groups.append((feature.get("name"),feature))
+  for extension in registry.findall("extensions/extension"):
+    if extension.get("name") in Extensions:
+      groups.append((extension.get("name"),extension))
+  groups.sort(key=lambda group:(Versions+Extensions).index(group[0]))
+  for name,element in groups:
+    for require in element.findall("require"):
+      if not Vulkan(require):
+        continue
+      for command in require.findall("command"):
+        if command.get("name") in origins:
+          continue
+        origins[command.get("name")]=name
+        if require.get("depends"):
+          conditions[command.get("name")]=require.get("depends")
+  return firstParameters,aliases,origins,conditions
+
+def Generate(path):
+  firstParameters,aliases,origins,conditions=Load(path)
+
+  grouped={name:[] for name in Versions+Extensions}
+  errors=[]
+  for command in Commands:
+    target=aliases.get(command,command)
+    if target not in firstParameters:
+      errors.append(f"{command} is not in the registry")
+    elif firstParameters[target] not in DispatchableTypes:
+      errors.append(f"{command} is not a device level command")
+    elif command not in origins:
+      errors.append(f"{command} is not part of Vulkan 1.3 or {', '.join(Extensions)}")
+    else:
+      grouped[origins[command]].append(command)
+  if errors:
+    raise SystemExit("\n".join(errors))
+
+  lines=[
+    "#pragma once",
+    "#include<string>",
+    "#include<vulkan/vulkan.h>",
+    "",
+    "//Generated by GenerateDispatch.py from vk.xml, edit its Commands list and",
+    "//rerun instead of editing this file.",
+    "//",
+    "//Device level entry points resolved once per VkDevice with",
+    "//vkGetDeviceProcAddr. Calls through the table go straight to the driver,",
+    "//the exported functions go through the loader's trampoline and its",
+    "//dispatch first.",
+    "struct DeviceDispatch{"
+  ]
+  for group in Versions+Extensions:
+    if not grouped[group]:
+      continue
+    lines.append(f"  //{group}{', optional' if group in Optional else ''}")
+    for command in grouped[group]:
+      if command in conditions:
+        lines.append(f"  //Needs {conditions[command]}, may stay null")
+      lines.append(f"  PFN_{command} {command}=nullptr;")
+  lines+=[
+    "",
+    "  void Load(VkDevice device,PFN_vkGetDeviceProcAddr getDeviceProcAddr){"
+  ]
+  for group in Versions+Extensions:
+    for command in grouped[group]:
+      lines.append(f"    {command}=reinterpret_cast<PFN_{command}>(getDeviceProcAddr(device,\"{command}\"));")
+  lines+=[
+    "  }",
+    "",
+    "  //The loader exports of the core commands, for code that records on a",
+    "  //raw VkDevice without a table of its own. Extension commands stay null.",
+    "  static const DeviceDispatch &Exports(){",
+    "    static const DeviceDispatch exports=[]{",
+    "      DeviceDispatch table;"
+  ]
+  for group in Versions:
+    for command in grouped[group]:
+      lines.append(f"      table.{command}=&::{command};")
+  lines+=[
+    "      return table;",
+    "    }();",
+    "    return exports;",
+    "  }",
+    "",
+    "  //Required commands the device did not return, each preceded by a space",
+    "  std::string Missing()const{",
+    "    std::string missing;"
+  ]
+  for group in Versions+Extensions:
+    if group in Optional:
+      continue
+    for command in grouped[group]:
+      if command in conditions:
+        continue
+      lines.append(f"    if(!{command})")
+      lines.append(f"      missing+=\" {command}\";")
+  lines+=[
+    "    return missing;",
+    "  }",
+    "};",
+    ""
+  ]
+  return "\n".join(lines)
+
+if __name__=="__main__":
+  if len(sys.argv)!=3:
+    raise SystemExit("Usage: GenerateDispatch.py <vk.xml> <DeviceDispatch.h>")
+  header=Generate(sys.argv[1])
+  with open(sys.argv[2],"w",newline="\n") as file:
+    file.write(header)
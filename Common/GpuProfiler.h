@@ -0,0 +1,422 @@
+#pragma once
+#include<array>
+#include<vector>
+#include<string>
+#include<chrono>
+#include<thread>
+#include<algorithm>
+#include<fstream>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"DeviceDispatch.h"
+
+//Per-pass GPU timing. Every profiled pass is wrapped in a pair of
+//vkCmdWriteTimestamp2 queries and, if statistics were requested, a pipeline
+//statistics query. Each frame in flight owns its own query pools, results
+//are read back with WITH_AVAILABILITY and never wait on the GPU, so a frame
+//shows up in Results() a few frames after it was submitted.
+//
+//Alongside the GPU time the profiler keeps the CPU time spent recording each
+//pass and the submit-to-complete latency, measured from Submitted() to the
+//first Collect() that finds every query of the frame available.
+//
+//Queries are reset from the host, the device needs the hostQueryReset
+//feature. Statistics also need pipelineStatisticsQuery enabled, on a device
+//that does not support it they are left out and only time is kept. Queries are
+//written and read through the given dispatch table, or the loader exports
+//when there is none.
+class GpuProfiler{
+public:
+  //Names of the VkQueryPipelineStatisticFlagBits in bit order
+  static constexpr std::array<const char *,11> StatisticNames={
+    "inputAssemblyVertices","inputAssemblyPrimitives","vertexShaderInvocations",
+    "geometryShaderInvocations","geometryShaderPrimitives","clippingInvocations",
+    "clippingPrimitives","fragmentShaderInvocations","tessellationControlShaderPatches",
+    "tessellationEvaluationShaderInvocations","computeShaderInvocations"
+  };
+
+  struct PassResult{
+    std::string name;
+    uint32_t queueFamily=VK_QUEUE_FAMILY_IGNORED;
+    //GPU times are relative to the first timestamp read from the same queue
+    //family, the timestamps of different families are not comparable
+    double gpuBeginMs=0.0;
+    double gpuMs=0.0;
+    //CPU times are relative to the creation of the profiler
+    double cpuBeginMs=0.0;
+    double cpuRecordMs=0.0;
+    //One value per requested statistic in bit order, empty if not collected
+    std::vector<uint64_t> statistics;
+  };
+
+  struct FrameResult{
+    uint64_t frame=0;
+    double submitMs=0.0;
+    double submitToCompleteMs=0.0;
+    std::vector<PassResult> passes;
+  };
+
+private:
+  struct Pass{
+    std::string name;
+    uint32_t queueFamily=VK_QUEUE_FAMILY_IGNORED;
+    bool timed=false;
+    uint32_t statisticsIndex=~0u;
+    double cpuBeginMs=0.0;
+    double cpuEndMs=0.0;
+  };
+
+  struct Frame{
+    VkQueryPool timestamps=nullptr;
+    VkQueryPool statistics=nullptr;
+    std::vector<Pass> passes;
+    uint32_t statisticsCount=0;
+    uint64_t number=0;
+    double submitMs=0.0;
+    bool pending=false;
+  };
+
+  struct Family{
+    VkQueueFlags flags=0;
+    uint64_t timestampMask=0;
+    bool haveOrigin=false;
+    uint64_t origin=0;
+  };
+
+  VkDevice device=nullptr;
+  const DeviceDispatch *dispatch;
+  double timestampPeriod=1.0;
+  uint32_t maxPasses=0;
+  VkQueryPipelineStatisticFlags statisticFlags=0;
+  uint32_t statisticCount=0;
+  std::vector<Family> families;
+  uint32_t defaultFamily=0;
+
+  std::vector<Frame> frames;
+  Frame *current=nullptr;
+  uint64_t frameNumber=0;
+  uint32_t open=~0u;
+  std::chrono::steady_clock::time_point cpuOrigin=std::chrono::steady_clock::now();
+
+  std::vector<FrameResult> results;
+  std::vector<uint64_t> readback;
+
+  double Now()const{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-cpuOrigin).count();
+  }
+
+  uint32_t FamilyIndex(uint32_t queueFamily)const{
+    return queueFamily<families.size()?queueFamily:defaultFamily;
+  }
+
+  //Reads the frame if all its queries are done, returns false otherwise
+  bool Read(Frame &frame){
+    if(!frame.pending)
+      return true;
+
+    //Passes past maxPasses were recorded untimed
+    uint32_t queryCount=std::min((uint32_t)frame.passes.size(),maxPasses)*2;
+    readback.assign(frame.passes.size()*4,0);
+    if(queryCount>0){
+      auto result=dispatch->vkGetQueryPoolResults(device,frame.timestamps,0,queryCount,
+        readback.size()*sizeof(uint64_t),readback.data(),2*sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT|VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+      if(result!=VK_SUCCESS&&result!=VK_NOT_READY)
+        throw std::runtime_error("Failed to read timestamp queries");
+    }
+
+    //Passes that could not be timed never wrote their queries
+    for(uint32_t index=0;index<frame.passes.size();index++){
+      if(frame.passes[index].timed&&(readback[index*4+1]==0||readback[index*4+3]==0))
+        return false;
+    }
+
+    std::vector<uint64_t> statistics((statisticCount+1)*frame.statisticsCount);
+    if(frame.statisticsCount>0){
+      auto result=dispatch->vkGetQueryPoolResults(device,frame.statistics,0,frame.statisticsCount,
+        statistics.size()*sizeof(uint64_t),statistics.data(),(statisticCount+1)*sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT|VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+      if(result!=VK_SUCCESS&&result!=VK_NOT_READY)
+        throw std::runtime_error("Failed to read pipeline statistics queries");
+      for(uint32_t index=0;index<frame.statisticsCount;index++){
+        if(statistics[index*(statisticCount+1)+statisticCount]==0)
+          return false;
+      }
+    }
+
+    FrameResult frameResult;
+    frameResult.frame=frame.number;
+    frameResult.submitMs=frame.submitMs;
+    frameResult.submitToCompleteMs=Now()-frame.submitMs;
+
+    for(uint32_t index=0;index<frame.passes.size();index++){
+      auto &pass=frame.passes[index];
+      PassResult passResult;
+      passResult.name=pass.name;
+      passResult.queueFamily=pass.queueFamily;
+      passResult.cpuBeginMs=pass.cpuBeginMs;
+      passResult.cpuRecordMs=pass.cpuEndMs-pass.cpuBeginMs;
+
+      if(pass.timed){
+        auto &family=families[FamilyIndex(pass.queueFamily)];
+        uint64_t mask=family.timestampMask;
+        uint64_t begin=readback[index*4]&mask;
+        uint64_t end=readback[index*4+2]&mask;
+        if(!family.haveOrigin){
+          family.origin=begin;
+          family.haveOrigin=true;
+        }
+        passResult.gpuBeginMs=(double)(int64_t)(begin-family.origin)*timestampPeriod*1e-6;
+        passResult.gpuMs=(double)((end-begin)&mask)*timestampPeriod*1e-6;
+      }
+
+      if(pass.statisticsIndex!=~0u){
+        auto first=statistics.begin()+pass.statisticsIndex*(statisticCount+1);
+        passResult.statistics.assign(first,first+statisticCount);
+      }
+      frameResult.passes.push_back(std::move(passResult));
+    }
+
+    results.push_back(std::move(frameResult));
+    frame.pending=false;
+    return true;
+  }
+
+  static std::string Escape(const std::string &text){
+    std::string escaped;
+    for(char character:text){
+      if(character=='"'||character=='\\')
+        escaped+='\\';
+      escaped+=character;
+    }
+    return escaped;
+  }
+
+  std::string StatisticsJson(const PassResult &pass)const{
+    std::string json="{";
+    uint32_t value=0;
+    for(uint32_t bit=0;bit<StatisticNames.size()&&value<pass.statistics.size();bit++){
+      if(!(statisticFlags&(1u<<bit)))
+        continue;
+      json+=std::format("{}\"{}\":{}",value>0?",":"",StatisticNames[bit],pass.statistics[value]);
+      value++;
+    }
+    return json+"}";
+  }
+
+  static bool StatisticsSupported(VkPhysicalDevice physicalDevice){
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice,&features);
+    return features.pipelineStatisticsQuery;
+  }
+
+public:
+  GpuProfiler(VkDevice device,VkPhysicalDevice physicalDevice,uint32_t framesInFlight=3,
+    uint32_t maxPasses=64,VkQueryPipelineStatisticFlags statisticFlags=0,const DeviceDispatch *dispatch=nullptr):
+    device(device),dispatch(dispatch?dispatch:&DeviceDispatch::Exports()),maxPasses(maxPasses),
+    statisticFlags(StatisticsSupported(physicalDevice)?statisticFlags:0){
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+    timestampPeriod=properties.limits.timestampPeriod;
+
+    uint32_t familyCount=0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,familyProperties.data());
+    for(uint32_t family=0;family<familyCount;family++){
+      auto bits=familyProperties[family].timestampValidBits;
+      families.push_back({
+        .flags=familyProperties[family].queueFlags,
+        .timestampMask=bits>=64?~0ull:(1ull<<bits)-1
+      });
+      if(familyProperties[family].queueFlags&VK_QUEUE_GRAPHICS_BIT&&
+         !(families[defaultFamily].flags&VK_QUEUE_GRAPHICS_BIT))
+        defaultFamily=family;
+    }
+
+    for(uint32_t bit=0;bit<32;bit++){
+      if(this->statisticFlags&(1u<<bit))
+        statisticCount++;
+    }
+
+    frames.resize(framesInFlight);
+    for(auto &frame:frames){
+      VkQueryPoolCreateInfo queryPoolInfo={
+        .sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext=nullptr,
+        .flags=0,
+        .queryType=VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount=maxPasses*2,
+        .pipelineStatistics=0
+      };
+      auto result=this->dispatch->vkCreateQueryPool(device,&queryPoolInfo,nullptr,&frame.timestamps);
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to create timestamp query pool");
+      this->dispatch->vkResetQueryPool(device,frame.timestamps,0,maxPasses*2);
+
+      if(this->statisticFlags){
+        queryPoolInfo.queryType=VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryPoolInfo.queryCount=maxPasses;
+        queryPoolInfo.pipelineStatistics=this->statisticFlags;
+        result=this->dispatch->vkCreateQueryPool(device,&queryPoolInfo,nullptr,&frame.statistics);
+        if(result!=VK_SUCCESS)
+          throw std::runtime_error("Failed to create pipeline statistics query pool");
+        this->dispatch->vkResetQueryPool(device,frame.statistics,0,maxPasses);
+      }
+    }
+  }
+
+  GpuProfiler(const GpuProfiler &)=delete;
+  GpuProfiler &operator=(const GpuProfiler &)=delete;
+
+  ~GpuProfiler(){
+    Destroy();
+  }
+
+  //Call once the GPU no longer uses the query pools, before the device goes away
+  void Destroy(){
+    if(!device)
+      return;
+    for(auto &frame:frames){
+      dispatch->vkDestroyQueryPool(device,frame.timestamps,nullptr);
+      if(frame.statistics)
+        dispatch->vkDestroyQueryPool(device,frame.statistics,nullptr);
+    }
+    frames.clear();
+    device=nullptr;
+  }
+
+  //Starts recording into the next frame's pools. If that frame's results
+  //are still in flight it waits for them, which only happens when more
+  //frames are queued than the profiler was created for.
+  void BeginFrame(){
+    current=&frames[frameNumber%frames.size()];
+    while(!Read(*current))
+      std::this_thread::yield();
+
+    dispatch->vkResetQueryPool(device,current->timestamps,0,maxPasses*2);
+    if(current->statistics)
+      dispatch->vkResetQueryPool(device,current->statistics,0,maxPasses);
+
+    current->passes.clear();
+    current->statisticsCount=0;
+    current->number=frameNumber++;
+    current->pending=false;
+  }
+
+  //queueFamily decides whether timestamps and statistics are allowed on
+  //the command buffer, IGNORED assumes a graphics queue
+  void BeginPass(VkCommandBuffer CMDBuffer,const std::string &name,uint32_t queueFamily){
+    if(!current)
+      throw std::runtime_error("BeginPass called outside a frame");
+    if(open!=~0u)
+      throw std::runtime_error("Profiled passes cannot nest");
+
+    Pass pass;
+    pass.name=name;
+    pass.queueFamily=queueFamily;
+    pass.cpuBeginMs=Now();
+
+    uint32_t index=(uint32_t)current->passes.size();
+    auto &family=families[FamilyIndex(queueFamily)];
+    if(index<maxPasses&&family.timestampMask!=0){
+      pass.timed=true;
+      dispatch->vkCmdWriteTimestamp2(CMDBuffer,VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,current->timestamps,index*2);
+    }
+
+    //Compute queues may only count compute invocations, transfer queues
+    //none at all
+    bool graphics=family.flags&VK_QUEUE_GRAPHICS_BIT;
+    bool compute=family.flags&VK_QUEUE_COMPUTE_BIT;
+    bool computeOnly=(statisticFlags&~VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)==0;
+    if(current->statistics&&index<maxPasses&&(graphics||(compute&&computeOnly))){
+      pass.statisticsIndex=current->statisticsCount++;
+      dispatch->vkCmdBeginQuery(CMDBuffer,current->statistics,pass.statisticsIndex,0);
+    }
+
+    current->passes.push_back(std::move(pass));
+    open=index;
+  }
+
+  void EndPass(VkCommandBuffer CMDBuffer){
+    if(open==~0u)
+      throw std::runtime_error("EndPass without BeginPass");
+
+    auto &pass=current->passes[open];
+    if(pass.statisticsIndex!=~0u)
+      dispatch->vkCmdEndQuery(CMDBuffer,current->statistics,pass.statisticsIndex);
+    if(pass.timed)
+      dispatch->vkCmdWriteTimestamp2(CMDBuffer,VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,current->timestamps,open*2+1);
+    pass.cpuEndMs=Now();
+    open=~0u;
+  }
+
+  //Marks the current frame as submitted, starts the latency measurement
+  void Submitted(){
+    if(!current)
+      return;
+    current->submitMs=Now();
+    current->pending=true;
+    current=nullptr;
+  }
+
+  //Moves every finished frame into Results(), never waits on the GPU
+  void Collect(){
+    for(auto &frame:frames)
+      Read(frame);
+  }
+
+  const std::vector<FrameResult> &Results()const{
+    return results;
+  }
+
+  void WriteJson(const std::string &path)const{
+    std::ofstream file(path);
+    if(!file.is_open())
+      throw std::runtime_error("Unable to open profile output");
+
+    file<<"{\"frames\":[";
+    for(size_t frameIndex=0;frameIndex<results.size();frameIndex++){
+      auto &frame=results[frameIndex];
+      file<<std::format("{}\n{{\"frame\":{},\"submitToCompleteMs\":{},\"passes\":[",
+        frameIndex>0?",":"",frame.frame,frame.submitToCompleteMs);
+      for(size_t passIndex=0;passIndex<frame.passes.size();passIndex++){
+        auto &pass=frame.passes[passIndex];
+        file<<std::format("{}{{\"name\":\"{}\",\"queueFamily\":{},\"gpuMs\":{},\"cpuRecordMs\":{},\"statistics\":{}}}",
+          passIndex>0?",":"",Escape(pass.name),(int32_t)pass.queueFamily,pass.gpuMs,pass.cpuRecordMs,StatisticsJson(pass));
+      }
+      file<<"]}";
+    }
+    file<<"\n]}\n";
+  }
+
+  //Chrome trace event format, open in chrome://tracing or Perfetto. Every
+  //queue family is its own process starting at its own first timestamp,
+  //the timestamps of different families and the CPU clock are not
+  //calibrated against each other so their tracks do not line up.
+  void WriteChromeTrace(const std::string &path)const{
+    std::ofstream file(path);
+    if(!file.is_open())
+      throw std::runtime_error("Unable to open trace output");
+
+    file<<"{\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}}";
+    for(uint32_t family=0;family<families.size();family++)
+      file<<std::format(",\n{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"GPU queue family {}\"}}}}",
+        family+1,family);
+    for(auto &frame:results){
+      for(auto &pass:frame.passes){
+        auto name=Escape(pass.name);
+        file<<std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":{},\"dur\":{},\"args\":{{\"frame\":{}}}}}",
+          name,pass.cpuBeginMs*1000.0,pass.cpuRecordMs*1000.0,frame.frame);
+        file<<std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":0,\"ts\":{},\"dur\":{},\"args\":{{\"frame\":{},\"statistics\":{}}}}}",
+          name,FamilyIndex(pass.queueFamily)+1,pass.gpuBeginMs*1000.0,pass.gpuMs*1000.0,frame.frame,StatisticsJson(pass));
+      }
+      file<<std::format(",\n{{\"name\":\"Submit to complete\",\"ph\":\"X\",\"pid\":0,\"tid\":1,\"ts\":{},\"dur\":{},\"args\":{{\"frame\":{}}}}}",
+        frame.submitMs*1000.0,frame.submitToCompleteMs*1000.0,frame.frame);
+    }
+    file<<"\n]}\n";
+  }
+};
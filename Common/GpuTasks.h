@@ -0,0 +1,232 @@
+#pragma once
+#include<vector>
+#include<coroutine>
+#include<exception>
+#include<utility>
+#include<vulkan/vulkan.h>
+#include"DeviceQueues.h"
+#include"FrameGraph.h"
+
+//GPU work as C++20 coroutines. A GpuTask is written as a straight line of
+//host work and submissions:
+//
+//  GpuTask Job(GpuExecutor &executor,FrameGraph &graph){
+//    ...upload, AddPass...
+//    co_await executor.Submit(graph);
+//    ...read back, build the next graph...
+//  }
+//
+//co_await suspends the task until the timeline values its submission
+//signaled are reached, the executor runs other tasks in the meantime. Run()
+//drives every spawned task from the calling thread: it resumes the tasks
+//that can go on, checks each queue's timeline once per round and, when no
+//task is ready, blocks in one vkWaitSemaphores for whichever submission
+//finishes first. Many independent chains stay in flight without threads or
+//callbacks.
+//
+//Single threaded, the executor and the tasks must not be touched from
+//another thread while Run() is going. Whatever a task references has to
+//outlive Run().
+
+class GpuTask{
+public:
+  struct promise_type{
+    std::exception_ptr exception;
+
+    GpuTask get_return_object(){
+      return GpuTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    //Started by the executor, not on creation
+    std::suspend_always initial_suspend()noexcept{
+      return {};
+    }
+    //Kept alive so the executor can see it finished and destroy it
+    std::suspend_always final_suspend()noexcept{
+      return {};
+    }
+    void return_void(){
+    }
+    void unhandled_exception(){
+      exception=std::current_exception();
+    }
+  };
+
+private:
+  friend class GpuExecutor;
+  std::coroutine_handle<promise_type> handle;
+
+  explicit GpuTask(std::coroutine_handle<promise_type> handle):
+    handle(handle){
+  }
+
+public:
+  GpuTask(GpuTask &&other)noexcept:
+    handle(std::exchange(other.handle,nullptr)){
+  }
+
+  GpuTask &operator=(GpuTask &&other)noexcept{
+    if(this!=&other){
+      if(handle)
+        handle.destroy();
+      handle=std::exchange(other.handle,nullptr);
+    }
+    return *this;
+  }
+
+  GpuTask(const GpuTask &)=delete;
+  GpuTask &operator=(const GpuTask &)=delete;
+
+  ~GpuTask(){
+    if(handle)
+      handle.destroy();
+  }
+};
+
+class GpuExecutor{
+  using Handle=std::coroutine_handle<GpuTask::promise_type>;
+
+  struct Waiting{
+    std::vector<DeviceQueues::SyncPoint> points;
+    Handle handle;
+  };
+
+  DeviceQueues &queues;
+  std::vector<Handle> ready;
+  std::vector<Waiting> waiting;
+  //Scratch for Run(), kept to avoid allocating every round
+  std::vector<Handle> resuming;
+  std::vector<DeviceQueues::SyncPoint> pending;
+  std::exception_ptr exception;
+
+  uint64_t rounds=0;
+  uint64_t blockingWaits=0;
+
+  bool Reached(const std::vector<DeviceQueues::SyncPoint> &points){
+    for(auto &point:points){
+      if(point.queue&&point.value>0&&queues.Completed(*point.queue)<point.value)
+        return false;
+    }
+    return true;
+  }
+
+  //Moves every waiting task whose points are all reached to ready
+  void Poll(){
+    std::erase_if(waiting,[&](Waiting &entry){
+      if(!Reached(entry.points))
+        return false;
+      ready.push_back(entry.handle);
+      return true;
+    });
+  }
+
+  void Resume(Handle handle){
+    handle.resume();
+    if(!handle.done())
+      return;
+    if(handle.promise().exception&&!exception)
+      exception=handle.promise().exception;
+    handle.destroy();
+  }
+
+public:
+  //What co_await waits on, the submission has already been made when the
+  //awaitable is created. await_resume hands the points back so a later
+  //submission can wait on them on the device instead.
+  class Awaitable{
+    GpuExecutor &executor;
+    std::vector<DeviceQueues::SyncPoint> points;
+
+  public:
+    Awaitable(GpuExecutor &executor,std::vector<DeviceQueues::SyncPoint> points):
+      executor(executor),
+      points(std::move(points)){
+    }
+
+    bool await_ready(){
+      return executor.Reached(points);
+    }
+
+    void await_suspend(Handle handle){
+      executor.waiting.push_back({.points=points,.handle=handle});
+    }
+
+    std::vector<DeviceQueues::SyncPoint> await_resume(){
+      return std::move(points);
+    }
+  };
+
+  GpuExecutor(DeviceQueues &queues):
+    queues(queues){
+  }
+
+  GpuExecutor(const GpuExecutor &)=delete;
+  GpuExecutor &operator=(const GpuExecutor &)=delete;
+
+  //Tasks left suspended by a Run() that threw are dropped without being
+  //resumed, their submissions may still be executing
+  ~GpuExecutor(){
+    for(auto handle:ready)
+      handle.destroy();
+    for(auto &entry:waiting)
+      entry.handle.destroy();
+  }
+
+  //Queued to run from the next Run()
+  void Spawn(GpuTask task){
+    ready.push_back(std::exchange(task.handle,nullptr));
+  }
+
+  //Submits the graph and suspends until every queue it used is done with it
+  Awaitable Submit(FrameGraph &graph){
+    return Awaitable(*this,graph.Submit(queues));
+  }
+
+  Awaitable Wait(std::vector<DeviceQueues::SyncPoint> points){
+    return Awaitable(*this,std::move(points));
+  }
+
+  //Returns once every spawned task has finished. The first exception a task
+  //threw is rethrown after the others have run to completion, so none of
+  //them is left with work in flight.
+  void Run(){
+    while(!ready.empty()||!waiting.empty()){
+      rounds++;
+      //Resumed tasks may spawn or become ready again, they go in the next round
+      resuming.swap(ready);
+      for(auto handle:resuming)
+        Resume(handle);
+      resuming.clear();
+
+      if(!ready.empty()||waiting.empty())
+        continue;
+      Poll();
+      if(!ready.empty())
+        continue;
+
+      //WaitAny returns at once on a null point, reached ones would keep it
+      //from blocking on the rest
+      pending.clear();
+      for(auto &entry:waiting){
+        for(auto &point:entry.points){
+          if(point.queue&&point.value>0&&queues.Completed(*point.queue)<point.value)
+            pending.push_back(point);
+        }
+      }
+      queues.WaitAny(pending);
+      blockingWaits++;
+      Poll();
+    }
+
+    if(exception)
+      std::rethrow_exception(std::exchange(exception,nullptr));
+  }
+
+  //Rounds of Run() so far and how many of them had to block on the device
+  uint64_t Rounds()const{
+    return rounds;
+  }
+
+  uint64_t BlockingWaits()const{
+    return blockingWaits;
+  }
+};
@@ -0,0 +1,547 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<unordered_map>
+#include<chrono>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"HeadlessDevice.h"
+#include"TracedCommands.h"
+
+//The scenarios render through shader objects with every piece of state
+//dynamic. GraphicsPipelines builds the equivalent VkPipelines from the same
+//SPIR-V and a GraphicsState, so both paths can be timed on the same scene:
+//
+//  Monolithic  one vkCreateGraphicsPipelines per state, all stages and
+//              state compiled together
+//  Library     VK_EXT_graphics_pipeline_library. The vertex input,
+//              pre-rasterization, fragment shader and fragment output parts
+//              are created once per distinct piece of state they bake in,
+//              a state's pipeline links the four, by default without link
+//              time optimisation
+//
+//Pipelines keep only viewport and scissor dynamic, the rest of
+//GraphicsState is baked in. Every pipeline and part is kept by a hash of the
+//state it covers, creation goes through the context's PipelineCache when
+//one is set.
+//
+//Pipelines are not part of the trace format, GraphicsPipelines cannot be
+//created while the context is capturing.
+
+enum class PipelineBackend:uint32_t{
+  ShaderObject=0,
+  Monolithic,
+  Library
+};
+
+inline const char *PipelineBackendName(PipelineBackend backend){
+  static constexpr std::array<const char *,3> Names={"shader-objects","monolithic","library"};
+  return Names[(size_t)backend];
+}
+
+//What the scenarios set dynamically and a pipeline bakes in. The state the
+//scenarios never change, depth, stencil, blending and multisampling, is
+//fixed and not part of it.
+struct GraphicsState{
+  VkPrimitiveTopology topology=VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPolygonMode polygonMode=VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cullMode=VK_CULL_MODE_NONE;
+  VkFrontFace frontFace=VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+    VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+  VkFormat colorFormat=VK_FORMAT_R8G8B8A8_UNORM;
+  //Pipelines only take per vertex and divisor 1 instance rate bindings
+  std::vector<VkVertexInputBindingDescription2EXT> bindings;
+  std::vector<VkVertexInputAttributeDescription2EXT> attributes;
+
+private:
+  //FNV-1a, the same as DescriptorSet::Hash
+  static void Mix(uint64_t &hash,uint64_t value,int bytes=4){
+    for(int byte=0;byte<bytes;byte++){
+      hash^=(value>>(byte*8))&0xff;
+      hash*=0x100000001b3ull;
+    }
+  }
+
+  uint64_t LayoutHash()const{
+    uint64_t hash=0xcbf29ce484222325ull;
+    for(auto &binding:bindings){
+      Mix(hash,binding.binding);
+      Mix(hash,binding.stride);
+      Mix(hash,(uint32_t)binding.inputRate);
+      Mix(hash,binding.divisor);
+    }
+    for(auto &attribute:attributes){
+      Mix(hash,attribute.location);
+      Mix(hash,attribute.binding);
+      Mix(hash,(uint32_t)attribute.format);
+      Mix(hash,attribute.offset);
+    }
+    return hash;
+  }
+
+public:
+  //What each library part bakes in
+  uint64_t VertexInputHash()const{
+    auto hash=LayoutHash();
+    Mix(hash,(uint32_t)topology);
+    return hash;
+  }
+
+  uint64_t PreRasterizationHash()const{
+    uint64_t hash=0xcbf29ce484222325ull;
+    Mix(hash,(uint32_t)polygonMode);
+    Mix(hash,cullMode);
+    Mix(hash,(uint32_t)frontFace);
+    return hash;
+  }
+
+  uint64_t FragmentOutputHash()const{
+    uint64_t hash=0xcbf29ce484222325ull;
+    Mix(hash,writeMask);
+    Mix(hash,(uint32_t)colorFormat);
+    return hash;
+  }
+
+  uint64_t Hash()const{
+    uint64_t hash=0xcbf29ce484222325ull;
+    Mix(hash,VertexInputHash(),8);
+    Mix(hash,PreRasterizationHash(),8);
+    Mix(hash,FragmentOutputHash(),8);
+    return hash;
+  }
+
+  //Records the state for shader objects. With previous only what differs
+  //from it is set, without it everything including the fixed state.
+  void Apply(TracedCommands &commands,const GraphicsState *previous=nullptr)const{
+    if(!previous){
+      commands.SetRasterizerDiscardEnable(VK_FALSE);
+      commands.SetDepthTestEnable(VK_FALSE);
+      commands.SetDepthWriteEnable(VK_FALSE);
+      commands.SetDepthBiasEnable(VK_FALSE);
+      commands.SetDepthBoundsTestEnable(VK_FALSE);
+      commands.SetStencilTestEnable(VK_FALSE);
+      commands.SetPrimitiveRestartEnable(VK_FALSE);
+      commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+      VkSampleMask sampleMask=~0u;
+      commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+      commands.SetAlphaToCoverageEnable(VK_FALSE);
+      VkBool32 blendEnable=VK_FALSE;
+      commands.SetColorBlendEnable(0,1,&blendEnable);
+    }
+    if(!previous||previous->topology!=topology)
+      commands.SetPrimitiveTopology(topology);
+    if(!previous||previous->polygonMode!=polygonMode)
+      commands.SetPolygonMode(polygonMode);
+    if(!previous||previous->cullMode!=cullMode)
+      commands.SetCullMode(cullMode);
+    if(!previous||previous->frontFace!=frontFace)
+      commands.SetFrontFace(frontFace);
+    if(!previous||previous->writeMask!=writeMask)
+      commands.SetColorWriteMask(0,1,&writeMask);
+    if(!previous||previous->LayoutHash()!=LayoutHash()){
+      commands.SetVertexInput((uint32_t)bindings.size(),bindings.data(),
+        (uint32_t)attributes.size(),attributes.data());
+    }
+  }
+};
+
+struct PipelineOptions{
+  //Link library parts with link time optimisation, slower to create and
+  //meant to run as fast as a monolithic pipeline
+  bool optimise=false;
+  //Through the context's PipelineCache, false for cold creation timings
+  bool cached=true;
+};
+
+struct PipelineStats{
+  //Monolithic or linked pipelines and the time spent creating them
+  uint32_t pipelines=0;
+  double pipelineMs=0.0;
+  //Library parts, the fragment shader part included
+  uint32_t libraries=0;
+  double libraryMs=0.0;
+};
+
+class GraphicsPipelines{
+  //Every create info of one GraphicsState, each pipeline or part picks what
+  //it covers. Points into itself, filled in place and never copied.
+  struct Description{
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPipelineVertexInputStateCreateInfo vertexInput;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    VkPipelineViewportStateCreateInfo viewport;
+    VkPipelineRasterizationStateCreateInfo rasterization;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    VkPipelineDepthStencilStateCreateInfo depthStencil;
+    VkPipelineColorBlendAttachmentState blendAttachment;
+    VkPipelineColorBlendStateCreateInfo colorBlend;
+    std::array<VkDynamicState,2> dynamicStates;
+    VkPipelineDynamicStateCreateInfo dynamic;
+    VkPipelineRenderingCreateInfo rendering;
+    std::array<VkPipelineShaderStageCreateInfo,2> stages;
+
+    Description()=default;
+    Description(const Description &)=delete;
+    Description &operator=(const Description &)=delete;
+  };
+
+  HeadlessDevice &context;
+  PipelineBackend backend;
+  PipelineOptions options;
+  VkPipelineLayout layout;
+  VkPipelineCache cache=VK_NULL_HANDLE;
+  VkShaderModule vertexModule=nullptr;
+  VkShaderModule fragmentModule=nullptr;
+  PipelineStats stats;
+
+  //By GraphicsState::Hash
+  std::unordered_map<uint64_t,VkPipeline> pipelines;
+  //Library parts by the hash of the state they bake in, the fragment shader
+  //part depends on none of GraphicsState
+  std::unordered_map<uint64_t,VkPipeline> vertexInputs;
+  std::unordered_map<uint64_t,VkPipeline> preRasterizations;
+  std::unordered_map<uint64_t,VkPipeline> fragmentOutputs;
+  VkPipeline fragmentShader=nullptr;
+
+  VkShaderModule CreateModule(const std::vector<uint32_t> &code){
+    const auto *words=&code;
+    if(context.optimiser)
+      words=&context.optimiser->Cached(code.data(),code.size()*sizeof(uint32_t));
+    VkShaderModuleCreateInfo moduleInfo={
+      .sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .codeSize=words->size()*sizeof(uint32_t),
+      .pCode=words->data()
+    };
+    VkShaderModule module=nullptr;
+    if(context.dispatch.vkCreateShaderModule(context.device,&moduleInfo,nullptr,&module)!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader module");
+    return module;
+  }
+
+  void Describe(const GraphicsState &state,Description &description)const{
+    for(auto &binding:state.bindings){
+      if(binding.divisor!=1)
+        throw std::runtime_error(std::format("Binding {} has divisor {}, pipelines only take 1",binding.binding,binding.divisor));
+      description.bindings.push_back({
+        .binding=binding.binding,
+        .stride=binding.stride,
+        .inputRate=binding.inputRate
+      });
+    }
+    for(auto &attribute:state.attributes){
+      description.attributes.push_back({
+        .location=attribute.location,
+        .binding=attribute.binding,
+        .format=attribute.format,
+        .offset=attribute.offset
+      });
+    }
+
+    description.vertexInput={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .vertexBindingDescriptionCount=(uint32_t)description.bindings.size(),
+      .pVertexBindingDescriptions=description.bindings.data(),
+      .vertexAttributeDescriptionCount=(uint32_t)description.attributes.size(),
+      .pVertexAttributeDescriptions=description.attributes.data()
+    };
+    description.inputAssembly={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .topology=state.topology,
+      .primitiveRestartEnable=VK_FALSE
+    };
+    //Counts come from vkCmdSetViewportWithCount and vkCmdSetScissorWithCount
+    description.viewport={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .viewportCount=0,
+      .pViewports=nullptr,
+      .scissorCount=0,
+      .pScissors=nullptr
+    };
+    description.rasterization={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .depthClampEnable=VK_FALSE,
+      .rasterizerDiscardEnable=VK_FALSE,
+      .polygonMode=state.polygonMode,
+      .cullMode=state.cullMode,
+      .frontFace=state.frontFace,
+      .depthBiasEnable=VK_FALSE,
+      .depthBiasConstantFactor=0.0f,
+      .depthBiasClamp=0.0f,
+      .depthBiasSlopeFactor=0.0f,
+      .lineWidth=1.0f
+    };
+    description.multisample={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .rasterizationSamples=VK_SAMPLE_COUNT_1_BIT,
+      .sampleShadingEnable=VK_FALSE,
+      .minSampleShading=0.0f,
+      .pSampleMask=nullptr,
+      .alphaToCoverageEnable=VK_FALSE,
+      .alphaToOneEnable=VK_FALSE
+    };
+    description.depthStencil={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .depthTestEnable=VK_FALSE,
+      .depthWriteEnable=VK_FALSE,
+      .depthCompareOp=VK_COMPARE_OP_ALWAYS,
+      .depthBoundsTestEnable=VK_FALSE,
+      .stencilTestEnable=VK_FALSE,
+      .front={},
+      .back={},
+      .minDepthBounds=0.0f,
+      .maxDepthBounds=1.0f
+    };
+    description.blendAttachment={
+      .blendEnable=VK_FALSE,
+      .srcColorBlendFactor=VK_BLEND_FACTOR_ONE,
+      .dstColorBlendFactor=VK_BLEND_FACTOR_ZERO,
+      .colorBlendOp=VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor=VK_BLEND_FACTOR_ONE,
+      .dstAlphaBlendFactor=VK_BLEND_FACTOR_ZERO,
+      .alphaBlendOp=VK_BLEND_OP_ADD,
+      .colorWriteMask=state.writeMask
+    };
+    description.colorBlend={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .logicOpEnable=VK_FALSE,
+      .logicOp=VK_LOGIC_OP_COPY,
+      .attachmentCount=1,
+      .pAttachments=&description.blendAttachment,
+      .blendConstants={0.0f,0.0f,0.0f,0.0f}
+    };
+    description.dynamicStates={VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT,VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT};
+    description.dynamic={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .dynamicStateCount=(uint32_t)description.dynamicStates.size(),
+      .pDynamicStates=description.dynamicStates.data()
+    };
+    description.rendering={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .pNext=nullptr,
+      .viewMask=0,
+      .colorAttachmentCount=1,
+      .pColorAttachmentFormats=&state.colorFormat,
+      .depthAttachmentFormat=VK_FORMAT_UNDEFINED,
+      .stencilAttachmentFormat=VK_FORMAT_UNDEFINED
+    };
+    description.stages={{{
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .module=vertexModule,
+      .pName="main",
+      .pSpecializationInfo=nullptr
+    },{
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .module=fragmentModule,
+      .pName="main",
+      .pSpecializationInfo=nullptr
+    }}};
+  }
+
+  VkPipeline Create(const VkGraphicsPipelineCreateInfo &pipelineInfo,double &milliseconds){
+    VkPipeline pipeline=nullptr;
+    auto begin=std::chrono::steady_clock::now();
+    auto result=context.dispatch.vkCreateGraphicsPipelines(context.device,cache,1,&pipelineInfo,nullptr,&pipeline);
+    milliseconds+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-begin).count();
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error(std::format("Failed to create graphics pipeline ({})",(int32_t)result));
+    return pipeline;
+  }
+
+  VkPipeline Monolithic(const GraphicsState &state){
+    Description description;
+    Describe(state,description);
+    VkGraphicsPipelineCreateInfo pipelineInfo={
+      .sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext=&description.rendering,
+      .flags=0,
+      .stageCount=(uint32_t)description.stages.size(),
+      .pStages=description.stages.data(),
+      .pVertexInputState=&description.vertexInput,
+      .pInputAssemblyState=&description.inputAssembly,
+      .pTessellationState=nullptr,
+      .pViewportState=&description.viewport,
+      .pRasterizationState=&description.rasterization,
+      .pMultisampleState=&description.multisample,
+      .pDepthStencilState=&description.depthStencil,
+      .pColorBlendState=&description.colorBlend,
+      .pDynamicState=&description.dynamic,
+      .layout=layout,
+      .renderPass=VK_NULL_HANDLE,
+      .subpass=0,
+      .basePipelineHandle=VK_NULL_HANDLE,
+      .basePipelineIndex=-1
+    };
+    stats.pipelines++;
+    return Create(pipelineInfo,stats.pipelineMs);
+  }
+
+  //One library part, the create info holds only the state of that part
+  VkPipeline Part(VkGraphicsPipelineLibraryFlagsEXT part,const Description &description){
+    bool vertexInput=part==VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+    bool preRasterization=part==VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+    bool fragment=part==VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+    bool output=part==VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo={
+      .sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+      .pNext=vertexInput?nullptr:&description.rendering,
+      .flags=part
+    };
+    VkGraphicsPipelineCreateInfo pipelineInfo={
+      .sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext=&libraryInfo,
+      .flags=VK_PIPELINE_CREATE_LIBRARY_BIT_KHR|VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT,
+      .stageCount=preRasterization||fragment?1u:0u,
+      .pStages=preRasterization?&description.stages[0]:fragment?&description.stages[1]:nullptr,
+      .pVertexInputState=vertexInput?&description.vertexInput:nullptr,
+      .pInputAssemblyState=vertexInput?&description.inputAssembly:nullptr,
+      .pTessellationState=nullptr,
+      .pViewportState=preRasterization?&description.viewport:nullptr,
+      .pRasterizationState=preRasterization?&description.rasterization:nullptr,
+      .pMultisampleState=fragment||output?&description.multisample:nullptr,
+      .pDepthStencilState=fragment?&description.depthStencil:nullptr,
+      .pColorBlendState=output?&description.colorBlend:nullptr,
+      .pDynamicState=preRasterization?&description.dynamic:nullptr,
+      .layout=preRasterization||fragment?layout:VK_NULL_HANDLE,
+      .renderPass=VK_NULL_HANDLE,
+      .subpass=0,
+      .basePipelineHandle=VK_NULL_HANDLE,
+      .basePipelineIndex=-1
+    };
+    stats.libraries++;
+    return Create(pipelineInfo,stats.libraryMs);
+  }
+
+  VkPipeline Linked(const GraphicsState &state){
+    Description description;
+    Describe(state,description);
+
+    auto Find=[&](std::unordered_map<uint64_t,VkPipeline> &parts,uint64_t key,VkGraphicsPipelineLibraryFlagsEXT part){
+      auto found=parts.find(key);
+      if(found!=parts.end())
+        return found->second;
+      return parts[key]=Part(part,description);
+    };
+    if(!fragmentShader)
+      fragmentShader=Part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,description);
+    std::array<VkPipeline,4> libraries={
+      Find(vertexInputs,state.VertexInputHash(),VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT),
+      Find(preRasterizations,state.PreRasterizationHash(),VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT),
+      fragmentShader,
+      Find(fragmentOutputs,state.FragmentOutputHash(),VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+    };
+
+    VkPipelineLibraryCreateInfoKHR linkInfo={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+      .pNext=nullptr,
+      .libraryCount=(uint32_t)libraries.size(),
+      .pLibraries=libraries.data()
+    };
+    VkGraphicsPipelineCreateInfo pipelineInfo={
+      .sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext=&linkInfo,
+      .flags=options.optimise?(VkPipelineCreateFlags)VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT:0u,
+      .stageCount=0,
+      .pStages=nullptr,
+      .pVertexInputState=nullptr,
+      .pInputAssemblyState=nullptr,
+      .pTessellationState=nullptr,
+      .pViewportState=nullptr,
+      .pRasterizationState=nullptr,
+      .pMultisampleState=nullptr,
+      .pDepthStencilState=nullptr,
+      .pColorBlendState=nullptr,
+      .pDynamicState=nullptr,
+      .layout=layout,
+      .renderPass=VK_NULL_HANDLE,
+      .subpass=0,
+      .basePipelineHandle=VK_NULL_HANDLE,
+      .basePipelineIndex=-1
+    };
+    stats.pipelines++;
+    return Create(pipelineInfo,stats.pipelineMs);
+  }
+
+public:
+  GraphicsPipelines(HeadlessDevice &context,PipelineBackend backend,VkPipelineLayout layout,
+    const std::vector<uint32_t> &vertexCode,const std::vector<uint32_t> &fragmentCode,const PipelineOptions &options={}):
+    context(context),
+    backend(backend),
+    options(options),
+    layout(layout){
+    if(backend==PipelineBackend::ShaderObject)
+      throw std::runtime_error("Shader objects need no pipelines");
+    if(backend==PipelineBackend::Library&&!context.pipelineLibrary)
+      throw std::runtime_error("Device does not support VK_EXT_graphics_pipeline_library");
+    if(context.trace)
+      throw std::runtime_error("Pipelines cannot be captured, the trace format only has shader objects");
+    if(options.cached&&context.pipelineCache)
+      cache=context.pipelineCache->Handle();
+
+    vertexModule=CreateModule(vertexCode);
+    fragmentModule=CreateModule(fragmentCode);
+  }
+
+  GraphicsPipelines(const GraphicsPipelines &)=delete;
+  GraphicsPipelines &operator=(const GraphicsPipelines &)=delete;
+
+  ~GraphicsPipelines(){
+    Clear();
+    context.dispatch.vkDestroyShaderModule(context.device,vertexModule,nullptr);
+    context.dispatch.vkDestroyShaderModule(context.device,fragmentModule,nullptr);
+  }
+
+  //The pipeline of a state, created the first time it is asked for
+  VkPipeline Get(const GraphicsState &state){
+    auto key=state.Hash();
+    auto found=pipelines.find(key);
+    if(found!=pipelines.end())
+      return found->second;
+    auto pipeline=backend==PipelineBackend::Monolithic?Monolithic(state):Linked(state);
+    pipelines.emplace(key,pipeline);
+    return pipeline;
+  }
+
+  //Destroys every pipeline and library part, the device must be done with them
+  void Clear(){
+    for(auto *parts:{&pipelines,&vertexInputs,&preRasterizations,&fragmentOutputs}){
+      for(auto &[key,pipeline]:*parts)
+        context.dispatch.vkDestroyPipeline(context.device,pipeline,nullptr);
+      parts->clear();
+    }
+    if(fragmentShader)
+      context.dispatch.vkDestroyPipeline(context.device,fragmentShader,nullptr);
+    fragmentShader=nullptr;
+  }
+
+  const PipelineStats &Stats()const{
+    return stats;
+  }
+};
@@ -0,0 +1,763 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<string>
+#include<string_view>
+#include<memory>
+#include<chrono>
+#include<cctype>
+#include<cstring>
+#include<algorithm>
+#include<filesystem>
+#include<fstream>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"DeviceQueues.h"
+#include"DeviceDispatch.h"
+#include"DebugMessenger.h"
+#include"Trace.h"
+#include"ShaderCompiler.h"
+#include"SpirvOptimiser.h"
+#include"MemoryService.h"
+#include"PipelineCache.h"
+#include"DescriptorLayout.h"
+
+//Instance, device and allocator for the tools that run the scenarios without
+//a window: the benchmark, the crash runner and the fuzzers. Devices are picked
+//by name and/or driverID so CI can run against Mesa lavapipe or the mock ICD,
+//with no filter the first device is used like the scenarios do.
+//
+//Construction only creates the instance, Open() picks and creates the device.
+//Everything is created in the calling process, the crash runner relies on
+//that to give every forked worker a device of its own. Every context has its
+//own instance, so one context per physical device can be driven from its own
+//thread.
+
+struct DeviceInfo{
+  VkPhysicalDevice physicalDevice=nullptr;
+  VkPhysicalDeviceProperties properties={};
+  VkPhysicalDeviceDriverProperties driver={};
+};
+
+struct DriverAlias{
+  const char *name;
+  VkDriverId id;
+};
+
+inline constexpr std::array<DriverAlias,9> DriverAliases={{
+  {"lavapipe",VK_DRIVER_ID_MESA_LLVMPIPE},
+  {"llvmpipe",VK_DRIVER_ID_MESA_LLVMPIPE},
+  {"radv",VK_DRIVER_ID_MESA_RADV},
+  {"amdvlk",VK_DRIVER_ID_AMD_OPEN_SOURCE},
+  {"amd",VK_DRIVER_ID_AMD_PROPRIETARY},
+  {"nvidia",VK_DRIVER_ID_NVIDIA_PROPRIETARY},
+  {"nvk",VK_DRIVER_ID_MESA_NVK},
+  {"anv",VK_DRIVER_ID_INTEL_OPEN_SOURCE_MESA},
+  {"venus",VK_DRIVER_ID_MESA_VENUS}
+}};
+
+inline bool ContainsNoCase(std::string_view text,std::string_view pattern){
+  auto found=std::search(text.begin(),text.end(),pattern.begin(),pattern.end(),[](char a,char b){
+    return std::tolower((unsigned char)a)==std::tolower((unsigned char)b);
+  });
+  return found!=text.end();
+}
+
+inline bool EqualsNoCase(std::string_view a,std::string_view b){
+  return a.size()==b.size()&&ContainsNoCase(a,b);
+}
+
+inline std::string Describe(const DeviceInfo &device){
+  return std::format("{} [{}, driverID {}, Vulkan {}.{}.{}]",
+    device.properties.deviceName,device.driver.driverName,(uint32_t)device.driver.driverID,
+    VK_API_VERSION_MAJOR(device.properties.apiVersion),VK_API_VERSION_MINOR(device.properties.apiVersion),
+    VK_API_VERSION_PATCH(device.properties.apiVersion));
+}
+
+inline std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
+  std::vector<uint32_t> buffer;
+  size_t bufferSize=0;
+
+  if(!std::filesystem::exists(filePath))
+    throw std::runtime_error(std::format("Unable to find file {}",filePath.string()));
+
+  std::fstream fileStream(filePath.string(),std::ios::binary|std::ios::in);
+  if(!fileStream.is_open())
+    throw std::runtime_error("Unable to open file handle");
+
+  fileStream.seekg(0,fileStream.end);
+  bufferSize=fileStream.tellg();
+  fileStream.seekg(0,fileStream.beg);
+
+  if(bufferSize%sizeof(uint32_t)!=0)
+    throw std::runtime_error("Invalid shader file size");
+
+  buffer.resize(bufferSize/sizeof(uint32_t));
+  fileStream.read(reinterpret_cast<char *>(buffer.data()),bufferSize);
+  fileStream.close();
+
+  return buffer;
+}
+
+class HeadlessDevice{
+  //Declared first so it is destroyed last, after the instance
+  std::unique_ptr<DebugMessenger> debugSink;
+  VkDebugUtilsMessengerEXT debugMessenger=nullptr;
+
+  std::vector<VkExtensionProperties> Extensions()const{
+    uint32_t extensionCount=0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&extensionCount,nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&extensionCount,extensions.data());
+    return extensions;
+  }
+
+  static bool Contains(const std::vector<VkExtensionProperties> &extensions,const char *name){
+    return std::any_of(extensions.begin(),extensions.end(),[&](const VkExtensionProperties &extension){
+      return strcmp(extension.extensionName,name)==0;
+    });
+  }
+
+  void CheckExtensions(const std::vector<const char *> &required)const{
+    auto extensions=Extensions();
+    std::string missing;
+    for(auto name:required){
+      if(!Contains(extensions,name))
+        missing+=std::format(" {}",name);
+    }
+    if(!missing.empty())
+      throw std::runtime_error(std::format("Device is missing{}",missing));
+  }
+
+public:
+  VkInstance instance=nullptr;
+  std::vector<DeviceInfo> devices;
+  DeviceInfo info;
+  VkPhysicalDevice physicalDevice=nullptr;
+  VkDevice device=nullptr;
+  VmaAllocator allocator=nullptr;
+  //Budget and per tag usage of everything CreateBuffer allocates
+  std::unique_ptr<MemoryService> memory;
+  std::unique_ptr<DeviceQueues> queues;
+  std::filesystem::path shaderPath;
+  //Compiles the GLSL instead of loading the .spv under shaderPath when set
+  ShaderCompiler *compiler=nullptr;
+  //Runs on the SPIR-V CreateShaders hands to the driver when set
+  SpirvOptimiser *optimiser=nullptr;
+  //Pipelines are created through it when set, see GraphicsPipelines
+  PipelineCache *pipelineCache=nullptr;
+  //Set while capturing, the helpers below and TracedCommands record into it
+  TraceWriter *trace=nullptr;
+  //Runtime descriptor arrays with partially bound and variable count
+  //bindings were enabled, BindlessHeap needs them
+  bool bindless=false;
+  //Largest divisor instance rate vertex bindings may use, 1 without a vertex
+  //attribute divisor extension
+  uint32_t maxInstanceDivisor=1;
+  //VK_EXT_memory_budget was enabled, heap budgets are the driver's and
+  //allocations fail rather than go over them
+  bool memoryBudget=false;
+  //VK_EXT_graphics_pipeline_library was enabled, pipelines can be linked
+  //from libraries. With fast linking, linking without link time
+  //optimisation is meant to be cheap enough to do while recording.
+  bool pipelineLibrary=false;
+  bool pipelineFastLinking=false;
+  //Subgroup operations compute shaders may use, 0 when the compute stage has
+  //none, and the narrowest subgroup a compute dispatch may get
+  VkSubgroupFeatureFlags subgroupOperations=0;
+  uint32_t minSubgroupSize=0;
+  //subgroupSizeControl and computeFullSubgroups were enabled and compute
+  //shaders can require a subgroup size. subgroupSize is the device's default,
+  //maxComputeWorkgroupSubgroups bounds the workgroup size at a required size.
+  bool fullSubgroups=false;
+  uint32_t subgroupSize=0;
+  uint32_t maxComputeWorkgroupSubgroups=0;
+  //shaderInt64 and shaderBufferInt64Atomics were enabled, ComputePrimitives
+  //scans in a single pass with them
+  bool int64Atomics=false;
+
+  //Every device call the tools make, straight to the driver. Filled in by
+  //Open(), vkCmdBindIndexBuffer2KHR stays null without VK_KHR_maintenance5
+  //and TracedCommands falls back to vkCmdBindIndexBuffer.
+  DeviceDispatch dispatch;
+
+  //1.3 rather than the scenarios' 1.4, lavapipe releases still shipped on
+  //CI images only report 1.3
+  HeadlessDevice(bool validation=false){
+    std::vector<const char *> InstanceLayers;
+    std::vector<const char *> InstanceExtensions;
+    if(validation){
+      InstanceLayers.push_back("VK_LAYER_KHRONOS_validation");
+      InstanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+
+    VkApplicationInfo applicationInfo={
+      .sType=VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName="Headless",
+      .applicationVersion=VK_MAKE_VERSION(1, 0, 0),
+      .pEngineName="TestEngine",
+      .engineVersion=VK_MAKE_VERSION(1, 0, 0),
+      .apiVersion=VK_API_VERSION_1_3
+    };
+
+    VkInstanceCreateInfo instanceInfo={
+      .sType=VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .pApplicationInfo=&applicationInfo,
+      .enabledLayerCount=(uint32_t)InstanceLayers.size(),
+      .ppEnabledLayerNames=InstanceLayers.data(),
+      .enabledExtensionCount=(uint32_t)InstanceExtensions.size(),
+      .ppEnabledExtensionNames=InstanceExtensions.data()
+    };
+    auto result=vkCreateInstance(&instanceInfo,nullptr,&instance);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create instance");
+
+    if(validation){
+      auto pfCreateDebugUtilsMessengerEXT=reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(instance,"vkCreateDebugUtilsMessengerEXT"));
+
+      debugSink=std::make_unique<DebugMessenger>();
+      VkDebugUtilsMessengerCreateInfoEXT createInfo={
+        .sType=VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+        .messageSeverity=VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT|
+                         VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+        .messageType=VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT|
+                     VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT|
+                     VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+        .pfnUserCallback=&DebugMessenger::Callback,
+        .pUserData=debugSink.get()
+      };
+      pfCreateDebugUtilsMessengerEXT(instance,&createInfo,nullptr,&debugMessenger);
+    }
+
+    std::vector<VkPhysicalDevice> physicalDevices;
+    uint32_t physicalDeviceCount=0;
+    vkEnumeratePhysicalDevices(instance,&physicalDeviceCount,nullptr);
+    physicalDevices.resize(physicalDeviceCount);
+    vkEnumeratePhysicalDevices(instance,&physicalDeviceCount,physicalDevices.data());
+
+    for(auto physicalDevice:physicalDevices){
+      DeviceInfo device;
+      device.physicalDevice=physicalDevice;
+      device.driver.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES;
+      VkPhysicalDeviceProperties2 properties={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext=&device.driver
+      };
+      vkGetPhysicalDeviceProperties2(physicalDevice,&properties);
+      device.properties=properties.properties;
+      device.driver.pNext=nullptr;
+      devices.push_back(device);
+    }
+  }
+
+  HeadlessDevice(const HeadlessDevice &)=delete;
+  HeadlessDevice &operator=(const HeadlessDevice &)=delete;
+
+  ~HeadlessDevice(){
+    if(queues)
+      queues->Destroy();
+    memory.reset();
+    if(allocator)
+      vmaDestroyAllocator(allocator);
+    if(device)
+      vkDestroyDevice(device,nullptr);
+    if(debugMessenger){
+      auto pfDestroyDebugUtilsMessengerEXT=reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(instance,"vkDestroyDebugUtilsMessengerEXT"));
+      pfDestroyDebugUtilsMessengerEXT(instance,debugMessenger,nullptr);
+    }
+    if(instance)
+      vkDestroyInstance(instance,nullptr);
+  }
+
+  //name matches a substring of the device name, e.g. "Mock" for the mock
+  //ICD. driver is a VkDriverId number or one of DriverAliases. Both have to
+  //match when both are given. Returns indices into devices in enumeration
+  //order, which is the same for every instance.
+  std::vector<size_t> Matching(const std::string &name,const std::string &driver)const{
+    bool filterDriver=!driver.empty();
+    uint32_t driverID=0;
+    if(filterDriver){
+      if(std::all_of(driver.begin(),driver.end(),[](char c){return std::isdigit((unsigned char)c)!=0;})){
+        driverID=(uint32_t)std::stoul(driver);
+      }else{
+        auto alias=std::find_if(DriverAliases.begin(),DriverAliases.end(),[&](const DriverAlias &alias){
+          return EqualsNoCase(alias.name,driver);
+        });
+        if(alias==DriverAliases.end())
+          throw std::runtime_error(std::format("Unknown driver {}",driver));
+        driverID=(uint32_t)alias->id;
+      }
+    }
+
+    std::vector<size_t> matches;
+    for(size_t index=0;index<devices.size();index++){
+      auto &device=devices[index];
+      if(filterDriver&&(uint32_t)device.driver.driverID!=driverID)
+        continue;
+      if(!name.empty()&&!ContainsNoCase(device.properties.deviceName,name))
+        continue;
+      matches.push_back(index);
+    }
+    return matches;
+  }
+
+  //The first device Matching() finds
+  const DeviceInfo &Select(const std::string &name,const std::string &driver)const{
+    if(devices.empty())
+      throw std::runtime_error("Unable to find graphics device");
+    auto matches=Matching(name,driver);
+    if(matches.empty())
+      throw std::runtime_error("No device matches the name/driver filter");
+    return devices[matches.front()];
+  }
+
+  void Open(const std::string &name,const std::string &driver){
+    Open(Select(name,driver));
+  }
+
+  //selection is one of this context's devices
+  void Open(const DeviceInfo &selection){
+    info=selection;
+    physicalDevice=info.physicalDevice;
+    if(info.properties.apiVersion<VK_API_VERSION_1_3)
+      throw std::runtime_error("Device does not support Vulkan 1.3");
+
+    std::vector<const char *> DeviceExtensions={
+      VK_EXT_SHADER_OBJECT_EXTENSION_NAME,
+      VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME};
+    CheckExtensions(DeviceExtensions);
+
+    //Optional, gives index buffers a size
+    auto extensions=Extensions();
+    bool maintenance5=Contains(extensions,VK_KHR_MAINTENANCE_5_EXTENSION_NAME);
+    if(maintenance5)
+      DeviceExtensions.push_back(VK_KHR_MAINTENANCE_5_EXTENSION_NAME);
+
+    //Optional, real heap budgets instead of VMA's estimate
+    memoryBudget=Contains(extensions,VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if(memoryBudget)
+      DeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    //Optional, instance rate divisors other than 1. The KHR extension is the
+    //EXT one promoted, the feature struct is shared and only the properties
+    //differ.
+    const char *divisorExtension=nullptr;
+    if(Contains(extensions,VK_KHR_VERTEX_ATTRIBUTE_DIVISOR_EXTENSION_NAME))
+      divisorExtension=VK_KHR_VERTEX_ATTRIBUTE_DIVISOR_EXTENSION_NAME;
+    else if(Contains(extensions,VK_EXT_VERTEX_ATTRIBUTE_DIVISOR_EXTENSION_NAME))
+      divisorExtension=VK_EXT_VERTEX_ATTRIBUTE_DIVISOR_EXTENSION_NAME;
+
+    //Optional, only the pipeline backend uses it
+    if(Contains(extensions,VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)&&
+      Contains(extensions,VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)){
+      VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedLibrary={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        .pNext=nullptr
+      };
+      VkPhysicalDeviceFeatures2 supported={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext=&supportedLibrary,
+        .features={}
+      };
+      vkGetPhysicalDeviceFeatures2(physicalDevice,&supported);
+      pipelineLibrary=supportedLibrary.graphicsPipelineLibrary;
+    }
+    if(pipelineLibrary){
+      DeviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+      DeviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+      VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT,
+        .pNext=nullptr
+      };
+      VkPhysicalDeviceProperties2 properties={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext=&libraryProperties
+      };
+      vkGetPhysicalDeviceProperties2(physicalDevice,&properties);
+      pipelineFastLinking=libraryProperties.graphicsPipelineLibraryFastLinking;
+    }
+
+    VkPhysicalDeviceVulkan13Features Vulkan13Features={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext=nullptr,
+      .synchronization2=VK_TRUE,
+      .dynamicRendering=VK_TRUE
+    };
+
+    //Optional, instance rate divisors for the instancing scenario, only
+    //queried when the device has one of the divisor extensions
+    VkPhysicalDeviceVertexAttributeDivisorFeaturesKHR supportedDivisor={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_ATTRIBUTE_DIVISOR_FEATURES_KHR,
+      .pNext=nullptr
+    };
+    //Optional, subgroup size control for ComputePrimitives
+    VkPhysicalDeviceVulkan13Features supported13={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext=divisorExtension?&supportedDivisor:nullptr
+    };
+    //Optional, the descriptor indexing subset bindless heaps rely on
+    VkPhysicalDeviceVulkan12Features supported12={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext=&supported13
+    };
+    VkPhysicalDeviceFeatures2 supported={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext=&supported12,
+      .features={}
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice,&supported);
+    bindless=supported12.runtimeDescriptorArray&&supported12.descriptorBindingPartiallyBound&&
+      supported12.descriptorBindingVariableDescriptorCount;
+    int64Atomics=supported.features.shaderInt64&&supported12.shaderBufferInt64Atomics;
+
+    //Core in 1.1 and 1.3, only the size control features need enabling
+    VkPhysicalDeviceSubgroupSizeControlProperties subgroupSizeProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES,
+      .pNext=nullptr
+    };
+    VkPhysicalDeviceSubgroupProperties subgroupProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+      .pNext=&subgroupSizeProperties
+    };
+    VkPhysicalDeviceProperties2 subgroupDeviceProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext=&subgroupProperties
+    };
+    vkGetPhysicalDeviceProperties2(physicalDevice,&subgroupDeviceProperties);
+    if(subgroupProperties.supportedStages&VK_SHADER_STAGE_COMPUTE_BIT)
+      subgroupOperations=subgroupProperties.supportedOperations;
+    minSubgroupSize=subgroupSizeProperties.minSubgroupSize?subgroupSizeProperties.minSubgroupSize:subgroupProperties.subgroupSize;
+    subgroupSize=subgroupProperties.subgroupSize;
+    maxComputeWorkgroupSubgroups=subgroupSizeProperties.maxComputeWorkgroupSubgroups;
+    fullSubgroups=supported13.subgroupSizeControl&&supported13.computeFullSubgroups&&
+      (subgroupSizeProperties.requiredSubgroupSizeStages&VK_SHADER_STAGE_COMPUTE_BIT);
+    Vulkan13Features.subgroupSizeControl=fullSubgroups;
+    Vulkan13Features.computeFullSubgroups=fullSubgroups;
+
+    bool divisor=supportedDivisor.vertexAttributeInstanceRateDivisor;
+    if(divisor){
+      DeviceExtensions.push_back(divisorExtension);
+      VkPhysicalDeviceVertexAttributeDivisorPropertiesKHR divisorProperties={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_ATTRIBUTE_DIVISOR_PROPERTIES_KHR,
+        .pNext=nullptr
+      };
+      VkPhysicalDeviceVertexAttributeDivisorPropertiesEXT divisorPropertiesEXT={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_ATTRIBUTE_DIVISOR_PROPERTIES_EXT,
+        .pNext=nullptr
+      };
+      bool promoted=divisorExtension==std::string_view(VK_KHR_VERTEX_ATTRIBUTE_DIVISOR_EXTENSION_NAME);
+      VkPhysicalDeviceProperties2 properties={
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext=promoted?(void *)&divisorProperties:(void *)&divisorPropertiesEXT
+      };
+      vkGetPhysicalDeviceProperties2(physicalDevice,&properties);
+      maxInstanceDivisor=promoted?divisorProperties.maxVertexAttribDivisor:divisorPropertiesEXT.maxVertexAttribDivisor;
+    }
+
+    VkPhysicalDeviceVulkan12Features Vulkan12Features={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext=&Vulkan13Features,
+      .shaderBufferInt64Atomics=int64Atomics,
+      .descriptorBindingPartiallyBound=bindless,
+      .descriptorBindingVariableDescriptorCount=bindless,
+      .runtimeDescriptorArray=bindless,
+      .timelineSemaphore=VK_TRUE,
+      .bufferDeviceAddress=VK_TRUE
+    };
+    VkPhysicalDeviceFeatures enabledFeatures={
+      .shaderInt64=int64Atomics
+    };
+
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT DescriptorBufferFeatures={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+      .pNext=&Vulkan12Features,
+      .descriptorBuffer=VK_TRUE,
+      .descriptorBufferCaptureReplay=VK_FALSE,
+      .descriptorBufferImageLayoutIgnored=VK_FALSE,
+      .descriptorBufferPushDescriptors=VK_FALSE
+    };
+
+    VkPhysicalDeviceShaderObjectFeaturesEXT ShaderObjectFeatures={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT,
+      .pNext=&DescriptorBufferFeatures,
+      .shaderObject=VK_TRUE
+    };
+
+    //The feature is mandatory wherever the extension is exposed
+    VkPhysicalDeviceMaintenance5FeaturesKHR Maintenance5Features={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_5_FEATURES_KHR,
+      .pNext=&ShaderObjectFeatures,
+      .maintenance5=VK_TRUE
+    };
+
+    VkPhysicalDeviceVertexAttributeDivisorFeaturesKHR DivisorFeatures={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_ATTRIBUTE_DIVISOR_FEATURES_KHR,
+      .pNext=maintenance5?(void *)&Maintenance5Features:(void *)&ShaderObjectFeatures,
+      .vertexAttributeInstanceRateDivisor=VK_TRUE,
+      .vertexAttributeInstanceRateZeroDivisor=VK_FALSE
+    };
+    const void *features=&ShaderObjectFeatures;
+    if(divisor)
+      features=&DivisorFeatures;
+    else if(maintenance5)
+      features=&Maintenance5Features;
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT LibraryFeatures={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+      .pNext=const_cast<void *>(features),
+      .graphicsPipelineLibrary=VK_TRUE
+    };
+    if(pipelineLibrary)
+      features=&LibraryFeatures;
+
+    queues=std::make_unique<DeviceQueues>(physicalDevice);
+
+    VkDeviceCreateInfo deviceCreateInfo={
+      .sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext=features,
+      .flags=0,
+      .queueCreateInfoCount=(uint32_t)queues->CreateInfos().size(),
+      .pQueueCreateInfos=queues->CreateInfos().data(),
+      .enabledLayerCount=0,
+      .ppEnabledLayerNames=nullptr,
+      .enabledExtensionCount=(uint32_t)DeviceExtensions.size(),
+      .ppEnabledExtensionNames=DeviceExtensions.data(),
+      .pEnabledFeatures=&enabledFeatures
+    };
+
+    auto result=vkCreateDevice(physicalDevice,&deviceCreateInfo,nullptr,&device);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create device");
+
+    dispatch.Load(device,&vkGetDeviceProcAddr);
+    if(!maintenance5)
+      dispatch.vkCmdBindIndexBuffer2KHR=nullptr;
+    auto missing=dispatch.Missing();
+    if(!missing.empty())
+      throw std::runtime_error(std::format("Device does not expose{}",missing));
+
+    queues->Create(device,&dispatch);
+
+    VmaVulkanFunctions vulkanFunctions={
+      .vkGetInstanceProcAddr=&vkGetInstanceProcAddr,
+      .vkGetDeviceProcAddr=&vkGetDeviceProcAddr,
+    };
+    VmaAllocatorCreateInfo allocatorCreateInfo={
+      .flags=VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT|
+        (memoryBudget?(VmaAllocatorCreateFlags)VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT:0u),
+      .physicalDevice=physicalDevice,
+      .device=device,
+      .preferredLargeHeapBlockSize=0,
+      .pAllocationCallbacks=nullptr,
+      .pDeviceMemoryCallbacks=nullptr,
+      .pHeapSizeLimit=nullptr,
+      .pVulkanFunctions=&vulkanFunctions,
+      .instance=instance,
+      .vulkanApiVersion=VK_API_VERSION_1_3,
+      .pTypeExternalMemoryHandleTypes=nullptr
+    };
+    result=vmaCreateAllocator(&allocatorCreateInfo,&allocator);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create VMA allocator");
+    memory=std::make_unique<MemoryService>(allocator,memoryBudget);
+  }
+
+  //A lost device stays lost, the only way forward is a new one
+  bool Lost()const{
+    return device&&dispatch.vkDeviceWaitIdle(device)==VK_ERROR_DEVICE_LOST;
+  }
+
+  //bindingFlags is empty or has one entry per binding
+  VkDescriptorSetLayout CreateSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings,
+    VkDescriptorSetLayoutCreateFlags flags=0,const std::vector<VkDescriptorBindingFlags> &bindingFlags={})const{
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .pNext=nullptr,
+      .bindingCount=(uint32_t)bindingFlags.size(),
+      .pBindingFlags=bindingFlags.data()
+    };
+    VkDescriptorSetLayoutCreateInfo descriptorSetInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext=bindingFlags.empty()?nullptr:&bindingFlagsInfo,
+      .flags=flags,
+      .bindingCount=(uint32_t)bindings.size(),
+      .pBindings=bindings.data()
+    };
+    VkDescriptorSetLayout layout=nullptr;
+    auto result=dispatch.vkCreateDescriptorSetLayout(device,&descriptorSetInfo,nullptr,&layout);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create descriptor set layout");
+
+    if(trace)
+      trace->SetLayout(layout,flags,bindings,bindingFlags);
+    return layout;
+  }
+
+  VkSampler CreateSampler(const VkSamplerCreateInfo &samplerInfo)const{
+    VkSampler sampler=nullptr;
+    auto result=dispatch.vkCreateSampler(device,&samplerInfo,nullptr,&sampler);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create sampler");
+
+    if(trace)
+      trace->Sampler(sampler,samplerInfo);
+    return sampler;
+  }
+
+  VkPipelineLayout CreatePipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+    const std::vector<VkPushConstantRange> &pushConstants={})const{
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .setLayoutCount=(uint32_t)setLayouts.size(),
+      .pSetLayouts=setLayouts.data(),
+      .pushConstantRangeCount=(uint32_t)pushConstants.size(),
+      .pPushConstantRanges=pushConstants.data()
+    };
+    VkPipelineLayout layout=nullptr;
+    auto result=dispatch.vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create pipeline layout");
+
+    if(trace)
+      trace->PipelineLayout(layout,pipelineLayoutInfo);
+    return layout;
+  }
+
+  //vkCreateShadersEXT, traced before the call so a capture still holds a
+  //call that never returns
+  VkResult CreateShaders(uint32_t count,const VkShaderCreateInfoEXT *infos,VkShaderEXT *shaders)const{
+    std::vector<VkShaderCreateInfoEXT> optimisedInfos;
+    if(optimiser){
+      optimisedInfos.assign(infos,infos+count);
+      for(auto &info:optimisedInfos){
+        if(info.codeType!=VK_SHADER_CODE_TYPE_SPIRV_EXT)
+          continue;
+        auto &code=optimiser->Cached(static_cast<const uint32_t *>(info.pCode),info.codeSize);
+        info.codeSize=code.size()*sizeof(uint32_t);
+        info.pCode=code.data();
+      }
+
+      if(optimiser->compare){
+        std::vector<VkShaderEXT> originals(count,VK_NULL_HANDLE);
+        auto begin=std::chrono::steady_clock::now();
+        dispatch.vkCreateShadersEXT(device,count,infos,nullptr,originals.data());
+        auto end=std::chrono::steady_clock::now();
+        for(auto original:originals){
+          if(original!=VK_NULL_HANDLE)
+            dispatch.vkDestroyShaderEXT(device,original,nullptr);
+        }
+
+        std::vector<VkShaderEXT> optimised(count,VK_NULL_HANDLE);
+        auto optimisedBegin=std::chrono::steady_clock::now();
+        dispatch.vkCreateShadersEXT(device,count,optimisedInfos.data(),nullptr,optimised.data());
+        auto optimisedEnd=std::chrono::steady_clock::now();
+        for(auto shader:optimised){
+          if(shader!=VK_NULL_HANDLE)
+            dispatch.vkDestroyShaderEXT(device,shader,nullptr);
+        }
+
+        optimiser->Compared(std::chrono::duration<double,std::milli>(end-begin).count(),
+          std::chrono::duration<double,std::milli>(optimisedEnd-optimisedBegin).count());
+      }
+      infos=optimisedInfos.data();
+    }
+
+    if(trace)
+      trace->CreateShaders(count,infos);
+    auto result=dispatch.vkCreateShadersEXT(device,count,infos,nullptr,shaders);
+    if(trace)
+      trace->Created(count,shaders);
+    return result;
+  }
+
+  void DestroyShader(VkShaderEXT shader)const{
+    if(trace)
+      trace->DestroyShader(shader);
+    dispatch.vkDestroyShaderEXT(device,shader,nullptr);
+  }
+
+  //vkGetDescriptorEXT into a buffer from CreateBuffer
+  void GetDescriptor(const VkDescriptorGetInfoEXT &info,size_t size,VkBuffer buffer,
+    const VmaAllocationInfo &allocationInfo,VkDeviceSize offset)const{
+
+    if(trace)
+      trace->Descriptor(info,size,buffer,offset);
+    dispatch.vkGetDescriptorEXT(device,&info,size,(uint8_t *)allocationInfo.pMappedData+offset);
+  }
+
+  //Host visible and mapped, the scenarios only ever touch tiny buffers
+  VkBuffer CreateBuffer(VkDeviceSize size,VkBufferUsageFlags usage,VmaAllocation &allocation,VmaAllocationInfo &allocationInfo)const{
+    VkBufferCreateInfo bufferInfo={
+      .sType=VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .size=size,
+      .usage=usage|VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      .sharingMode=VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount=0,
+      .pQueueFamilyIndices=nullptr
+    };
+
+    VmaAllocationCreateInfo allocateInfo={
+      .flags=VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT|VMA_ALLOCATION_CREATE_MAPPED_BIT|memory->AllocationFlags(),
+      .usage=VMA_MEMORY_USAGE_AUTO,
+      .requiredFlags=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      .preferredFlags=VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      .memoryTypeBits=0,
+      .pool=nullptr,
+      .pUserData=nullptr,
+      .priority=0.0f
+    };
+
+    VkBuffer buffer=nullptr;
+    auto result=vmaCreateBuffer(allocator,&bufferInfo,&allocateInfo,&buffer,&allocation,&allocationInfo);
+    if(result==VK_ERROR_OUT_OF_DEVICE_MEMORY&&memoryBudget)
+      throw std::runtime_error(std::format("Buffer of {} bytes does not fit the memory budget\n{}",size,memory->Report()));
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create buffer memory");
+    memory->Track(allocation,MemoryTagFromUsage(usage));
+
+    if(trace)
+      trace->Buffer(buffer,size,usage,BufferAddress(buffer),allocationInfo.pMappedData);
+    return buffer;
+  }
+
+  //For buffers from CreateBuffer
+  void DestroyBuffer(VkBuffer buffer,VmaAllocation allocation)const{
+    memory->Untrack(allocation);
+    vmaDestroyBuffer(allocator,buffer,allocation);
+  }
+
+  VkDeviceAddress BufferAddress(VkBuffer buffer)const{
+    VkBufferDeviceAddressInfo bufferDeviceAddressInfo={
+      .sType=VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .pNext=nullptr,
+      .buffer=buffer
+    };
+    return dispatch.vkGetBufferDeviceAddress(device,&bufferDeviceAddressInfo);
+  }
+
+  std::vector<uint32_t> Shader(const char *name)const{
+    if(compiler)
+      return compiler->Compile(name);
+    return LoadShader(shaderPath/name);
+  }
+};
+
+template<typename Set>
+DescriptorLayout<Set>::DescriptorLayout(HeadlessDevice &context,VkDescriptorSetLayoutCreateFlags flags):
+  DescriptorLayout(context.device,context.physicalDevice,flags,&context.dispatch){
+  trace=context.trace;
+  if(trace)
+    trace->SetLayout(layout,flags,std::vector<VkDescriptorSetLayoutBinding>(Set::Layout.begin(),Set::Layout.end()),{});
+}
@@ -0,0 +1,327 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<cstring>
+#include<format>
+#include<stdexcept>
+#include<algorithm>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"HeadlessDevice.h"
+#include"TracedCommands.h"
+#include"VertexPacking.h"
+
+//Instanced drawing for meshes from VertexPacker. Draws go into a
+//RenderQueue one object at a time; Build() collapses every draw of the same
+//mesh into one instanced vkCmdDraw, with the per-object data as instance
+//rate vertex streams in an InstanceStream:
+//
+//  transform  three R32G32B32A32_SFLOAT rows of an affine matrix, divisor 1
+//  tint       R32G32B32A32_SFLOAT, divisor tintDivisor
+//
+//The tint binding steps once every tintDivisor instances of a mesh, so only
+//the tint of the first draw of every group is kept. Without
+//VK_KHR/EXT_vertex_attribute_divisor, or past maxVertexAttribDivisor, every
+//tint is kept at divisor 1 instead. Callers give the draws of a group the
+//same tint, so both draw the same.
+
+//Rows of the 3x4 matrix taking a mesh position to clip space
+struct InstanceTransform{
+  std::array<std::array<float,4>,3> rows;
+};
+
+using InstanceTint=std::array<float,4>;
+
+//Per frame instance data out of one persistently mapped vertex buffer,
+//split into one region per frame in flight like UniformRing. The caller has
+//to have waited for the submissions that read a region before it comes
+//around again.
+//
+//Every frame is written again before it is read, so the stream lets the
+//memory service's defragmentation move it without copying anything.
+class InstanceStream{
+  HeadlessDevice &context;
+  VkDeviceSize frameSize;
+  uint32_t frames;
+  VkBuffer buffer=nullptr;
+  VmaAllocation allocation=nullptr;
+  VmaAllocationInfo allocationInfo={};
+  uint32_t frame=0;
+  VkDeviceSize used=0;
+  VkBuffer movedBuffer=nullptr;
+
+  bool MoveBegin(VmaAllocation destination){
+    //A trace only knows the buffer it was created with
+    if(context.trace)
+      return false;
+    VkBufferCreateInfo bufferInfo={
+      .sType=VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .size=frameSize*frames,
+      .usage=VK_BUFFER_USAGE_VERTEX_BUFFER_BIT|VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      .sharingMode=VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount=0,
+      .pQueueFamilyIndices=nullptr
+    };
+    if(context.dispatch.vkCreateBuffer(context.device,&bufferInfo,nullptr,&movedBuffer)!=VK_SUCCESS)
+      return false;
+    if(vmaBindBufferMemory(context.allocator,destination,movedBuffer)!=VK_SUCCESS){
+      context.dispatch.vkDestroyBuffer(context.device,movedBuffer,nullptr);
+      movedBuffer=nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  void MoveEnd(){
+    context.dispatch.vkDestroyBuffer(context.device,buffer,nullptr);
+    buffer=movedBuffer;
+    movedBuffer=nullptr;
+    vmaGetAllocationInfo(context.allocator,allocation,&allocationInfo);
+  }
+
+public:
+  InstanceStream(HeadlessDevice &context,VkDeviceSize frameSize,uint32_t frames=2):
+    context(context),
+    frameSize(frameSize),
+    frames(frames){
+    buffer=context.CreateBuffer(frameSize*frames,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,allocation,allocationInfo);
+    context.memory->Movable(allocation,{
+      .begin=[this](VmaAllocation destination){return MoveBegin(destination);},
+      .end=[this](){MoveEnd();}
+    });
+  }
+
+  InstanceStream(const InstanceStream &)=delete;
+  InstanceStream &operator=(const InstanceStream &)=delete;
+
+  ~InstanceStream(){
+    context.DestroyBuffer(buffer,allocation);
+  }
+
+  VkBuffer Buffer()const{
+    return buffer;
+  }
+
+  void BeginFrame(){
+    frame=(frame+1)%frames;
+    used=0;
+  }
+
+  //Offset of the copy from the start of Buffer(), 16 byte aligned
+  VkDeviceSize Append(const void *data,size_t size){
+    auto offset=(used+15)&~VkDeviceSize(15);
+    if(offset+size>frameSize)
+      throw std::runtime_error(std::format("Instance stream frame is full at {} bytes",frameSize));
+    used=offset+size;
+    offset+=frame*frameSize;
+    memcpy(static_cast<uint8_t *>(allocationInfo.pMappedData)+offset,data,size);
+    return offset;
+  }
+
+  //After the frame's appends and before submitting, only records them into
+  //a trace being captured
+  void Flush()const{
+    if(context.trace&&used>0){
+      auto offset=frame*frameSize;
+      context.trace->BufferData(buffer,offset,used,static_cast<const uint8_t *>(allocationInfo.pMappedData)+offset);
+    }
+  }
+};
+
+class RenderQueue{
+  //Vertex input and bindings of a mesh with the two instance bindings after
+  //its own, only the instance offsets change from frame to frame
+  struct Mesh{
+    uint32_t vertexCount;
+    std::vector<VkVertexInputBindingDescription2EXT> bindings;
+    std::vector<VkVertexInputAttributeDescription2EXT> attributes;
+    std::vector<VkBuffer> buffers;
+    std::vector<VkDeviceSize> offsets;
+    std::vector<VkDeviceSize> sizes;
+    std::vector<VkDeviceSize> strides;
+    //This frame's draws, in submission order
+    std::vector<InstanceTransform> transforms;
+    std::vector<InstanceTint> tints;
+  };
+
+  //What Build() made of a mesh's draws for Record()
+  struct Batch{
+    uint32_t mesh;
+    uint32_t instanceCount;
+    VkDeviceSize transformOffset;
+    VkDeviceSize tintOffset;
+  };
+
+  //One draw per submitted object, for comparison with the collapsed path
+  struct Single{
+    uint32_t mesh;
+    uint32_t instance;
+  };
+
+  uint32_t transformLocation;
+  uint32_t tintLocation;
+  uint32_t tintDivisor;
+  bool collapse;
+  std::vector<Mesh> meshes;
+  std::vector<Batch> batches;
+  //Batch of each mesh this frame, for the uncollapsed path
+  std::vector<uint32_t> meshBatches;
+  std::vector<Single> singles;
+  std::vector<InstanceTint> groupTints;
+  uint32_t submitted=0;
+
+  void Bind(TracedCommands &commands,Mesh &mesh,const Batch &batch,VkBuffer instances){
+    auto instanceBinding=mesh.buffers.size()-2;
+    mesh.buffers[instanceBinding]=mesh.buffers[instanceBinding+1]=instances;
+    mesh.offsets[instanceBinding]=batch.transformOffset;
+    mesh.offsets[instanceBinding+1]=batch.tintOffset;
+    commands.SetVertexInput((uint32_t)mesh.bindings.size(),mesh.bindings.data(),
+      (uint32_t)mesh.attributes.size(),mesh.attributes.data());
+    commands.BindVertexBuffers(0,(uint32_t)mesh.buffers.size(),mesh.buffers.data(),mesh.offsets.data(),
+      mesh.sizes.data(),mesh.strides.data());
+  }
+
+public:
+  //Locations the vertex shader reads the transform rows, three in a row,
+  //and the tint from. collapse false keeps one draw per object.
+  RenderQueue(HeadlessDevice &context,uint32_t transformLocation,uint32_t tintLocation,uint32_t tintDivisor,bool collapse=true):
+    transformLocation(transformLocation),
+    tintLocation(tintLocation),
+    tintDivisor(collapse&&tintDivisor<=context.maxInstanceDivisor?std::max(tintDivisor,1u):1),
+    collapse(collapse){
+  }
+
+  //The mesh's streams placed back to back in buffer from base, as
+  //PackedMesh::BindRanges lays them out
+  uint32_t AddMesh(const PackedMesh &mesh,VkBuffer buffer,VkDeviceSize base=0){
+    Mesh entry={
+      .vertexCount=mesh.vertexCount,
+      .bindings=mesh.bindings,
+      .attributes=mesh.attributes
+    };
+    mesh.BindRanges(base,entry.offsets,entry.sizes,entry.strides);
+    entry.buffers.assign(entry.offsets.size(),buffer);
+
+    auto transformBinding=(uint32_t)entry.bindings.size();
+    entry.bindings.push_back({
+      .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+      .pNext=nullptr,
+      .binding=transformBinding,
+      .stride=sizeof(InstanceTransform),
+      .inputRate=VK_VERTEX_INPUT_RATE_INSTANCE,
+      .divisor=1
+    });
+    entry.bindings.push_back({
+      .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+      .pNext=nullptr,
+      .binding=transformBinding+1,
+      .stride=sizeof(InstanceTint),
+      .inputRate=VK_VERTEX_INPUT_RATE_INSTANCE,
+      .divisor=tintDivisor
+    });
+    for(uint32_t row=0;row<3;row++){
+      entry.attributes.push_back({
+        .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+        .pNext=nullptr,
+        .location=transformLocation+row,
+        .binding=transformBinding,
+        .format=VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset=row*(uint32_t)sizeof(std::array<float,4>)
+      });
+    }
+    entry.attributes.push_back({
+      .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+      .pNext=nullptr,
+      .location=tintLocation,
+      .binding=transformBinding+1,
+      .format=VK_FORMAT_R32G32B32A32_SFLOAT,
+      .offset=0
+    });
+    entry.buffers.insert(entry.buffers.end(),2,VK_NULL_HANDLE);
+    entry.offsets.insert(entry.offsets.end(),2,0);
+    entry.sizes.insert(entry.sizes.end(),2,VK_WHOLE_SIZE);
+    entry.strides.insert(entry.strides.end(),{sizeof(InstanceTransform),sizeof(InstanceTint)});
+
+    meshes.push_back(std::move(entry));
+    meshBatches.push_back(0);
+    return (uint32_t)meshes.size()-1;
+  }
+
+  void Draw(uint32_t mesh,const InstanceTransform &transform,const InstanceTint &tint){
+    auto &entry=meshes[mesh];
+    entry.transforms.push_back(transform);
+    entry.tints.push_back(tint);
+    if(!collapse)
+      singles.push_back({.mesh=mesh,.instance=(uint32_t)entry.transforms.size()-1});
+    submitted++;
+  }
+
+  //Writes this frame's instance data to the stream, after the last Draw()
+  //and before the stream's Flush()
+  void Build(InstanceStream &stream){
+    batches.clear();
+    for(uint32_t mesh=0;mesh<meshes.size();mesh++){
+      auto &entry=meshes[mesh];
+      if(entry.transforms.empty())
+        continue;
+
+      const InstanceTint *tints=entry.tints.data();
+      size_t tintCount=entry.tints.size();
+      if(tintDivisor>1){
+        groupTints.clear();
+        for(size_t instance=0;instance<entry.tints.size();instance+=tintDivisor)
+          groupTints.push_back(entry.tints[instance]);
+        tints=groupTints.data();
+        tintCount=groupTints.size();
+      }
+      meshBatches[mesh]=(uint32_t)batches.size();
+      batches.push_back({
+        .mesh=mesh,
+        .instanceCount=(uint32_t)entry.transforms.size(),
+        .transformOffset=stream.Append(entry.transforms.data(),entry.transforms.size()*sizeof(InstanceTransform)),
+        .tintOffset=stream.Append(tints,tintCount*sizeof(InstanceTint))
+      });
+    }
+  }
+
+  //Records the frame's draws, one vkCmdDraw per mesh when collapsing. The
+  //rest of the graphics state is the caller's.
+  void Record(TracedCommands &commands,const InstanceStream &stream){
+    if(collapse){
+      for(auto &batch:batches){
+        auto &mesh=meshes[batch.mesh];
+        Bind(commands,mesh,batch,stream.Buffer());
+        commands.Draw(mesh.vertexCount,batch.instanceCount,0,0);
+      }
+      return;
+    }
+
+    //What a renderer without instancing does, vertex input and buffers
+    //again for every object
+    for(auto &single:singles){
+      auto &mesh=meshes[single.mesh];
+      Bind(commands,mesh,batches[meshBatches[single.mesh]],stream.Buffer());
+      commands.Draw(mesh.vertexCount,1,0,single.instance);
+    }
+  }
+
+  //Drops the frame's draws once recorded
+  void Clear(){
+    for(auto &mesh:meshes){
+      mesh.transforms.clear();
+      mesh.tints.clear();
+    }
+    singles.clear();
+    submitted=0;
+  }
+
+  uint32_t Submitted()const{
+    return submitted;
+  }
+
+  uint32_t DrawCalls()const{
+    return collapse?(uint32_t)batches.size():(uint32_t)singles.size();
+  }
+};
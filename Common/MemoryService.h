@@ -0,0 +1,302 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<string>
+#include<unordered_map>
+#include<functional>
+#include<format>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+
+//Where the memory of a device goes. Per heap usage and budget come from
+//vmaGetHeapBudgets, with VK_EXT_memory_budget those are the driver's numbers
+//for the whole process, without it VMA's own estimate. Allocations made
+//through HeadlessDevice::CreateBuffer and RenderTargetPool are also counted
+//by tag; memory the frame graph allocates for transients is in the heap
+//numbers only.
+//
+//With the budget extension, allocations are made with
+//VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT and fail instead of going over
+//budget, so a device local heap never quietly spills into system memory.
+//
+//Idle() runs incremental VMA defragmentation, a bounded pass per call. Only
+//allocations registered with Movable() are moved, their owners recreate the
+//resource at the new place. Everything else stays where it is, most of it is
+//referenced by device address from descriptors and cannot move.
+
+enum class MemoryTag:uint32_t{
+  Descriptor=0,
+  Vertex,
+  Index,
+  Uniform,
+  Storage,
+  Staging,
+  RenderTarget,
+  Other,
+  Count
+};
+
+inline const char *MemoryTagName(MemoryTag tag){
+  static constexpr std::array<const char *,(size_t)MemoryTag::Count> Names={
+    "descriptor","vertex","index","uniform","storage","staging","render target","other"};
+  return Names[(size_t)tag];
+}
+
+//Buffers are tagged by the first usage that says what they are for
+inline MemoryTag MemoryTagFromUsage(VkBufferUsageFlags usage){
+  if(usage&(VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT|VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT))
+    return MemoryTag::Descriptor;
+  if(usage&VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+    return MemoryTag::Vertex;
+  if(usage&VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+    return MemoryTag::Index;
+  if(usage&VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    return MemoryTag::Uniform;
+  if(usage&VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    return MemoryTag::Storage;
+  if(usage&(VK_BUFFER_USAGE_TRANSFER_SRC_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+    return MemoryTag::Staging;
+  return MemoryTag::Other;
+}
+
+struct MemoryHeapBudget{
+  uint32_t heap;
+  VkMemoryHeapFlags flags;
+  VkDeviceSize size;
+  //Everything the process has on the heap, and how much it should stay under
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+  //VMA's blocks and the part of them holding allocations
+  VkDeviceSize blockBytes;
+  VkDeviceSize allocationBytes;
+  uint32_t blockCount;
+  uint32_t allocationCount;
+};
+
+struct MemoryTagUsage{
+  VkDeviceSize bytes=0;
+  VkDeviceSize peakBytes=0;
+  uint32_t count=0;
+};
+
+struct MemoryDefragmentation{
+  uint32_t passes=0;
+  uint32_t allocationsMoved=0;
+  VkDeviceSize bytesMoved=0;
+  VkDeviceSize bytesFreed=0;
+  uint32_t blocksFreed=0;
+};
+
+//How an owner moves its resource during defragmentation
+struct MemoryRelocation{
+  //Create the resource again bound to destination and copy what has to
+  //survive, false leaves the allocation where it is
+  std::function<bool(VmaAllocation destination)> begin;
+  //The allocation now lives at the new place, drop the old resource
+  std::function<void()> end;
+};
+
+class MemoryService{
+  struct Entry{
+    MemoryTag tag;
+    VkDeviceSize size;
+    MemoryRelocation *relocation;
+  };
+
+  VmaAllocator allocator;
+  bool budgetExtension;
+  std::unordered_map<VmaAllocation,Entry> allocations;
+  std::unordered_map<VmaAllocation,MemoryRelocation> relocations;
+  std::array<MemoryTagUsage,(size_t)MemoryTag::Count> tags={};
+
+  VmaDefragmentationContext defragmentation=nullptr;
+  //Allocations moved by the pass in progress, ended after it
+  std::vector<MemoryRelocation *> moving;
+  MemoryDefragmentation defragmented;
+
+public:
+  MemoryService(VmaAllocator allocator,bool budgetExtension):
+    allocator(allocator),
+    budgetExtension(budgetExtension){
+  }
+
+  MemoryService(const MemoryService &)=delete;
+  MemoryService &operator=(const MemoryService &)=delete;
+
+  ~MemoryService(){
+    if(defragmentation)
+      vmaEndDefragmentation(allocator,defragmentation,nullptr);
+  }
+
+  //Added to the flags of every tracked allocation
+  VmaAllocationCreateFlags AllocationFlags()const{
+    return budgetExtension?(VmaAllocationCreateFlags)VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT:0u;
+  }
+
+  void Track(VmaAllocation allocation,MemoryTag tag){
+    VmaAllocationInfo info={};
+    vmaGetAllocationInfo(allocator,allocation,&info);
+    vmaSetAllocationName(allocator,allocation,MemoryTagName(tag));
+    allocations[allocation]={.tag=tag,.size=info.size,.relocation=nullptr};
+
+    auto &usage=tags[(size_t)tag];
+    usage.bytes+=info.size;
+    usage.peakBytes=std::max(usage.peakBytes,usage.bytes);
+    usage.count++;
+  }
+
+  //Before the allocation is freed
+  void Untrack(VmaAllocation allocation){
+    auto found=allocations.find(allocation);
+    if(found==allocations.end())
+      return;
+    auto &usage=tags[(size_t)found->second.tag];
+    usage.bytes-=found->second.size;
+    usage.count--;
+    relocations.erase(allocation);
+    allocations.erase(found);
+  }
+
+  //Lets Idle() move a tracked allocation. The callbacks run from Idle()
+  //only, with the device idle.
+  void Movable(VmaAllocation allocation,MemoryRelocation relocation){
+    auto found=allocations.find(allocation);
+    if(found==allocations.end())
+      throw std::runtime_error("Only tracked allocations can be made movable");
+    found->second.relocation=&(relocations[allocation]=std::move(relocation));
+  }
+
+  const MemoryTagUsage &Usage(MemoryTag tag)const{
+    return tags[(size_t)tag];
+  }
+
+  std::vector<MemoryHeapBudget> Heaps()const{
+    const VkPhysicalDeviceMemoryProperties *properties=nullptr;
+    vmaGetMemoryProperties(allocator,&properties);
+    std::array<VmaBudget,VK_MAX_MEMORY_HEAPS> budgets={};
+    vmaGetHeapBudgets(allocator,budgets.data());
+
+    std::vector<MemoryHeapBudget> heaps;
+    for(uint32_t heap=0;heap<properties->memoryHeapCount;heap++){
+      auto &budget=budgets[heap];
+      heaps.push_back({
+        .heap=heap,
+        .flags=properties->memoryHeaps[heap].flags,
+        .size=properties->memoryHeaps[heap].size,
+        .usage=budget.usage,
+        .budget=budget.budget,
+        .blockBytes=budget.statistics.blockBytes,
+        .allocationBytes=budget.statistics.allocationBytes,
+        .blockCount=budget.statistics.blockCount,
+        .allocationCount=budget.statistics.allocationCount
+      });
+    }
+    return heaps;
+  }
+
+  //Device local heaps using more than fraction of their budget
+  std::vector<uint32_t> OverBudget(double fraction=0.9)const{
+    std::vector<uint32_t> heaps;
+    for(auto &heap:Heaps()){
+      if((heap.flags&VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)&&heap.budget>0&&heap.usage>heap.budget*fraction)
+        heaps.push_back(heap.heap);
+    }
+    return heaps;
+  }
+
+  //Share of VMA's blocks not holding allocations
+  double Fragmentation()const{
+    VmaTotalStatistics statistics={};
+    vmaCalculateStatistics(allocator,&statistics);
+    auto &total=statistics.total.statistics;
+    return total.blockBytes>0?1.0-(double)total.allocationBytes/total.blockBytes:0.0;
+  }
+
+  //Call with the device idle, between frames. Starts defragmenting once
+  //more than threshold of the blocks is free and runs one pass of at most
+  //maxMoves allocations and maxBytes, true while there is more to do.
+  bool Idle(double threshold=0.25,uint32_t maxMoves=64,VkDeviceSize maxBytes=16*1024*1024){
+    if(!defragmentation){
+      if(Fragmentation()<=threshold)
+        return false;
+      VmaDefragmentationInfo info={
+        .flags=VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT,
+        .pool=nullptr,
+        .maxBytesPerPass=maxBytes,
+        .maxAllocationsPerPass=maxMoves,
+        .pfnBreakCallback=nullptr,
+        .pBreakCallbackUserData=nullptr
+      };
+      if(vmaBeginDefragmentation(allocator,&info,&defragmentation)!=VK_SUCCESS){
+        defragmentation=nullptr;
+        return false;
+      }
+    }
+
+    VmaDefragmentationPassMoveInfo pass={};
+    auto result=vmaBeginDefragmentationPass(allocator,defragmentation,&pass);
+    if(result==VK_INCOMPLETE){
+      moving.clear();
+      for(uint32_t index=0;index<pass.moveCount;index++){
+        auto &move=pass.pMoves[index];
+        auto found=allocations.find(move.srcAllocation);
+        auto relocation=found!=allocations.end()?found->second.relocation:nullptr;
+        if(relocation&&relocation->begin(move.dstTmpAllocation))
+          moving.push_back(relocation);
+        else
+          move.operation=VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+      }
+      result=vmaEndDefragmentationPass(allocator,defragmentation,&pass);
+      for(auto relocation:moving)
+        relocation->end();
+      defragmented.passes++;
+    }
+    if(result==VK_INCOMPLETE)
+      return true;
+
+    VmaDefragmentationStats stats={};
+    vmaEndDefragmentation(allocator,defragmentation,&stats);
+    defragmentation=nullptr;
+    defragmented.allocationsMoved+=stats.allocationsMoved;
+    defragmented.bytesMoved+=stats.bytesMoved;
+    defragmented.bytesFreed+=stats.bytesFreed;
+    defragmented.blocksFreed+=stats.deviceMemoryBlocksFreed;
+    return false;
+  }
+
+  const MemoryDefragmentation &Defragmented()const{
+    return defragmented;
+  }
+
+  std::string Report()const{
+    auto MiB=[](VkDeviceSize bytes){
+      return bytes/(1024.0*1024.0);
+    };
+
+    std::string report=std::format("Memory budget {}\n{:<6}{:>8}{:>12}{:>12}{:>12}{:>12}{:>8}\n",
+      budgetExtension?"from VK_EXT_memory_budget":"estimated by VMA",
+      "heap","local","size MiB","usage MiB","budget MiB","alloc MiB","blocks");
+    for(auto &heap:Heaps()){
+      report+=std::format("{:<6}{:>8}{:>12.2f}{:>12.2f}{:>12.2f}{:>12.2f}{:>8}\n",
+        heap.heap,(heap.flags&VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)?"yes":"no",
+        MiB(heap.size),MiB(heap.usage),MiB(heap.budget),MiB(heap.allocationBytes),heap.blockCount);
+    }
+
+    report+=std::format("{:<16}{:>8}{:>12}{:>12}\n","tag","count","MiB","peak MiB");
+    for(uint32_t tag=0;tag<(uint32_t)MemoryTag::Count;tag++){
+      auto &usage=tags[tag];
+      if(usage.peakBytes==0)
+        continue;
+      report+=std::format("{:<16}{:>8}{:>12.2f}{:>12.2f}\n",MemoryTagName((MemoryTag)tag),usage.count,
+        MiB(usage.bytes),MiB(usage.peakBytes));
+    }
+
+    report+=std::format("Fragmentation {:.1f}%, defragmented {} passes, {} allocations, {:.2f} MiB moved, {} blocks freed",
+      Fragmentation()*100.0,defragmented.passes,defragmented.allocationsMoved,MiB(defragmented.bytesMoved),
+      defragmented.blocksFreed);
+    for(auto heap:OverBudget())
+      report+=std::format("\nWarning: device local heap {} is above 90% of its budget",heap);
+    return report;
+  }
+};
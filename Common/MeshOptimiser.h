@@ -0,0 +1,692 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<string>
+#include<random>
+#include<bit>
+#include<cmath>
+#include<cstdint>
+#include<cstring>
+#include<algorithm>
+#include<numeric>
+#include<filesystem>
+#include<fstream>
+#include<sstream>
+#include<format>
+#include<stdexcept>
+#include<type_traits>
+#include"VertexPacking.h"
+
+#if defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+#include<emmintrin.h>
+#define MESH_OPTIMISER_SSE2
+#endif
+
+//Index buffer optimisation run once when a mesh is imported, in the order
+//the stages build on each other:
+//
+//  vertex cache   Forsyth's linear speed reordering, triangles sharing
+//                 vertices still in the post-transform cache go first
+//  overdraw       splits the cache ordered list into clusters where the
+//                 cache is cold anyway and sorts them front to back from
+//                 every direction at once, Sander et al. 2007
+//  vertex fetch   renumbers the vertices in first use order so the fetches
+//                 walk the vertex buffer forwards
+//
+//The analysers model the hardware the stages target: a 16 entry FIFO
+//post-transform cache, 64 byte vertex fetch lines and a depth tested
+//rasteriser looking at the mesh along the six axis directions. The cache
+//lookups and the rasteriser's pixel loop run four lanes at a time with SSE2,
+//with a scalar path for everything else.
+
+struct IndexedMesh{
+  MeshData data;
+  //Triangle list
+  std::vector<uint32_t> indices;
+
+  uint32_t VertexCount()const{
+    return (uint32_t)data.positions.size();
+  }
+};
+
+struct VertexCacheStats{
+  uint32_t transformed=0;
+  //Average cache miss ratio, transformed vertices per triangle, 0.5 at best
+  float acmr=0.0f;
+  //Average transform to vertex ratio, 1.0 at best
+  float atvr=0.0f;
+};
+
+struct VertexFetchStats{
+  uint64_t bytesFetched=0;
+  //Bytes fetched over bytes referenced, 1.0 at best
+  float overfetch=0.0f;
+};
+
+struct OverdrawStats{
+  uint64_t covered=0;
+  uint64_t shaded=0;
+  //Shaded over covered pixels, 1.0 at best
+  float overdraw=0.0f;
+};
+
+//FIFO post-transform cache of up to 32 entries, a multiple of 4
+class VertexCacheModel{
+  static constexpr uint32_t MaxSize=32;
+  static constexpr uint32_t Empty=~0u;
+
+  alignas(16) std::array<uint32_t,MaxSize> entries;
+  uint32_t size;
+  uint32_t next=0;
+
+public:
+  VertexCacheModel(uint32_t size):size(size){
+    if(size==0||size>MaxSize||size%4!=0)
+      throw std::runtime_error("Cache size has to be a multiple of 4 up to 32");
+    entries.fill(Empty);
+  }
+
+  bool Contains(uint32_t index)const{
+#ifdef MESH_OPTIMISER_SSE2
+    auto key=_mm_set1_epi32((int)index);
+    auto found=_mm_setzero_si128();
+    for(uint32_t entry=0;entry<size;entry+=4)
+      found=_mm_or_si128(found,_mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(&entries[entry])),key));
+    return _mm_movemask_epi8(found)!=0;
+#else
+    return std::find(entries.begin(),entries.begin()+size,index)!=entries.begin()+size;
+#endif
+  }
+
+  //True on a miss, the vertex is transformed and replaces the oldest entry
+  bool Access(uint32_t index){
+    if(Contains(index))
+      return false;
+    entries[next]=index;
+    next=(next+1)%size;
+    return true;
+  }
+
+  void Clear(){
+    entries.fill(Empty);
+    next=0;
+  }
+};
+
+class MeshOptimiser{
+  static constexpr uint32_t ScoringCacheSize=32;
+  static constexpr uint32_t FetchLine=64;
+  static constexpr uint32_t FetchLines=128;
+
+  static void Validate(const IndexedMesh &mesh){
+    if(mesh.indices.size()%3!=0)
+      throw std::runtime_error("Index count is not a multiple of 3");
+    auto vertexCount=mesh.VertexCount();
+    for(auto index:mesh.indices){
+      if(index>=vertexCount)
+        throw std::runtime_error(std::format("Index {} is past the {} vertices",index,vertexCount));
+    }
+  }
+
+  //Forsyth's scoring: the three most recent vertices are scored lower so the
+  //next triangle does not simply continue the strip, vertices with few
+  //triangles left are boosted to finish them off
+  static float VertexScore(int32_t cachePosition,uint32_t remaining){
+    if(remaining==0)
+      return -1.0f;
+    float score=0.0f;
+    if(cachePosition>=0){
+      if(cachePosition<3)
+        score=0.75f;
+      else
+        score=std::pow(1.0f-(float)(cachePosition-3)/(ScoringCacheSize-3),1.5f);
+    }
+    return score+2.0f/std::sqrt((float)remaining);
+  }
+
+  static std::array<float,3> Sub(const std::array<float,3> &a,const std::array<float,3> &b){
+    return {a[0]-b[0],a[1]-b[1],a[2]-b[2]};
+  }
+
+  static std::array<float,3> Cross(const std::array<float,3> &a,const std::array<float,3> &b){
+    return {a[1]*b[2]-a[2]*b[1],a[2]*b[0]-a[0]*b[2],a[0]*b[1]-a[1]*b[0]};
+  }
+
+  static float Dot(const std::array<float,3> &a,const std::array<float,3> &b){
+    return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];
+  }
+
+  //Depth tested coverage of one triangle in pixel coordinates, z is the
+  //depth. Triangles whose signed area does not have the sign of facing are
+  //back facing and culled. Counts the pixels that pass the test into shaded.
+  static void Rasterise(std::vector<float> &depth,uint32_t stride,uint32_t resolution,float facing,
+    std::array<float,3> a,std::array<float,3> b,std::array<float,3> c,uint64_t &shaded){
+
+    float area=(b[0]-a[0])*(c[1]-a[1])-(b[1]-a[1])*(c[0]-a[0]);
+    if(area*facing<=0.0f)
+      return;
+    if(area<0.0f){
+      std::swap(b,c);
+      area=-area;
+    }
+    float inverseArea=1.0f/area;
+
+    auto minX=(int32_t)std::max(0.0f,std::floor(std::min({a[0],b[0],c[0]})));
+    auto maxX=(int32_t)std::min((float)resolution-1.0f,std::ceil(std::max({a[0],b[0],c[0]})));
+    auto minY=(int32_t)std::max(0.0f,std::floor(std::min({a[1],b[1],c[1]})));
+    auto maxY=(int32_t)std::min((float)resolution-1.0f,std::ceil(std::max({a[1],b[1],c[1]})));
+    if(minX>maxX||minY>maxY)
+      return;
+
+    //Edge functions opposite a, b and c, their ratio to the area are the
+    //barycentric weights of the vertex
+    struct Edge{
+      float stepX;
+      float stepY;
+      float origin;
+      float At(float x,float y)const{
+        return origin+stepX*x+stepY*y;
+      }
+    };
+    auto MakeEdge=[](const std::array<float,3> &from,const std::array<float,3> &to)->Edge{
+      return {
+        .stepX=-(to[1]-from[1]),
+        .stepY=to[0]-from[0],
+        .origin=(to[1]-from[1])*from[0]-(to[0]-from[0])*from[1]
+      };
+    };
+    std::array<Edge,3> edges={MakeEdge(b,c),MakeEdge(c,a),MakeEdge(a,b)};
+
+    //The pixel loop starts 4 aligned, lanes left of the bounds fail the
+    //edge tests on their own
+    auto startX=minX&~3;
+    for(int32_t y=minY;y<=maxY;y++){
+      float centreY=(float)y+0.5f;
+      float *row=depth.data()+(size_t)y*stride;
+#ifdef MESH_OPTIMISER_SSE2
+      const auto lanes=_mm_set_ps(3.0f,2.0f,1.0f,0.0f);
+      const auto zero=_mm_setzero_ps();
+      __m128 weights[3];
+      __m128 steps[3];
+      for(int edge=0;edge<3;edge++){
+        weights[edge]=_mm_add_ps(_mm_set1_ps(edges[edge].At((float)startX+0.5f,centreY)),
+          _mm_mul_ps(lanes,_mm_set1_ps(edges[edge].stepX)));
+        steps[edge]=_mm_set1_ps(edges[edge].stepX*4.0f);
+      }
+      auto za=_mm_set1_ps(a[2]*inverseArea);
+      auto zb=_mm_set1_ps(b[2]*inverseArea);
+      auto zc=_mm_set1_ps(c[2]*inverseArea);
+      for(int32_t x=startX;x<=maxX;x+=4){
+        auto inside=_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(weights[0],zero),_mm_cmpge_ps(weights[1],zero)),
+          _mm_cmpge_ps(weights[2],zero));
+        auto z=_mm_add_ps(_mm_add_ps(_mm_mul_ps(weights[0],za),_mm_mul_ps(weights[1],zb)),_mm_mul_ps(weights[2],zc));
+        auto stored=_mm_loadu_ps(row+x);
+        auto pass=_mm_and_ps(inside,_mm_cmplt_ps(z,stored));
+        auto mask=_mm_movemask_ps(pass);
+        if(mask){
+          shaded+=std::popcount((uint32_t)mask);
+          _mm_storeu_ps(row+x,_mm_or_ps(_mm_and_ps(pass,z),_mm_andnot_ps(pass,stored)));
+        }
+        for(int edge=0;edge<3;edge++)
+          weights[edge]=_mm_add_ps(weights[edge],steps[edge]);
+      }
+#else
+      for(int32_t x=startX;x<=maxX;x++){
+        float centreX=(float)x+0.5f;
+        std::array<float,3> weights={edges[0].At(centreX,centreY),edges[1].At(centreX,centreY),edges[2].At(centreX,centreY)};
+        if(weights[0]<0.0f||weights[1]<0.0f||weights[2]<0.0f)
+          continue;
+        float z=(weights[0]*a[2]+weights[1]*b[2]+weights[2]*c[2])*inverseArea;
+        if(z<row[x]){
+          row[x]=z;
+          shaded++;
+        }
+      }
+#endif
+    }
+  }
+
+public:
+  //*************** Stages ************************
+  static void OptimiseVertexCache(IndexedMesh &mesh){
+    Validate(mesh);
+    auto vertexCount=mesh.VertexCount();
+    auto triangleCount=(uint32_t)(mesh.indices.size()/3);
+    if(triangleCount==0)
+      return;
+
+    //Triangles of every vertex, the first remaining[vertex] are still to go
+    std::vector<uint32_t> remaining(vertexCount,0);
+    for(auto index:mesh.indices)
+      remaining[index]++;
+    std::vector<uint32_t> offsets(vertexCount+1,0);
+    for(uint32_t vertex=0;vertex<vertexCount;vertex++)
+      offsets[vertex+1]=offsets[vertex]+remaining[vertex];
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    {
+      std::vector<uint32_t> fill(offsets.begin(),offsets.end()-1);
+      for(uint32_t triangle=0;triangle<triangleCount;triangle++){
+        for(uint32_t corner=0;corner<3;corner++)
+          adjacency[fill[mesh.indices[triangle*3+corner]]++]=triangle;
+      }
+    }
+
+    std::vector<int32_t> cachePositions(vertexCount,-1);
+    std::vector<float> vertexScores(vertexCount);
+    for(uint32_t vertex=0;vertex<vertexCount;vertex++)
+      vertexScores[vertex]=VertexScore(-1,remaining[vertex]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount,0);
+    int64_t best=0;
+    for(uint32_t triangle=0;triangle<triangleCount;triangle++){
+      auto *corners=&mesh.indices[triangle*3];
+      triangleScores[triangle]=vertexScores[corners[0]]+vertexScores[corners[1]]+vertexScores[corners[2]];
+      if(triangleScores[triangle]>triangleScores[best])
+        best=triangle;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(mesh.indices.size());
+    std::vector<uint32_t> cache,nextCache;
+    cache.reserve(ScoringCacheSize+3);
+    nextCache.reserve(ScoringCacheSize+3);
+    uint32_t cursor=0;
+
+    for(uint32_t count=0;count<triangleCount;count++){
+      //Nothing in the cache has triangles left, continue in input order
+      if(best<0){
+        while(emitted[cursor])
+          cursor++;
+        best=cursor;
+      }
+
+      std::array<uint32_t,3> corners={mesh.indices[best*3],mesh.indices[best*3+1],mesh.indices[best*3+2]};
+      output.insert(output.end(),corners.begin(),corners.end());
+      emitted[best]=1;
+
+      nextCache.clear();
+      for(auto vertex:corners){
+        auto begin=adjacency.begin()+offsets[vertex];
+        auto end=begin+remaining[vertex];
+        auto found=std::find(begin,end,(uint32_t)best);
+        std::iter_swap(found,end-1);
+        remaining[vertex]--;
+        if(std::find(nextCache.begin(),nextCache.end(),vertex)==nextCache.end())
+          nextCache.push_back(vertex);
+      }
+      for(auto vertex:cache){
+        if(std::find(corners.begin(),corners.end(),vertex)==corners.end())
+          nextCache.push_back(vertex);
+      }
+
+      //Rescore everything that moved, entries pushed out of the cache
+      //included, and pick the best triangle touching the cache
+      best=-1;
+      float bestScore=-1.0f;
+      for(uint32_t position=0;position<nextCache.size();position++){
+        auto vertex=nextCache[position];
+        auto cachePosition=position<ScoringCacheSize?(int32_t)position:-1;
+        cachePositions[vertex]=cachePosition;
+        float score=VertexScore(cachePosition,remaining[vertex]);
+        float delta=score-vertexScores[vertex];
+        vertexScores[vertex]=score;
+
+        for(uint32_t index=0;index<remaining[vertex];index++){
+          auto triangle=adjacency[offsets[vertex]+index];
+          triangleScores[triangle]+=delta;
+          if(cachePosition>=0&&triangleScores[triangle]>bestScore){
+            bestScore=triangleScores[triangle];
+            best=triangle;
+          }
+        }
+      }
+      if(nextCache.size()>ScoringCacheSize)
+        nextCache.resize(ScoringCacheSize);
+      std::swap(cache,nextCache);
+    }
+
+    mesh.indices=std::move(output);
+  }
+
+  //Cluster boundaries are kept where the cache ordered list misses on all
+  //three vertices, and added where a cluster's own miss ratio from a cold
+  //cache is within threshold of the whole mesh's. Run after
+  //OptimiseVertexCache.
+  static void OptimiseOverdraw(IndexedMesh &mesh,float threshold=1.05f,uint32_t cacheSize=16){
+    Validate(mesh);
+    auto triangleCount=(uint32_t)(mesh.indices.size()/3);
+    if(triangleCount==0)
+      return;
+
+    VertexCacheModel cache(cacheSize);
+    std::vector<uint32_t> hardBoundaries;
+    uint32_t meshMisses=0;
+    for(uint32_t triangle=0;triangle<triangleCount;triangle++){
+      uint32_t misses=0;
+      for(uint32_t corner=0;corner<3;corner++)
+        misses+=cache.Access(mesh.indices[triangle*3+corner])?1:0;
+      if(triangle==0||misses==3)
+        hardBoundaries.push_back(triangle);
+      meshMisses+=misses;
+    }
+    hardBoundaries.push_back(triangleCount);
+    float limit=(float)meshMisses/triangleCount*threshold;
+
+    std::vector<uint32_t> clusters;
+    for(size_t hard=0;hard+1<hardBoundaries.size();hard++){
+      auto start=hardBoundaries[hard];
+      auto end=hardBoundaries[hard+1];
+      clusters.push_back(start);
+      cache.Clear();
+      uint32_t misses=0;
+      for(auto triangle=start;triangle<end;triangle++){
+        for(uint32_t corner=0;corner<3;corner++)
+          misses+=cache.Access(mesh.indices[triangle*3+corner])?1:0;
+        if(triangle+1<end&&(float)misses/(triangle+1-clusters.back())<=limit){
+          clusters.push_back(triangle+1);
+          cache.Clear();
+          misses=0;
+        }
+      }
+    }
+    clusters.push_back(triangleCount);
+
+    std::array<float,3> meshCentre={0.0f,0.0f,0.0f};
+    for(auto &position:mesh.data.positions){
+      for(int axis=0;axis<3;axis++)
+        meshCentre[axis]+=position[axis];
+    }
+    for(int axis=0;axis<3;axis++)
+      meshCentre[axis]/=(float)mesh.data.positions.size();
+
+    //Clusters far out along their own normal occlude the rest from most
+    //directions, they are drawn first
+    struct Cluster{
+      uint32_t start;
+      uint32_t end;
+      float key;
+    };
+    std::vector<Cluster> sorted;
+    for(size_t cluster=0;cluster+1<clusters.size();cluster++){
+      std::array<float,3> centre={0.0f,0.0f,0.0f};
+      std::array<float,3> normal={0.0f,0.0f,0.0f};
+      float totalArea=0.0f;
+      for(auto triangle=clusters[cluster];triangle<clusters[cluster+1];triangle++){
+        auto &a=mesh.data.positions[mesh.indices[triangle*3]];
+        auto &b=mesh.data.positions[mesh.indices[triangle*3+1]];
+        auto &c=mesh.data.positions[mesh.indices[triangle*3+2]];
+        auto cross=Cross(Sub(b,a),Sub(c,a));
+        float area=std::sqrt(Dot(cross,cross));
+        for(int axis=0;axis<3;axis++){
+          centre[axis]+=(a[axis]+b[axis]+c[axis])/3.0f*area;
+          normal[axis]+=cross[axis];
+        }
+        totalArea+=area;
+      }
+
+      float key=0.0f;
+      float length=std::sqrt(Dot(normal,normal));
+      if(totalArea>0.0f&&length>0.0f){
+        for(int axis=0;axis<3;axis++)
+          centre[axis]/=totalArea;
+        key=Dot(Sub(centre,meshCentre),normal)/length;
+      }
+      sorted.push_back({clusters[cluster],clusters[cluster+1],key});
+    }
+    std::stable_sort(sorted.begin(),sorted.end(),[](const Cluster &a,const Cluster &b){
+      return a.key>b.key;
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(mesh.indices.size());
+    for(auto &cluster:sorted)
+      output.insert(output.end(),mesh.indices.begin()+cluster.start*3,mesh.indices.begin()+cluster.end*3);
+    mesh.indices=std::move(output);
+  }
+
+  //Vertices no triangle uses are dropped
+  static void OptimiseVertexFetch(IndexedMesh &mesh){
+    Validate(mesh);
+    auto vertexCount=mesh.VertexCount();
+    std::vector<uint32_t> remap(vertexCount,~0u);
+    uint32_t next=0;
+    for(auto &index:mesh.indices){
+      if(remap[index]==~0u)
+        remap[index]=next++;
+      index=remap[index];
+    }
+
+    auto Reorder=[&](auto &attribute){
+      if(attribute.empty())
+        return;
+      std::remove_reference_t<decltype(attribute)> reordered(next);
+      for(uint32_t vertex=0;vertex<vertexCount;vertex++){
+        if(remap[vertex]!=~0u)
+          reordered[remap[vertex]]=attribute[vertex];
+      }
+      attribute=std::move(reordered);
+    };
+    Reorder(mesh.data.positions);
+    Reorder(mesh.data.normals);
+    Reorder(mesh.data.texCoords);
+  }
+
+  //The three stages in order
+  static void Optimise(IndexedMesh &mesh){
+    OptimiseVertexCache(mesh);
+    OptimiseOverdraw(mesh);
+    OptimiseVertexFetch(mesh);
+  }
+
+  //*************** Analysis **********************
+  static VertexCacheStats AnalyseVertexCache(const IndexedMesh &mesh,uint32_t cacheSize=16){
+    Validate(mesh);
+    VertexCacheStats stats;
+    if(mesh.indices.empty())
+      return stats;
+
+    VertexCacheModel cache(cacheSize);
+    std::vector<uint8_t> used(mesh.VertexCount(),0);
+    uint32_t unique=0;
+    for(auto index:mesh.indices){
+      if(cache.Access(index))
+        stats.transformed++;
+      if(!used[index]){
+        used[index]=1;
+        unique++;
+      }
+    }
+    stats.acmr=(float)stats.transformed/(mesh.indices.size()/3);
+    stats.atvr=(float)stats.transformed/unique;
+    return stats;
+  }
+
+  //Direct mapped cache of 128 lines, 8KiB, over a vertex buffer of stride
+  //bytes per vertex
+  static VertexFetchStats AnalyseVertexFetch(const IndexedMesh &mesh,uint32_t stride){
+    Validate(mesh);
+    VertexFetchStats stats;
+    if(mesh.indices.empty()||stride==0)
+      return stats;
+
+    std::vector<uint64_t> tags(FetchLines,~0ull);
+    std::vector<uint8_t> used(mesh.VertexCount(),0);
+    uint64_t referenced=0;
+    for(auto index:mesh.indices){
+      uint64_t first=(uint64_t)index*stride/FetchLine;
+      uint64_t last=((uint64_t)index*stride+stride-1)/FetchLine;
+      for(auto line=first;line<=last;line++){
+        auto &tag=tags[line%FetchLines];
+        if(tag!=line){
+          tag=line;
+          stats.bytesFetched+=FetchLine;
+        }
+      }
+      if(!used[index]){
+        used[index]=1;
+        referenced+=stride;
+      }
+    }
+    stats.overfetch=(float)stats.bytesFetched/referenced;
+    return stats;
+  }
+
+  //Orthographic along +-x, +-y and +-z, each view fitted to the mesh bounds
+  //at resolution x resolution. Front faces are counter-clockwise.
+  static OverdrawStats AnalyseOverdraw(const IndexedMesh &mesh,uint32_t resolution=256){
+    Validate(mesh);
+    OverdrawStats stats;
+    if(mesh.indices.empty())
+      return stats;
+
+    std::array<float,3> minimum=mesh.data.positions[0];
+    std::array<float,3> maximum=mesh.data.positions[0];
+    for(auto &position:mesh.data.positions){
+      for(int axis=0;axis<3;axis++){
+        minimum[axis]=std::min(minimum[axis],position[axis]);
+        maximum[axis]=std::max(maximum[axis],position[axis]);
+      }
+    }
+
+    //Rows padded to 4 floats for the SSE2 loop
+    uint32_t stride=(resolution+3)&~3u;
+    std::vector<float> depth((size_t)stride*resolution);
+    for(int axis=0;axis<3;axis++){
+      int u=(axis+1)%3;
+      int v=(axis+2)%3;
+      float scaleU=maximum[u]>minimum[u]?(float)resolution/(maximum[u]-minimum[u]):0.0f;
+      float scaleV=maximum[v]>minimum[v]?(float)resolution/(maximum[v]-minimum[v]):0.0f;
+
+      for(float direction:{1.0f,-1.0f}){
+        std::fill(depth.begin(),depth.end(),INFINITY);
+        auto Project=[&](uint32_t index)->std::array<float,3>{
+          auto &position=mesh.data.positions[index];
+          return {(position[u]-minimum[u])*scaleU,(position[v]-minimum[v])*scaleV,position[axis]*direction};
+        };
+        //u x v is the view axis. Seen from its negative side a counter-
+        //clockwise triangle has a negative area, from the positive side a
+        //positive one.
+        for(size_t triangle=0;triangle<mesh.indices.size();triangle+=3){
+          Rasterise(depth,stride,resolution,-direction,Project(mesh.indices[triangle]),Project(mesh.indices[triangle+1]),
+            Project(mesh.indices[triangle+2]),stats.shaded);
+        }
+        for(uint32_t y=0;y<resolution;y++){
+          for(uint32_t x=0;x<resolution;x++)
+            stats.covered+=depth[(size_t)y*stride+x]!=INFINITY?1:0;
+        }
+      }
+    }
+    stats.overdraw=stats.covered>0?(float)stats.shaded/stats.covered:0.0f;
+    return stats;
+  }
+};
+
+//Overlapping UV spheres of radius 0.2 with normals, on the diagonal of the
+//box from (-0.5,-0.5,0.25) to (0.5,0.5,0.75) so they fit the clip volume as
+//they are.
+//Triangles and vertices are shuffled so every stage has something to do,
+//the way meshes come out of tools that ignore ordering.
+inline IndexedMesh ShuffledSpheres(uint32_t count,uint32_t rings,uint32_t segments,uint32_t seed=1){
+  if(count==0||rings<2||segments<3)
+    throw std::runtime_error("Spheres need at least 2 rings and 3 segments");
+
+  IndexedMesh mesh;
+  float radius=0.2f;
+  for(uint32_t sphere=0;sphere<count;sphere++){
+    float along=count>1?(float)sphere/(count-1):0.5f;
+    std::array<float,3> centre={
+      -0.5f+radius+along*(1.0f-2.0f*radius),
+      -0.5f+radius+along*(1.0f-2.0f*radius),
+      0.25f+radius+along*(0.5f-2.0f*radius)
+    };
+
+    auto first=mesh.VertexCount();
+    for(uint32_t ring=0;ring<=rings;ring++){
+      float theta=(float)ring/rings*3.14159265f;
+      for(uint32_t segment=0;segment<=segments;segment++){
+        float phi=(float)segment/segments*2.0f*3.14159265f;
+        std::array<float,3> normal={std::sin(theta)*std::cos(phi),std::cos(theta),std::sin(theta)*std::sin(phi)};
+        mesh.data.positions.push_back({centre[0]+normal[0]*radius,centre[1]+normal[1]*radius,centre[2]+normal[2]*radius});
+        mesh.data.normals.push_back(normal);
+        mesh.data.texCoords.push_back({(float)segment/segments,(float)ring/rings});
+      }
+    }
+    //Counter-clockwise from outside, the poles skip their degenerate halves
+    for(uint32_t ring=0;ring<rings;ring++){
+      for(uint32_t segment=0;segment<segments;segment++){
+        uint32_t a=first+ring*(segments+1)+segment;
+        uint32_t b=a+segments+1;
+        if(ring>0)
+          mesh.indices.insert(mesh.indices.end(),{a,a+1,b});
+        if(ring+1<rings)
+          mesh.indices.insert(mesh.indices.end(),{a+1,b+1,b});
+      }
+    }
+  }
+
+  std::mt19937 random(seed);
+  auto vertexCount=mesh.VertexCount();
+  std::vector<uint32_t> order(vertexCount);
+  std::iota(order.begin(),order.end(),0u);
+  std::shuffle(order.begin(),order.end(),random);
+  MeshData shuffled;
+  shuffled.positions.resize(vertexCount);
+  shuffled.normals.resize(vertexCount);
+  shuffled.texCoords.resize(vertexCount);
+  for(uint32_t vertex=0;vertex<vertexCount;vertex++){
+    shuffled.positions[order[vertex]]=mesh.data.positions[vertex];
+    shuffled.normals[order[vertex]]=mesh.data.normals[vertex];
+    shuffled.texCoords[order[vertex]]=mesh.data.texCoords[vertex];
+  }
+  mesh.data=std::move(shuffled);
+  for(auto &index:mesh.indices)
+    index=order[index];
+
+  std::vector<std::array<uint32_t,3>> triangles(mesh.indices.size()/3);
+  memcpy(triangles.data(),mesh.indices.data(),mesh.indices.size()*sizeof(uint32_t));
+  std::shuffle(triangles.begin(),triangles.end(),random);
+  memcpy(mesh.indices.data(),triangles.data(),mesh.indices.size()*sizeof(uint32_t));
+  return mesh;
+}
+
+//Positions and faces of a Wavefront OBJ, polygons are fanned into
+//triangles. Normals and texture coordinates are indexed separately from the
+//positions in OBJ and are left out.
+inline IndexedMesh LoadObj(const std::filesystem::path &path){
+  std::ifstream file(path);
+  if(!file.is_open())
+    throw std::runtime_error(std::format("Unable to open mesh {}",path.string()));
+
+  IndexedMesh mesh;
+  std::string line;
+  std::vector<uint32_t> face;
+  while(std::getline(file,line)){
+    std::istringstream stream(line);
+    std::string keyword;
+    stream>>keyword;
+    if(keyword=="v"){
+      std::array<float,3> position;
+      if(!(stream>>position[0]>>position[1]>>position[2]))
+        throw std::runtime_error(std::format("Malformed vertex in {}",path.string()));
+      mesh.data.positions.push_back(position);
+    }else if(keyword=="f"){
+      face.clear();
+      std::string corner;
+      while(stream>>corner){
+        //v, v/vt, v//vn or v/vt/vn, negative indices count from the end
+        auto index=std::stol(corner.substr(0,corner.find('/')));
+        if(index<0)
+          index+=(long)mesh.data.positions.size()+1;
+        if(index<1||index>(long)mesh.data.positions.size())
+          throw std::runtime_error(std::format("Face index {} out of range in {}",index,path.string()));
+        face.push_back((uint32_t)index-1);
+      }
+      for(size_t corner=2;corner<face.size();corner++)
+        mesh.indices.insert(mesh.indices.end(),{face[0],face[corner-1],face[corner]});
+    }
+  }
+  if(mesh.indices.empty())
+    throw std::runtime_error(std::format("{} holds no faces",path.string()));
+  return mesh;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include<vector>
+#include<atomic>
+#include<string>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<format>
+#include<stdexcept>
+#include<unistd.h>
+#include<vulkan/vulkan.h>
+#include"DeviceDispatch.h"
+
+//A VkPipelineCache kept on disk between runs. Each device gets its own file
+//under the cache directory, named after the vendor, device and
+//pipelineCacheUUID, so caches of different GPUs and driver builds never
+//meet. A file whose header does not match the device is ignored and
+//replaced on Save().
+//
+//Without a directory the cache only lives as long as the object, which is
+//what a cold creation measurement wants.
+
+class PipelineCache{
+  VkDevice device;
+  const DeviceDispatch &dispatch;
+  VkPhysicalDeviceProperties properties;
+  std::filesystem::path path;
+  VkPipelineCache cache=nullptr;
+  size_t loadedBytes=0;
+
+  //The header every implementation writes first, VkPipelineCacheHeaderVersionOne
+  bool Matches(const std::vector<uint8_t> &data)const{
+    VkPipelineCacheHeaderVersionOne header={};
+    if(data.size()<sizeof(header))
+      return false;
+    memcpy(&header,data.data(),sizeof(header));
+    return header.headerSize>=sizeof(header)&&
+      header.headerVersion==VK_PIPELINE_CACHE_HEADER_VERSION_ONE&&
+      header.vendorID==properties.vendorID&&
+      header.deviceID==properties.deviceID&&
+      memcmp(header.pipelineCacheUUID,properties.pipelineCacheUUID,VK_UUID_SIZE)==0;
+  }
+
+  std::vector<uint8_t> Load()const{
+    std::vector<uint8_t> data;
+    if(path.empty())
+      return data;
+    std::ifstream stream(path,std::ios::binary|std::ios::ate);
+    if(!stream.is_open())
+      return data;
+    data.resize((size_t)stream.tellg());
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char *>(data.data()),data.size());
+    if(!stream.good()||!Matches(data))
+      data.clear();
+    return data;
+  }
+
+public:
+  PipelineCache(VkDevice device,const DeviceDispatch &dispatch,const VkPhysicalDeviceProperties &properties,
+    const std::filesystem::path &directory={}):
+    device(device),
+    dispatch(dispatch),
+    properties(properties){
+    if(!directory.empty()){
+      std::filesystem::create_directories(directory);
+      std::string uuid;
+      for(auto byte:properties.pipelineCacheUUID)
+        uuid+=std::format("{:02x}",byte);
+      path=directory/std::format("{:04x}_{:04x}_{}.bin",properties.vendorID,properties.deviceID,uuid);
+    }
+
+    auto data=Load();
+    loadedBytes=data.size();
+    VkPipelineCacheCreateInfo cacheInfo={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .initialDataSize=data.size(),
+      .pInitialData=data.empty()?nullptr:data.data()
+    };
+    auto result=dispatch.vkCreatePipelineCache(device,&cacheInfo,nullptr,&cache);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create pipeline cache");
+  }
+
+  PipelineCache(const PipelineCache &)=delete;
+  PipelineCache &operator=(const PipelineCache &)=delete;
+
+  ~PipelineCache(){
+    dispatch.vkDestroyPipelineCache(device,cache,nullptr);
+  }
+
+  VkPipelineCache Handle()const{
+    return cache;
+  }
+
+  //Bytes of cache data read from disk, 0 when the run started cold
+  size_t LoadedBytes()const{
+    return loadedBytes;
+  }
+
+  const std::filesystem::path &Path()const{
+    return path;
+  }
+
+  //Writes the cache under a temporary name and renames it over the old file,
+  //returns the bytes written. The name is unique to the call, devices saving
+  //to the same file from several threads or processes never share one.
+  size_t Save()const{
+    if(path.empty())
+      return 0;
+    size_t size=0;
+    if(dispatch.vkGetPipelineCacheData(device,cache,&size,nullptr)!=VK_SUCCESS||size==0)
+      return 0;
+    std::vector<uint8_t> data(size);
+    if(dispatch.vkGetPipelineCacheData(device,cache,&size,data.data())!=VK_SUCCESS)
+      return 0;
+
+    static std::atomic<uint64_t> saves=0;
+    auto temporary=path;
+    temporary+=std::format(".{}.{}.tmp",getpid(),saves.fetch_add(1,std::memory_order_relaxed));
+    std::error_code error;
+    {
+      std::ofstream stream(temporary,std::ios::binary|std::ios::trunc);
+      if(!stream.is_open())
+        throw std::runtime_error(std::format("Unable to write pipeline cache {}",temporary.string()));
+      stream.write(reinterpret_cast<const char *>(data.data()),size);
+      stream.close();
+      //A short write, e.g. on a full disk, must not replace the old file
+      if(!stream.good()){
+        std::filesystem::remove(temporary,error);
+        return 0;
+      }
+    }
+    std::filesystem::rename(temporary,path,error);
+    if(error){
+      std::filesystem::remove(temporary,error);
+      return 0;
+    }
+    return size;
+  }
+};
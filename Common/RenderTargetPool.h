@@ -0,0 +1,262 @@
+#pragma once
+#include<vector>
+#include<memory>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"ResourceTracker.h"
+#include"MemoryService.h"
+
+//Render targets are pooled by (extent, format, usage, samples) so repeated
+//offscreen passes reuse the same image and view instead of going back to VMA.
+//Layouts are owned by the ResourceTracker passed to the pool, evicted images
+//are dropped from it so a recycled handle never inherits a stale layout.
+//
+//With a MemoryService the targets are tagged as render targets, and idle
+//ones may be moved by its defragmentation: the image and view are created
+//again on the new memory, contents are not kept.
+struct RenderTargetKey{
+  VkExtent2D extent;
+  VkFormat format;
+  VkImageUsageFlags usage;
+  VkSampleCountFlagBits samples;
+
+  bool operator==(const RenderTargetKey &other)const{
+    return extent.width==other.extent.width&&extent.height==other.extent.height&&
+      format==other.format&&usage==other.usage&&samples==other.samples;
+  }
+};
+
+struct RenderTarget{
+  RenderTargetKey key;
+  VkImage image=nullptr;
+  VkImageView view=nullptr;
+  VmaAllocation allocation=nullptr;
+  VkImageAspectFlags aspect=0;
+  bool lazilyAllocated=false;
+  bool inUse=false;
+  uint64_t lastUsedFrame=0;
+  //Waiting for the defragmentation pass to end
+  VkImage movedImage=nullptr;
+  VkImageView movedView=nullptr;
+};
+
+class RenderTargetPool{
+  VkDevice device=nullptr;
+  VmaAllocator allocator=nullptr;
+  ResourceTracker &tracker;
+  MemoryService *memory=nullptr;
+  std::vector<std::unique_ptr<RenderTarget>> targets;
+  uint64_t frame=0;
+
+  static VkImageAspectFlags AspectFromFormat(VkFormat format){
+    switch(format){
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT|VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+  }
+
+  static VkImageCreateInfo ImageInfo(const RenderTargetKey &key){
+    return {
+      .sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext=nullptr,
+      .imageType=VK_IMAGE_TYPE_2D,
+      .format=key.format,
+      .extent={key.extent.width,key.extent.height,1},
+      .mipLevels=1,
+      .arrayLayers=1,
+      .samples=key.samples,
+      .tiling=VK_IMAGE_TILING_OPTIMAL,
+      .usage=key.usage,
+      .sharingMode=VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount=0,
+      .pQueueFamilyIndices=nullptr,
+      .initialLayout=VK_IMAGE_LAYOUT_UNDEFINED
+    };
+  }
+
+  VkImageView CreateView(const RenderTarget &target,VkImage image){
+    VkImageViewCreateInfo imageviewInfo={
+      .sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .image=image,
+      .viewType=VK_IMAGE_VIEW_TYPE_2D,
+      .format=target.key.format,
+      .components={
+        .r=VK_COMPONENT_SWIZZLE_IDENTITY,
+        .g=VK_COMPONENT_SWIZZLE_IDENTITY,
+        .b=VK_COMPONENT_SWIZZLE_IDENTITY,
+        .a=VK_COMPONENT_SWIZZLE_IDENTITY
+      },
+      .subresourceRange={
+        .aspectMask=target.aspect,
+        .baseMipLevel=0,
+        .levelCount=1,
+        .baseArrayLayer=0,
+        .layerCount=1
+      }
+    };
+
+    VkImageView view=nullptr;
+    if(vkCreateImageView(device,&imageviewInfo,nullptr,&view)!=VK_SUCCESS)
+      return nullptr;
+    return view;
+  }
+
+  //Defragmentation wants the allocation elsewhere, only idle targets go
+  bool MoveBegin(RenderTarget &target,VmaAllocation destination){
+    if(target.inUse)
+      return false;
+    auto imageInfo=ImageInfo(target.key);
+    if(vkCreateImage(device,&imageInfo,nullptr,&target.movedImage)!=VK_SUCCESS)
+      return false;
+    if(vmaBindImageMemory(allocator,destination,target.movedImage)==VK_SUCCESS)
+      target.movedView=CreateView(target,target.movedImage);
+    if(!target.movedView){
+      vkDestroyImage(device,target.movedImage,nullptr);
+      target.movedImage=nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  //The allocation handle now refers to the new memory, the old image and
+  //view are the only things left on the old one
+  void MoveEnd(RenderTarget &target){
+    tracker.Forget(target.image);
+    vkDestroyImageView(device,target.view,nullptr);
+    vkDestroyImage(device,target.image,nullptr);
+    target.image=target.movedImage;
+    target.view=target.movedView;
+    target.movedImage=nullptr;
+    target.movedView=nullptr;
+  }
+
+  std::unique_ptr<RenderTarget> Create(const RenderTargetKey &key){
+    auto target=std::make_unique<RenderTarget>();
+    target->key=key;
+    target->aspect=AspectFromFormat(key.format);
+
+    auto imageInfo=ImageInfo(key);
+    VmaAllocationCreateInfo imageAllocateInfo={
+      .flags=memory?memory->AllocationFlags():0,
+      .usage=VMA_MEMORY_USAGE_AUTO,
+      .requiredFlags=VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      .preferredFlags=0,
+      .memoryTypeBits=0,
+      .pool=nullptr,
+      .pUserData=nullptr,
+      .priority=0.0f
+    };
+
+    //Transient attachments never leave tile memory on hardware that supports
+    //lazily allocated memory, fall back to normal device memory everywhere else
+    VkResult result=VK_ERROR_FEATURE_NOT_PRESENT;
+    if(key.usage&VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT){
+      imageAllocateInfo.usage=VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+      imageAllocateInfo.requiredFlags=VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+      result=vmaCreateImage(allocator,&imageInfo,&imageAllocateInfo,&target->image,&target->allocation,nullptr);
+      target->lazilyAllocated=result==VK_SUCCESS;
+
+      imageAllocateInfo.usage=VMA_MEMORY_USAGE_AUTO;
+      imageAllocateInfo.requiredFlags=VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+    if(result!=VK_SUCCESS)
+      result=vmaCreateImage(allocator,&imageInfo,&imageAllocateInfo,&target->image,&target->allocation,nullptr);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create render target");
+
+    target->view=CreateView(*target,target->image);
+    if(!target->view){
+      vmaDestroyImage(allocator,target->image,target->allocation);
+      throw std::runtime_error("Failed to create render target view");
+    }
+
+    if(memory){
+      memory->Track(target->allocation,MemoryTag::RenderTarget);
+      //Lazily allocated memory has nothing worth moving
+      if(!target->lazilyAllocated){
+        auto moved=target.get();
+        memory->Movable(target->allocation,{
+          .begin=[this,moved](VmaAllocation destination){return MoveBegin(*moved,destination);},
+          .end=[this,moved](){MoveEnd(*moved);}
+        });
+      }
+    }
+    return target;
+  }
+
+  void Destroy(RenderTarget &target){
+    tracker.Forget(target.image);
+    if(memory)
+      memory->Untrack(target.allocation);
+    vkDestroyImageView(device,target.view,nullptr);
+    vmaDestroyImage(allocator,target.image,target.allocation);
+  }
+
+public:
+  RenderTargetPool(VkDevice device,VmaAllocator allocator,ResourceTracker &tracker,MemoryService *memory=nullptr):
+    device(device),allocator(allocator),tracker(tracker),memory(memory){}
+  RenderTargetPool(const RenderTargetPool &)=delete;
+  RenderTargetPool &operator=(const RenderTargetPool &)=delete;
+
+  ~RenderTargetPool(){
+    Clear();
+  }
+
+  //Destroys every pooled target, used before the allocator goes away
+  void Clear(){
+    for(auto &target:targets)
+      Destroy(*target);
+    targets.clear();
+  }
+
+  //Returns an idle target matching the key, creating one only on a miss.
+  //The returned reference stays valid until Trim() evicts the target.
+  RenderTarget &Acquire(const RenderTargetKey &key){
+    for(auto &target:targets){
+      if(!target->inUse&&target->key==key){
+        target->inUse=true;
+        target->lastUsedFrame=frame;
+        return *target;
+      }
+    }
+
+    targets.push_back(Create(key));
+    auto &target=*targets.back();
+    target.inUse=true;
+    target.lastUsedFrame=frame;
+    return target;
+  }
+
+  void Release(RenderTarget &target){
+    target.inUse=false;
+  }
+
+  //Call once per frame after the previous frame's work has completed.
+  //Targets idle for more than maxIdleFrames are destroyed.
+  void Trim(uint64_t maxIdleFrames=3){
+    frame++;
+    std::erase_if(targets,[&](std::unique_ptr<RenderTarget> &target){
+      if(target->inUse||frame-target->lastUsedFrame<=maxIdleFrames)
+        return false;
+      Destroy(*target);
+      return true;
+    });
+  }
+
+  size_t Size()const{
+    return targets.size();
+  }
+};
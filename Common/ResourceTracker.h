@@ -0,0 +1,400 @@
+#pragma once
+#include<vector>
+#include<unordered_map>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"DeviceDispatch.h"
+
+//Tracks the last access of every buffer and image used in a command stream.
+//Passes declare what they are about to touch with UseBuffer/UseImage, Flush
+//then works out the smallest set of barriers against the recorded state and
+//emits them in a single vkCmdPipelineBarrier2.
+//
+//Read after read in the same layout produces no barrier, write after read
+//only needs an execution dependency, and anything after a write gets a
+//memory dependency limited to the stages and accesses actually involved.
+//
+//Resources are assumed VK_SHARING_MODE_EXCLUSIVE. Once BeginQueue has set the
+//family being recorded, the first use claims ownership and Release hands the
+//resource to another family; its next use there records the matching acquire.
+//The submission containing the acquire must wait on the one with the release.
+//
+//Barriers are recorded through the given dispatch table, or the loader
+//exports when there is none.
+class ResourceTracker{
+public:
+  static constexpr VkAccessFlags2 WriteAccess=
+    VK_ACCESS_2_SHADER_WRITE_BIT|VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT|
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT|VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT|
+    VK_ACCESS_2_TRANSFER_WRITE_BIT|VK_ACCESS_2_HOST_WRITE_BIT|VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+private:
+  struct State{
+    VkPipelineStageFlags2 writeStage=VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 writeAccess=VK_ACCESS_2_NONE;
+    //Readers since the last write, a following write has to wait for them
+    VkPipelineStageFlags2 readStages=VK_PIPELINE_STAGE_2_NONE;
+    //Stages and accesses the last write has already been made visible to
+    VkPipelineStageFlags2 visibleStages=VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 visibleAccess=VK_ACCESS_2_NONE;
+    //Family owning the resource, IGNORED until the first use
+    uint32_t owner=VK_QUEUE_FAMILY_IGNORED;
+    //Set by a release until the owner records the acquire
+    uint32_t releasedFrom=VK_QUEUE_FAMILY_IGNORED;
+  };
+
+  struct ImageState:State{
+    VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageAspectFlags aspect=VK_IMAGE_ASPECT_COLOR_BIT;
+    //Layout before the release, the acquire has to repeat the same transition
+    VkImageLayout releasedLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  struct Use{
+    VkPipelineStageFlags2 stage=VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 access=VK_ACCESS_2_NONE;
+  };
+
+  struct ImageUse:Use{
+    VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED;
+    bool discard=false;
+  };
+
+  struct Scope{
+    VkPipelineStageFlags2 srcStage=VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 srcAccess=VK_ACCESS_2_NONE;
+    uint32_t srcFamily=VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstFamily=VK_QUEUE_FAMILY_IGNORED;
+  };
+
+  struct Release{
+    uint32_t family=VK_QUEUE_FAMILY_IGNORED;
+    VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  const DeviceDispatch *dispatch;
+  uint32_t queueFamily=VK_QUEUE_FAMILY_IGNORED;
+
+  std::unordered_map<VkBuffer,State> buffers;
+  std::unordered_map<VkImage,ImageState> images;
+
+  //Pending uses are merged per resource so one transition point produces
+  //at most one barrier per buffer or image
+  std::vector<std::pair<VkBuffer,Use>> pendingBuffers;
+  std::vector<std::pair<VkImage,ImageUse>> pendingImages;
+  std::vector<std::pair<VkBuffer,Release>> releaseBuffers;
+  std::vector<std::pair<VkImage,Release>> releaseImages;
+
+  std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+  std::vector<VkImageMemoryBarrier2> imageBarriers;
+
+  //Returns true when the use needs a barrier and fills in the source scope
+  bool Resolve(State &state,const Use &use,bool layoutChange,Scope &scope){
+    bool write=(use.access&WriteAccess)!=0;
+    bool barrier=false;
+    scope=Scope{};
+
+    if(state.releasedFrom!=VK_QUEUE_FAMILY_IGNORED){
+      if(state.owner!=queueFamily)
+        throw std::runtime_error("Resource used on a queue family it was not released to");
+
+      //The acquire only needs the destination scope, the semaphore wait
+      //orders it after the release
+      scope.srcFamily=state.releasedFrom;
+      scope.dstFamily=state.owner;
+      state.releasedFrom=VK_QUEUE_FAMILY_IGNORED;
+      state.writeStage=use.stage;
+      state.writeAccess=use.access&WriteAccess;
+      state.readStages=write?VK_PIPELINE_STAGE_2_NONE:use.stage;
+      state.visibleStages=write?VK_PIPELINE_STAGE_2_NONE:use.stage;
+      state.visibleAccess=write?VK_ACCESS_2_NONE:use.access;
+      return true;
+    }
+    if(state.owner==VK_QUEUE_FAMILY_IGNORED)
+      state.owner=queueFamily;
+
+    if(write||layoutChange){
+      //Write after write needs the memory dependency, write after read only
+      //has to wait for the readers to finish
+      scope.srcStage=state.writeStage|state.readStages;
+      scope.srcAccess=state.writeAccess;
+      barrier=layoutChange||scope.srcStage!=VK_PIPELINE_STAGE_2_NONE;
+
+      //A layout transition is visible to its destination scope, a write made
+      //by the use itself is not visible to anything yet
+      state.writeStage=use.stage;
+      state.writeAccess=use.access&WriteAccess;
+      state.readStages=write?VK_PIPELINE_STAGE_2_NONE:use.stage;
+      state.visibleStages=write?VK_PIPELINE_STAGE_2_NONE:use.stage;
+      state.visibleAccess=write?VK_ACCESS_2_NONE:use.access;
+    }else{
+      bool visible=(state.visibleStages&use.stage)==use.stage&&
+                   (state.visibleAccess&use.access)==use.access;
+      if(state.writeStage!=VK_PIPELINE_STAGE_2_NONE&&!visible){
+        scope.srcStage=state.writeStage;
+        scope.srcAccess=state.writeAccess;
+        barrier=true;
+        state.visibleStages|=use.stage;
+        state.visibleAccess|=use.access;
+      }
+      state.readStages|=use.stage;
+    }
+
+    return barrier;
+  }
+
+public:
+  explicit ResourceTracker(const DeviceDispatch *dispatch=nullptr):
+    dispatch(dispatch?dispatch:&DeviceDispatch::Exports()){}
+
+  //Registers an image whose contents are already in a known layout, e.g. one
+  //written by an earlier submission. Unknown images start out UNDEFINED.
+  void ImportImage(VkImage image,VkImageAspectFlags aspect,VkImageLayout layout){
+    auto &state=images[image];
+    state=ImageState{};
+    state.aspect=aspect;
+    state.layout=layout;
+  }
+
+  //Drops the state of a destroyed resource so a recycled handle starts clean
+  void Forget(VkBuffer buffer){
+    buffers.erase(buffer);
+  }
+
+  void Forget(VkImage image){
+    images.erase(image);
+  }
+
+  //Family the following uses are recorded for. IGNORED, the default, keeps
+  //everything on one queue and never emits ownership transfers.
+  void BeginQueue(uint32_t family){
+    queueFamily=family;
+  }
+
+  //Hands the resource to another queue family at the next Flush. Images can
+  //move to the layout of their first use on the new queue as part of the
+  //transfer, the acquire then repeats the same transition.
+  void Release(VkBuffer buffer,uint32_t family){
+    releaseBuffers.push_back({buffer,{family,VK_IMAGE_LAYOUT_UNDEFINED}});
+  }
+
+  void Release(VkImage image,uint32_t family,VkImageLayout layout){
+    releaseImages.push_back({image,{family,layout}});
+  }
+
+  //Family currently owning the resource, IGNORED if it has not been used yet
+  uint32_t Owner(VkBuffer buffer)const{
+    auto it=buffers.find(buffer);
+    return it==buffers.end()?VK_QUEUE_FAMILY_IGNORED:it->second.owner;
+  }
+
+  uint32_t Owner(VkImage image)const{
+    auto it=images.find(image);
+    return it==images.end()?VK_QUEUE_FAMILY_IGNORED:it->second.owner;
+  }
+
+  VkImageLayout Layout(VkImage image)const{
+    auto it=images.find(image);
+    return it==images.end()?VK_IMAGE_LAYOUT_UNDEFINED:it->second.layout;
+  }
+
+  void UseBuffer(VkBuffer buffer,VkPipelineStageFlags2 stage,VkAccessFlags2 access){
+    for(auto &[pendingBuffer,use]:pendingBuffers){
+      if(pendingBuffer==buffer){
+        use.stage|=stage;
+        use.access|=access;
+        return;
+      }
+    }
+    pendingBuffers.push_back({buffer,{stage,access}});
+  }
+
+  //The buffer takes over memory previous used before. Its next use waits
+  //for the last uses of previous as if both were the same resource.
+  void Alias(VkBuffer previous,VkBuffer buffer){
+    auto it=buffers.find(previous);
+    if(it==buffers.end())
+      return;
+    auto &state=buffers[buffer];
+    state.writeStage|=it->second.writeStage;
+    state.writeAccess|=it->second.writeAccess;
+    state.readStages|=it->second.readStages;
+    state.visibleStages=VK_PIPELINE_STAGE_2_NONE;
+    state.visibleAccess=VK_ACCESS_2_NONE;
+  }
+
+  //discard lets the transition start from UNDEFINED when the old contents
+  //are about to be overwritten anyway, e.g. attachments using LOAD_OP_CLEAR
+  void UseImage(VkImage image,VkImageAspectFlags aspect,VkImageLayout layout,
+    VkPipelineStageFlags2 stage,VkAccessFlags2 access,bool discard=false){
+
+    for(auto &[pendingImage,use]:pendingImages){
+      if(pendingImage==image){
+        if(use.layout!=layout)
+          throw std::runtime_error("Image used in two layouts at one transition point");
+        use.stage|=stage;
+        use.access|=access;
+        use.discard=use.discard&&discard;
+        return;
+      }
+    }
+
+    auto &state=images[image];
+    state.aspect=aspect;
+
+    ImageUse use;
+    use.stage=stage;
+    use.access=access;
+    use.layout=layout;
+    use.discard=discard;
+    pendingImages.push_back({image,use});
+  }
+
+  //Resolves every pending use against the recorded state and emits the
+  //needed barriers as one vkCmdPipelineBarrier2. Does nothing if no hazard exists.
+  void Flush(VkCommandBuffer CMDBuffer){
+    bufferBarriers.clear();
+    imageBarriers.clear();
+
+    for(auto &[buffer,use]:pendingBuffers){
+      Scope scope;
+      if(!Resolve(buffers[buffer],use,false,scope))
+        continue;
+
+      bufferBarriers.push_back({
+        .sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext=nullptr,
+        .srcStageMask=scope.srcStage,
+        .srcAccessMask=scope.srcAccess,
+        .dstStageMask=use.stage,
+        .dstAccessMask=use.access,
+        .srcQueueFamilyIndex=scope.srcFamily,
+        .dstQueueFamilyIndex=scope.dstFamily,
+        .buffer=buffer,
+        .offset=0,
+        .size=VK_WHOLE_SIZE
+      });
+    }
+
+    for(auto &[image,use]:pendingImages){
+      auto &state=images[image];
+      VkImageLayout oldLayout=use.discard?VK_IMAGE_LAYOUT_UNDEFINED:state.layout;
+      bool layoutChange=use.discard||state.layout!=use.layout;
+
+      if(state.releasedFrom!=VK_QUEUE_FAMILY_IGNORED){
+        if(state.layout!=use.layout)
+          throw std::runtime_error("Image acquired in a different layout than it was released in");
+        oldLayout=state.releasedLayout;
+      }
+
+      Scope scope;
+      if(!Resolve(state,use,layoutChange,scope))
+        continue;
+      state.layout=use.layout;
+
+      imageBarriers.push_back({
+        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext=nullptr,
+        .srcStageMask=scope.srcStage,
+        .srcAccessMask=scope.srcAccess,
+        .dstStageMask=use.stage,
+        .dstAccessMask=use.access,
+        .oldLayout=oldLayout,
+        .newLayout=use.layout,
+        .srcQueueFamilyIndex=scope.srcFamily,
+        .dstQueueFamilyIndex=scope.dstFamily,
+        .image=image,
+        .subresourceRange={
+          .aspectMask=state.aspect,
+          .baseMipLevel=0,
+          .levelCount=VK_REMAINING_MIP_LEVELS,
+          .baseArrayLayer=0,
+          .layerCount=VK_REMAINING_ARRAY_LAYERS
+        }
+      });
+    }
+
+    //Releases only need the source scope, the acquire on the other queue
+    //provides the destination. Resources never used yet have nothing to hand over.
+    for(auto &[buffer,release]:releaseBuffers){
+      auto &state=buffers[buffer];
+      if(state.owner==VK_QUEUE_FAMILY_IGNORED||state.owner==release.family)
+        continue;
+
+      bufferBarriers.push_back({
+        .sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext=nullptr,
+        .srcStageMask=state.writeStage|state.readStages,
+        .srcAccessMask=state.writeAccess,
+        .dstStageMask=VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask=VK_ACCESS_2_NONE,
+        .srcQueueFamilyIndex=state.owner,
+        .dstQueueFamilyIndex=release.family,
+        .buffer=buffer,
+        .offset=0,
+        .size=VK_WHOLE_SIZE
+      });
+
+      uint32_t owner=state.owner;
+      state=State{};
+      state.owner=release.family;
+      state.releasedFrom=owner;
+    }
+
+    for(auto &[image,release]:releaseImages){
+      auto &state=images[image];
+      if(state.owner==VK_QUEUE_FAMILY_IGNORED||state.owner==release.family)
+        continue;
+
+      imageBarriers.push_back({
+        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext=nullptr,
+        .srcStageMask=state.writeStage|state.readStages,
+        .srcAccessMask=state.writeAccess,
+        .dstStageMask=VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask=VK_ACCESS_2_NONE,
+        .oldLayout=state.layout,
+        .newLayout=release.layout,
+        .srcQueueFamilyIndex=state.owner,
+        .dstQueueFamilyIndex=release.family,
+        .image=image,
+        .subresourceRange={
+          .aspectMask=state.aspect,
+          .baseMipLevel=0,
+          .levelCount=VK_REMAINING_MIP_LEVELS,
+          .baseArrayLayer=0,
+          .layerCount=VK_REMAINING_ARRAY_LAYERS
+        }
+      });
+
+      ImageState released;
+      released.aspect=state.aspect;
+      released.layout=release.layout;
+      released.releasedLayout=state.layout;
+      released.owner=release.family;
+      released.releasedFrom=state.owner;
+      state=released;
+    }
+
+    pendingBuffers.clear();
+    pendingImages.clear();
+    releaseBuffers.clear();
+    releaseImages.clear();
+
+    if(bufferBarriers.empty()&&imageBarriers.empty())
+      return;
+
+    VkDependencyInfo dependencyInfo={
+      .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext=nullptr,
+      .dependencyFlags=0,
+      .memoryBarrierCount=0,
+      .pMemoryBarriers=nullptr,
+      .bufferMemoryBarrierCount=(uint32_t)bufferBarriers.size(),
+      .pBufferMemoryBarriers=bufferBarriers.data(),
+      .imageMemoryBarrierCount=(uint32_t)imageBarriers.size(),
+      .pImageMemoryBarriers=imageBarriers.data()
+    };
+    dispatch->vkCmdPipelineBarrier2(CMDBuffer,&dependencyInfo);
+  }
+};
@@ -0,0 +1,1769 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<string>
+#include<memory>
+#include<chrono>
+#include<functional>
+#include<cmath>
+#include<cstring>
+#include<algorithm>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"HeadlessDevice.h"
+#include"DescriptorLayout.h"
+#include"FrameGraph.h"
+#include"RenderTargetPool.h"
+#include"TracedCommands.h"
+#include"VertexPacking.h"
+#include"MeshOptimiser.h"
+#include"BindlessHeap.h"
+#include"UniformRing.h"
+#include"Instancing.h"
+#include"GpuTasks.h"
+#include"GraphicsPipelines.h"
+
+//The three repro scenarios as reusable objects for the headless tools. Each
+//one is set up in its constructor and runs one frame per Iterate(). Variants
+//select between valid usage and the misuse the original repro relies on, so
+//the benchmark can time the valid paths and the crash runner can sweep the
+//broken ones.
+//
+//Setup goes through the HeadlessDevice helpers and commands through
+//TracedCommands, so a scenario run with a trace set on the context is
+//captured whole.
+
+using Clock=std::chrono::steady_clock;
+
+inline double Milliseconds(Clock::time_point begin,Clock::time_point end){
+  return std::chrono::duration<double,std::milli>(end-begin).count();
+}
+
+//Timings of one iteration. cpuMs covers the host work up to the last
+//submission, totalMs runs until the device has finished the work.
+struct Sample{
+  double cpuMs;
+  double totalMs;
+};
+
+class Scenario{
+public:
+  virtual ~Scenario()=default;
+  virtual Sample Iterate()=0;
+};
+
+struct ComputeVariant{
+  //Added to the input buffer's address when its descriptor is written,
+  //DescriptorBuffer.cpp triggers the fault with 32MiB
+  VkDeviceSize addressOffset=0;
+  //Dispatch without any descriptor buffer bound
+  bool bindDescriptorBuffer=true;
+};
+
+struct DrawVariant{
+  //VertexBinding.cpp draws without vkCmdBindVertexBuffers2
+  bool bindVertexBuffer=true;
+  //Overlapping spheres through an index buffer run through MeshOptimiser
+  //instead of the triangle
+  bool indexed=false;
+};
+
+struct ShaderVariant{
+  //LinkShaderLayout.cpp hands each stage its own, disagreeing set layouts
+  bool matchingLayouts=true;
+  bool link=true;
+};
+
+//DescriptorBuffer: one dispatch reading and writing storage buffers bound
+//through a descriptor buffer, built as a frame graph every iteration
+class ComputeScenario:public Scenario{
+  //The input and output buffers of comp.glsl
+  using ComputeSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>>;
+
+  HeadlessDevice &context;
+  ComputeVariant variant;
+  DescriptorLayout<ComputeSet> setLayout;
+  VkPipelineLayout pipelineLayout=nullptr;
+  VkShaderEXT shader=nullptr;
+
+  VkBuffer descriptorBuffer=nullptr;
+  VmaAllocation descriptorAllocation=nullptr;
+  VkBuffer inputBuffer=nullptr;
+  VmaAllocation inputAllocation=nullptr;
+  VkBuffer outputBuffer=nullptr;
+  VmaAllocation outputAllocation=nullptr;
+  VkDeviceAddress descriptorBufferAddress=0;
+
+  ResourceTracker tracker{&context.dispatch};
+  FrameGraph frameGraph;
+
+public:
+  ComputeScenario(HeadlessDevice &context,const ComputeVariant &variant={}):
+    context(context),variant(variant),setLayout(context),frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto setLayoutHandle=setLayout.Handle();
+    pipelineLayout=context.CreatePipelineLayout({setLayoutHandle});
+
+    auto computeShaderCode=context.Shader("comp.spv");
+    ComputeSet::Check(computeShaderCode,0);
+    VkShaderCreateInfoEXT shaderCreateInfo={
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_COMPUTE_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=computeShaderCode.size()*sizeof(uint32_t),
+      .pCode=computeShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayoutHandle,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    };
+    auto result=context.CreateShaders(1,&shaderCreateInfo,&shader);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    VmaAllocationInfo descriptorInfo={},inputInfo={},outputInfo={};
+    descriptorBuffer=context.CreateBuffer(std::max<VkDeviceSize>(setLayout.Size(),256),
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,descriptorAllocation,descriptorInfo);
+    inputBuffer=context.CreateBuffer(2048,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,inputAllocation,inputInfo);
+    outputBuffer=context.CreateBuffer(4096,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,outputAllocation,outputInfo);
+    descriptorBufferAddress=context.BufferAddress(descriptorBuffer);
+
+    auto writer=setLayout.Writer(descriptorBuffer,descriptorInfo);
+    writer.Buffer<0>(context.BufferAddress(inputBuffer)+variant.addressOffset,2048);
+    writer.Buffer<1>(context.BufferAddress(outputBuffer),4096);
+
+    auto input=reinterpret_cast<float *>(inputInfo.pMappedData);
+    input[0]=2.5f;
+    input[1]=3.5f;
+    input[2]=4.5f;
+    input[3]=5.5f;
+
+    frameGraph.Trace(context.trace);
+  }
+
+  ~ComputeScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    context.DestroyBuffer(descriptorBuffer,descriptorAllocation);
+    context.DestroyBuffer(inputBuffer,inputAllocation);
+    context.DestroyBuffer(outputBuffer,outputAllocation);
+    context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    frameGraph.Reset();
+    auto inputResource=frameGraph.ImportBuffer("Input",inputBuffer);
+    auto outputResource=frameGraph.ImportBuffer("Output",outputBuffer);
+
+    frameGraph.AddPass("Dispatch",QueueType::Compute,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Read(inputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+        pass.Write(outputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+        commands.BindShaders(1,&stageFlags,&shader);
+
+        if(variant.bindDescriptorBuffer){
+          VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+            .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+            .pNext=nullptr,
+            .address=descriptorBufferAddress,
+            .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+          };
+          commands.BindDescriptorBuffers(1,&bufferBindingInfo);
+
+          uint32_t bufferIndice=0;
+          VkDeviceSize bufferOffset=0;
+          commands.SetDescriptorBufferOffsets(VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
+        }
+        commands.Dispatch(1,1,1);
+      });
+    frameGraph.Export(outputResource,VK_PIPELINE_STAGE_2_HOST_BIT,VK_ACCESS_2_HOST_READ_BIT);
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+//VertexBinding: a triangle drawn with shader objects and dynamic state into
+//a pooled render target, or an optimised indexed mesh with the same setup
+class DrawScenario:public Scenario{
+  static constexpr uint32_t Size=512;
+
+  HeadlessDevice &context;
+  DrawVariant variant;
+  std::array<VkShaderEXT,2> shaders={};
+  VkBuffer vertexBuffer=nullptr;
+  VmaAllocation vertexAllocation=nullptr;
+  VkBuffer indexBuffer=nullptr;
+  VmaAllocation indexAllocation=nullptr;
+  PackedMesh mesh;
+  uint32_t indexCount=0;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  RenderTarget &framebuffer;
+  FrameGraph frameGraph;
+
+public:
+  DrawScenario(HeadlessDevice &context,const DrawVariant &variant={}):
+    context(context),
+    variant(variant),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    framebuffer(renderTargets.Acquire({
+      .extent={Size,Size},
+      .format=VK_FORMAT_R8G8B8A8_UNORM,
+      .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .samples=VK_SAMPLE_COUNT_1_BIT
+    })),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto vertShaderCode=context.Shader("VertexBindingVert.spv");
+    auto fragShaderCode=context.Shader("VertexBindingFrag.spv");
+
+    std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+      .pCode=vertShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=0,
+      .pSetLayouts=nullptr,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    },{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+      .pCode=fragShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=0,
+      .pSetLayouts=nullptr,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    }}};
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    //Full precision floats, the format VertexBinding.cpp uses
+    if(variant.indexed){
+      auto spheres=ShuffledSpheres(4,12,24);
+      MeshOptimiser::Optimise(spheres);
+      spheres.data.normals.clear();
+      spheres.data.texCoords.clear();
+      mesh=VertexPacker::Pack(spheres.data,{});
+
+      indexCount=(uint32_t)spheres.indices.size();
+      VmaAllocationInfo indexInfo={};
+      indexBuffer=context.CreateBuffer(indexCount*sizeof(uint32_t),VK_BUFFER_USAGE_INDEX_BUFFER_BIT,indexAllocation,indexInfo);
+      memcpy(indexInfo.pMappedData,spheres.indices.data(),indexCount*sizeof(uint32_t));
+    }else{
+      mesh=VertexPacker::Pack({
+        .positions={{0.0f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+        .normals={},
+        .texCoords={}
+      },{});
+    }
+
+    VmaAllocationInfo vertexInfo={};
+    vertexBuffer=context.CreateBuffer(std::max<VkDeviceSize>(mesh.Bytes(),1024),VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      vertexAllocation,vertexInfo);
+    size_t vertexOffset=0;
+    for(auto &stream:mesh.streams){
+      memcpy(static_cast<uint8_t *>(vertexInfo.pMappedData)+vertexOffset,stream.data(),stream.size());
+      vertexOffset+=stream.size();
+    }
+
+    if(context.trace)
+      context.trace->Image(framebuffer);
+    frameGraph.Trace(context.trace);
+  }
+
+  ~DrawScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    renderTargets.Release(framebuffer);
+    renderTargets.Clear();
+    context.DestroyBuffer(vertexBuffer,vertexAllocation);
+    if(indexBuffer)
+      context.DestroyBuffer(indexBuffer,indexAllocation);
+    for(auto shader:shaders){
+      if(shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    }
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkRenderingAttachmentInfo attachmentInfo{
+          .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext=nullptr,
+          .imageView=framebuffer.view,
+          .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode=VK_RESOLVE_MODE_NONE,
+          .resolveImageView=VK_NULL_HANDLE,
+          .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue={.color={0.0,0.0,0.0,0.0}}
+        };
+        VkRenderingInfo renderingInfo={
+          .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext=nullptr,
+          .flags=0,
+          .renderArea={
+            .offset={0,0},
+            .extent={Size,Size}
+          },
+          .layerCount=1,
+          .viewMask=0,
+          .colorAttachmentCount=1,
+          .pColorAttachments=&attachmentInfo,
+          .pDepthAttachment=nullptr,
+          .pStencilAttachment=nullptr
+        };
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        //Every state shader objects leave dynamic has to be set before drawing
+        commands.BeginRendering(renderingInfo);
+        commands.SetViewport(1,&viewPort);
+        commands.SetScissor(1,&scissor);
+        commands.SetRasterizerDiscardEnable(VK_FALSE);
+        commands.SetCullMode(VK_CULL_MODE_NONE);
+        commands.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        commands.SetDepthTestEnable(VK_FALSE);
+        commands.SetDepthWriteEnable(VK_FALSE);
+        commands.SetDepthBiasEnable(VK_FALSE);
+        commands.SetDepthBoundsTestEnable(VK_FALSE);
+        commands.SetStencilTestEnable(VK_FALSE);
+        commands.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        commands.SetPrimitiveRestartEnable(VK_FALSE);
+        commands.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+        VkSampleMask sampleMask=~0u;
+        commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+        commands.SetAlphaToCoverageEnable(VK_FALSE);
+        VkBool32 blendEnable=VK_FALSE;
+        commands.SetColorBlendEnable(0,1,&blendEnable);
+        VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+          VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+        commands.SetColorWriteMask(0,1,&writeMask);
+
+        std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+        commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+
+        commands.SetVertexInput((uint32_t)mesh.bindings.size(),mesh.bindings.data(),
+          (uint32_t)mesh.attributes.size(),mesh.attributes.data());
+
+        std::vector<VkDeviceSize> offsets,sizes,strides;
+        mesh.BindRanges(0,offsets,sizes,strides);
+        if(variant.bindVertexBuffer){
+          std::vector<VkBuffer> buffers(offsets.size(),vertexBuffer);
+          commands.BindVertexBuffers(0,(uint32_t)buffers.size(),buffers.data(),offsets.data(),sizes.data(),strides.data());
+        }
+
+        if(variant.indexed){
+          commands.BindIndexBuffer(indexBuffer,0,indexCount*sizeof(uint32_t),VK_INDEX_TYPE_UINT32);
+          commands.DrawIndexed(indexCount,1,0,0,0);
+        }else{
+          commands.Draw(mesh.vertexCount,1,0,0);
+        }
+        commands.EndRendering();
+      });
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+//LinkedShaderLayout: creating and destroying the vertex and fragment shader
+//objects. With matching layouts both stages get the same three set layouts,
+//the union of what the two shaders declare.
+class ShaderScenario:public Scenario{
+  HeadlessDevice &context;
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  std::vector<VkDescriptorSetLayout> vertexLayouts;
+  std::vector<VkDescriptorSetLayout> fragmentLayouts;
+  std::vector<uint32_t> vertexShaderCode;
+  std::vector<uint32_t> fragmentShaderCode;
+  std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={};
+
+public:
+  ShaderScenario(HeadlessDevice &context,const ShaderVariant &variant={}):context(context){
+    VkDescriptorSetLayoutBinding bindingUniform={
+      .binding=0,
+      .descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount=1,
+      .stageFlags=VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers=nullptr
+    };
+    VkDescriptorSetLayoutBinding bindingTexture={
+      .binding=1,
+      .descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount=1,
+      .stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers=nullptr
+    };
+    if(variant.matchingLayouts){
+      setLayouts={
+        context.CreateSetLayout({bindingUniform}),
+        context.CreateSetLayout({bindingUniform}),
+        context.CreateSetLayout({bindingTexture})};
+      vertexLayouts=setLayouts;
+      fragmentLayouts=setLayouts;
+    }else{
+      //Same layouts as LinkShaderLayout.cpp
+      auto bindingStage=[&](VkShaderStageFlags stages){
+        auto binding=bindingUniform;
+        binding.stageFlags=stages;
+        return binding;
+      };
+      auto sharedLayout=context.CreateSetLayout({bindingUniform});
+      auto vertexLayout=context.CreateSetLayout({bindingStage(VK_SHADER_STAGE_VERTEX_BIT)});
+      auto fragmentLayout=context.CreateSetLayout({bindingStage(VK_SHADER_STAGE_FRAGMENT_BIT),bindingTexture});
+      setLayouts={sharedLayout,vertexLayout,fragmentLayout};
+      vertexLayouts={vertexLayout,sharedLayout};
+      fragmentLayouts={fragmentLayout,sharedLayout};
+    }
+
+    vertexShaderCode=context.Shader("LinkedShaderLayoutVert.spv");
+    fragmentShaderCode=context.Shader("LinkedShaderLayoutFrag.spv");
+
+    shaderCreateInfos[0]={
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=variant.link?(VkShaderCreateFlagsEXT)VK_SHADER_CREATE_LINK_STAGE_BIT_EXT:0u,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=vertexShaderCode.size()*sizeof(uint32_t),
+      .pCode=vertexShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=(uint32_t)vertexLayouts.size(),
+      .pSetLayouts=vertexLayouts.data(),
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    };
+    shaderCreateInfos[1]=shaderCreateInfos[0];
+    shaderCreateInfos[1].stage=VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderCreateInfos[1].nextStage=0;
+    shaderCreateInfos[1].codeSize=fragmentShaderCode.size()*sizeof(uint32_t);
+    shaderCreateInfos[1].pCode=fragmentShaderCode.data();
+    shaderCreateInfos[1].setLayoutCount=(uint32_t)fragmentLayouts.size();
+    shaderCreateInfos[1].pSetLayouts=fragmentLayouts.data();
+  }
+
+  ~ShaderScenario(){
+    for(auto layout:setLayouts)
+      context.dispatch.vkDestroyDescriptorSetLayout(context.device,layout,nullptr);
+  }
+
+  Sample Iterate()override{
+    std::array<VkShaderEXT,2> shaders={};
+
+    auto begin=Clock::now();
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    auto created=Clock::now();
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    for(auto shader:shaders)
+      context.DestroyShader(shader);
+    auto destroyed=Clock::now();
+
+    return {Milliseconds(begin,created),Milliseconds(begin,destroyed)};
+  }
+};
+
+//LinkShaderLayout.cpp's textured material drawn bindless: every texture,
+//sampler and material buffer lives in one BindlessHeap, bound once, and each
+//draw only pushes the indices of its material. The textures are cleared to
+//their colour every frame, a stand-in for uploads.
+class BindlessScenario:public Scenario{
+  static constexpr uint32_t Size=256;
+  static constexpr uint32_t TextureSize=16;
+  //A 4x4 grid of quads, one material each
+  static constexpr uint32_t MaterialCount=16;
+  //Apart by minStorageBufferOffsetAlignment on every implementation
+  static constexpr VkDeviceSize MaterialStride=256;
+
+  //Matches the push constant block of the Bindless shaders
+  struct Material{
+    std::array<float,2> offset;
+    uint32_t textureIndex;
+    uint32_t samplerIndex;
+    uint32_t bufferIndex;
+  };
+
+  HeadlessDevice &context;
+  BindlessHeap heap;
+  std::array<VkShaderEXT,2> shaders={};
+  std::array<VkSampler,2> samplers={};
+  VkBuffer vertexBuffer=nullptr;
+  VmaAllocation vertexAllocation=nullptr;
+  VkBuffer materialBuffer=nullptr;
+  VmaAllocation materialAllocation=nullptr;
+  PackedMesh mesh;
+  std::vector<Material> materials;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  RenderTarget &framebuffer;
+  std::vector<RenderTarget *> textures;
+  FrameGraph frameGraph;
+
+public:
+  BindlessScenario(HeadlessDevice &context):
+    context(context),
+    heap(context,sizeof(Material)),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    framebuffer(renderTargets.Acquire({
+      .extent={Size,Size},
+      .format=VK_FORMAT_R8G8B8A8_UNORM,
+      .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .samples=VK_SAMPLE_COUNT_1_BIT
+    })),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto vertShaderCode=context.Shader("BindlessVert.spv");
+    auto fragShaderCode=context.Shader("BindlessFrag.spv");
+
+    auto setLayout=heap.SetLayout();
+    std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+      .pCode=vertShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=1,
+      .pPushConstantRanges=&heap.PushConstants(),
+      .pSpecializationInfo=nullptr
+    },{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+      .pCode=fragShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=1,
+      .pPushConstantRanges=&heap.PushConstants(),
+      .pSpecializationInfo=nullptr
+    }}};
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    mesh=VertexPacker::Pack({
+      .positions={{-0.5f,-0.5f,0.0f},{0.5f,-0.5f,0.0f},{0.5f,0.5f,0.0f},
+        {-0.5f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+      .normals={},
+      .texCoords={}
+    },{});
+    VmaAllocationInfo vertexInfo={};
+    vertexBuffer=context.CreateBuffer(std::max<VkDeviceSize>(mesh.Bytes(),1024),VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      vertexAllocation,vertexInfo);
+    memcpy(vertexInfo.pMappedData,mesh.streams[0].data(),mesh.streams[0].size());
+
+    VmaAllocationInfo materialInfo={};
+    materialBuffer=context.CreateBuffer(MaterialCount*MaterialStride,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      materialAllocation,materialInfo);
+    auto materialAddress=context.BufferAddress(materialBuffer);
+
+    for(uint32_t filter=0;filter<samplers.size();filter++){
+      samplers[filter]=context.CreateSampler({
+        .sType=VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext=nullptr,
+        .flags=0,
+        .magFilter=filter?VK_FILTER_LINEAR:VK_FILTER_NEAREST,
+        .minFilter=filter?VK_FILTER_LINEAR:VK_FILTER_NEAREST,
+        .mipmapMode=VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias=0.0f,
+        .anisotropyEnable=VK_FALSE,
+        .maxAnisotropy=1.0f,
+        .compareEnable=VK_FALSE,
+        .compareOp=VK_COMPARE_OP_ALWAYS,
+        .minLod=0.0f,
+        .maxLod=0.0f,
+        .borderColor=VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates=VK_FALSE
+      });
+    }
+
+    if(context.trace)
+      context.trace->Image(framebuffer);
+    std::array<uint32_t,2> samplerIndices={heap.AddSampler(samplers[0]),heap.AddSampler(samplers[1])};
+    for(uint32_t index=0;index<MaterialCount;index++){
+      auto &texture=renderTargets.Acquire({
+        .extent={TextureSize,TextureSize},
+        .format=VK_FORMAT_R8G8B8A8_UNORM,
+        .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT|VK_IMAGE_USAGE_SAMPLED_BIT,
+        .samples=VK_SAMPLE_COUNT_1_BIT
+      });
+      textures.push_back(&texture);
+      if(context.trace)
+        context.trace->Image(texture);
+
+      auto tint=reinterpret_cast<float *>(static_cast<uint8_t *>(materialInfo.pMappedData)+index*MaterialStride);
+      tint[0]=tint[1]=tint[2]=0.5f+0.5f*(float)index/MaterialCount;
+      tint[3]=1.0f;
+
+      materials.push_back({
+        .offset={-0.75f+0.5f*(index%4),-0.75f+0.5f*(index/4)},
+        .textureIndex=heap.AddImage(texture.view),
+        .samplerIndex=samplerIndices[index%2],
+        .bufferIndex=heap.AddBuffer(materialAddress+index*MaterialStride,16)
+      });
+    }
+    frameGraph.Trace(context.trace);
+  }
+
+  ~BindlessScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    renderTargets.Release(framebuffer);
+    for(auto texture:textures)
+      renderTargets.Release(*texture);
+    renderTargets.Clear();
+    context.DestroyBuffer(vertexBuffer,vertexAllocation);
+    context.DestroyBuffer(materialBuffer,materialAllocation);
+    for(auto sampler:samplers)
+      context.dispatch.vkDestroySampler(context.device,sampler,nullptr);
+    for(auto shader:shaders){
+      if(shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    }
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+    std::vector<FrameGraphResource> textureResources;
+    for(auto texture:textures)
+      textureResources.push_back(frameGraph.ImportImage("Texture",texture->image,texture->aspect));
+
+    VkRenderingAttachmentInfo attachmentInfo{
+      .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+      .pNext=nullptr,
+      .imageView=VK_NULL_HANDLE,
+      .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      .resolveMode=VK_RESOLVE_MODE_NONE,
+      .resolveImageView=VK_NULL_HANDLE,
+      .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+      .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+      .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+      .clearValue={.color={0.0,0.0,0.0,0.0}}
+    };
+    VkRenderingInfo renderingInfo={
+      .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .renderArea={
+        .offset={0,0},
+        .extent={TextureSize,TextureSize}
+      },
+      .layerCount=1,
+      .viewMask=0,
+      .colorAttachmentCount=1,
+      .pColorAttachments=&attachmentInfo,
+      .pDepthAttachment=nullptr,
+      .pStencilAttachment=nullptr
+    };
+
+    frameGraph.AddPass("Textures",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        for(auto resource:textureResources){
+          pass.Image(resource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+        }
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        for(uint32_t index=0;index<MaterialCount;index++){
+          attachmentInfo.imageView=textures[index]->view;
+          attachmentInfo.clearValue.color={{(float)(index&1),(float)((index>>1)&1),(float)((index>>2)&1),1.0f}};
+          commands.BeginRendering(renderingInfo);
+          commands.EndRendering();
+        }
+      });
+
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+        for(auto resource:textureResources){
+          pass.Image(resource,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        }
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        attachmentInfo.imageView=framebuffer.view;
+        attachmentInfo.clearValue.color={{0.0f,0.0f,0.0f,0.0f}};
+        renderingInfo.renderArea.extent={Size,Size};
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        commands.BeginRendering(renderingInfo);
+        commands.SetViewport(1,&viewPort);
+        commands.SetScissor(1,&scissor);
+        commands.SetRasterizerDiscardEnable(VK_FALSE);
+        commands.SetCullMode(VK_CULL_MODE_NONE);
+        commands.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        commands.SetDepthTestEnable(VK_FALSE);
+        commands.SetDepthWriteEnable(VK_FALSE);
+        commands.SetDepthBiasEnable(VK_FALSE);
+        commands.SetDepthBoundsTestEnable(VK_FALSE);
+        commands.SetStencilTestEnable(VK_FALSE);
+        commands.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        commands.SetPrimitiveRestartEnable(VK_FALSE);
+        commands.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+        VkSampleMask sampleMask=~0u;
+        commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+        commands.SetAlphaToCoverageEnable(VK_FALSE);
+        VkBool32 blendEnable=VK_FALSE;
+        commands.SetColorBlendEnable(0,1,&blendEnable);
+        VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+          VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+        commands.SetColorWriteMask(0,1,&writeMask);
+
+        std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+        commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+        commands.SetVertexInput((uint32_t)mesh.bindings.size(),mesh.bindings.data(),
+          (uint32_t)mesh.attributes.size(),mesh.attributes.data());
+        std::vector<VkDeviceSize> offsets,sizes,strides;
+        mesh.BindRanges(0,offsets,sizes,strides);
+        commands.BindVertexBuffers(0,1,&vertexBuffer,offsets.data(),sizes.data(),strides.data());
+
+        //The only descriptor state of the pass, materials below just push
+        heap.Bind(commands,VK_PIPELINE_BIND_POINT_GRAPHICS);
+        for(auto &material:materials){
+          commands.PushConstants(heap.PipelineLayout(),heap.PushConstants().stageFlags,0,sizeof(Material),&material);
+          commands.Draw(mesh.vertexCount,1,0,0);
+        }
+        commands.EndRendering();
+      });
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+struct UniformVariant{
+  uint32_t objects;
+};
+
+//Per object SceneData, the uniform block of LinkedShaderLayoutVert.glsl, for
+//a grid of small triangles. Every frame writes each object's matrices to a
+//fresh UniformRing slot and draws it with set 0 pointed at that slot.
+class UniformScenario:public Scenario{
+  static constexpr uint32_t Size=256;
+
+  struct SceneData{
+    UniformMatrix model;
+    UniformMatrix view;
+    UniformMatrix projection;
+  };
+
+  HeadlessDevice &context;
+  UniformVariant variant;
+  UniformRing ring;
+  std::array<VkShaderEXT,2> shaders={};
+  VkBuffer vertexBuffer=nullptr;
+  VmaAllocation vertexAllocation=nullptr;
+  PackedMesh mesh;
+  //Reused every frame, no allocation per draw
+  std::vector<UniformSlice> slices;
+  uint32_t frame=0;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  RenderTarget &framebuffer;
+  FrameGraph frameGraph;
+
+public:
+  UniformScenario(HeadlessDevice &context,UniformVariant variant):
+    context(context),
+    variant(variant),
+    ring(context,sizeof(SceneData),variant.objects),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    framebuffer(renderTargets.Acquire({
+      .extent={Size,Size},
+      .format=VK_FORMAT_R8G8B8A8_UNORM,
+      .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .samples=VK_SAMPLE_COUNT_1_BIT
+    })),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto vertShaderCode=context.Shader("UniformRingVert.spv");
+    auto fragShaderCode=context.Shader("VertexBindingFrag.spv");
+
+    auto setLayout=ring.SetLayout();
+    std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+      .pCode=vertShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    },{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+      .pCode=fragShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    }}};
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    mesh=VertexPacker::Pack({
+      .positions={{0.0f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+      .normals={},
+      .texCoords={}
+    },{});
+    VmaAllocationInfo vertexInfo={};
+    vertexBuffer=context.CreateBuffer(std::max<VkDeviceSize>(mesh.Bytes(),1024),VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      vertexAllocation,vertexInfo);
+    memcpy(vertexInfo.pMappedData,mesh.streams[0].data(),mesh.streams[0].size());
+
+    slices.resize(variant.objects);
+    if(context.trace)
+      context.trace->Image(framebuffer);
+    frameGraph.Trace(context.trace);
+  }
+
+  ~UniformScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    renderTargets.Release(framebuffer);
+    renderTargets.Clear();
+    context.DestroyBuffer(vertexBuffer,vertexAllocation);
+    for(auto shader:shaders){
+      if(shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    }
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    //The previous frame was waited for, the ring only needs two
+    ring.BeginFrame();
+    auto side=(uint32_t)std::ceil(std::sqrt((double)variant.objects));
+    auto cell=2.0f/side;
+    auto angle=0.05f*frame++;
+    std::array<UniformMatrix,3> matrices={UniformMatrix::Identity(),UniformMatrix::Identity(),UniformMatrix::Identity()};
+    for(uint32_t object=0;object<variant.objects;object++){
+      matrices[0]=UniformMatrix::Translation(-1.0f+cell*(object%side+0.5f),-1.0f+cell*(object/side+0.5f),0.0f)*
+        UniformMatrix::ScaleRotation(cell*0.8f,angle+0.01f*object);
+      slices[object]=ring.Allocate();
+      UniformRing::StoreMatrices(slices[object].data,matrices.data(),matrices.size());
+    }
+    ring.Flush();
+
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkRenderingAttachmentInfo attachmentInfo{
+          .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext=nullptr,
+          .imageView=framebuffer.view,
+          .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode=VK_RESOLVE_MODE_NONE,
+          .resolveImageView=VK_NULL_HANDLE,
+          .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue={.color={0.0,0.0,0.0,0.0}}
+        };
+        VkRenderingInfo renderingInfo={
+          .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext=nullptr,
+          .flags=0,
+          .renderArea={
+            .offset={0,0},
+            .extent={Size,Size}
+          },
+          .layerCount=1,
+          .viewMask=0,
+          .colorAttachmentCount=1,
+          .pColorAttachments=&attachmentInfo,
+          .pDepthAttachment=nullptr,
+          .pStencilAttachment=nullptr
+        };
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        commands.BeginRendering(renderingInfo);
+        commands.SetViewport(1,&viewPort);
+        commands.SetScissor(1,&scissor);
+        commands.SetRasterizerDiscardEnable(VK_FALSE);
+        commands.SetCullMode(VK_CULL_MODE_NONE);
+        commands.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        commands.SetDepthTestEnable(VK_FALSE);
+        commands.SetDepthWriteEnable(VK_FALSE);
+        commands.SetDepthBiasEnable(VK_FALSE);
+        commands.SetDepthBoundsTestEnable(VK_FALSE);
+        commands.SetStencilTestEnable(VK_FALSE);
+        commands.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        commands.SetPrimitiveRestartEnable(VK_FALSE);
+        commands.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+        VkSampleMask sampleMask=~0u;
+        commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+        commands.SetAlphaToCoverageEnable(VK_FALSE);
+        VkBool32 blendEnable=VK_FALSE;
+        commands.SetColorBlendEnable(0,1,&blendEnable);
+        VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+          VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+        commands.SetColorWriteMask(0,1,&writeMask);
+
+        std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+        commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+        commands.SetVertexInput((uint32_t)mesh.bindings.size(),mesh.bindings.data(),
+          (uint32_t)mesh.attributes.size(),mesh.attributes.data());
+        std::vector<VkDeviceSize> offsets,sizes,strides;
+        mesh.BindRanges(0,offsets,sizes,strides);
+        commands.BindVertexBuffers(0,1,&vertexBuffer,offsets.data(),sizes.data(),strides.data());
+
+        ring.Bind(commands);
+        for(auto &slice:slices){
+          ring.Use(commands,VK_PIPELINE_BIND_POINT_GRAPHICS,slice);
+          commands.Draw(mesh.vertexCount,1,0,0);
+        }
+        commands.EndRendering();
+      });
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+struct InstancingVariant{
+  //Collapse repeated draws of a mesh into one instanced draw
+  bool collapse;
+};
+
+//VertexBinding.cpp's draw scaled up to a few thousand small objects of three
+//meshes, drawn through a RenderQueue. Collapsed it records three instanced
+//draws, uncollapsed one draw per object. Every tint group of a mesh shares
+//one tint, stepped with a binding divisor where the device supports one.
+class InstancingScenario:public Scenario{
+  static constexpr uint32_t Size=256;
+  static constexpr uint32_t ObjectCount=4096;
+  static constexpr uint32_t TintDivisor=16;
+
+  HeadlessDevice &context;
+  InstancingVariant variant;
+  std::array<VkShaderEXT,2> shaders={};
+  VkBuffer vertexBuffer=nullptr;
+  VmaAllocation vertexAllocation=nullptr;
+  std::array<PackedMesh,3> meshes;
+  std::array<uint32_t,3> meshIds={};
+  InstanceStream stream;
+  RenderQueue queue;
+  uint32_t frame=0;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  RenderTarget &framebuffer;
+  FrameGraph frameGraph;
+
+  //Triangle list of a regular polygon around the origin
+  static MeshData Polygon(uint32_t sides){
+    MeshData mesh;
+    for(uint32_t side=0;side<sides;side++){
+      auto a=6.2831853f*side/sides;
+      auto b=6.2831853f*(side+1)/sides;
+      mesh.positions.push_back({0.0f,0.0f,0.0f});
+      mesh.positions.push_back({0.5f*std::cos(a),0.5f*std::sin(a),0.0f});
+      mesh.positions.push_back({0.5f*std::cos(b),0.5f*std::sin(b),0.0f});
+    }
+    return mesh;
+  }
+
+public:
+  InstancingScenario(HeadlessDevice &context,InstancingVariant variant):
+    context(context),
+    variant(variant),
+    stream(context,ObjectCount*(sizeof(InstanceTransform)+sizeof(InstanceTint))+4096),
+    queue(context,1,4,TintDivisor,variant.collapse),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    framebuffer(renderTargets.Acquire({
+      .extent={Size,Size},
+      .format=VK_FORMAT_R8G8B8A8_UNORM,
+      .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .samples=VK_SAMPLE_COUNT_1_BIT
+    })),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto vertShaderCode=context.Shader("InstancedVert.spv");
+    auto fragShaderCode=context.Shader("InstancedFrag.spv");
+
+    std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_VERTEX_BIT,
+      .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+      .pCode=vertShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=0,
+      .pSetLayouts=nullptr,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    },{
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT,
+      .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+      .pCode=fragShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=0,
+      .pSetLayouts=nullptr,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    }}};
+    auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    std::array<uint32_t,3> sides={3,4,6};
+    size_t bytes=0;
+    for(size_t mesh=0;mesh<meshes.size();mesh++){
+      meshes[mesh]=VertexPacker::Pack(Polygon(sides[mesh]),{});
+      bytes+=meshes[mesh].Bytes();
+    }
+    VmaAllocationInfo vertexInfo={};
+    vertexBuffer=context.CreateBuffer(std::max<VkDeviceSize>(bytes,1024),VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      vertexAllocation,vertexInfo);
+    VkDeviceSize base=0;
+    for(size_t mesh=0;mesh<meshes.size();mesh++){
+      meshIds[mesh]=queue.AddMesh(meshes[mesh],vertexBuffer,base);
+      for(auto &data:meshes[mesh].streams){
+        memcpy(static_cast<uint8_t *>(vertexInfo.pMappedData)+base,data.data(),data.size());
+        base+=data.size();
+      }
+    }
+
+    if(context.trace)
+      context.trace->Image(framebuffer);
+    frameGraph.Trace(context.trace);
+  }
+
+  ~InstancingScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    renderTargets.Release(framebuffer);
+    renderTargets.Clear();
+    context.DestroyBuffer(vertexBuffer,vertexAllocation);
+    for(auto shader:shaders){
+      if(shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    }
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    //A 64x64 grid, the meshes interleaved the way a scene traversal would
+    //submit them
+    constexpr uint32_t Side=64;
+    constexpr float Cell=2.0f/Side;
+    auto angle=0.05f*frame++;
+    queue.Clear();
+    for(uint32_t object=0;object<ObjectCount;object++){
+      auto scale=Cell*0.8f;
+      auto rotation=angle+0.01f*object;
+      auto c=scale*std::cos(rotation);
+      auto s=scale*std::sin(rotation);
+      InstanceTransform transform={{{
+        {c,-s,0.0f,-1.0f+Cell*(object%Side+0.5f)},
+        {s,c,0.0f,-1.0f+Cell*(object/Side+0.5f)},
+        {0.0f,0.0f,1.0f,0.0f}
+      }}};
+      //Consecutive draws of a mesh in groups of TintDivisor share a tint
+      auto group=(float)((object/(uint32_t)meshes.size()/TintDivisor)%8);
+      queue.Draw(meshIds[object%meshes.size()],transform,{0.3f+0.1f*group,0.5f,1.0f-0.1f*group,1.0f});
+    }
+    stream.BeginFrame();
+    queue.Build(stream);
+    stream.Flush();
+
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkRenderingAttachmentInfo attachmentInfo{
+          .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext=nullptr,
+          .imageView=framebuffer.view,
+          .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode=VK_RESOLVE_MODE_NONE,
+          .resolveImageView=VK_NULL_HANDLE,
+          .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue={.color={0.0,0.0,0.0,0.0}}
+        };
+        VkRenderingInfo renderingInfo={
+          .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext=nullptr,
+          .flags=0,
+          .renderArea={
+            .offset={0,0},
+            .extent={Size,Size}
+          },
+          .layerCount=1,
+          .viewMask=0,
+          .colorAttachmentCount=1,
+          .pColorAttachments=&attachmentInfo,
+          .pDepthAttachment=nullptr,
+          .pStencilAttachment=nullptr
+        };
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        commands.BeginRendering(renderingInfo);
+        commands.SetViewport(1,&viewPort);
+        commands.SetScissor(1,&scissor);
+        commands.SetRasterizerDiscardEnable(VK_FALSE);
+        commands.SetCullMode(VK_CULL_MODE_NONE);
+        commands.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        commands.SetDepthTestEnable(VK_FALSE);
+        commands.SetDepthWriteEnable(VK_FALSE);
+        commands.SetDepthBiasEnable(VK_FALSE);
+        commands.SetDepthBoundsTestEnable(VK_FALSE);
+        commands.SetStencilTestEnable(VK_FALSE);
+        commands.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        commands.SetPrimitiveRestartEnable(VK_FALSE);
+        commands.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        commands.SetRasterizationSamples(VK_SAMPLE_COUNT_1_BIT);
+        VkSampleMask sampleMask=~0u;
+        commands.SetSampleMask(VK_SAMPLE_COUNT_1_BIT,&sampleMask);
+        commands.SetAlphaToCoverageEnable(VK_FALSE);
+        VkBool32 blendEnable=VK_FALSE;
+        commands.SetColorBlendEnable(0,1,&blendEnable);
+        VkColorComponentFlags writeMask=VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|
+          VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+        commands.SetColorWriteMask(0,1,&writeMask);
+
+        std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+        commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+        queue.Record(commands,stream);
+        commands.EndRendering();
+      });
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+struct TaskVariant{
+  //Spawn every job before running the executor, otherwise run them one
+  //after another like the rest of the host code does
+  bool concurrent;
+};
+
+//Many small independent jobs, each a GpuTask chaining upload, compute and
+//readback a few times over. Concurrent, the executor keeps every job in
+//flight and the host writes and reads one job's buffers while the device
+//runs the others. Serial is the same chains run one at a time.
+class TaskScenario:public Scenario{
+  static constexpr uint32_t JobCount=64;
+  static constexpr uint32_t Steps=4;
+
+  using TaskSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>>;
+
+  struct Job{
+    uint32_t index;
+    VkBuffer inputBuffer=nullptr;
+    VmaAllocation inputAllocation=nullptr;
+    VmaAllocationInfo inputInfo={};
+    VkBuffer outputBuffer=nullptr;
+    VmaAllocation outputAllocation=nullptr;
+    VmaAllocationInfo outputInfo={};
+    VkDeviceSize descriptorOffset=0;
+    std::unique_ptr<FrameGraph> frameGraph;
+  };
+
+  HeadlessDevice &context;
+  TaskVariant variant;
+  DescriptorLayout<TaskSet> setLayout;
+  VkPipelineLayout pipelineLayout=nullptr;
+  VkShaderEXT shader=nullptr;
+  VkBuffer descriptorBuffer=nullptr;
+  VmaAllocation descriptorAllocation=nullptr;
+  VkDeviceAddress descriptorBufferAddress=0;
+  std::vector<std::unique_ptr<Job>> jobs;
+  //Sum of every readback, keeps the host side of the chain from being dead
+  float checksum=0.0f;
+  Clock::time_point submitted;
+
+  ResourceTracker tracker{&context.dispatch};
+  GpuExecutor executor;
+
+  GpuTask Chain(Job &job){
+    auto input=static_cast<float *>(job.inputInfo.pMappedData);
+    auto output=static_cast<const float *>(job.outputInfo.pMappedData);
+
+    for(uint32_t step=0;step<Steps;step++){
+      //Upload, the first step starts from the job's index and every later
+      //one from what the previous step read back
+      for(uint32_t component=0;component<4;component++)
+        input[component]=step==0?(float)job.index:output[component]+1.0f;
+      if(context.trace)
+        context.trace->BufferData(job.inputBuffer,0,4*sizeof(float),input);
+
+      auto &frameGraph=*job.frameGraph;
+      frameGraph.Reset();
+      auto inputResource=frameGraph.ImportBuffer("Input",job.inputBuffer);
+      auto outputResource=frameGraph.ImportBuffer("Output",job.outputBuffer);
+      frameGraph.AddPass("Dispatch",QueueType::Compute,
+        [&](FrameGraph::PassBuilder &pass){
+          pass.Read(inputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+          pass.Write(outputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        },
+        [&](VkCommandBuffer CMDBuffer){
+          TracedCommands commands(context,CMDBuffer);
+          VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+          commands.BindShaders(1,&stageFlags,&shader);
+
+          VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+            .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+            .pNext=nullptr,
+            .address=descriptorBufferAddress,
+            .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+          };
+          commands.BindDescriptorBuffers(1,&bufferBindingInfo);
+
+          uint32_t bufferIndice=0;
+          commands.SetDescriptorBufferOffsets(VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&job.descriptorOffset);
+          commands.Dispatch(1,1,1);
+        });
+      frameGraph.Export(outputResource,VK_PIPELINE_STAGE_2_HOST_BIT,VK_ACCESS_2_HOST_READ_BIT);
+
+      auto submission=executor.Submit(frameGraph);
+      submitted=Clock::now();
+      co_await submission;
+
+      //Readback
+      checksum+=output[0];
+    }
+  }
+
+public:
+  TaskScenario(HeadlessDevice &context,TaskVariant variant):
+    context(context),
+    variant(variant),
+    setLayout(context),
+    executor(*context.queues){
+    auto setLayoutHandle=setLayout.Handle();
+    pipelineLayout=context.CreatePipelineLayout({setLayoutHandle});
+
+    auto computeShaderCode=context.Shader("comp.spv");
+    TaskSet::Check(computeShaderCode,0);
+    VkShaderCreateInfoEXT shaderCreateInfo={
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_COMPUTE_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=computeShaderCode.size()*sizeof(uint32_t),
+      .pCode=computeShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayoutHandle,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    };
+    auto result=context.CreateShaders(1,&shaderCreateInfo,&shader);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    VmaAllocationInfo descriptorInfo={};
+    descriptorBuffer=context.CreateBuffer(setLayout.Stride()*JobCount,
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,descriptorAllocation,descriptorInfo);
+    descriptorBufferAddress=context.BufferAddress(descriptorBuffer);
+
+    for(uint32_t index=0;index<JobCount;index++){
+      auto job=std::make_unique<Job>();
+      job->index=index;
+      job->inputBuffer=context.CreateBuffer(256,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,job->inputAllocation,job->inputInfo);
+      job->outputBuffer=context.CreateBuffer(256,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,job->outputAllocation,job->outputInfo);
+      job->descriptorOffset=index*setLayout.Stride();
+
+      auto writer=setLayout.Writer(descriptorBuffer,descriptorInfo,job->descriptorOffset);
+      writer.Buffer<0>(context.BufferAddress(job->inputBuffer),256);
+      writer.Buffer<1>(context.BufferAddress(job->outputBuffer),256);
+
+      job->frameGraph=std::make_unique<FrameGraph>(context.device,context.allocator,tracker,&context.dispatch);
+      job->frameGraph->Trace(context.trace);
+      jobs.push_back(std::move(job));
+    }
+  }
+
+  ~TaskScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    for(auto &job:jobs){
+      job->frameGraph->Reset();
+      context.DestroyBuffer(job->inputBuffer,job->inputAllocation);
+      context.DestroyBuffer(job->outputBuffer,job->outputAllocation);
+    }
+    context.DestroyBuffer(descriptorBuffer,descriptorAllocation);
+    context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    for(auto &job:jobs){
+      executor.Spawn(Chain(*job));
+      if(!variant.concurrent)
+        executor.Run();
+    }
+    executor.Run();
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+struct PipelineVariant{
+  PipelineBackend backend;
+};
+
+//VertexBinding's triangle drawn DrawCount times a frame, every draw in the
+//next of StateCount combinations of cull mode, front face and color write
+//mask. Shader objects set the state that changed, the pipeline backends bind
+//the state's pipeline, created up front from the same SPIR-V. The timings
+//are the bind and draw cost of each path, creation is timed by the
+//benchmark's --pipelines.
+class PipelineScenario:public Scenario{
+  static constexpr uint32_t Size=256;
+  static constexpr uint32_t DrawCount=1024;
+  static constexpr uint32_t StateCount=8;
+
+  HeadlessDevice &context;
+  PipelineVariant variant;
+  VkPipelineLayout pipelineLayout=nullptr;
+  std::array<VkShaderEXT,2> shaders={};
+  std::unique_ptr<GraphicsPipelines> pipelines;
+  std::array<GraphicsState,StateCount> states;
+  std::array<VkPipeline,StateCount> statePipelines={};
+  VkBuffer vertexBuffer=nullptr;
+  VmaAllocation vertexAllocation=nullptr;
+  PackedMesh mesh;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  RenderTarget &framebuffer;
+  FrameGraph frameGraph;
+
+public:
+  //Every combination of the states the draws cycle through, also what the
+  //benchmark's --pipelines creates
+  static std::array<GraphicsState,StateCount> States(VkFormat colorFormat,const PackedMesh &mesh){
+    std::array<GraphicsState,StateCount> states;
+    for(uint32_t index=0;index<StateCount;index++){
+      auto &state=states[index];
+      state.cullMode=index&1?VK_CULL_MODE_BACK_BIT:VK_CULL_MODE_NONE;
+      state.frontFace=index&2?VK_FRONT_FACE_CLOCKWISE:VK_FRONT_FACE_COUNTER_CLOCKWISE;
+      state.writeMask=index&4?VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|VK_COLOR_COMPONENT_B_BIT:
+        VK_COLOR_COMPONENT_R_BIT|VK_COLOR_COMPONENT_G_BIT|VK_COLOR_COMPONENT_B_BIT|VK_COLOR_COMPONENT_A_BIT;
+      state.colorFormat=colorFormat;
+      state.bindings=mesh.bindings;
+      state.attributes=mesh.attributes;
+    }
+    return states;
+  }
+
+  PipelineScenario(HeadlessDevice &context,PipelineVariant variant):
+    context(context),
+    variant(variant),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    framebuffer(renderTargets.Acquire({
+      .extent={Size,Size},
+      .format=VK_FORMAT_R8G8B8A8_UNORM,
+      .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .samples=VK_SAMPLE_COUNT_1_BIT
+    })),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+    auto vertShaderCode=context.Shader("VertexBindingVert.spv");
+    auto fragShaderCode=context.Shader("VertexBindingFrag.spv");
+
+    mesh=VertexPacker::Pack({
+      .positions={{0.0f,-0.5f,0.0f},{0.5f,0.5f,0.0f},{-0.5f,0.5f,0.0f}},
+      .normals={},
+      .texCoords={}
+    },{});
+    VmaAllocationInfo vertexInfo={};
+    vertexBuffer=context.CreateBuffer(std::max<VkDeviceSize>(mesh.Bytes(),1024),VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      vertexAllocation,vertexInfo);
+    memcpy(vertexInfo.pMappedData,mesh.streams[0].data(),mesh.streams[0].size());
+
+    states=States(framebuffer.key.format,mesh);
+
+    if(variant.backend==PipelineBackend::ShaderObject){
+      std::array<VkShaderCreateInfoEXT,2> shaderCreateInfos={{{
+        .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+        .pNext=nullptr,
+        .flags=0,
+        .stage=VK_SHADER_STAGE_VERTEX_BIT,
+        .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+        .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+        .codeSize=vertShaderCode.size()*sizeof(uint32_t),
+        .pCode=vertShaderCode.data(),
+        .pName="main",
+        .setLayoutCount=0,
+        .pSetLayouts=nullptr,
+        .pushConstantRangeCount=0,
+        .pPushConstantRanges=nullptr,
+        .pSpecializationInfo=nullptr
+      },{
+        .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+        .pNext=nullptr,
+        .flags=0,
+        .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+        .nextStage=0,
+        .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+        .codeSize=fragShaderCode.size()*sizeof(uint32_t),
+        .pCode=fragShaderCode.data(),
+        .pName="main",
+        .setLayoutCount=0,
+        .pSetLayouts=nullptr,
+        .pushConstantRangeCount=0,
+        .pPushConstantRanges=nullptr,
+        .pSpecializationInfo=nullptr
+      }}};
+      auto result=context.CreateShaders((uint32_t)shaderCreateInfos.size(),shaderCreateInfos.data(),shaders.data());
+      if(result!=VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader objects");
+    }else{
+      pipelineLayout=context.CreatePipelineLayout({});
+      pipelines=std::make_unique<GraphicsPipelines>(context,variant.backend,pipelineLayout,vertShaderCode,fragShaderCode);
+      for(uint32_t index=0;index<StateCount;index++)
+        statePipelines[index]=pipelines->Get(states[index]);
+    }
+
+    if(context.trace)
+      context.trace->Image(framebuffer);
+    frameGraph.Trace(context.trace);
+  }
+
+  ~PipelineScenario(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    renderTargets.Release(framebuffer);
+    renderTargets.Clear();
+    context.DestroyBuffer(vertexBuffer,vertexAllocation);
+    pipelines.reset();
+    if(pipelineLayout)
+      context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+    for(auto shader:shaders){
+      if(shader)
+        context.DestroyShader(shader);
+    }
+  }
+
+  Sample Iterate()override{
+    auto begin=Clock::now();
+
+    frameGraph.Reset();
+    auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
+
+    frameGraph.AddPass("Draw",QueueType::Graphics,
+      [&](FrameGraph::PassBuilder &pass){
+        pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+      },
+      [&](VkCommandBuffer CMDBuffer){
+        TracedCommands commands(context,CMDBuffer);
+        VkRenderingAttachmentInfo attachmentInfo{
+          .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext=nullptr,
+          .imageView=framebuffer.view,
+          .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode=VK_RESOLVE_MODE_NONE,
+          .resolveImageView=VK_NULL_HANDLE,
+          .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp=VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue={.color={0.0,0.0,0.0,0.0}}
+        };
+        VkRenderingInfo renderingInfo={
+          .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext=nullptr,
+          .flags=0,
+          .renderArea={
+            .offset={0,0},
+            .extent={Size,Size}
+          },
+          .layerCount=1,
+          .viewMask=0,
+          .colorAttachmentCount=1,
+          .pColorAttachments=&attachmentInfo,
+          .pDepthAttachment=nullptr,
+          .pStencilAttachment=nullptr
+        };
+        VkViewport viewPort={
+          .x=0.0f,
+          .y=0.0f,
+          .width=(float)Size,
+          .height=(float)Size,
+          .minDepth=0.0f,
+          .maxDepth=1.0f
+        };
+        VkRect2D scissor={
+          .offset={0,0},
+          .extent={Size,Size}
+        };
+
+        commands.BeginRendering(renderingInfo);
+        commands.SetViewport(1,&viewPort);
+        commands.SetScissor(1,&scissor);
+
+        //Pipelines bake the strides in, vkCmdBindVertexBuffers2 has to be
+        //given none
+        std::vector<VkDeviceSize> offsets,sizes,strides;
+        mesh.BindRanges(0,offsets,sizes,strides);
+        bool shaderObjects=variant.backend==PipelineBackend::ShaderObject;
+        commands.BindVertexBuffers(0,1,&vertexBuffer,offsets.data(),sizes.data(),shaderObjects?strides.data():nullptr);
+
+        if(shaderObjects){
+          std::array<VkShaderStageFlagBits,2> shaderStages={VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT};
+          commands.BindShaders((uint32_t)shaderStages.size(),shaderStages.data(),shaders.data());
+          states[0].Apply(commands);
+        }
+        for(uint32_t draw=0;draw<DrawCount;draw++){
+          auto state=draw%StateCount;
+          if(!shaderObjects)
+            commands.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS,statePipelines[state]);
+          else if(draw>0)
+            states[state].Apply(commands,&states[(draw-1)%StateCount]);
+          commands.Draw(mesh.vertexCount,1,0,0);
+        }
+        commands.EndRendering();
+      });
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    auto submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    auto completed=Clock::now();
+
+    return {Milliseconds(begin,submitted),Milliseconds(begin,completed)};
+  }
+};
+
+struct ScenarioEntry{
+  const char *scenario;
+  const char *variant;
+  //Valid usage only, everything else reproduces one of the driver faults
+  bool valid;
+  std::function<std::unique_ptr<Scenario>(HeadlessDevice &)> create;
+};
+
+inline std::vector<ScenarioEntry> ScenarioEntries(){
+  return {
+    {"compute","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<ComputeScenario>(context);}},
+    {"compute","address-offset",false,[](HeadlessDevice &context){
+      return std::make_unique<ComputeScenario>(context,ComputeVariant{.addressOffset=32*1024*1024,.bindDescriptorBuffer=true});}},
+    {"compute","unbound-descriptor-buffer",false,[](HeadlessDevice &context){
+      return std::make_unique<ComputeScenario>(context,ComputeVariant{.addressOffset=0,.bindDescriptorBuffer=false});}},
+    {"draw","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<DrawScenario>(context);}},
+    {"draw","indexed",true,[](HeadlessDevice &context){
+      return std::make_unique<DrawScenario>(context,DrawVariant{.bindVertexBuffer=true,.indexed=true});}},
+    {"draw","unbound-vertex-buffer",false,[](HeadlessDevice &context){
+      return std::make_unique<DrawScenario>(context,DrawVariant{.bindVertexBuffer=false,.indexed=false});}},
+    {"shaders","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<ShaderScenario>(context);}},
+    {"shaders","mismatched-layouts",false,[](HeadlessDevice &context){
+      return std::make_unique<ShaderScenario>(context,ShaderVariant{.matchingLayouts=false,.link=true});}},
+    {"shaders","mismatched-unlinked",false,[](HeadlessDevice &context){
+      return std::make_unique<ShaderScenario>(context,ShaderVariant{.matchingLayouts=false,.link=false});}},
+    {"bindless","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<BindlessScenario>(context);}},
+    {"uniforms","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<UniformScenario>(context,UniformVariant{.objects=1024});}},
+    {"uniforms","100k",true,[](HeadlessDevice &context){
+      return std::make_unique<UniformScenario>(context,UniformVariant{.objects=100000});}},
+    {"instancing","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<InstancingScenario>(context,InstancingVariant{.collapse=true});}},
+    {"instancing","per-draw",true,[](HeadlessDevice &context){
+      return std::make_unique<InstancingScenario>(context,InstancingVariant{.collapse=false});}},
+    {"tasks","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<TaskScenario>(context,TaskVariant{.concurrent=true});}},
+    {"tasks","serial",true,[](HeadlessDevice &context){
+      return std::make_unique<TaskScenario>(context,TaskVariant{.concurrent=false});}},
+    {"pipelines","valid",true,[](HeadlessDevice &context){
+      return std::make_unique<PipelineScenario>(context,PipelineVariant{.backend=PipelineBackend::ShaderObject});}},
+    {"pipelines","monolithic",true,[](HeadlessDevice &context){
+      return std::make_unique<PipelineScenario>(context,PipelineVariant{.backend=PipelineBackend::Monolithic});}},
+    {"pipelines","library",true,[](HeadlessDevice &context){
+      return std::make_unique<PipelineScenario>(context,PipelineVariant{.backend=PipelineBackend::Library});}}
+  };
+}
@@ -0,0 +1,382 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<string_view>
+#include<unordered_map>
+#include<filesystem>
+#include<fstream>
+#include<sstream>
+#include<mutex>
+#include<atomic>
+#include<thread>
+#include<exception>
+#include<algorithm>
+#include<format>
+#include<stdexcept>
+#include<cstdint>
+#include<unistd.h>
+#include<vulkan/vulkan.h>
+#ifdef HAVE_GLSLANG
+#include<glslang/Include/glslang_c_interface.h>
+#include<glslang/Public/resource_limits_c.h>
+#endif
+
+//Compiles the GLSL in process with glslang, so shader variants can be
+//iterated on without a build step. The settings match the glslangValidator
+//-V100 invocation the build uses, with --target-env for sources that ask for
+//a later Vulkan version.
+//
+//SPIR-V is cached by the content of the source, the stage and the defines,
+//in memory and as <key>.spv under the cache directory. Editing a shader and
+//running again compiles that one shader and nothing else. Files in the cache
+//are never stale, only unused, and the directory can be deleted at any time.
+//
+//glslang is optional. Without it, building a ShaderCompiler throws and the
+//tools keep loading the .spv files.
+
+struct ShaderDefine{
+  std::string name;
+  std::string value;
+};
+
+struct ShaderSource{
+  //Relative to the compiler's source directory
+  std::filesystem::path path;
+  VkShaderStageFlagBits stage;
+  std::vector<ShaderDefine> defines;
+  //Vulkan version the SPIR-V targets, 1.1 or later for subgroup operations
+  uint32_t apiVersion=VK_API_VERSION_1_0;
+};
+
+//The shaders the scenarios load, by the name of the .spv the build writes
+struct ScenarioShader{
+  const char *name;
+  ShaderSource source;
+};
+
+inline std::vector<ScenarioShader> ScenarioShaders(){
+  return {
+    {"comp.spv",{"DescriptorBuffer/comp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{}}},
+    {"VertexBindingVert.spv",{"VertexBinding/VertexBindingVert.glsl",VK_SHADER_STAGE_VERTEX_BIT,{}}},
+    {"VertexBindingFrag.spv",{"VertexBinding/VertexBindingFrag.glsl",VK_SHADER_STAGE_FRAGMENT_BIT,{}}},
+    {"InstancedVert.spv",{"VertexBinding/InstancedVert.glsl",VK_SHADER_STAGE_VERTEX_BIT,{}}},
+    {"InstancedFrag.spv",{"VertexBinding/InstancedFrag.glsl",VK_SHADER_STAGE_FRAGMENT_BIT,{}}},
+    {"LinkedShaderLayoutVert.spv",{"LinkedShaderLayoutBindings/LinkedShaderLayoutVert.glsl",VK_SHADER_STAGE_VERTEX_BIT,{}}},
+    {"LinkedShaderLayoutFrag.spv",{"LinkedShaderLayoutBindings/LinkedShaderLayoutFrag.glsl",VK_SHADER_STAGE_FRAGMENT_BIT,{}}},
+    {"BindlessVert.spv",{"LinkedShaderLayoutBindings/BindlessVert.glsl",VK_SHADER_STAGE_VERTEX_BIT,{}}},
+    {"BindlessFrag.spv",{"LinkedShaderLayoutBindings/BindlessFrag.glsl",VK_SHADER_STAGE_FRAGMENT_BIT,{}}},
+    {"UniformRingVert.spv",{"LinkedShaderLayoutBindings/UniformRingVert.glsl",VK_SHADER_STAGE_VERTEX_BIT,{}}},
+    {"PrimitiveReduce.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"REDUCE",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveScan.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"SCAN",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveScanLookBack.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"SCAN_LOOKBACK",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveClear.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"CLEAR",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveCompact.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"COMPACT",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveHistogram.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"HISTOGRAM",""}},VK_API_VERSION_1_1}},
+    {"PrimitiveScatter.spv",{"DescriptorBuffer/PrimitivesComp.glsl",VK_SHADER_STAGE_COMPUTE_BIT,{{"SCATTER",""}},VK_API_VERSION_1_1}}
+  };
+}
+
+class ShaderCompiler{
+  //Bumped whenever the compile settings below change, old entries then
+  //simply stop being looked up
+  static constexpr uint32_t CacheVersion=2;
+
+  std::filesystem::path sourceDir;
+  std::filesystem::path cacheDir;
+
+  std::mutex mutex;
+  std::unordered_map<uint64_t,std::vector<uint32_t>> cache;
+
+  std::atomic<uint32_t> memoryHits=0;
+  std::atomic<uint32_t> diskHits=0;
+  std::atomic<uint32_t> compiles=0;
+
+  //FNV-1a, 64 bit
+  static void Hash(uint64_t &hash,const void *data,size_t size){
+    auto bytes=static_cast<const uint8_t *>(data);
+    for(size_t index=0;index<size;index++){
+      hash^=bytes[index];
+      hash*=0x100000001b3ull;
+    }
+  }
+
+  static void Hash(uint64_t &hash,const std::string &text){
+    uint64_t size=text.size();
+    Hash(hash,&size,sizeof(size));
+    Hash(hash,text.data(),text.size());
+  }
+
+  static std::string ReadSource(const std::filesystem::path &path){
+    std::ifstream stream(path,std::ios::binary);
+    if(!stream.is_open())
+      throw std::runtime_error(std::format("Unable to open shader source {}",path.string()));
+    std::stringstream text;
+    text<<stream.rdbuf();
+    return text.str();
+  }
+
+  static std::string Preamble(const std::vector<ShaderDefine> &defines){
+    std::string preamble;
+    for(auto &define:defines)
+      preamble+=std::format("#define {} {}\n",define.name,define.value);
+    return preamble;
+  }
+
+  std::filesystem::path CachePath(uint64_t key)const{
+    return cacheDir/std::format("{:016x}.spv",key);
+  }
+
+  bool LoadCached(uint64_t key,std::vector<uint32_t> &code){
+    if(cacheDir.empty())
+      return false;
+    std::ifstream stream(CachePath(key),std::ios::binary|std::ios::ate);
+    if(!stream.is_open())
+      return false;
+    auto size=(size_t)stream.tellg();
+    if(size==0||size%sizeof(uint32_t)!=0)
+      return false;
+    code.resize(size/sizeof(uint32_t));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char *>(code.data()),size);
+    return stream.good();
+  }
+
+  //Written under a name unique to the call and renamed, a reader never sees
+  //half a module even with several processes sharing the cache. Thread id
+  //hashes can repeat across processes, so the name is the pid and a count.
+  void StoreCached(uint64_t key,const std::vector<uint32_t> &code){
+    if(cacheDir.empty())
+      return;
+    static std::atomic<uint64_t> stores=0;
+    auto path=CachePath(key);
+    auto temporary=path;
+    temporary+=std::format(".{}.{}.tmp",getpid(),stores.fetch_add(1,std::memory_order_relaxed));
+    {
+      std::ofstream stream(temporary,std::ios::binary|std::ios::trunc);
+      if(!stream.is_open())
+        return;
+      stream.write(reinterpret_cast<const char *>(code.data()),code.size()*sizeof(uint32_t));
+      if(!stream.good())
+        return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary,path,error);
+    if(error)
+      std::filesystem::remove(temporary,error);
+  }
+
+#ifdef HAVE_GLSLANG
+  static glslang_stage_t Stage(VkShaderStageFlagBits stage){
+    switch(stage){
+      case VK_SHADER_STAGE_VERTEX_BIT:return GLSLANG_STAGE_VERTEX;
+      case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:return GLSLANG_STAGE_TESSCONTROL;
+      case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:return GLSLANG_STAGE_TESSEVALUATION;
+      case VK_SHADER_STAGE_GEOMETRY_BIT:return GLSLANG_STAGE_GEOMETRY;
+      case VK_SHADER_STAGE_FRAGMENT_BIT:return GLSLANG_STAGE_FRAGMENT;
+      case VK_SHADER_STAGE_COMPUTE_BIT:return GLSLANG_STAGE_COMPUTE;
+      default:
+        throw std::runtime_error(std::format("No glslang stage for shader stage {}",(uint32_t)stage));
+    }
+  }
+
+  //What glslangValidator's --target-env picks for a Vulkan version
+  static void Target(uint32_t apiVersion,glslang_target_client_version_t &client,glslang_target_language_version_t &language){
+    switch(VK_API_VERSION_MINOR(apiVersion)){
+      case 0:
+        client=GLSLANG_TARGET_VULKAN_1_0;
+        language=GLSLANG_TARGET_SPV_1_0;
+        return;
+      case 1:
+        client=GLSLANG_TARGET_VULKAN_1_1;
+        language=GLSLANG_TARGET_SPV_1_3;
+        return;
+      case 2:
+        client=GLSLANG_TARGET_VULKAN_1_2;
+        language=GLSLANG_TARGET_SPV_1_5;
+        return;
+      default:
+        client=GLSLANG_TARGET_VULKAN_1_3;
+        language=GLSLANG_TARGET_SPV_1_6;
+        return;
+    }
+  }
+
+  static std::vector<uint32_t> Build(const std::string &name,const std::string &source,
+    VkShaderStageFlagBits stage,uint32_t apiVersion,const std::string &preamble){
+
+    glslang_target_client_version_t client;
+    glslang_target_language_version_t language;
+    Target(apiVersion,client,language);
+    auto messages=(glslang_messages_t)(GLSLANG_MSG_SPV_RULES_BIT|GLSLANG_MSG_VULKAN_RULES_BIT);
+    glslang_input_t input={
+      .language=GLSLANG_SOURCE_GLSL,
+      .stage=Stage(stage),
+      .client=GLSLANG_CLIENT_VULKAN,
+      .client_version=client,
+      .target_language=GLSLANG_TARGET_SPV,
+      .target_language_version=language,
+      .code=source.c_str(),
+      .default_version=100,
+      .default_profile=GLSLANG_NO_PROFILE,
+      .force_default_version_and_profile=false,
+      .forward_compatible=false,
+      .messages=messages,
+      .resource=glslang_default_resource(),
+      .callbacks={},
+      .callbacks_ctx=nullptr
+    };
+
+    auto shader=glslang_shader_create(&input);
+    if(!preamble.empty())
+      glslang_shader_set_preamble(shader,preamble.c_str());
+
+    if(!glslang_shader_preprocess(shader,&input)||!glslang_shader_parse(shader,&input)){
+      auto log=std::format("Failed to compile {}:\n{}",name,glslang_shader_get_info_log(shader));
+      glslang_shader_delete(shader);
+      throw std::runtime_error(log);
+    }
+
+    auto program=glslang_program_create();
+    glslang_program_add_shader(program,shader);
+    if(!glslang_program_link(program,messages)){
+      auto log=std::format("Failed to link {}:\n{}",name,glslang_program_get_info_log(program));
+      glslang_program_delete(program);
+      glslang_shader_delete(shader);
+      throw std::runtime_error(log);
+    }
+
+    glslang_program_SPIRV_generate(program,input.stage);
+    std::vector<uint32_t> code(glslang_program_SPIRV_get_size(program));
+    glslang_program_SPIRV_get(program,code.data());
+
+    glslang_program_delete(program);
+    glslang_shader_delete(shader);
+    return code;
+  }
+#endif
+
+public:
+  ShaderCompiler(std::filesystem::path sourceDir,std::filesystem::path cacheDir={}):
+    sourceDir(std::move(sourceDir)),cacheDir(std::move(cacheDir)){
+
+#ifdef HAVE_GLSLANG
+    if(!glslang_initialize_process())
+      throw std::runtime_error("Failed to initialise glslang");
+#else
+    throw std::runtime_error("Built without glslang, the shaders can only be loaded as .spv");
+#endif
+    if(!this->cacheDir.empty())
+      std::filesystem::create_directories(this->cacheDir);
+  }
+
+  ShaderCompiler(const ShaderCompiler &)=delete;
+  ShaderCompiler &operator=(const ShaderCompiler &)=delete;
+
+  ~ShaderCompiler(){
+#ifdef HAVE_GLSLANG
+    glslang_finalize_process();
+#endif
+  }
+
+  //Content address of a variant: its source text, stage, defines, target
+  //version and the compile settings. Reads the source, so an edit changes the key.
+  uint64_t Key(const ShaderSource &variant,const std::string &source)const{
+    uint64_t hash=0xcbf29ce484222325ull;
+    Hash(hash,&CacheVersion,sizeof(CacheVersion));
+    Hash(hash,source);
+    uint32_t stage=variant.stage;
+    Hash(hash,&stage,sizeof(stage));
+    for(auto &define:variant.defines){
+      Hash(hash,define.name);
+      Hash(hash,define.value);
+    }
+    Hash(hash,&variant.apiVersion,sizeof(variant.apiVersion));
+    return hash;
+  }
+
+  std::vector<uint32_t> Compile(const ShaderSource &variant){
+    auto source=ReadSource(sourceDir/variant.path);
+    auto key=Key(variant,source);
+    {
+      std::lock_guard lock(mutex);
+      auto entry=cache.find(key);
+      if(entry!=cache.end()){
+        memoryHits++;
+        return entry->second;
+      }
+    }
+
+    std::vector<uint32_t> code;
+    if(LoadCached(key,code)){
+      diskHits++;
+    }else{
+#ifdef HAVE_GLSLANG
+      code=Build(variant.path.string(),source,variant.stage,variant.apiVersion,Preamble(variant.defines));
+#endif
+      compiles++;
+      StoreCached(key,code);
+    }
+
+    std::lock_guard lock(mutex);
+    cache.emplace(key,code);
+    return code;
+  }
+
+  //A scenario shader by the name of its .spv
+  std::vector<uint32_t> Compile(const char *name){
+    for(auto &shader:ScenarioShaders()){
+      if(std::string_view(shader.name)==name)
+        return Compile(shader.source);
+    }
+    throw std::runtime_error(std::format("No GLSL source known for {}",name));
+  }
+
+  //Compiles the variants on up to threads threads, results in variant order.
+  //The first failure is rethrown once every thread has finished.
+  std::vector<std::vector<uint32_t>> CompileAll(const std::vector<ShaderSource> &variants,uint32_t threads=0){
+    if(threads==0)
+      threads=std::max(1u,std::thread::hardware_concurrency());
+    threads=std::min<uint32_t>(threads,(uint32_t)variants.size());
+
+    std::vector<std::vector<uint32_t>> results(variants.size());
+    std::vector<std::exception_ptr> errors(variants.size());
+    std::atomic<size_t> next=0;
+
+    auto Work=[&](){
+      for(size_t index=next++;index<variants.size();index=next++){
+        try{
+          results[index]=Compile(variants[index]);
+        }catch(...){
+          errors[index]=std::current_exception();
+        }
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for(uint32_t thread=1;thread<threads;thread++)
+      workers.emplace_back(Work);
+    Work();
+    for(auto &worker:workers)
+      worker.join();
+
+    for(auto &error:errors){
+      if(error)
+        std::rethrow_exception(error);
+    }
+    return results;
+  }
+
+  //Every scenario shader, done once up front so the tools' workers only
+  //ever hit the memory cache
+  void CompileScenarioShaders(uint32_t threads=0){
+    std::vector<ShaderSource> variants;
+    for(auto &shader:ScenarioShaders())
+      variants.push_back(shader.source);
+    CompileAll(variants,threads);
+  }
+
+  std::string Stats()const{
+    return std::format("{} compiled, {} from disk, {} from memory",
+      compiles.load(),diskHits.load(),memoryHits.load());
+  }
+};
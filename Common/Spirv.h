@@ -0,0 +1,101 @@
+#pragma once
+#include<vector>
+#include<cstdint>
+#include<stdexcept>
+
+//Minimal walk over a SPIR-V word stream, enough to find and patch
+//decorations in place without a round trip through glslang. Only the module
+//header and the instruction word counts are trusted, operands are read for
+//the few opcodes below.
+
+struct SpirvDecoration{
+  uint32_t target;
+  uint32_t decoration;
+  //Word index of the first literal, patching code[word] changes the value
+  uint32_t word;
+  uint32_t value;
+};
+
+struct SpirvVariable{
+  uint32_t id;
+  uint32_t storageClass;
+};
+
+class SpirvModule{
+public:
+  static constexpr uint32_t Magic=0x07230203;
+  static constexpr uint32_t HeaderWords=5;
+
+  static constexpr uint32_t OpVariable=59;
+  static constexpr uint32_t OpDecorate=71;
+
+  static constexpr uint32_t DecorationBuiltIn=11;
+  static constexpr uint32_t DecorationLocation=30;
+  static constexpr uint32_t DecorationBinding=33;
+  static constexpr uint32_t DecorationDescriptorSet=34;
+
+  static constexpr uint32_t StorageClassInput=1;
+  static constexpr uint32_t StorageClassUniform=2;
+  static constexpr uint32_t StorageClassOutput=3;
+
+  std::vector<SpirvDecoration> decorations;
+  std::vector<SpirvVariable> variables;
+
+  SpirvModule(const std::vector<uint32_t> &code){
+    if(code.size()<HeaderWords||code[0]!=Magic)
+      throw std::runtime_error("Not a SPIR-V module");
+
+    for(size_t word=HeaderWords;word<code.size();){
+      uint32_t wordCount=code[word]>>16;
+      uint32_t opcode=code[word]&0xffff;
+      if(wordCount==0||word+wordCount>code.size())
+        throw std::runtime_error("Truncated SPIR-V instruction");
+
+      if(opcode==OpDecorate&&wordCount>=3){
+        decorations.push_back({
+          .target=code[word+1],
+          .decoration=code[word+2],
+          .word=wordCount>=4?(uint32_t)word+3:0,
+          .value=wordCount>=4?code[word+3]:0
+        });
+      }else if(opcode==OpVariable&&wordCount>=4){
+        variables.push_back({
+          .id=code[word+2],
+          .storageClass=code[word+3]
+        });
+      }
+      word+=wordCount;
+    }
+  }
+
+  const SpirvDecoration *Find(uint32_t target,uint32_t decoration)const{
+    for(auto &entry:decorations){
+      if(entry.target==target&&entry.decoration==decoration)
+        return &entry;
+    }
+    return nullptr;
+  }
+
+  //Decorations of one kind, in stream order
+  std::vector<SpirvDecoration> All(uint32_t decoration)const{
+    std::vector<SpirvDecoration> found;
+    for(auto &entry:decorations){
+      if(entry.decoration==decoration&&entry.word!=0)
+        found.push_back(entry);
+    }
+    return found;
+  }
+
+  //Location decorations of the user defined variables in one storage class,
+  //built-ins have no Location and are skipped
+  std::vector<SpirvDecoration> Locations(uint32_t storageClass)const{
+    std::vector<SpirvDecoration> found;
+    for(auto &variable:variables){
+      if(variable.storageClass!=storageClass)
+        continue;
+      if(auto location=Find(variable.id,DecorationLocation);location&&location->word!=0)
+        found.push_back(*location);
+    }
+    return found;
+  }
+};
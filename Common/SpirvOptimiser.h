@@ -0,0 +1,350 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<string_view>
+#include<unordered_map>
+#include<unordered_set>
+#include<mutex>
+#include<chrono>
+#include<format>
+#include<algorithm>
+#include<stdexcept>
+#include<cstdint>
+#include<cstring>
+#include"Spirv.h"
+
+//Shrinks SPIR-V before it is handed to the driver, the way spirv-opt would
+//for the few passes that matter for glslangValidator -V output:
+//  stripDebug       OpSource, OpName, OpLine and friends
+//  deadCode         side effect free instructions whose result is never
+//                   used, then the types and constants nothing refers to
+//  unusedVariables  module scope variables nothing loads from or stores
+//                   to, e.g. the sceneUBO LinkedShaderLayoutFrag.glsl
+//                   declares and never reads. Outputs are kept, the next
+//                   stage's inputs are matched against them.
+//
+//Ids are found by matching operand words, a literal that happens to equal an
+//id keeps that id alive. That only ever makes a pass remove less. Modules
+//with decoration groups are only stripped.
+//
+//The passes change what the driver is given, the repros depend on exactly
+//the unused declarations removed here. Off unless a tool asks for it.
+
+struct SpirvPasses{
+  bool stripDebug=true;
+  bool deadCode=true;
+  bool unusedVariables=true;
+};
+
+struct SpirvStats{
+  uint32_t modules=0;
+  uint64_t wordsBefore=0;
+  uint64_t wordsAfter=0;
+  double optimiseMs=0.0;
+  //Creation of the same modules unoptimised and optimised, only filled in
+  //when comparing
+  uint32_t compared=0;
+  double createBeforeMs=0.0;
+  double createAfterMs=0.0;
+};
+
+class SpirvOptimiser{
+  std::mutex mutex;
+  std::unordered_map<std::string,std::vector<uint32_t>> cache;
+  SpirvStats stats;
+
+  struct Instruction{
+    uint32_t word;
+    uint32_t count;
+    uint32_t opcode;
+    bool inFunction;
+    bool removed;
+  };
+
+  static constexpr uint32_t OpSourceContinued=2;
+  static constexpr uint32_t OpSource=3;
+  static constexpr uint32_t OpSourceExtension=4;
+  static constexpr uint32_t OpName=5;
+  static constexpr uint32_t OpMemberName=6;
+  static constexpr uint32_t OpString=7;
+  static constexpr uint32_t OpLine=8;
+  static constexpr uint32_t OpExtInstImport=11;
+  static constexpr uint32_t OpExtInst=12;
+  static constexpr uint32_t OpEntryPoint=15;
+  static constexpr uint32_t OpFunction=54;
+  static constexpr uint32_t OpFunctionEnd=56;
+  static constexpr uint32_t OpLoad=61;
+  static constexpr uint32_t OpMemberDecorate=72;
+  static constexpr uint32_t OpDecorationGroup=73;
+  static constexpr uint32_t OpGroupDecorate=74;
+  static constexpr uint32_t OpGroupMemberDecorate=75;
+  static constexpr uint32_t OpNoLine=317;
+  static constexpr uint32_t OpModuleProcessed=330;
+  static constexpr uint32_t OpDecorateId=332;
+  static constexpr uint32_t OpDecorateString=5632;
+  static constexpr uint32_t OpMemberDecorateString=5633;
+
+  static constexpr uint32_t MemoryAccessVolatile=0x1;
+  static constexpr uint32_t GlslModf=35;
+  static constexpr uint32_t GlslFrexp=51;
+
+  static bool IsType(uint32_t opcode){
+    return (opcode>=19&&opcode<=38)||opcode==322||opcode==327||opcode==4456||opcode==4472||opcode==5341;
+  }
+
+  static bool IsConstant(uint32_t opcode){
+    return opcode>=41&&opcode<=52;
+  }
+
+  static bool IsDebug(uint32_t opcode){
+    return opcode==OpSourceContinued||opcode==OpSource||opcode==OpSourceExtension||opcode==OpName||
+      opcode==OpMemberName||opcode==OpString||opcode==OpLine||opcode==OpNoLine||opcode==OpModuleProcessed;
+  }
+
+  //Instructions whose first operand is the id they name or decorate
+  static bool IsTargeting(uint32_t opcode){
+    return opcode==OpName||opcode==OpMemberName||opcode==SpirvModule::OpDecorate||opcode==OpMemberDecorate||
+      opcode==OpDecorateId||opcode==OpDecorateString||opcode==OpMemberDecorateString;
+  }
+
+  //Has a result type and result id, reads its operands and nothing else.
+  //Image sampling is included, derivatives have no effect of their own.
+  static bool IsPure(const std::vector<uint32_t> &code,const Instruction &instruction,uint32_t glslSet){
+    auto opcode=instruction.opcode;
+    if(opcode==OpLoad)
+      return instruction.count<5||(code[instruction.word+4]&MemoryAccessVolatile)==0;
+    if(opcode==OpExtInst){
+      if(instruction.count<5||code[instruction.word+3]!=glslSet)
+        return false;
+      auto glslOpcode=code[instruction.word+4];
+      return glslOpcode!=GlslModf&&glslOpcode!=GlslFrexp;
+    }
+    return (opcode>=65&&opcode<=66)||                   //OpAccessChain, OpInBoundsAccessChain
+      (opcode>=79&&opcode<=84)||                        //shuffles and composites
+      (opcode>=86&&opcode<=98)||(opcode==100)||         //sampling, fetch, gather, read, OpImage
+      (opcode>=103&&opcode<=107)||                      //image queries
+      (opcode>=109&&opcode<=124)||                      //conversions
+      (opcode>=126&&opcode<=152)||                      //arithmetic
+      (opcode>=154&&opcode<=157)||                      //OpAny, OpAll, OpIsNan, OpIsInf
+      (opcode>=164&&opcode<=191)||                      //logic and comparisons, OpSelect
+      (opcode>=194&&opcode<=205);                       //bit operations
+  }
+
+  //Result id of a removable instruction, types name theirs first
+  static uint32_t Result(const std::vector<uint32_t> &code,const Instruction &instruction){
+    if(IsType(instruction.opcode))
+      return instruction.count>=2?code[instruction.word+1]:0;
+    return instruction.count>=3?code[instruction.word+2]:0;
+  }
+
+  //Word index of the first interface id, after the zero terminated name
+  static uint32_t InterfaceStart(const std::vector<uint32_t> &code,const Instruction &instruction){
+    for(uint32_t word=3;word<instruction.count;word++){
+      if((code[instruction.word+word]>>24)==0)
+        return word+1;
+    }
+    return instruction.count;
+  }
+
+  static std::vector<Instruction> Parse(const std::vector<uint32_t> &code,uint32_t &glslSet){
+    SpirvModule validated(code);
+    std::vector<Instruction> instructions;
+    bool inFunction=false;
+    for(size_t word=SpirvModule::HeaderWords;word<code.size();){
+      uint32_t count=code[word]>>16;
+      uint32_t opcode=code[word]&0xffff;
+      if(opcode==OpFunction)
+        inFunction=true;
+      instructions.push_back({(uint32_t)word,count,opcode,inFunction,false});
+      if(opcode==OpFunctionEnd)
+        inFunction=false;
+
+      if(opcode==OpExtInstImport&&count>=3){
+        auto name=reinterpret_cast<const char *>(&code[word+2]);
+        if(strncmp(name,"GLSL.std.450",(count-2)*sizeof(uint32_t))==0)
+          glslSet=code[word+1];
+      }
+      word+=count;
+    }
+    return instructions;
+  }
+
+  static void CountUses(const std::vector<uint32_t> &code,const std::vector<Instruction> &instructions,
+    uint32_t glslSet,bool interfaceUses,std::unordered_map<uint32_t,uint32_t> &uses){
+
+    uses.clear();
+    for(auto &instruction:instructions){
+      if(instruction.removed||instruction.opcode==OpName||instruction.opcode==OpMemberName)
+        continue;
+
+      uint32_t first=1;
+      uint32_t last=instruction.count;
+      uint32_t skip=0;
+      if(IsTargeting(instruction.opcode)){
+        //Built-ins mean something without being used, a WorkgroupSize
+        //constant sets the workgroup size
+        if(instruction.opcode==SpirvModule::OpDecorate&&instruction.count>=3&&
+          code[instruction.word+2]==SpirvModule::DecorationBuiltIn)
+          uses[code[instruction.word+1]]++;
+        //Only OpDecorateId has ids past its target
+        if(instruction.opcode!=OpDecorateId)
+          continue;
+        first=3;
+      }else if(instruction.opcode==OpEntryPoint){
+        auto interface=InterfaceStart(code,instruction);
+        uses[code[instruction.word+2]]++;
+        if(!interfaceUses)
+          continue;
+        first=interface;
+      }else if(IsType(instruction.opcode)){
+        skip=1;
+      }else if(instruction.count>=3&&(IsConstant(instruction.opcode)||instruction.opcode==SpirvModule::OpVariable||
+        IsPure(code,instruction,glslSet))){
+        skip=2;
+      }
+
+      for(uint32_t word=first;word<last;word++){
+        if(word!=skip)
+          uses[code[instruction.word+word]]++;
+      }
+    }
+  }
+
+  static bool Unused(const std::unordered_map<uint32_t,uint32_t> &uses,uint32_t id){
+    auto entry=uses.find(id);
+    return entry==uses.end()||entry->second==0;
+  }
+
+public:
+  SpirvPasses passes;
+  //CreateShaders also creates and destroys every call's modules once as
+  //given and once optimised to time the difference, on top of the creation
+  //the caller times itself
+  bool compare=false;
+
+  SpirvOptimiser(SpirvPasses passes={},bool compare=false):passes(passes),compare(compare){}
+
+  std::vector<uint32_t> Optimise(const std::vector<uint32_t> &code){
+    uint32_t glslSet=0;
+    auto instructions=Parse(code,glslSet);
+
+    bool grouped=std::any_of(instructions.begin(),instructions.end(),[](const Instruction &instruction){
+      return instruction.opcode==OpDecorationGroup||instruction.opcode==OpGroupDecorate||
+        instruction.opcode==OpGroupMemberDecorate;
+    });
+    bool nonSemantic=false;
+    for(auto &instruction:instructions){
+      if(instruction.opcode==OpExtInstImport&&instruction.count>=3){
+        std::string_view name(reinterpret_cast<const char *>(&code[instruction.word+2]));
+        nonSemantic|=name.starts_with("NonSemantic.");
+      }
+    }
+
+    if(passes.stripDebug){
+      for(auto &instruction:instructions){
+        //NonSemantic debug info refers to its OpStrings
+        if(IsDebug(instruction.opcode)&&!(nonSemantic&&instruction.opcode==OpString))
+          instruction.removed=true;
+      }
+    }
+
+    std::unordered_set<uint32_t> removedIds;
+    if(!grouped&&(passes.deadCode||passes.unusedVariables)){
+      std::unordered_map<uint32_t,uint32_t> uses;
+      for(bool changed=true;changed;){
+        changed=false;
+        CountUses(code,instructions,glslSet,!passes.unusedVariables,uses);
+        for(auto &instruction:instructions){
+          if(instruction.removed)
+            continue;
+
+          bool candidate=false;
+          if(instruction.inFunction)
+            candidate=passes.deadCode&&IsPure(code,instruction,glslSet);
+          else if(IsType(instruction.opcode)||IsConstant(instruction.opcode))
+            candidate=passes.deadCode;
+          else if(instruction.opcode==SpirvModule::OpVariable&&instruction.count>=4)
+            candidate=passes.unusedVariables&&code[instruction.word+3]!=SpirvModule::StorageClassOutput;
+
+          auto result=Result(code,instruction);
+          if(candidate&&result!=0&&Unused(uses,result)){
+            instruction.removed=true;
+            removedIds.insert(result);
+            changed=true;
+          }
+        }
+      }
+
+      for(auto &instruction:instructions){
+        if(!instruction.removed&&IsTargeting(instruction.opcode)&&instruction.count>=2&&
+          removedIds.contains(code[instruction.word+1]))
+          instruction.removed=true;
+      }
+    }
+
+    std::vector<uint32_t> optimised(code.begin(),code.begin()+SpirvModule::HeaderWords);
+    for(auto &instruction:instructions){
+      if(instruction.removed)
+        continue;
+      if(instruction.opcode==OpEntryPoint&&!removedIds.empty()){
+        auto interface=InterfaceStart(code,instruction);
+        auto start=optimised.size();
+        optimised.insert(optimised.end(),code.begin()+instruction.word,code.begin()+instruction.word+interface);
+        for(uint32_t word=interface;word<instruction.count;word++){
+          if(!removedIds.contains(code[instruction.word+word]))
+            optimised.push_back(code[instruction.word+word]);
+        }
+        optimised[start]=(uint32_t)((optimised.size()-start)<<16)|OpEntryPoint;
+        continue;
+      }
+      optimised.insert(optimised.end(),code.begin()+instruction.word,code.begin()+instruction.word+instruction.count);
+    }
+    return optimised;
+  }
+
+  //Optimised once per distinct module, the shader scenario recreates the
+  //same shaders every iteration
+  const std::vector<uint32_t> &Cached(const uint32_t *code,size_t bytes){
+    std::string_view key(reinterpret_cast<const char *>(code),bytes);
+    std::lock_guard lock(mutex);
+    auto entry=cache.find(std::string(key));
+    if(entry!=cache.end())
+      return entry->second;
+
+    auto begin=std::chrono::steady_clock::now();
+    auto optimised=Optimise(std::vector<uint32_t>(code,code+bytes/sizeof(uint32_t)));
+    stats.optimiseMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-begin).count();
+    stats.modules++;
+    stats.wordsBefore+=bytes/sizeof(uint32_t);
+    stats.wordsAfter+=optimised.size();
+    return cache.emplace(std::string(key),std::move(optimised)).first->second;
+  }
+
+  void Compared(double beforeMs,double afterMs){
+    std::lock_guard lock(mutex);
+    stats.compared++;
+    stats.createBeforeMs+=beforeMs;
+    stats.createAfterMs+=afterMs;
+  }
+
+  SpirvStats Totals(){
+    std::lock_guard lock(mutex);
+    return stats;
+  }
+
+  std::string Report(){
+    auto totals=Totals();
+    auto Change=[](double before,double after){
+      return before>0.0?(after-before)/before*100.0:0.0;
+    };
+    auto report=std::format("SPIR-V: {} modules, {} -> {} bytes ({:+.1f}%), optimised in {:.3f} ms",
+      totals.modules,totals.wordsBefore*4,totals.wordsAfter*4,
+      Change((double)totals.wordsBefore,(double)totals.wordsAfter),totals.optimiseMs);
+    if(totals.compared>0){
+      report+=std::format("\nvkCreateShadersEXT: {} calls, {:.3f} -> {:.3f} ms ({:+.1f}%)",
+        totals.compared,totals.createBeforeMs,totals.createAfterMs,Change(totals.createBeforeMs,totals.createAfterMs));
+    }
+    return report;
+  }
+
+};
@@ -0,0 +1,920 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<unordered_map>
+#include<filesystem>
+#include<fstream>
+#include<format>
+#include<type_traits>
+#include<cstring>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"RenderTargetPool.h"
+
+//Binary trace of a scenario: the objects it creates, the descriptors it
+//writes, the contents of its mapped buffers and every frame graph it submits
+//together with the commands of each pass. Enough to rerun it bit for bit
+//without the scenario's source.
+//
+//The file is a TraceHeader followed by records. A record is a TraceRecord,
+//its fixed payload and optional arrays, each starting on an 8 byte boundary,
+//so a mapped file is walked in place without parsing or copying.
+//
+//Handles never reach the file. Objects are numbered in creation order and
+//device addresses are stored relative to the buffer they fall in, a replay
+//resolves both against its own objects. Descriptor sizes and binding offsets
+//are stored as captured, a trace replays on the driver it was captured on.
+
+enum class TraceOp:uint16_t{
+  //Setup, also valid inside a frame
+  CreateSetLayout=1,
+  CreatePipelineLayout,
+  CreateBuffer,
+  BufferData,
+  CreateImage,
+  CreateShaders,
+  Shader,
+  DestroyShader,
+  GetDescriptor,
+  CreateSampler,
+
+  //Frame graph, resources are numbered in declaration order
+  Frame,
+  GraphBuffer,
+  GraphImage,
+  Pass,
+  Use,
+  Export,
+  Submit,
+
+  //Commands of one pass, between PassBegin and PassEnd
+  PassBegin,
+  PassEnd,
+  BindShaders,
+  BindDescriptorBuffers,
+  SetDescriptorBufferOffsets,
+  PushConstants,
+  SetVertexInput,
+  BindVertexBuffers,
+  BeginRendering,
+  EndRendering,
+  SetViewport,
+  SetScissor,
+  SetState,
+  SetSampleMask,
+  SetColorBlendEnable,
+  SetColorWriteMask,
+  Dispatch,
+  Draw,
+  BindIndexBuffer,
+  DrawIndexed
+};
+
+inline constexpr uint32_t TraceMagic=0x54564b41;
+inline constexpr uint32_t TraceVersion=2;
+inline constexpr uint32_t TraceNoObject=~0u;
+
+struct TraceHeader{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverID;
+  uint32_t apiVersion;
+  char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+};
+static_assert(sizeof(TraceHeader)%8==0,"Records have to start 8 byte aligned");
+
+//size covers the record, payload and arrays included
+struct TraceRecord{
+  TraceOp op;
+  uint16_t reserved;
+  uint32_t size;
+};
+
+//A device address as an offset from a buffer of the trace. Addresses below
+//every buffer keep buffer TraceNoObject and the absolute value.
+struct TraceAddress{
+  uint32_t buffer;
+  uint32_t reserved;
+  int64_t offset;
+};
+
+#pragma region Payloads
+struct TraceBinding{
+  uint32_t binding;
+  uint32_t type;
+  uint32_t count;
+  uint32_t stages;
+  //VkDescriptorBindingFlags
+  uint32_t flags;
+};
+
+//Followed by bindingCount TraceBinding
+struct TraceSetLayout{
+  uint32_t id;
+  uint32_t flags;
+  uint32_t bindingCount;
+};
+
+//Followed by setLayoutCount ids and pushConstantCount VkPushConstantRange
+struct TracePipelineLayout{
+  uint32_t id;
+  uint32_t setLayoutCount;
+  uint32_t pushConstantCount;
+};
+
+struct TraceBuffer{
+  uint32_t id;
+  uint32_t usage;
+  uint64_t size;
+};
+
+//Followed by size bytes
+struct TraceBufferData{
+  uint32_t id;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct TraceImage{
+  uint32_t id;
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;
+  uint32_t usage;
+  uint32_t samples;
+};
+
+struct TraceSampler{
+  uint32_t id;
+  uint32_t flags;
+  uint32_t magFilter;
+  uint32_t minFilter;
+  uint32_t mipmapMode;
+  uint32_t addressModeU;
+  uint32_t addressModeV;
+  uint32_t addressModeW;
+  float mipLodBias;
+  uint32_t anisotropyEnable;
+  float maxAnisotropy;
+  uint32_t compareEnable;
+  uint32_t compareOp;
+  float minLod;
+  float maxLod;
+  uint32_t borderColor;
+  uint32_t unnormalizedCoordinates;
+};
+
+//One per shader of a vkCreateShadersEXT call, followed by setLayoutCount ids,
+//pushConstantCount VkPushConstantRange and codeSize bytes. Shaders take the
+//next ids in order, whether or not the call returned a handle for them.
+struct TraceShader{
+  uint32_t flags;
+  uint32_t stage;
+  uint32_t nextStage;
+  uint32_t setLayoutCount;
+  uint32_t pushConstantCount;
+  uint64_t codeSize;
+  char name[32];
+};
+
+//Followed by shaderCount Shader records
+struct TraceCreateShaders{
+  uint32_t shaderCount;
+};
+
+struct TraceObject{
+  uint32_t id;
+};
+
+//Written size bytes into buffer at offset. Buffer descriptors use address,
+//range and format, image and sampler descriptors image, sampler and layout.
+struct TraceDescriptor{
+  uint32_t buffer;
+  uint32_t type;
+  uint64_t offset;
+  uint64_t size;
+  TraceAddress address;
+  uint64_t range;
+  uint32_t format;
+  uint32_t image;
+  uint32_t sampler;
+  uint32_t layout;
+};
+
+struct TraceGraphBuffer{
+  //TraceNoObject for a transient buffer of the graph
+  uint32_t id;
+  uint32_t usage;
+  uint64_t size;
+};
+
+struct TraceGraphImage{
+  uint32_t id;
+  uint32_t aspect;
+};
+
+//Followed by the pass name
+struct TracePass{
+  uint32_t queue;
+  uint32_t nameSize;
+};
+
+//Applies to the last Pass, or to the graph's exports for Export
+struct TraceUse{
+  uint32_t resource;
+  uint32_t layout;
+  uint64_t stage;
+  uint64_t access;
+  uint32_t discard;
+};
+
+struct TracePassBegin{
+  uint32_t pass;
+};
+
+//Followed by count stages and count shader ids
+struct TraceBindShaders{
+  uint32_t count;
+};
+
+//Followed by count TraceAddress and count usages
+struct TraceBindDescriptorBuffers{
+  uint32_t count;
+};
+
+//Followed by count offsets and count buffer indices
+struct TraceDescriptorBufferOffsets{
+  uint32_t bindPoint;
+  uint32_t layout;
+  uint32_t firstSet;
+  uint32_t count;
+};
+
+//Followed by size bytes
+struct TracePushConstants{
+  uint32_t layout;
+  uint32_t stages;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct TraceVertexBinding{
+  uint32_t binding;
+  uint32_t stride;
+  uint32_t inputRate;
+  uint32_t divisor;
+};
+
+struct TraceVertexAttribute{
+  uint32_t location;
+  uint32_t binding;
+  uint32_t format;
+  uint32_t offset;
+};
+
+//Followed by the bindings and the attributes
+struct TraceVertexInput{
+  uint32_t bindingCount;
+  uint32_t attributeCount;
+};
+
+//Followed by count buffer ids, offsets, sizes if hasSizes and strides if
+//hasStrides
+struct TraceVertexBuffers{
+  uint32_t firstBinding;
+  uint32_t count;
+  uint32_t hasSizes;
+  uint32_t hasStrides;
+};
+
+struct TraceAttachment{
+  uint32_t view;
+  uint32_t layout;
+  uint32_t resolveMode;
+  uint32_t resolveView;
+  uint32_t resolveLayout;
+  uint32_t loadOp;
+  uint32_t storeOp;
+  VkClearValue clear;
+};
+
+//Followed by colorCount attachments, then depth and stencil when present
+struct TraceRendering{
+  uint32_t flags;
+  VkRect2D area;
+  uint32_t layerCount;
+  uint32_t viewMask;
+  uint32_t colorCount;
+  uint32_t hasDepth;
+  uint32_t hasStencil;
+};
+
+//Followed by count VkViewport or VkRect2D
+struct TraceCount{
+  uint32_t count;
+};
+
+//Dynamic state with a single 32-bit argument, named by its VkDynamicState
+struct TraceState{
+  uint32_t state;
+  uint32_t value;
+};
+
+//Followed by (samples+31)/32 mask words
+struct TraceSampleMask{
+  uint32_t samples;
+};
+
+//Followed by count VkBool32 or VkColorComponentFlags
+struct TraceAttachmentRange{
+  uint32_t first;
+  uint32_t count;
+};
+
+struct TraceDispatch{
+  uint32_t x;
+  uint32_t y;
+  uint32_t z;
+};
+
+struct TraceDraw{
+  uint32_t vertexCount;
+  uint32_t instanceCount;
+  uint32_t firstVertex;
+  uint32_t firstInstance;
+};
+
+struct TraceIndexBuffer{
+  uint32_t buffer;
+  uint32_t indexType;
+  uint64_t offset;
+  //VK_WHOLE_SIZE when bound without VK_KHR_maintenance5
+  uint64_t size;
+};
+
+struct TraceDrawIndexed{
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t firstInstance;
+};
+#pragma endregion
+
+inline constexpr size_t TraceAlign(size_t size){
+  return (size+7)&~size_t(7);
+}
+
+//Streams records to the file as they are made and flushes each one, a
+//capture of a scenario that takes the driver down still holds everything up
+//to the faulting call. Mapped buffers are captured once, when the first
+//frame begins.
+class TraceWriter{
+  struct BufferEntry{
+    VkBuffer buffer;
+    uint32_t id;
+    VkDeviceAddress address;
+    VkDeviceSize size;
+    const void *mapped;
+  };
+
+  std::ofstream file;
+  std::vector<uint8_t> record;
+  std::unordered_map<uint64_t,uint32_t> ids;
+  std::vector<BufferEntry> buffers;
+  std::vector<TraceDescriptor> descriptors;
+  uint32_t nextId=0;
+  uint32_t frame=0;
+
+  template<typename T>
+  static uint64_t Key(T handle){
+    if constexpr(std::is_pointer_v<T>)
+      return (uint64_t)(uintptr_t)handle;
+    else
+      return (uint64_t)handle;
+  }
+
+  template<typename T>
+  void Begin(TraceOp op,const T &payload){
+    record.assign(sizeof(TraceRecord),0);
+    auto header=reinterpret_cast<TraceRecord *>(record.data());
+    header->op=op;
+    Append(static_cast<const void *>(&payload),sizeof(payload));
+  }
+
+  void Append(const void *data,size_t size){
+    auto offset=record.size();
+    record.resize(TraceAlign(offset+size),0);
+    if(size>0)
+      memcpy(record.data()+offset,data,size);
+  }
+
+  template<typename T>
+  void AppendArray(const T *data,size_t count){
+    Append(static_cast<const void *>(data),count*sizeof(T));
+  }
+
+  void End(){
+    reinterpret_cast<TraceRecord *>(record.data())->size=(uint32_t)record.size();
+    file.write(reinterpret_cast<const char *>(record.data()),record.size());
+    file.flush();
+  }
+
+  template<typename T>
+  void Write(TraceOp op,const T &payload){
+    Begin(op,payload);
+    End();
+  }
+
+  void WriteDescriptor(const TraceDescriptor &descriptor){
+    Write(TraceOp::GetDescriptor,descriptor);
+  }
+
+public:
+  TraceWriter(const std::filesystem::path &path,const VkPhysicalDeviceProperties &properties,VkDriverId driverID):
+    file(path,std::ios::binary|std::ios::out|std::ios::trunc){
+    if(!file.is_open())
+      throw std::runtime_error(std::format("Unable to open trace {}",path.string()));
+
+    TraceHeader header={
+      .magic=TraceMagic,
+      .version=TraceVersion,
+      .vendorID=properties.vendorID,
+      .deviceID=properties.deviceID,
+      .driverID=(uint32_t)driverID,
+      .apiVersion=properties.apiVersion,
+      .deviceName={}
+    };
+    strncpy(header.deviceName,properties.deviceName,sizeof(header.deviceName)-1);
+    file.write(reinterpret_cast<const char *>(&header),sizeof(header));
+    file.flush();
+  }
+
+  TraceWriter(const TraceWriter &)=delete;
+  TraceWriter &operator=(const TraceWriter &)=delete;
+
+  template<typename T>
+  uint32_t Add(T handle){
+    auto id=nextId++;
+    ids[Key(handle)]=id;
+    return id;
+  }
+
+  template<typename T>
+  uint32_t Id(T handle)const{
+    if(!handle)
+      return TraceNoObject;
+    auto found=ids.find(Key(handle));
+    if(found==ids.end())
+      throw std::runtime_error("Handle was not created while tracing");
+    return found->second;
+  }
+
+  TraceAddress Address(VkDeviceAddress address)const{
+    const BufferEntry *closest=nullptr;
+    for(auto &entry:buffers){
+      if(entry.address<=address&&(!closest||entry.address>closest->address))
+        closest=&entry;
+    }
+    if(!closest||address==0)
+      return {.buffer=TraceNoObject,.reserved=0,.offset=(int64_t)address};
+    return {.buffer=closest->id,.reserved=0,.offset=(int64_t)(address-closest->address)};
+  }
+
+  //Marks the start of a frame. The first one captures every mapped buffer
+  //and repeats the descriptors written so far on top of it.
+  void BeginFrame(){
+    if(frame==0){
+      for(auto &entry:buffers){
+        if(!entry.mapped)
+          continue;
+        Begin(TraceOp::BufferData,TraceBufferData{.id=entry.id,.reserved=0,.offset=0,.size=entry.size});
+        Append(entry.mapped,(size_t)entry.size);
+        End();
+      }
+      for(auto &descriptor:descriptors)
+        WriteDescriptor(descriptor);
+      descriptors.clear();
+    }
+    Write(TraceOp::Frame,TraceObject{.id=frame++});
+  }
+
+  //*************** Objects ***********************
+  void SetLayout(VkDescriptorSetLayout layout,VkDescriptorSetLayoutCreateFlags flags,
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings,const std::vector<VkDescriptorBindingFlags> &bindingFlags){
+
+    std::vector<TraceBinding> entries;
+    for(size_t index=0;index<bindings.size();index++){
+      auto &binding=bindings[index];
+      entries.push_back({
+        .binding=binding.binding,
+        .type=(uint32_t)binding.descriptorType,
+        .count=binding.descriptorCount,
+        .stages=binding.stageFlags,
+        .flags=index<bindingFlags.size()?bindingFlags[index]:0
+      });
+    }
+    Begin(TraceOp::CreateSetLayout,TraceSetLayout{.id=Add(layout),.flags=flags,.bindingCount=(uint32_t)bindings.size()});
+    AppendArray(entries.data(),entries.size());
+    End();
+  }
+
+  void PipelineLayout(VkPipelineLayout layout,const VkPipelineLayoutCreateInfo &info){
+    Begin(TraceOp::CreatePipelineLayout,TracePipelineLayout{
+      .id=Add(layout),
+      .setLayoutCount=info.setLayoutCount,
+      .pushConstantCount=info.pushConstantRangeCount
+    });
+    std::vector<uint32_t> setLayouts(info.setLayoutCount);
+    for(uint32_t index=0;index<info.setLayoutCount;index++)
+      setLayouts[index]=Id(info.pSetLayouts[index]);
+    AppendArray(setLayouts.data(),setLayouts.size());
+    AppendArray(info.pPushConstantRanges,info.pushConstantRangeCount);
+    End();
+  }
+
+  void Buffer(VkBuffer buffer,VkDeviceSize size,VkBufferUsageFlags usage,VkDeviceAddress address,const void *mapped){
+    auto id=Add(buffer);
+    buffers.push_back({.buffer=buffer,.id=id,.address=address,.size=size,.mapped=mapped});
+    Write(TraceOp::CreateBuffer,TraceBuffer{.id=id,.usage=usage,.size=size});
+  }
+
+  //Host writes to a mapped buffer after the first frame, replayed in place
+  //before the frame's next submission
+  void BufferData(VkBuffer buffer,VkDeviceSize offset,VkDeviceSize size,const void *data){
+    Begin(TraceOp::BufferData,TraceBufferData{.id=Id(buffer),.reserved=0,.offset=offset,.size=size});
+    Append(data,(size_t)size);
+    End();
+  }
+
+  void Image(const RenderTarget &target){
+    auto id=Add(target.image);
+    ids[Key(target.view)]=id;
+    Write(TraceOp::CreateImage,TraceImage{
+      .id=id,
+      .width=target.key.extent.width,
+      .height=target.key.extent.height,
+      .format=(uint32_t)target.key.format,
+      .usage=target.key.usage,
+      .samples=(uint32_t)target.key.samples
+    });
+  }
+
+  void Sampler(VkSampler sampler,const VkSamplerCreateInfo &info){
+    Write(TraceOp::CreateSampler,TraceSampler{
+      .id=Add(sampler),
+      .flags=info.flags,
+      .magFilter=(uint32_t)info.magFilter,
+      .minFilter=(uint32_t)info.minFilter,
+      .mipmapMode=(uint32_t)info.mipmapMode,
+      .addressModeU=(uint32_t)info.addressModeU,
+      .addressModeV=(uint32_t)info.addressModeV,
+      .addressModeW=(uint32_t)info.addressModeW,
+      .mipLodBias=info.mipLodBias,
+      .anisotropyEnable=info.anisotropyEnable,
+      .maxAnisotropy=info.maxAnisotropy,
+      .compareEnable=info.compareEnable,
+      .compareOp=(uint32_t)info.compareOp,
+      .minLod=info.minLod,
+      .maxLod=info.maxLod,
+      .borderColor=(uint32_t)info.borderColor,
+      .unnormalizedCoordinates=info.unnormalizedCoordinates
+    });
+  }
+
+  //Recorded before the driver sees the call, shaders then get their ids
+  //from Created() once it returns
+  void CreateShaders(uint32_t count,const VkShaderCreateInfoEXT *infos){
+    Begin(TraceOp::CreateShaders,TraceCreateShaders{.shaderCount=count});
+    End();
+    for(uint32_t index=0;index<count;index++){
+      auto &info=infos[index];
+      TraceShader shader={
+        .flags=info.flags,
+        .stage=(uint32_t)info.stage,
+        .nextStage=info.nextStage,
+        .setLayoutCount=info.setLayoutCount,
+        .pushConstantCount=info.pushConstantRangeCount,
+        .codeSize=info.codeSize,
+        .name={}
+      };
+      strncpy(shader.name,info.pName,sizeof(shader.name)-1);
+      Begin(TraceOp::Shader,shader);
+      std::vector<uint32_t> setLayouts(info.setLayoutCount);
+      for(uint32_t layout=0;layout<info.setLayoutCount;layout++)
+        setLayouts[layout]=Id(info.pSetLayouts[layout]);
+      AppendArray(setLayouts.data(),setLayouts.size());
+      AppendArray(info.pPushConstantRanges,info.pushConstantRangeCount);
+      Append(info.pCode,info.codeSize);
+      End();
+    }
+  }
+
+  //Handles the call returned, numbered the way the replay numbers them
+  void Created(uint32_t count,const VkShaderEXT *shaders){
+    for(uint32_t index=0;index<count;index++){
+      if(shaders[index])
+        Add(shaders[index]);
+      else
+        nextId++;
+    }
+  }
+
+  void DestroyShader(VkShaderEXT shader){
+    Write(TraceOp::DestroyShader,TraceObject{.id=Id(shader)});
+    ids.erase(Key(shader));
+  }
+
+  void Descriptor(const VkDescriptorGetInfoEXT &info,size_t size,VkBuffer buffer,VkDeviceSize offset){
+    const VkDescriptorAddressInfoEXT *addressInfo=nullptr;
+    const VkDescriptorImageInfo *imageInfo=nullptr;
+    VkSampler sampler=VK_NULL_HANDLE;
+    switch(info.type){
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+      sampler=*info.data.pSampler;
+      break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      imageInfo=info.data.pCombinedImageSampler;
+      sampler=imageInfo->sampler;
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      imageInfo=info.data.pSampledImage;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      imageInfo=info.data.pStorageImage;
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      addressInfo=info.data.pUniformBuffer;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      addressInfo=info.data.pStorageBuffer;
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      addressInfo=info.data.pUniformTexelBuffer;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      addressInfo=info.data.pStorageTexelBuffer;
+      break;
+    default:
+      throw std::runtime_error(std::format("Descriptor type {} cannot be traced",(uint32_t)info.type));
+    }
+
+    TraceDescriptor descriptor={
+      .buffer=Id(buffer),
+      .type=(uint32_t)info.type,
+      .offset=offset,
+      .size=size,
+      .address=Address(addressInfo?addressInfo->address:0),
+      .range=addressInfo?addressInfo->range:0,
+      .format=addressInfo?(uint32_t)addressInfo->format:0,
+      .image=imageInfo?Id(imageInfo->imageView):TraceNoObject,
+      .sampler=Id(sampler),
+      .layout=imageInfo?(uint32_t)imageInfo->imageLayout:0
+    };
+    WriteDescriptor(descriptor);
+    if(frame==0)
+      descriptors.push_back(descriptor);
+  }
+
+  //*************** Frame graph *******************
+  void GraphBuffer(VkBuffer buffer){
+    Write(TraceOp::GraphBuffer,TraceGraphBuffer{.id=Id(buffer),.usage=0,.size=0});
+  }
+
+  void GraphTransient(VkDeviceSize size,VkBufferUsageFlags usage){
+    Write(TraceOp::GraphBuffer,TraceGraphBuffer{.id=TraceNoObject,.usage=usage,.size=size});
+  }
+
+  void GraphImage(VkImage image,VkImageAspectFlags aspect){
+    Write(TraceOp::GraphImage,TraceGraphImage{.id=Id(image),.aspect=aspect});
+  }
+
+  void Pass(const std::string &name,uint32_t queue){
+    Begin(TraceOp::Pass,TracePass{.queue=queue,.nameSize=(uint32_t)name.size()+1});
+    Append(name.c_str(),name.size()+1);
+    End();
+  }
+
+  void Use(TraceOp op,uint32_t resource,VkPipelineStageFlags2 stage,VkAccessFlags2 access,VkImageLayout layout,bool discard){
+    Write(op,TraceUse{
+      .resource=resource,
+      .layout=(uint32_t)layout,
+      .stage=stage,
+      .access=access,
+      .discard=discard?1u:0u
+    });
+  }
+
+  void PassBegin(uint32_t pass){
+    Write(TraceOp::PassBegin,TracePassBegin{.pass=pass});
+  }
+
+  void PassEnd(){
+    Write(TraceOp::PassEnd,TraceObject{.id=0});
+  }
+
+  void Submit(){
+    Write(TraceOp::Submit,TraceObject{.id=0});
+  }
+
+  //*************** Commands **********************
+  void BindShaders(uint32_t count,const VkShaderStageFlagBits *stages,const VkShaderEXT *shaders){
+    Begin(TraceOp::BindShaders,TraceBindShaders{.count=count});
+    std::vector<uint32_t> values(count);
+    for(uint32_t index=0;index<count;index++)
+      values[index]=(uint32_t)stages[index];
+    AppendArray(values.data(),count);
+    for(uint32_t index=0;index<count;index++)
+      values[index]=shaders?Id(shaders[index]):TraceNoObject;
+    AppendArray(values.data(),count);
+    End();
+  }
+
+  void BindDescriptorBuffers(uint32_t count,const VkDescriptorBufferBindingInfoEXT *infos){
+    Begin(TraceOp::BindDescriptorBuffers,TraceBindDescriptorBuffers{.count=count});
+    std::vector<TraceAddress> addresses(count);
+    std::vector<uint32_t> usages(count);
+    for(uint32_t index=0;index<count;index++){
+      addresses[index]=Address(infos[index].address);
+      usages[index]=infos[index].usage;
+    }
+    AppendArray(addresses.data(),count);
+    AppendArray(usages.data(),count);
+    End();
+  }
+
+  void SetDescriptorBufferOffsets(VkPipelineBindPoint bindPoint,VkPipelineLayout layout,uint32_t firstSet,
+    uint32_t count,const uint32_t *indices,const VkDeviceSize *offsets){
+
+    Begin(TraceOp::SetDescriptorBufferOffsets,TraceDescriptorBufferOffsets{
+      .bindPoint=(uint32_t)bindPoint,
+      .layout=Id(layout),
+      .firstSet=firstSet,
+      .count=count
+    });
+    AppendArray(offsets,count);
+    AppendArray(indices,count);
+    End();
+  }
+
+  void PushConstants(VkPipelineLayout layout,VkShaderStageFlags stages,uint32_t offset,uint32_t size,const void *values){
+    Begin(TraceOp::PushConstants,TracePushConstants{
+      .layout=Id(layout),
+      .stages=stages,
+      .offset=offset,
+      .size=size
+    });
+    Append(values,size);
+    End();
+  }
+
+  void SetVertexInput(uint32_t bindingCount,const VkVertexInputBindingDescription2EXT *bindings,
+    uint32_t attributeCount,const VkVertexInputAttributeDescription2EXT *attributes){
+
+    std::vector<TraceVertexBinding> bindingEntries(bindingCount);
+    for(uint32_t index=0;index<bindingCount;index++){
+      auto &binding=bindings[index];
+      bindingEntries[index]={
+        .binding=binding.binding,
+        .stride=binding.stride,
+        .inputRate=(uint32_t)binding.inputRate,
+        .divisor=binding.divisor
+      };
+    }
+    std::vector<TraceVertexAttribute> attributeEntries(attributeCount);
+    for(uint32_t index=0;index<attributeCount;index++){
+      auto &attribute=attributes[index];
+      attributeEntries[index]={
+        .location=attribute.location,
+        .binding=attribute.binding,
+        .format=(uint32_t)attribute.format,
+        .offset=attribute.offset
+      };
+    }
+    Begin(TraceOp::SetVertexInput,TraceVertexInput{.bindingCount=bindingCount,.attributeCount=attributeCount});
+    AppendArray(bindingEntries.data(),bindingCount);
+    AppendArray(attributeEntries.data(),attributeCount);
+    End();
+  }
+
+  void BindVertexBuffers(uint32_t firstBinding,uint32_t count,const VkBuffer *vertexBuffers,
+    const VkDeviceSize *offsets,const VkDeviceSize *sizes,const VkDeviceSize *strides){
+
+    Begin(TraceOp::BindVertexBuffers,TraceVertexBuffers{
+      .firstBinding=firstBinding,
+      .count=count,
+      .hasSizes=sizes?1u:0u,
+      .hasStrides=strides?1u:0u
+    });
+    std::vector<uint32_t> bufferIds(count);
+    for(uint32_t index=0;index<count;index++)
+      bufferIds[index]=Id(vertexBuffers[index]);
+    AppendArray(bufferIds.data(),count);
+    AppendArray(offsets,count);
+    if(sizes)
+      AppendArray(sizes,count);
+    if(strides)
+      AppendArray(strides,count);
+    End();
+  }
+
+  void BeginRendering(const VkRenderingInfo &info){
+    Begin(TraceOp::BeginRendering,TraceRendering{
+      .flags=info.flags,
+      .area=info.renderArea,
+      .layerCount=info.layerCount,
+      .viewMask=info.viewMask,
+      .colorCount=info.colorAttachmentCount,
+      .hasDepth=info.pDepthAttachment?1u:0u,
+      .hasStencil=info.pStencilAttachment?1u:0u
+    });
+    std::vector<TraceAttachment> attachments;
+    auto AddAttachment=[&](const VkRenderingAttachmentInfo &attachment){
+      attachments.push_back({
+        .view=Id(attachment.imageView),
+        .layout=(uint32_t)attachment.imageLayout,
+        .resolveMode=(uint32_t)attachment.resolveMode,
+        .resolveView=Id(attachment.resolveImageView),
+        .resolveLayout=(uint32_t)attachment.resolveImageLayout,
+        .loadOp=(uint32_t)attachment.loadOp,
+        .storeOp=(uint32_t)attachment.storeOp,
+        .clear=attachment.clearValue
+      });
+    };
+    for(uint32_t index=0;index<info.colorAttachmentCount;index++)
+      AddAttachment(info.pColorAttachments[index]);
+    if(info.pDepthAttachment)
+      AddAttachment(*info.pDepthAttachment);
+    if(info.pStencilAttachment)
+      AddAttachment(*info.pStencilAttachment);
+    AppendArray(attachments.data(),attachments.size());
+    End();
+  }
+
+  void EndRendering(){
+    Write(TraceOp::EndRendering,TraceObject{.id=0});
+  }
+
+  void SetViewport(uint32_t count,const VkViewport *viewports){
+    Begin(TraceOp::SetViewport,TraceCount{.count=count});
+    AppendArray(viewports,count);
+    End();
+  }
+
+  void SetScissor(uint32_t count,const VkRect2D *scissors){
+    Begin(TraceOp::SetScissor,TraceCount{.count=count});
+    AppendArray(scissors,count);
+    End();
+  }
+
+  void SetState(VkDynamicState state,uint32_t value){
+    Write(TraceOp::SetState,TraceState{.state=(uint32_t)state,.value=value});
+  }
+
+  void SetSampleMask(VkSampleCountFlagBits samples,const VkSampleMask *mask){
+    Begin(TraceOp::SetSampleMask,TraceSampleMask{.samples=(uint32_t)samples});
+    AppendArray(mask,((uint32_t)samples+31)/32);
+    End();
+  }
+
+  void SetAttachmentRange(TraceOp op,uint32_t first,uint32_t count,const uint32_t *values){
+    Begin(op,TraceAttachmentRange{.first=first,.count=count});
+    AppendArray(values,count);
+    End();
+  }
+
+  void Dispatch(uint32_t x,uint32_t y,uint32_t z){
+    Write(TraceOp::Dispatch,TraceDispatch{.x=x,.y=y,.z=z});
+  }
+
+  void Draw(uint32_t vertexCount,uint32_t instanceCount,uint32_t firstVertex,uint32_t firstInstance){
+    Write(TraceOp::Draw,TraceDraw{
+      .vertexCount=vertexCount,
+      .instanceCount=instanceCount,
+      .firstVertex=firstVertex,
+      .firstInstance=firstInstance
+    });
+  }
+
+  void BindIndexBuffer(VkBuffer buffer,VkDeviceSize offset,VkDeviceSize size,VkIndexType indexType){
+    Write(TraceOp::BindIndexBuffer,TraceIndexBuffer{
+      .buffer=Id(buffer),
+      .indexType=(uint32_t)indexType,
+      .offset=offset,
+      .size=size
+    });
+  }
+
+  void DrawIndexed(uint32_t indexCount,uint32_t instanceCount,uint32_t firstIndex,int32_t vertexOffset,uint32_t firstInstance){
+    Write(TraceOp::DrawIndexed,TraceDrawIndexed{
+      .indexCount=indexCount,
+      .instanceCount=instanceCount,
+      .firstIndex=firstIndex,
+      .vertexOffset=vertexOffset,
+      .firstInstance=firstInstance
+    });
+  }
+};
@@ -0,0 +1,209 @@
+#pragma once
+#include<vulkan/vulkan.h>
+#include"HeadlessDevice.h"
+#include"Trace.h"
+
+//The commands the scenarios record, forwarded to the command buffer and
+//written to the context's trace while one is being captured. Every call is
+//traced before it reaches the driver. Without a trace each method is the
+//Vulkan call and a null check.
+class TracedCommands{
+  const HeadlessDevice &context;
+  VkCommandBuffer CMDBuffer;
+  TraceWriter *trace;
+
+  void State(VkDynamicState state,uint32_t value){
+    if(trace)
+      trace->SetState(state,value);
+  }
+
+public:
+  TracedCommands(const HeadlessDevice &context,VkCommandBuffer CMDBuffer):
+    context(context),CMDBuffer(CMDBuffer),trace(context.trace){}
+
+  void BindShaders(uint32_t count,const VkShaderStageFlagBits *stages,const VkShaderEXT *shaders){
+    if(trace)
+      trace->BindShaders(count,stages,shaders);
+    context.dispatch.vkCmdBindShadersEXT(CMDBuffer,count,stages,shaders);
+  }
+
+  //Pipelines have no place in the trace format, GraphicsPipelines refuses to
+  //create any while capturing so there is nothing to record here
+  void BindPipeline(VkPipelineBindPoint bindPoint,VkPipeline pipeline){
+    context.dispatch.vkCmdBindPipeline(CMDBuffer,bindPoint,pipeline);
+  }
+
+  void BindDescriptorBuffers(uint32_t count,const VkDescriptorBufferBindingInfoEXT *infos){
+    if(trace)
+      trace->BindDescriptorBuffers(count,infos);
+    context.dispatch.vkCmdBindDescriptorBuffersEXT(CMDBuffer,count,infos);
+  }
+
+  void SetDescriptorBufferOffsets(VkPipelineBindPoint bindPoint,VkPipelineLayout layout,uint32_t firstSet,
+    uint32_t count,const uint32_t *indices,const VkDeviceSize *offsets){
+
+    if(trace)
+      trace->SetDescriptorBufferOffsets(bindPoint,layout,firstSet,count,indices,offsets);
+    context.dispatch.vkCmdSetDescriptorBufferOffsetsEXT(CMDBuffer,bindPoint,layout,firstSet,count,indices,offsets);
+  }
+
+  void PushConstants(VkPipelineLayout layout,VkShaderStageFlags stages,uint32_t offset,uint32_t size,const void *values){
+    if(trace)
+      trace->PushConstants(layout,stages,offset,size,values);
+    context.dispatch.vkCmdPushConstants(CMDBuffer,layout,stages,offset,size,values);
+  }
+
+  void SetVertexInput(uint32_t bindingCount,const VkVertexInputBindingDescription2EXT *bindings,
+    uint32_t attributeCount,const VkVertexInputAttributeDescription2EXT *attributes){
+
+    if(trace)
+      trace->SetVertexInput(bindingCount,bindings,attributeCount,attributes);
+    context.dispatch.vkCmdSetVertexInputEXT(CMDBuffer,bindingCount,bindings,attributeCount,attributes);
+  }
+
+  void BindVertexBuffers(uint32_t firstBinding,uint32_t count,const VkBuffer *buffers,
+    const VkDeviceSize *offsets,const VkDeviceSize *sizes,const VkDeviceSize *strides){
+
+    if(trace)
+      trace->BindVertexBuffers(firstBinding,count,buffers,offsets,sizes,strides);
+    context.dispatch.vkCmdBindVertexBuffers2(CMDBuffer,firstBinding,count,buffers,offsets,sizes,strides);
+  }
+
+  void BeginRendering(const VkRenderingInfo &info){
+    if(trace)
+      trace->BeginRendering(info);
+    context.dispatch.vkCmdBeginRendering(CMDBuffer,&info);
+  }
+
+  void EndRendering(){
+    if(trace)
+      trace->EndRendering();
+    context.dispatch.vkCmdEndRendering(CMDBuffer);
+  }
+
+  void SetViewport(uint32_t count,const VkViewport *viewports){
+    if(trace)
+      trace->SetViewport(count,viewports);
+    context.dispatch.vkCmdSetViewportWithCount(CMDBuffer,count,viewports);
+  }
+
+  void SetScissor(uint32_t count,const VkRect2D *scissors){
+    if(trace)
+      trace->SetScissor(count,scissors);
+    context.dispatch.vkCmdSetScissorWithCount(CMDBuffer,count,scissors);
+  }
+
+  void SetRasterizerDiscardEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE,enable);
+    context.dispatch.vkCmdSetRasterizerDiscardEnable(CMDBuffer,enable);
+  }
+
+  void SetCullMode(VkCullModeFlags mode){
+    State(VK_DYNAMIC_STATE_CULL_MODE,mode);
+    context.dispatch.vkCmdSetCullMode(CMDBuffer,mode);
+  }
+
+  void SetFrontFace(VkFrontFace face){
+    State(VK_DYNAMIC_STATE_FRONT_FACE,(uint32_t)face);
+    context.dispatch.vkCmdSetFrontFace(CMDBuffer,face);
+  }
+
+  void SetDepthTestEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,enable);
+    context.dispatch.vkCmdSetDepthTestEnable(CMDBuffer,enable);
+  }
+
+  void SetDepthWriteEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,enable);
+    context.dispatch.vkCmdSetDepthWriteEnable(CMDBuffer,enable);
+  }
+
+  void SetDepthBiasEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,enable);
+    context.dispatch.vkCmdSetDepthBiasEnable(CMDBuffer,enable);
+  }
+
+  void SetDepthBoundsTestEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE,enable);
+    context.dispatch.vkCmdSetDepthBoundsTestEnable(CMDBuffer,enable);
+  }
+
+  void SetStencilTestEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE,enable);
+    context.dispatch.vkCmdSetStencilTestEnable(CMDBuffer,enable);
+  }
+
+  void SetPrimitiveTopology(VkPrimitiveTopology topology){
+    State(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,(uint32_t)topology);
+    context.dispatch.vkCmdSetPrimitiveTopology(CMDBuffer,topology);
+  }
+
+  void SetPrimitiveRestartEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,enable);
+    context.dispatch.vkCmdSetPrimitiveRestartEnable(CMDBuffer,enable);
+  }
+
+  void SetPolygonMode(VkPolygonMode mode){
+    State(VK_DYNAMIC_STATE_POLYGON_MODE_EXT,(uint32_t)mode);
+    context.dispatch.vkCmdSetPolygonModeEXT(CMDBuffer,mode);
+  }
+
+  void SetRasterizationSamples(VkSampleCountFlagBits samples){
+    State(VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT,(uint32_t)samples);
+    context.dispatch.vkCmdSetRasterizationSamplesEXT(CMDBuffer,samples);
+  }
+
+  void SetSampleMask(VkSampleCountFlagBits samples,const VkSampleMask *mask){
+    if(trace)
+      trace->SetSampleMask(samples,mask);
+    context.dispatch.vkCmdSetSampleMaskEXT(CMDBuffer,samples,mask);
+  }
+
+  void SetAlphaToCoverageEnable(VkBool32 enable){
+    State(VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT,enable);
+    context.dispatch.vkCmdSetAlphaToCoverageEnableEXT(CMDBuffer,enable);
+  }
+
+  void SetColorBlendEnable(uint32_t first,uint32_t count,const VkBool32 *enables){
+    if(trace)
+      trace->SetAttachmentRange(TraceOp::SetColorBlendEnable,first,count,enables);
+    context.dispatch.vkCmdSetColorBlendEnableEXT(CMDBuffer,first,count,enables);
+  }
+
+  void SetColorWriteMask(uint32_t first,uint32_t count,const VkColorComponentFlags *masks){
+    if(trace)
+      trace->SetAttachmentRange(TraceOp::SetColorWriteMask,first,count,masks);
+    context.dispatch.vkCmdSetColorWriteMaskEXT(CMDBuffer,first,count,masks);
+  }
+
+  void Dispatch(uint32_t x,uint32_t y,uint32_t z){
+    if(trace)
+      trace->Dispatch(x,y,z);
+    context.dispatch.vkCmdDispatch(CMDBuffer,x,y,z);
+  }
+
+  void Draw(uint32_t vertexCount,uint32_t instanceCount,uint32_t firstVertex,uint32_t firstInstance){
+    if(trace)
+      trace->Draw(vertexCount,instanceCount,firstVertex,firstInstance);
+    context.dispatch.vkCmdDraw(CMDBuffer,vertexCount,instanceCount,firstVertex,firstInstance);
+  }
+
+  //vkCmdBindIndexBuffer2KHR bounds the indices to size bytes, without
+  //VK_KHR_maintenance5 the binding runs to the end of the buffer
+  void BindIndexBuffer(VkBuffer buffer,VkDeviceSize offset,VkDeviceSize size,VkIndexType indexType){
+    if(!context.dispatch.vkCmdBindIndexBuffer2KHR)
+      size=VK_WHOLE_SIZE;
+    if(trace)
+      trace->BindIndexBuffer(buffer,offset,size,indexType);
+    if(context.dispatch.vkCmdBindIndexBuffer2KHR)
+      context.dispatch.vkCmdBindIndexBuffer2KHR(CMDBuffer,buffer,offset,size,indexType);
+    else
+      context.dispatch.vkCmdBindIndexBuffer(CMDBuffer,buffer,offset,indexType);
+  }
+
+  void DrawIndexed(uint32_t indexCount,uint32_t instanceCount,uint32_t firstIndex,int32_t vertexOffset,uint32_t firstInstance){
+    if(trace)
+      trace->DrawIndexed(indexCount,instanceCount,firstIndex,vertexOffset,firstInstance);
+    context.dispatch.vkCmdDrawIndexed(CMDBuffer,indexCount,instanceCount,firstIndex,vertexOffset,firstInstance);
+  }
+};
@@ -0,0 +1,236 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<cmath>
+#include<cstring>
+#include<format>
+#include<stdexcept>
+#include<algorithm>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"HeadlessDevice.h"
+#include"DescriptorLayout.h"
+#include"TracedCommands.h"
+
+#if defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+#include<emmintrin.h>
+#define UNIFORM_RING_SSE2
+#endif
+
+//Per-draw uniform data out of one persistently mapped buffer. The buffer is
+//split into frames, each frame into slots of the same size, every slot
+//starting on minUniformBufferOffsetAlignment:
+//
+//  frame 0: slot 0 | slot 1 | ... | frame 1: slot 0 | slot 1 | ...
+//
+//Allocate() hands out the next slot of the current frame, there is nothing
+//to free, BeginFrame() moves to the next frame and starts over. A frame is
+//reused frames calls later, the caller has to have waited for the
+//submissions that read it by then.
+//
+//Shaders see a slot either as set 0 binding 0 of SetLayout(), a uniform
+//block like SceneData in LinkedShaderLayoutVert.glsl, or through its device
+//address. For the former every slot has its own uniform buffer descriptor,
+//written once when the ring is created, so selecting a slot is a
+//vkCmdSetDescriptorBufferOffsets with no descriptor write per draw.
+
+//16 byte aligned so it can be written with aligned vector stores, column
+//major like GLSL's mat4
+struct alignas(16) UniformMatrix{
+  std::array<float,16> values;
+
+  static UniformMatrix Identity(){
+    return {{1.0f,0.0f,0.0f,0.0f, 0.0f,1.0f,0.0f,0.0f, 0.0f,0.0f,1.0f,0.0f, 0.0f,0.0f,0.0f,1.0f}};
+  }
+
+  static UniformMatrix Translation(float x,float y,float z){
+    auto matrix=Identity();
+    matrix.values[12]=x;
+    matrix.values[13]=y;
+    matrix.values[14]=z;
+    return matrix;
+  }
+
+  //Uniform scale followed by a rotation around z
+  static UniformMatrix ScaleRotation(float scale,float angle){
+    auto matrix=Identity();
+    matrix.values[0]=scale*std::cos(angle);
+    matrix.values[1]=scale*std::sin(angle);
+    matrix.values[4]=-matrix.values[1];
+    matrix.values[5]=matrix.values[0];
+    matrix.values[10]=scale;
+    return matrix;
+  }
+
+  UniformMatrix operator*(const UniformMatrix &other)const{
+    UniformMatrix result={};
+    for(int column=0;column<4;column++){
+      for(int row=0;row<4;row++){
+        float sum=0.0f;
+        for(int k=0;k<4;k++)
+          sum+=values[k*4+row]*other.values[column*4+k];
+        result.values[column*4+row]=sum;
+      }
+    }
+    return result;
+  }
+};
+
+struct UniformSlice{
+  //Mapped, aligned to at least 16 bytes
+  void *data;
+  //Index of the slot in the whole ring, for UniformRing::Use
+  uint32_t slot;
+  //From the start of Buffer()
+  VkDeviceSize offset;
+  VkDeviceAddress address;
+};
+
+class UniformRing{
+  using SliceSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1,VK_SHADER_STAGE_ALL_GRAPHICS|VK_SHADER_STAGE_COMPUTE_BIT>>;
+
+  HeadlessDevice &context;
+  uint32_t slotSize;
+  uint32_t slotsPerFrame;
+  uint32_t frames;
+  VkDeviceSize stride=0;
+
+  VkBuffer buffer=nullptr;
+  VmaAllocation allocation=nullptr;
+  VmaAllocationInfo allocationInfo={};
+  VkDeviceAddress address=0;
+
+  DescriptorLayout<SliceSet> setLayout;
+  VkPipelineLayout pipelineLayout=nullptr;
+  VkBuffer descriptorBuffer=nullptr;
+  VmaAllocation descriptorAllocation=nullptr;
+  VmaAllocationInfo descriptorInfo={};
+  VkDeviceAddress descriptorAddress=0;
+  VkDeviceSize descriptorStride=0;
+
+  uint32_t frame=0;
+  uint32_t used=0;
+
+  static VkDeviceSize Align(VkDeviceSize value,VkDeviceSize alignment){
+    return (value+alignment-1)/alignment*alignment;
+  }
+
+public:
+  //slotSize bytes per draw, up to slotsPerFrame draws in each of frames
+  //frames in flight
+  UniformRing(HeadlessDevice &context,uint32_t slotSize,uint32_t slotsPerFrame,uint32_t frames=2):
+    context(context),
+    slotSize(slotSize),
+    slotsPerFrame(slotsPerFrame),
+    frames(frames),
+    setLayout(context){
+    if(slotSize==0||slotsPerFrame==0||frames==0)
+      throw std::runtime_error("Uniform ring needs at least one slot of one byte per frame");
+
+    //16 at least for the vector stores, the limit is a power of two
+    stride=Align(slotSize,std::max<VkDeviceSize>(context.info.properties.limits.minUniformBufferOffsetAlignment,16));
+    buffer=context.CreateBuffer(stride*slotsPerFrame*frames,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,allocation,allocationInfo);
+    address=context.BufferAddress(buffer);
+
+    pipelineLayout=context.CreatePipelineLayout({setLayout.Handle()});
+
+    descriptorStride=setLayout.Stride();
+    descriptorBuffer=context.CreateBuffer(descriptorStride*slotsPerFrame*frames,
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,descriptorAllocation,descriptorInfo);
+    descriptorAddress=context.BufferAddress(descriptorBuffer);
+
+    for(uint32_t slot=0;slot<slotsPerFrame*frames;slot++)
+      setLayout.Writer(descriptorBuffer,descriptorInfo,slot*descriptorStride).Buffer<0>(address+slot*stride,slotSize);
+  }
+
+  UniformRing(const UniformRing &)=delete;
+  UniformRing &operator=(const UniformRing &)=delete;
+
+  ~UniformRing(){
+    context.DestroyBuffer(descriptorBuffer,descriptorAllocation);
+    context.DestroyBuffer(buffer,allocation);
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+  }
+
+  VkBuffer Buffer()const{
+    return buffer;
+  }
+
+  VkDescriptorSetLayout SetLayout()const{
+    return setLayout.Handle();
+  }
+
+  VkPipelineLayout PipelineLayout()const{
+    return pipelineLayout;
+  }
+
+  VkDeviceSize Stride()const{
+    return stride;
+  }
+
+  void BeginFrame(){
+    frame=(frame+1)%frames;
+    used=0;
+  }
+
+  UniformSlice Allocate(){
+    if(used==slotsPerFrame)
+      throw std::runtime_error(std::format("Uniform ring frame is full at {} slots",slotsPerFrame));
+    auto slot=frame*slotsPerFrame+used++;
+    auto offset=slot*stride;
+    return {
+      .data=static_cast<uint8_t *>(allocationInfo.pMappedData)+offset,
+      .slot=slot,
+      .offset=offset,
+      .address=address+offset
+    };
+  }
+
+  //Copies count matrices to a slice with 16 byte stores. The mapping is
+  //usually write combined, streaming stores skip reading the lines first.
+  static void StoreMatrices(void *destination,const UniformMatrix *matrices,size_t count){
+#ifdef UNIFORM_RING_SSE2
+    auto target=static_cast<float *>(destination);
+    for(size_t matrix=0;matrix<count;matrix++){
+      for(int column=0;column<16;column+=4)
+        _mm_stream_ps(target+matrix*16+column,_mm_load_ps(matrices[matrix].values.data()+column));
+    }
+#else
+    memcpy(destination,matrices,count*sizeof(UniformMatrix));
+#endif
+  }
+
+  //Call after writing the frame's slices and before submitting. The memory
+  //is coherent, this only orders the streaming stores and records the
+  //slices into a trace being captured.
+  void Flush()const{
+#ifdef UNIFORM_RING_SSE2
+    _mm_sfence();
+#endif
+    if(context.trace&&used>0){
+      auto offset=frame*slotsPerFrame*stride;
+      context.trace->BufferData(buffer,offset,used*stride,
+        static_cast<const uint8_t *>(allocationInfo.pMappedData)+offset);
+    }
+  }
+
+  //Binds the slot descriptors as the only descriptor buffer, once per
+  //command buffer before any Use()
+  void Bind(TracedCommands &commands)const{
+    VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+      .pNext=nullptr,
+      .address=descriptorAddress,
+      .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+    };
+    commands.BindDescriptorBuffers(1,&bufferBindingInfo);
+  }
+
+  //Points set 0 of PipelineLayout() at the slice
+  void Use(TracedCommands &commands,VkPipelineBindPoint bindPoint,const UniformSlice &slice)const{
+    uint32_t bufferIndice=0;
+    VkDeviceSize bufferOffset=slice.slot*descriptorStride;
+    commands.SetDescriptorBufferOffsets(bindPoint,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
+  }
+};
@@ -0,0 +1,312 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<cmath>
+#include<cstdint>
+#include<cstring>
+#include<algorithm>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+
+//Packs vertex attributes into smaller formats and describes the result for
+//vkCmdSetVertexInputEXT. Every format used has mandatory VERTEX_BUFFER
+//support, so packed meshes run on any device the scenarios run on.
+//
+//  positions  R32G32B32_SFLOAT, or R16G16B16A16_UNORM relative to the
+//             mesh bounds. w is stored as 1.0, decode with
+//             bounds.offset+position.xyz*bounds.scale.
+//  normals    R32G32B32_SFLOAT, octahedral in R16G16_SNORM, or xyz in
+//             A2B10G10R10_UNORM_PACK32 decoded with normalize(n*2.0-1.0).
+//             Octahedral decodes as
+//               vec3 n=vec3(e,1.0-abs(e.x)-abs(e.y));
+//               float t=max(-n.z,0.0);
+//               n.xy+=mix(vec2(t),vec2(-t),greaterThanEqual(n.xy,vec2(0.0)));
+//               n=normalize(n);
+//  texCoords  R32G32_SFLOAT or R16G16_SFLOAT
+//
+//Interleaved puts every attribute in binding 0. Split keeps positions alone
+//in binding 0, so depth only passes fetch nothing else, and the rest
+//interleaved in binding 1.
+
+enum class PositionFormat{
+  Float,
+  Unorm16
+};
+
+enum class NormalFormat{
+  Float,
+  Octahedral16,
+  Packed1010102
+};
+
+enum class TexCoordFormat{
+  Float,
+  Half
+};
+
+enum class VertexLayout{
+  Interleaved,
+  Split
+};
+
+struct VertexFormat{
+  PositionFormat position=PositionFormat::Float;
+  NormalFormat normal=NormalFormat::Float;
+  TexCoordFormat texCoord=TexCoordFormat::Float;
+  VertexLayout layout=VertexLayout::Interleaved;
+  //The LinkedShaderLayoutVert.glsl locations
+  uint32_t positionLocation=0;
+  uint32_t texCoordLocation=1;
+  uint32_t normalLocation=2;
+};
+
+//Normals and texture coordinates are optional, empty or one per position
+struct MeshData{
+  std::vector<std::array<float,3>> positions;
+  std::vector<std::array<float,3>> normals;
+  std::vector<std::array<float,2>> texCoords;
+};
+
+struct PackedMesh{
+  uint32_t vertexCount=0;
+  //One per binding, binding n is streams[n]
+  std::vector<std::vector<uint8_t>> streams;
+  std::vector<VkVertexInputBindingDescription2EXT> bindings;
+  std::vector<VkVertexInputAttributeDescription2EXT> attributes;
+  //Dequantisation for Unorm16 positions, identity otherwise
+  std::array<float,3> positionOffset={0.0f,0.0f,0.0f};
+  std::array<float,3> positionScale={1.0f,1.0f,1.0f};
+
+  size_t Bytes()const{
+    size_t bytes=0;
+    for(auto &stream:streams)
+      bytes+=stream.size();
+    return bytes;
+  }
+
+  //Offsets and strides for vkCmdBindVertexBuffers2 when the streams are
+  //placed back to back in one buffer starting at base
+  void BindRanges(VkDeviceSize base,std::vector<VkDeviceSize> &offsets,std::vector<VkDeviceSize> &sizes,
+    std::vector<VkDeviceSize> &strides)const{
+
+    offsets.clear();
+    sizes.clear();
+    strides.clear();
+    for(size_t binding=0;binding<streams.size();binding++){
+      offsets.push_back(base);
+      sizes.push_back(streams[binding].size());
+      strides.push_back(bindings[binding].stride);
+      base+=streams[binding].size();
+    }
+  }
+};
+
+class VertexPacker{
+  struct Attribute{
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;
+    uint32_t binding;
+    uint32_t offset;
+  };
+
+  static uint16_t Unorm16(float value){
+    return (uint16_t)std::lround(std::clamp(value,0.0f,1.0f)*65535.0f);
+  }
+
+  static int16_t Snorm16(float value){
+    return (int16_t)std::lround(std::clamp(value,-1.0f,1.0f)*32767.0f);
+  }
+
+  //Round to nearest even, overflow saturates to infinity and values below
+  //the smallest normal flush to zero, plenty for texture coordinates
+  static uint16_t Half(float value){
+    uint32_t bits;
+    memcpy(&bits,&value,sizeof(bits));
+    uint32_t sign=(bits>>16)&0x8000;
+    int32_t exponent=(int32_t)((bits>>23)&0xff)-127+15;
+    uint32_t mantissa=bits&0x7fffff;
+
+    if(((bits>>23)&0xff)==0xff)
+      return (uint16_t)(sign|0x7c00|(mantissa?0x200:0));
+    if(exponent>=31)
+      return (uint16_t)(sign|0x7c00);
+    if(exponent<=0)
+      return (uint16_t)sign;
+
+    uint32_t half=((uint32_t)exponent<<10)|(mantissa>>13);
+    uint32_t remainder=mantissa&0x1fff;
+    if(remainder>0x1000||(remainder==0x1000&&(half&1)))
+      half++;
+    return (uint16_t)(sign|half);
+  }
+
+  static std::array<float,3> Normalised(const std::array<float,3> &normal){
+    float length=std::sqrt(normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
+    if(length==0.0f)
+      return {0.0f,0.0f,1.0f};
+    return {normal[0]/length,normal[1]/length,normal[2]/length};
+  }
+
+  static std::array<float,2> Octahedral(const std::array<float,3> &normal){
+    auto n=Normalised(normal);
+    float sum=std::abs(n[0])+std::abs(n[1])+std::abs(n[2]);
+    float x=n[0]/sum;
+    float y=n[1]/sum;
+    if(n[2]<0.0f){
+      float foldedX=(1.0f-std::abs(y))*(x>=0.0f?1.0f:-1.0f);
+      float foldedY=(1.0f-std::abs(x))*(y>=0.0f?1.0f:-1.0f);
+      x=foldedX;
+      y=foldedY;
+    }
+    return {x,y};
+  }
+
+  static uint32_t Packed1010102(const std::array<float,3> &normal){
+    auto n=Normalised(normal);
+    auto Channel=[](float value){
+      return (uint32_t)std::lround(std::clamp(value*0.5f+0.5f,0.0f,1.0f)*1023.0f);
+    };
+    return Channel(n[0])|(Channel(n[1])<<10)|(Channel(n[2])<<20);
+  }
+
+  template<typename T>
+  static void Write(std::vector<uint8_t> &stream,size_t offset,const T &value){
+    memcpy(stream.data()+offset,&value,sizeof(T));
+  }
+
+public:
+  static PackedMesh Pack(const MeshData &mesh,const VertexFormat &format){
+    auto count=mesh.positions.size();
+    if(count==0)
+      throw std::runtime_error("Mesh has no positions");
+    if(!mesh.normals.empty()&&mesh.normals.size()!=count)
+      throw std::runtime_error("Mesh needs one normal per position");
+    if(!mesh.texCoords.empty()&&mesh.texCoords.size()!=count)
+      throw std::runtime_error("Mesh needs one texture coordinate per position");
+
+    PackedMesh packed;
+    packed.vertexCount=(uint32_t)count;
+
+    uint32_t attributeBinding=format.layout==VertexLayout::Split?1:0;
+    std::vector<Attribute> attributes;
+    attributes.push_back(format.position==PositionFormat::Unorm16?
+      Attribute{format.positionLocation,VK_FORMAT_R16G16B16A16_UNORM,8,0,0}:
+      Attribute{format.positionLocation,VK_FORMAT_R32G32B32_SFLOAT,12,0,0});
+    if(!mesh.normals.empty()){
+      switch(format.normal){
+        case NormalFormat::Float:
+          attributes.push_back({format.normalLocation,VK_FORMAT_R32G32B32_SFLOAT,12,attributeBinding,0});
+          break;
+        case NormalFormat::Octahedral16:
+          attributes.push_back({format.normalLocation,VK_FORMAT_R16G16_SNORM,4,attributeBinding,0});
+          break;
+        case NormalFormat::Packed1010102:
+          attributes.push_back({format.normalLocation,VK_FORMAT_A2B10G10R10_UNORM_PACK32,4,attributeBinding,0});
+          break;
+      }
+    }
+    if(!mesh.texCoords.empty()){
+      attributes.push_back(format.texCoord==TexCoordFormat::Half?
+        Attribute{format.texCoordLocation,VK_FORMAT_R16G16_SFLOAT,4,attributeBinding,0}:
+        Attribute{format.texCoordLocation,VK_FORMAT_R32G32_SFLOAT,8,attributeBinding,0});
+    }
+
+    //Every size is a multiple of 4, offsets stay aligned without padding
+    std::array<uint32_t,2> strides={0,0};
+    for(auto &attribute:attributes){
+      attribute.offset=strides[attribute.binding];
+      strides[attribute.binding]+=attribute.size;
+    }
+
+    uint32_t bindingCount=strides[1]>0?2:1;
+    for(uint32_t binding=0;binding<bindingCount;binding++){
+      packed.bindings.push_back({
+        .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+        .pNext=nullptr,
+        .binding=binding,
+        .stride=strides[binding],
+        .inputRate=VK_VERTEX_INPUT_RATE_VERTEX,
+        .divisor=1
+      });
+      packed.streams.emplace_back((size_t)strides[binding]*count);
+    }
+    for(auto &attribute:attributes){
+      packed.attributes.push_back({
+        .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+        .pNext=nullptr,
+        .location=attribute.location,
+        .binding=attribute.binding,
+        .format=attribute.format,
+        .offset=attribute.offset
+      });
+    }
+
+    if(format.position==PositionFormat::Unorm16){
+      std::array<float,3> minimum=mesh.positions[0];
+      std::array<float,3> maximum=mesh.positions[0];
+      for(auto &position:mesh.positions){
+        for(int axis=0;axis<3;axis++){
+          minimum[axis]=std::min(minimum[axis],position[axis]);
+          maximum[axis]=std::max(maximum[axis],position[axis]);
+        }
+      }
+      for(int axis=0;axis<3;axis++){
+        packed.positionOffset[axis]=minimum[axis];
+        //Flat axes still get a usable scale
+        packed.positionScale[axis]=maximum[axis]>minimum[axis]?maximum[axis]-minimum[axis]:1.0f;
+      }
+    }
+
+    for(size_t vertex=0;vertex<count;vertex++){
+      size_t attribute=0;
+      {
+        auto &target=attributes[attribute++];
+        auto &stream=packed.streams[target.binding];
+        size_t offset=vertex*strides[target.binding]+target.offset;
+        auto &position=mesh.positions[vertex];
+        if(format.position==PositionFormat::Unorm16){
+          std::array<uint16_t,4> quantised;
+          for(int axis=0;axis<3;axis++)
+            quantised[axis]=Unorm16((position[axis]-packed.positionOffset[axis])/packed.positionScale[axis]);
+          quantised[3]=65535;
+          Write(stream,offset,quantised);
+        }else{
+          Write(stream,offset,position);
+        }
+      }
+
+      if(!mesh.normals.empty()){
+        auto &target=attributes[attribute++];
+        auto &stream=packed.streams[target.binding];
+        size_t offset=vertex*strides[target.binding]+target.offset;
+        auto &normal=mesh.normals[vertex];
+        switch(format.normal){
+          case NormalFormat::Float:
+            Write(stream,offset,normal);
+            break;
+          case NormalFormat::Octahedral16:{
+            auto encoded=Octahedral(normal);
+            Write(stream,offset,std::array<int16_t,2>{Snorm16(encoded[0]),Snorm16(encoded[1])});
+            break;
+          }
+          case NormalFormat::Packed1010102:
+            Write(stream,offset,Packed1010102(normal));
+            break;
+        }
+      }
+
+      if(!mesh.texCoords.empty()){
+        auto &target=attributes[attribute++];
+        auto &stream=packed.streams[target.binding];
+        size_t offset=vertex*strides[target.binding]+target.offset;
+        auto &texCoord=mesh.texCoords[vertex];
+        if(format.texCoord==TexCoordFormat::Half)
+          Write(stream,offset,std::array<uint16_t,2>{Half(texCoord[0]),Half(texCoord[1])});
+        else
+          Write(stream,offset,texCoord);
+      }
+    }
+    return packed;
+  }
+};
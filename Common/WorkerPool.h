@@ -0,0 +1,476 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<string>
+#include<string_view>
+#include<atomic>
+#include<thread>
+#include<chrono>
+#include<functional>
+#include<iostream>
+#include<format>
+#include<cstring>
+#include<algorithm>
+#include<stdexcept>
+
+#include<signal.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/wait.h>
+#include<sys/resource.h>
+#include<sys/prctl.h>
+
+//Crash isolation for the headless tools. Jobs run in forked worker processes
+//that each set themselves up once, e.g. open a device of their own, and then
+//run jobs until none are left. A worker that segfaults, aborts, loses its
+//device or hangs past the watchdog timeout only costs the job it was
+//running: the parent records the outcome and forks a replacement that
+//carries on with the remaining work.
+//
+//Jobs are split into one contiguous range per worker in shared memory. A
+//worker pops from the back of its own range and, once that is empty, steals
+//from the front of the fullest other range, so slow jobs do not leave the
+//other cores idle.
+//
+//Run() must be called from a process that has not touched Vulkan, loaders
+//and drivers are not fork safe. POSIX only.
+
+enum class Outcome:uint32_t{
+  Pending,
+  Passed,
+  Failed,
+  DeviceLost,
+  Crashed,
+  TimedOut,
+  Skipped
+};
+
+inline constexpr std::array<const char *,7> OutcomeNames={
+  "pending","passed","failed","device-lost","crashed","timed-out","skipped"};
+
+struct JobReport{
+  Outcome outcome=Outcome::Pending;
+  int32_t worker=-1;
+  //Signal for crashes, exit code for workers that exited mid-job
+  int32_t status=0;
+  double durationMs=0.0;
+  //Last value the job stored to its progress counter, tells how far a job
+  //got before its worker died
+  uint32_t progress=0;
+  std::string message;
+};
+
+//Array in MAP_SHARED memory, what forked workers write lands in the parent's
+//copy. Elements are value initialised.
+template<typename T>
+class SharedArray{
+  T *elements=nullptr;
+  size_t count=0;
+
+public:
+  SharedArray(size_t count):count(count){
+    if(count==0)
+      return;
+    void *memory=mmap(nullptr,sizeof(T)*count,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+    if(memory==MAP_FAILED)
+      throw std::runtime_error("Failed to map shared memory");
+    elements=reinterpret_cast<T *>(memory);
+    for(size_t index=0;index<count;index++)
+      new(&elements[index]) T{};
+  }
+
+  SharedArray(const SharedArray &)=delete;
+  SharedArray &operator=(const SharedArray &)=delete;
+
+  ~SharedArray(){
+    if(elements)
+      munmap(elements,sizeof(T)*count);
+  }
+
+  T &operator[](size_t index){
+    return elements[index];
+  }
+
+  const T &operator[](size_t index)const{
+    return elements[index];
+  }
+
+  T *Data(){
+    return elements;
+  }
+
+  size_t Size()const{
+    return count;
+  }
+};
+
+class WorkerPool{
+public:
+  struct Settings{
+    uint32_t workers=std::max(1u,std::thread::hardware_concurrency());
+    double timeoutSeconds=10.0;
+    //Address space limit per worker, 0 for none
+    uint64_t memoryLimitMiB=0;
+  };
+
+  //Runs one job inside a worker. Returning DeviceLost retires the worker,
+  //the next job gets a fresh process.
+  using JobFunction=std::function<Outcome(uint32_t job,std::atomic<uint32_t> &progress,std::string &message)>;
+  //Runs once in every newly forked worker, whatever the returned function
+  //captures lives until the worker exits
+  using SetupFunction=std::function<JobFunction()>;
+
+private:
+  static constexpr uint32_t NoJob=~0u;
+  //Current job of a worker that has not finished setting up, the watchdog
+  //times it like a job but there is no result to report when it dies
+  static constexpr uint32_t SetupJob=~0u-1;
+  static constexpr size_t MessageSize=256;
+
+  //Worker exit codes besides 0, anything else is treated as a crash
+  static constexpr int ExitDeviceLost=3;
+  static constexpr int ExitSetupFailed=4;
+
+  //Written by the worker that ran the job, or by the parent when the worker
+  //died in the middle of it. outcome is stored last.
+  struct JobResult{
+    std::atomic<uint32_t> outcome;
+    std::atomic<uint32_t> progress;
+    int32_t worker;
+    int32_t status;
+    double durationMs;
+    char message[MessageSize];
+  };
+
+  struct WorkerSlot{
+    //Remaining job range [top, bottom) packed as top<<32|bottom, the owner
+    //takes from the bottom and thieves from the top, both with one CAS
+    std::atomic<uint64_t> range;
+    std::atomic<uint32_t> current;
+    std::atomic<int64_t> startedNs;
+    std::atomic<uint32_t> completed;
+    std::atomic<uint32_t> stolen;
+    char setupError[MessageSize];
+  };
+
+  //The atomics live in MAP_SHARED memory and are used from several processes
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+  static_assert(std::atomic<uint32_t>::is_always_lock_free);
+  static_assert(std::atomic<int64_t>::is_always_lock_free);
+
+  static int64_t NowNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static void CopyMessage(char *target,std::string_view message){
+    size_t length=std::min(message.size(),MessageSize-1);
+    memcpy(target,message.data(),length);
+    target[length]='\0';
+  }
+
+  class WorkQueue{
+    WorkerSlot *slots;
+    uint32_t workerCount;
+
+    static uint64_t Pack(uint32_t top,uint32_t bottom){
+      return (uint64_t)top<<32|bottom;
+    }
+
+    //Publishes the job as the worker's current one straight after the CAS
+    //that took it, so the parent can tell which job a worker died in from the
+    //moment it leaves the queue. startedNs goes first for the watchdog.
+    void Claim(uint32_t worker,uint32_t job){
+      slots[worker].startedNs.store(NowNs(),std::memory_order_relaxed);
+      slots[worker].current.store(job,std::memory_order_release);
+    }
+
+    bool Take(uint32_t worker,uint32_t &job){
+      auto &range=slots[worker].range;
+      uint64_t value=range.load(std::memory_order_acquire);
+      for(;;){
+        uint32_t top=(uint32_t)(value>>32),bottom=(uint32_t)value;
+        if(top>=bottom)
+          return false;
+        if(range.compare_exchange_weak(value,Pack(top,bottom-1),std::memory_order_acq_rel)){
+          job=bottom-1;
+          return true;
+        }
+      }
+    }
+
+  public:
+    WorkQueue(WorkerSlot *slots,uint32_t workerCount,uint32_t jobCount):slots(slots),workerCount(workerCount){
+      for(uint32_t worker=0;worker<workerCount;worker++){
+        uint32_t begin=(uint32_t)((uint64_t)jobCount*worker/workerCount);
+        uint32_t end=(uint32_t)((uint64_t)jobCount*(worker+1)/workerCount);
+        slots[worker].range.store(Pack(begin,end),std::memory_order_relaxed);
+        slots[worker].current.store(NoJob,std::memory_order_relaxed);
+      }
+    }
+
+    //Takes the newest job of the worker's own range and claims it
+    bool Pop(uint32_t worker,uint32_t &job){
+      if(!Take(worker,job))
+        return false;
+      Claim(worker,job);
+      return true;
+    }
+
+    //Takes the oldest job of whichever worker has the most left and claims it
+    bool Steal(uint32_t thief,uint32_t &job){
+      for(;;){
+        uint32_t victim=NoJob,most=0;
+        for(uint32_t worker=0;worker<workerCount;worker++){
+          if(worker==thief)
+            continue;
+          uint64_t value=slots[worker].range.load(std::memory_order_acquire);
+          uint32_t top=(uint32_t)(value>>32),bottom=(uint32_t)value;
+          if(top<bottom&&bottom-top>most){
+            most=bottom-top;
+            victim=worker;
+          }
+        }
+        if(victim==NoJob)
+          return false;
+
+        auto &range=slots[victim].range;
+        uint64_t value=range.load(std::memory_order_acquire);
+        uint32_t top=(uint32_t)(value>>32),bottom=(uint32_t)value;
+        if(top<bottom&&range.compare_exchange_strong(value,Pack(top+1,bottom),std::memory_order_acq_rel)){
+          job=top;
+          Claim(thief,job);
+          slots[thief].stolen.fetch_add(1,std::memory_order_relaxed);
+          return true;
+        }
+      }
+    }
+
+    bool Empty()const{
+      for(uint32_t worker=0;worker<workerCount;worker++){
+        uint64_t value=slots[worker].range.load(std::memory_order_acquire);
+        if((uint32_t)(value>>32)<(uint32_t)value)
+          return false;
+      }
+      return true;
+    }
+
+    //Whatever nobody got to, e.g. once every worker failed to set up
+    template<typename F>
+    void Drain(F &&visit){
+      for(uint32_t worker=0;worker<workerCount;worker++){
+        uint32_t job;
+        while(Take(worker,job))
+          visit(job);
+      }
+    }
+  };
+
+  Settings settings;
+  uint32_t stolen=0;
+
+  [[noreturn]] void WorkerMain(uint32_t worker,const SetupFunction &setup,WorkQueue &queue,
+    WorkerSlot *slots,JobResult *results){
+
+    //Die with the parent, and keep faulting drivers from filling the disk
+    prctl(PR_SET_PDEATHSIG,SIGKILL);
+    rlimit core={0,0};
+    setrlimit(RLIMIT_CORE,&core);
+    if(settings.memoryLimitMiB>0){
+      rlimit memory={settings.memoryLimitMiB<<20,settings.memoryLimitMiB<<20};
+      setrlimit(RLIMIT_AS,&memory);
+    }
+
+    auto &slot=slots[worker];
+    int exitCode=0;
+    try{
+      auto run=setup();
+      slot.current.store(NoJob,std::memory_order_release);
+      std::string message;
+
+      uint32_t job;
+      while(queue.Pop(worker,job)||queue.Steal(worker,job)){
+        auto &result=results[job];
+        result.worker=(int32_t)worker;
+
+        message.clear();
+        auto begin=NowNs();
+        Outcome outcome;
+        try{
+          outcome=run(job,result.progress,message);
+        }catch(const std::exception &exception){
+          message=exception.what();
+          outcome=Outcome::Failed;
+        }
+        result.durationMs=(NowNs()-begin)/1e6;
+        CopyMessage(result.message,message);
+        result.outcome.store((uint32_t)outcome,std::memory_order_release);
+
+        slot.current.store(NoJob,std::memory_order_release);
+        slot.completed.fetch_add(1,std::memory_order_relaxed);
+
+        //Nothing more can run on a lost device, the parent forks a fresh worker
+        if(outcome==Outcome::DeviceLost){
+          exitCode=ExitDeviceLost;
+          break;
+        }
+      }
+    }catch(const std::exception &exception){
+      CopyMessage(slot.setupError,exception.what());
+      exitCode=ExitSetupFailed;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    _exit(exitCode);
+  }
+
+public:
+  WorkerPool(const Settings &settings):settings(settings){
+    if(settings.workers==0)
+      throw std::runtime_error("At least one worker is required");
+    if(settings.timeoutSeconds<=0.0)
+      throw std::runtime_error("Timeout has to be positive");
+  }
+
+  //Jobs stolen across workers by the last Run()
+  uint32_t Stolen()const{
+    return stolen;
+  }
+
+  uint32_t WorkerCount(uint32_t jobCount)const{
+    return std::min(settings.workers,jobCount);
+  }
+
+  //Runs jobs [0, jobCount) and returns one report per job. Jobs left over
+  //once every worker has been retired are reported as Skipped.
+  std::vector<JobReport> Run(uint32_t jobCount,const SetupFunction &setup){
+    std::vector<JobReport> reports(jobCount);
+    stolen=0;
+    if(jobCount==0)
+      return reports;
+
+    uint32_t workerCount=WorkerCount(jobCount);
+    SharedArray<WorkerSlot> slots(workerCount);
+    SharedArray<JobResult> results(jobCount);
+    WorkQueue queue(slots.Data(),workerCount,jobCount);
+
+    struct Worker{
+      pid_t pid=0;
+      bool timedOut=false;
+      bool retired=false;
+      uint32_t completedAtSpawn=0;
+      uint32_t fruitlessSpawns=0;
+    };
+    std::vector<Worker> workers(workerCount);
+    uint32_t alive=0;
+
+    auto Spawn=[&](uint32_t index){
+      auto &worker=workers[index];
+      worker.timedOut=false;
+      worker.completedAtSpawn=slots[index].completed.load(std::memory_order_relaxed);
+      //Published before the fork so the watchdog covers setup from the start
+      slots[index].startedNs.store(NowNs(),std::memory_order_relaxed);
+      slots[index].current.store(SetupJob,std::memory_order_release);
+      std::cout.flush();
+      std::cerr.flush();
+      pid_t pid=fork();
+      if(pid<0)
+        throw std::runtime_error("Failed to fork worker");
+      if(pid==0)
+        WorkerMain(index,setup,queue,slots.Data(),results.Data());
+      worker.pid=pid;
+      alive++;
+    };
+
+    //Called once waitpid reports the worker gone
+    auto Reap=[&](uint32_t index,int status){
+      auto &worker=workers[index];
+      auto &slot=slots[index];
+      worker.pid=0;
+      alive--;
+
+      uint32_t job=slot.current.exchange(NoJob,std::memory_order_acq_rel);
+      if(job==SetupJob&&worker.timedOut)
+        std::cerr<<std::format("Worker {} timed out setting up\n",index);
+      if(job!=NoJob&&job!=SetupJob&&results[job].outcome.load(std::memory_order_acquire)==(uint32_t)Outcome::Pending){
+        auto &result=results[job];
+        result.worker=(int32_t)index;
+        result.durationMs=(NowNs()-slot.startedNs.load(std::memory_order_relaxed))/1e6;
+        result.status=WIFSIGNALED(status)?WTERMSIG(status):WEXITSTATUS(status);
+        CopyMessage(result.message,WIFSIGNALED(status)?strsignal(WTERMSIG(status)):"Worker exited mid-job");
+        result.outcome.store((uint32_t)(worker.timedOut?Outcome::TimedOut:Outcome::Crashed),std::memory_order_release);
+        slot.completed.fetch_add(1,std::memory_order_relaxed);
+      }
+
+      if(WIFEXITED(status)&&WEXITSTATUS(status)==ExitSetupFailed){
+        std::cerr<<std::format("Worker {} could not set up: {}\n",index,slot.setupError);
+        worker.retired=true;
+      }
+
+      //A worker dying over and over before finishing anything, e.g. in
+      //device creation, is not worth replacing
+      if(slot.completed.load(std::memory_order_relaxed)==worker.completedAtSpawn){
+        if(++worker.fruitlessSpawns>=3)
+          worker.retired=true;
+      }else{
+        worker.fruitlessSpawns=0;
+      }
+
+      if(!worker.retired&&!queue.Empty())
+        Spawn(index);
+    };
+
+    for(uint32_t index=0;index<workerCount;index++)
+      Spawn(index);
+
+    auto timeoutNs=(int64_t)(settings.timeoutSeconds*1e9);
+    while(alive>0){
+      int status=0;
+      pid_t pid;
+      while((pid=waitpid(-1,&status,WNOHANG))>0){
+        auto worker=std::find_if(workers.begin(),workers.end(),[&](const Worker &worker){
+          return worker.pid==pid;
+        });
+        if(worker!=workers.end())
+          Reap((uint32_t)(worker-workers.begin()),status);
+      }
+
+      //Watchdog, a hung driver call never comes back on its own
+      auto now=NowNs();
+      for(uint32_t index=0;index<workerCount;index++){
+        auto &worker=workers[index];
+        if(worker.pid==0||worker.timedOut)
+          continue;
+        if(slots[index].current.load(std::memory_order_acquire)==NoJob)
+          continue;
+        if(now-slots[index].startedNs.load(std::memory_order_relaxed)>timeoutNs){
+          worker.timedOut=true;
+          kill(worker.pid,SIGKILL);
+        }
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    queue.Drain([&](uint32_t job){
+      CopyMessage(results[job].message,"No worker left to run it");
+      results[job].outcome.store((uint32_t)Outcome::Skipped,std::memory_order_release);
+    });
+
+    for(uint32_t index=0;index<workerCount;index++)
+      stolen+=slots[index].stolen.load(std::memory_order_relaxed);
+
+    for(uint32_t job=0;job<jobCount;job++){
+      auto &result=results[job];
+      auto &report=reports[job];
+      report.outcome=(Outcome)result.outcome.load(std::memory_order_acquire);
+      report.worker=result.worker;
+      report.status=result.status;
+      report.durationMs=result.durationMs;
+      report.progress=result.progress.load(std::memory_order_relaxed);
+      report.message=result.message;
+    }
+    return reports;
+  }
+};
@@ -1,5 +1,6 @@
 #include<vector>
 #include<array>
+#include<memory>
 #include<filesystem>
 #include<fstream>
 #include<iostream>
@@ -9,6 +10,11 @@
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
 #define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
 #include<vma/vk_mem_alloc.h>
+#include"../Common/FrameGraph.h"
+#include"../Common/DeviceQueues.h"
+#include"../Common/DebugMessenger.h"
+#include"../Common/GpuProfiler.h"
+#include"../Common/DescriptorLayout.h"
 
 static std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
   std::vector<uint32_t> buffer;
@@ -35,18 +41,14 @@ static std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
   return buffer;
 }
 
-VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
-  VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-  VkDebugUtilsMessageTypeFlagsEXT messageType,
-  const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
-  void *pUserData){
+int main(int argc,char **argv){
+  //The profile and trace are only written when asked for with --profile <directory>
+  std::filesystem::path profileDirectory;
+  for(int index=1;index+1<argc;index++){
+    if(std::string(argv[index])=="--profile")
+      profileDirectory=argv[++index];
+  }
 
-  std::cerr<<"Validation Layer: "<<pCallbackData->pMessage<<std::endl;
-
-  return VK_FALSE; // Return VK_TRUE to terminate the application
-}
-
-int main(){
   //************** Instance ***********************
 #pragma region Instance
   std::array<const char *,0> InstanceLayers;//={"VK_LAYER_KHRONOS_validation"};
@@ -84,6 +86,8 @@ int main(){
   PFN_vkCreateDebugUtilsMessengerEXT pfCreateDebugUtilsMessengerEXT=reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
     vkGetInstanceProcAddr(instance,"vkCreateDebugUtilsMessengerEXT"));
 
+  //Destroyed at the end of main, after the instance
+  auto debugSink=std::make_unique<DebugMessenger>();
   VkDebugUtilsMessengerEXT debugMessenger;
   VkDebugUtilsMessengerCreateInfoEXT createInfo={
     .sType=VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
@@ -95,8 +99,8 @@ int main(){
                  VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT|
                  VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT|
                  VK_DEBUG_UTILS_MESSAGE_TYPE_DEVICE_ADDRESS_BINDING_BIT_EXT,
-    .pfnUserCallback=&DebugCallback,
-    .pUserData=nullptr
+    .pfnUserCallback=&DebugMessenger::Callback,
+    .pUserData=debugSink.get()
   };
   pfCreateDebugUtilsMessengerEXT(instance,&createInfo,nullptr,&debugMessenger);
 
@@ -112,17 +116,43 @@ int main(){
 
   //*************** Device ************************
 #pragma region Device
-  VkPhysicalDeviceBufferDeviceAddressFeatures BufferDeviceAddressFeatures={
-  .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR,
-  .pNext=nullptr,
-  .bufferDeviceAddress=VK_TRUE,
-  .bufferDeviceAddressCaptureReplay=VK_FALSE,
-  .bufferDeviceAddressMultiDevice=VK_FALSE
+  //DeviceQueues waits on timeline semaphores and GpuProfiler resets its
+  //queries from the host. Check both up front so a device without them
+  //says so instead of failing vkCreateDevice.
+  VkPhysicalDeviceVulkan12Features supported12={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .pNext=nullptr
+  };
+  VkPhysicalDeviceFeatures2 supported={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext=&supported12,
+    .features={}
+  };
+  vkGetPhysicalDeviceFeatures2(physicalDevices[0],&supported);
+  if(!supported12.timelineSemaphore)
+    throw std::runtime_error("Device does not support timelineSemaphore, DeviceQueues needs it");
+  if(!supported12.hostQueryReset)
+    throw std::runtime_error("Device does not support hostQueryReset, GpuProfiler needs it");
+
+  VkPhysicalDeviceVulkan13Features Vulkan13Features={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+    .pNext=nullptr,
+    .synchronization2=VK_TRUE
+  };
+
+  //Buffer device address moves in here, the 1.2 struct cannot be chained
+  //together with VkPhysicalDeviceBufferDeviceAddressFeatures
+  VkPhysicalDeviceVulkan12Features Vulkan12Features={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .pNext=&Vulkan13Features,
+    .hostQueryReset=VK_TRUE,
+    .timelineSemaphore=VK_TRUE,
+    .bufferDeviceAddress=VK_TRUE
   };
 
   VkPhysicalDeviceDescriptorBufferFeaturesEXT DescriptorBufferFeatures={
     .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
-    .pNext=&BufferDeviceAddressFeatures,
+    .pNext=&Vulkan12Features,
     .descriptorBuffer=VK_TRUE,
     .descriptorBufferCaptureReplay=VK_FALSE,
     .descriptorBufferImageLayoutIgnored=VK_FALSE,
@@ -135,27 +165,23 @@ int main(){
     .shaderObject=VK_TRUE
   };
 
-  float queuePriorities=1.0;
-  const VkDeviceQueueCreateInfo queueCreateInfos={
-    .sType=VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-    .pNext=nullptr,
-    .flags=0,
-    .queueFamilyIndex=0,
-    .queueCount=1,
-    .pQueuePriorities=&queuePriorities,
+  DeviceQueues queues(physicalDevices[0]);
+
+  VkPhysicalDeviceFeatures deviceFeatures={
+    .pipelineStatisticsQuery=supported.features.pipelineStatisticsQuery
   };
 
   VkDeviceCreateInfo deviceInfo={
     .sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
     .pNext=&ShaderObjectFeatures,
     .flags=0,
-    .queueCreateInfoCount=1,
-    .pQueueCreateInfos=&queueCreateInfos,
+    .queueCreateInfoCount=(uint32_t)queues.CreateInfos().size(),
+    .pQueueCreateInfos=queues.CreateInfos().data(),
     .enabledLayerCount=0,
     .ppEnabledLayerNames=nullptr,
     .enabledExtensionCount=(uint32_t)DeviceExtensions.size(),
     .ppEnabledExtensionNames=DeviceExtensions.data(),
-    .pEnabledFeatures=nullptr,
+    .pEnabledFeatures=&deviceFeatures,
   };
 
   VkDevice device=nullptr;
@@ -166,32 +192,10 @@ int main(){
 
   //****** Vulkan function loading ****************
 #pragma region Functions
-  PFN_vkCreateShadersEXT pfCreateShader=reinterpret_cast<PFN_vkCreateShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCreateShadersEXT"));
-  PFN_vkDestroyShaderEXT pfDestroyShader=reinterpret_cast<PFN_vkDestroyShaderEXT>(
-    vkGetDeviceProcAddr(device,"vkDestroyShaderEXT"));
-
-  PFN_vkCmdBindShadersEXT pfCmdBindShaders=reinterpret_cast<PFN_vkCmdBindShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdBindShadersEXT"));
-
-  PFN_vkGetDescriptorSetLayoutSizeEXT pfGetDescriptorSetLayoutSize=reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
-    vkGetDeviceProcAddr(device,"vkGetDescriptorSetLayoutSizeEXT"));
-
-  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT pfGetDescriptorSetLayoutBindingOffset=
-    reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
-      vkGetDeviceProcAddr(device,"vkGetDescriptorSetLayoutBindingOffsetEXT"));
-
-  PFN_vkCmdBindDescriptorBuffersEXT pfnCmdBindDescriptorBuffersEXT=
-    reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdBindDescriptorBuffersEXT"));
-
-  PFN_vkGetDescriptorEXT pfnGetDescriptorEXT=
-    reinterpret_cast<PFN_vkGetDescriptorEXT>(
-    vkGetDeviceProcAddr(device,"vkGetDescriptorEXT"));
-
-  PFN_vkCmdSetDescriptorBufferOffsetsEXT pfnCmdSetDescriptorBufferOffsetsEXT=
-    reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
-      vkGetDeviceProcAddr(device,"vkCmdSetDescriptorBufferOffsetsEXT"));
+  //Everything after device creation records and calls through one table
+  DeviceDispatch dispatch;
+  dispatch.Load(device,&vkGetDeviceProcAddr);
+  queues.Create(device,&dispatch);
 
   VkPhysicalDeviceDescriptorBufferPropertiesEXT DescriptorBufferProperties={
     .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT
@@ -206,39 +210,13 @@ int main(){
 #pragma region Layout
   vkGetPhysicalDeviceProperties2(physicalDevices[0],&DeviceProperties);
 
-
-  auto CreateSetLayout=[&device](std::vector<VkDescriptorSetLayoutBinding> bindings)->VkDescriptorSetLayout{
-    VkDescriptorSetLayoutCreateInfo descriptorSetInfo={
-      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      .pNext=nullptr,
-      .flags=0,
-      .bindingCount=(uint32_t)bindings.size(),
-      .pBindings=bindings.data()
-    };
-    VkDescriptorSetLayout layout=nullptr;
-    auto result=vkCreateDescriptorSetLayout(device,&descriptorSetInfo,nullptr,&layout);
-    if(result!=VK_SUCCESS)
-      throw std::runtime_error("Failed to create descriptor set layout");
-
-    return layout;
-  };
-
-  VkDescriptorSetLayoutBinding bindingInput={
-    .binding=0,
-    .descriptorType=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-    .descriptorCount=1,
-    .stageFlags=VK_SHADER_STAGE_COMPUTE_BIT,
-    .pImmutableSamplers=nullptr
-  };
-  VkDescriptorSetLayoutBinding bindingOutput={
-    .binding=1,
-    .descriptorType=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-    .descriptorCount=1,
-    .stageFlags=VK_SHADER_STAGE_COMPUTE_BIT,
-    .pImmutableSamplers=nullptr
-  };
-
-  auto setLayout=CreateSetLayout({bindingInput,bindingOutput});
+  using ComputeSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>,
+    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,1,VK_SHADER_STAGE_COMPUTE_BIT>>;
+  //Created without the descriptor buffer flag as the repro always has, so the
+  //size and binding offsets are still queried by hand below
+  auto computeSetLayout=std::make_unique<DescriptorLayout<ComputeSet>>(device,physicalDevices[0],0,&dispatch);
+  auto setLayout=computeSetLayout->Handle();
 #pragma endregion
 
   //*************** Shader ************************
@@ -265,21 +243,21 @@ int main(){
   }};
 
   std::vector<VkShaderEXT> shaders(ShaderCreateInfos.size(),nullptr);
-  result=pfCreateShader(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
+  result=dispatch.vkCreateShadersEXT(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create shader objects");
 #pragma endregion
 
   //************ Image/Buffer *********************
 #pragma region ImageBuffer
-  auto GetBufferAddress=[device](VkBuffer buffer)->auto{
+  auto GetBufferAddress=[device,&dispatch](VkBuffer buffer)->auto{
     VkBufferDeviceAddressInfo bufferDeviceAddressInfo={
      .sType=VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
      .pNext=nullptr,
      .buffer=buffer
     };
 
-    return vkGetBufferDeviceAddress(device,&bufferDeviceAddressInfo);
+    return dispatch.vkGetBufferDeviceAddress(device,&bufferDeviceAddressInfo);
   };
 
   VmaAllocator allocator=nullptr;
@@ -307,7 +285,7 @@ int main(){
 
 
   VkDeviceSize descriptorSize=0;
-  pfGetDescriptorSetLayoutSize(device,setLayout,&descriptorSize);
+  dispatch.vkGetDescriptorSetLayoutSizeEXT(device,setLayout,&descriptorSize);
 
   VmaAllocationInfo descriptorAllocationInfo={};
   VkBuffer descriptorBuffer=nullptr;
@@ -363,7 +341,7 @@ int main(){
 
   //************** Pipeline ***********************
 #pragma region Pipeline
-  auto GetDescriptor=[device,pfnGetDescriptorEXT,DescriptorBufferProperties,descriptorAllocationInfo](VkDeviceAddress address,VkDeviceSize size,VkDeviceSize offset){
+  auto GetDescriptor=[device,&dispatch,DescriptorBufferProperties,descriptorAllocationInfo](VkDeviceAddress address,VkDeviceSize size,VkDeviceSize offset){
     VkDescriptorAddressInfoEXT inputAddressInfo={
       .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
       .pNext=nullptr,
@@ -379,13 +357,13 @@ int main(){
       .data={.pStorageBuffer=&inputAddressInfo}
     };
 
-    pfnGetDescriptorEXT(
+    dispatch.vkGetDescriptorEXT(
       device,&InputDescriptorGetInfo,
       DescriptorBufferProperties.storageBufferDescriptorSize,
       (uint8_t *)descriptorAllocationInfo.pMappedData+offset);
   };
   VkDeviceSize bindingOffset=0;
-  pfGetDescriptorSetLayoutBindingOffset(device,setLayout,0,&bindingOffset);
+  dispatch.vkGetDescriptorSetLayoutBindingOffsetEXT(device,setLayout,0,&bindingOffset);
 
   //CRASH HERE - an invalid offset causes a access violation in the AMD driver
   //This is another soft crash that the drivers will recover but can 
@@ -393,7 +371,7 @@ int main(){
   GetDescriptor(GetBufferAddress(inputBuffer)/*+(32*1024*1024)*/,inputSize,bindingOffset);
   std::cout<<std::format("Binding 0 Offset {}\n",bindingOffset);
 
-  pfGetDescriptorSetLayoutBindingOffset(device,setLayout,1,&bindingOffset);
+  dispatch.vkGetDescriptorSetLayoutBindingOffsetEXT(device,setLayout,1,&bindingOffset);
   GetDescriptor(GetBufferAddress(outputBuffer),outputSize,bindingOffset);
   std::cout<<std::format("Binding 1 Offset {}\n",bindingOffset);
 
@@ -407,116 +385,91 @@ int main(){
     .pushConstantRangeCount=0,
     .pPushConstantRanges=nullptr
   };
-  result=vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&pipelineLayout);
+  result=dispatch.vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&pipelineLayout);
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create pipeline layout");
 #pragma endregion
 
-  //*********** Command Buffer ********************
-#pragma region Command
-  VkCommandPool commandPool=nullptr;
-  VkCommandPoolCreateInfo commandPoolInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-    .pNext=nullptr,
-    .flags=0,
-    .queueFamilyIndex=0
-  };
-  result=vkCreateCommandPool(device,&commandPoolInfo,nullptr,&commandPool);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to create command pool");
-
-  VkCommandBuffer CMDBuffer;
-  VkCommandBufferAllocateInfo bufferAllocatorInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-    .pNext=nullptr,
-    .commandPool=commandPool,
-    .level=VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-    .commandBufferCount=1
-  };
-
-  /*******************************
-   *                             *
-   *  Command Buffer Operations  *
-   *                             *
-   *******************************/
-
-  result=vkAllocateCommandBuffers(device,&bufferAllocatorInfo,&CMDBuffer);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to allocate command buffer");
-#pragma endregion
-
-
   /************************************************
   *                                              *
   *        Command Buffer Operations             *
   *                                              *
   ************************************************/
-  VkCommandBufferBeginInfo bufferBeginInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-    .pNext=nullptr,
-    .flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    .pInheritanceInfo=nullptr
-  };
-  vkBeginCommandBuffer(CMDBuffer,&bufferBeginInfo);
-
-  VkBufferDeviceAddressInfo bufferDeviceAddressInfo={
-    .sType=VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-    .pNext=nullptr,
-    .buffer=descriptorBuffer
-  };
-
-  auto descriptorBufferAddress=GetBufferAddress(descriptorBuffer);
-
-  VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
-  pfCmdBindShaders(CMDBuffer,(uint32_t)shaders.size(),&stageFlags,shaders.data());
-   
-  VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
-    .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
-    .pNext=nullptr,
-    .address=descriptorBufferAddress,
-    .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
-  };
-  pfnCmdBindDescriptorBuffersEXT(CMDBuffer,1,&bufferBindingInfo);
-
-  uint32_t bufferIndice=0;
-  VkDeviceSize bufferOffset=0;
-
-  pfnCmdSetDescriptorBufferOffsetsEXT(CMDBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
-  vkCmdDispatch(CMDBuffer,1,1,1);
-
-  vkEndCommandBuffer(CMDBuffer);
-  VkQueue queue=nullptr;
-  vkGetDeviceQueue(device,0,0,&queue);
-  
+  //Command buffers come from the pools DeviceQueues keeps per queue family,
+  //the dispatch goes to the dedicated compute queue when there is one
   auto input=reinterpret_cast<float *>(inputAllocationInfo.pMappedData);
   input[0]=2.5f;
   input[1]=3.5f;
   input[2]=4.5f;
   input[3]=5.5f;
 
-  VkSubmitInfo submitInfo={
-    .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO,
+  VkBufferDeviceAddressInfo bufferDeviceAddressInfo={
+    .sType=VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
     .pNext=nullptr,
-    .waitSemaphoreCount=0,
-    .pWaitSemaphores=nullptr,
-    .pWaitDstStageMask=nullptr,
-    .commandBufferCount=1,
-    .pCommandBuffers=&CMDBuffer,
-    .signalSemaphoreCount=0,
-    .pSignalSemaphores=nullptr
+    .buffer=descriptorBuffer
   };
 
-  vkQueueSubmit(queue,1,&submitInfo,nullptr);
-  vkQueueWaitIdle(queue);
+  auto descriptorBufferAddress=GetBufferAddress(descriptorBuffer);
 
-  vkDestroyCommandPool(device,commandPool,nullptr);
+  //Host writes to the input are made visible by the submit itself
+  ResourceTracker resourceTracker(&dispatch);
+  FrameGraph frameGraph(device,allocator,resourceTracker,&dispatch);
+  GpuProfiler profiler(device,physicalDevices[0],3,64,VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT,&dispatch);
+  frameGraph.Profile(&profiler);
+  auto inputResource=frameGraph.ImportBuffer("Input",inputBuffer);
+  auto outputResource=frameGraph.ImportBuffer("Output",outputBuffer);
+
+  frameGraph.AddPass("Dispatch",QueueType::Compute,
+    [&](FrameGraph::PassBuilder &pass){
+      pass.Read(inputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+      pass.Write(outputResource,VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    },
+    [&](VkCommandBuffer CMDBuffer){
+      VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+      dispatch.vkCmdBindShadersEXT(CMDBuffer,(uint32_t)shaders.size(),&stageFlags,shaders.data());
+
+      VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+        .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+        .pNext=nullptr,
+        .address=descriptorBufferAddress,
+        .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+      };
+      dispatch.vkCmdBindDescriptorBuffersEXT(CMDBuffer,1,&bufferBindingInfo);
+
+      uint32_t bufferIndice=0;
+      VkDeviceSize bufferOffset=0;
+
+      dispatch.vkCmdSetDescriptorBufferOffsetsEXT(CMDBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
+      dispatch.vkCmdDispatch(CMDBuffer,1,1,1);
+    });
+
+  frameGraph.Export(outputResource,VK_PIPELINE_STAGE_2_HOST_BIT,VK_ACCESS_2_HOST_READ_BIT);
+  profiler.BeginFrame();
+  auto syncPoints=frameGraph.Submit(queues);
+  profiler.Submitted();
+  for(auto &point:syncPoints)
+    queues.Wait(point);
+
+  profiler.Collect();
+  if(!profileDirectory.empty()){
+    profiler.WriteJson((profileDirectory/"DescriptorBuffer.profile.json").string());
+    profiler.WriteChromeTrace((profileDirectory/"DescriptorBuffer.trace.json").string());
+  }
+
+  auto output=reinterpret_cast<float *>(outputAllocationInfo.pMappedData);
+  std::cout<<std::format("Output {} {} {} {}\n",output[0],output[1],output[2],output[3]);
+
+  queues.Destroy();
+  profiler.Destroy();
+  frameGraph.Reset();
   vmaDestroyBuffer(allocator,descriptorBuffer,descriptorBufferAllocation);
   vmaDestroyBuffer(allocator,inputBuffer,inputBufferAllocation);
   vmaDestroyBuffer(allocator,outputBuffer,outputBufferAllocation);
   vmaDestroyAllocator(allocator);
 
   for(auto &shader:shaders)
-    pfDestroyShader(device,shader,nullptr);
+    dispatch.vkDestroyShaderEXT(device,shader,nullptr);
+  computeSetLayout.reset();
 
   vkDestroyDevice(device,nullptr);
   vkDestroyInstance(instance,nullptr);
@@ -0,0 +1,355 @@
+#version 450
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+//Every ComputePrimitives kernel, one is picked by defining REDUCE, SCAN,
+//SCAN_LOOKBACK, CLEAR, COMPACT, HISTOGRAM or SCATTER. Needs SPIR-V 1.3 for
+//the subgroup operations.
+//
+//A workgroup handles a tile of TILE elements in ROUNDS rounds of one element
+//per invocation. Scans run per subgroup first, the subgroup totals are then
+//scanned in shared memory. Element order within a round follows the
+//subgroups, which assumes every subgroup of the workgroup is full.
+//ComputePrimitives creates the kernels with full subgroups of a required
+//size to guarantee it.
+
+#ifdef SCAN_LOOKBACK
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_shader_atomic_int64 : require
+#endif
+
+#define WORKGROUP_SIZE 256
+#define ROUNDS 4
+#define TILE (WORKGROUP_SIZE*ROUNDS)
+#define RADIX_BITS 4
+#define RADIX (1<<RADIX_BITS)
+//ComputePrimitives refuses devices with subgroups under 4 invocations
+#define MAX_SUBGROUPS (WORKGROUP_SIZE/4)
+
+#define FLAG_PREDICATE 1u
+#define FLAG_OFFSETS 2u
+
+layout(local_size_x=WORKGROUP_SIZE) in;
+
+layout(std430,set=0,binding=0) readonly buffer Input{
+  uint values[];
+}inputData;
+
+layout(std430,set=0,binding=1) writeonly buffer Output{
+  uint values[];
+}outputData;
+
+//Tile offsets from a scan, per tile or per digit and tile for SCATTER
+layout(std430,set=0,binding=2) readonly buffer Offsets{
+  uint values[];
+}offsets;
+
+#ifdef SCAN_LOOKBACK
+//Per tile the published sum in the low 32 bits and its state above them,
+//single 64 bit atomics so a sum is never seen without its state
+layout(std430,set=0,binding=3) coherent buffer Status{
+  uint tileCounter;
+  uint padding;
+  uint64_t tiles[];
+}status;
+#else
+//Words CLEAR zeroes, COMPACT writes the number of values kept to [0]
+layout(std430,set=0,binding=3) buffer Extra{
+  uint values[];
+}extra;
+#endif
+
+layout(push_constant) uniform Parameters{
+  uint count;
+  //Bit offset of the digit HISTOGRAM and SCATTER sort by
+  uint shift;
+  //Compaction keeps the values with (value&mask)==match
+  uint mask;
+  uint match;
+  uint flags;
+}parameters;
+
+shared uint subgroupTotals[MAX_SUBGROUPS];
+shared uint workgroupTotal;
+
+//Index of the invocation's element within a round
+uint Slot(){
+  return gl_SubgroupID*gl_SubgroupSize+gl_SubgroupInvocationID;
+}
+
+bool Keep(uint value){
+  return (value&parameters.mask)==parameters.match;
+}
+
+//The element as the kernel sums it, 0 past the end. With FLAG_PREDICATE a
+//kept value counts 1 and any other 0.
+uint Load(uint index){
+  if(index>=parameters.count)
+    return 0u;
+  uint value=inputData.values[index];
+  if((parameters.flags&FLAG_PREDICATE)!=0)
+    return Keep(value)?1u:0u;
+  return value;
+}
+
+//Sum of value over the workgroup
+uint WorkgroupAdd(uint value){
+  uint sum=subgroupAdd(value);
+  if(subgroupElect())
+    subgroupTotals[gl_SubgroupID]=sum;
+  barrier();
+  if(gl_LocalInvocationIndex==0){
+    uint total=0;
+    for(uint index=0;index<gl_NumSubgroups;index++)
+      total+=subgroupTotals[index];
+    workgroupTotal=total;
+  }
+  barrier();
+  uint total=workgroupTotal;
+  barrier();
+  return total;
+}
+
+//Exclusive prefix sum of value in Slot() order, total is the workgroup's sum
+uint WorkgroupExclusiveAdd(uint value,out uint total){
+  uint exclusive=subgroupExclusiveAdd(value);
+  uint sum=subgroupAdd(value);
+  if(subgroupElect())
+    subgroupTotals[gl_SubgroupID]=sum;
+  barrier();
+  if(gl_LocalInvocationIndex==0){
+    uint running=0;
+    for(uint index=0;index<gl_NumSubgroups;index++){
+      uint subgroupTotal=subgroupTotals[index];
+      subgroupTotals[index]=running;
+      running+=subgroupTotal;
+    }
+    workgroupTotal=running;
+  }
+  barrier();
+  exclusive+=subgroupTotals[gl_SubgroupID];
+  total=workgroupTotal;
+  //The next call overwrites the totals
+  barrier();
+  return exclusive;
+}
+
+#ifdef REDUCE
+//Sum of every tile to outputData.values[tile]
+void main(){
+  uint base=gl_WorkGroupID.x*TILE+Slot();
+  uint sum=0;
+  for(uint iteration=0;iteration<ROUNDS;iteration++)
+    sum+=Load(base+iteration*WORKGROUP_SIZE);
+  sum=WorkgroupAdd(sum);
+  if(gl_LocalInvocationIndex==0)
+    outputData.values[gl_WorkGroupID.x]=sum;
+}
+#endif
+
+#ifdef SCAN
+//Exclusive scan of every tile, plus the tile's offset with FLAG_OFFSETS
+void main(){
+  uint base=gl_WorkGroupID.x*TILE+Slot();
+  uint carry=(parameters.flags&FLAG_OFFSETS)!=0?offsets.values[gl_WorkGroupID.x]:0u;
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    uint index=base+iteration*WORKGROUP_SIZE;
+    uint total;
+    uint exclusive=WorkgroupExclusiveAdd(Load(index),total);
+    if(index<parameters.count)
+      outputData.values[index]=carry+exclusive;
+    carry+=total;
+  }
+}
+#endif
+
+#ifdef SCAN_LOOKBACK
+//States of a published sum, 0 is nothing published yet
+#define STATE_AGGREGATE 1u
+#define STATE_PREFIX 2u
+
+shared uint tileIndex;
+shared uint tilePrefix;
+
+uint64_t Publish(uint state,uint sum){
+  return (uint64_t(state)<<32)|uint64_t(sum);
+}
+
+//Single pass exclusive scan with decoupled look-back. Tiles are numbered in
+//the order workgroups start, not by gl_WorkGroupID, so every tile waited on
+//belongs to a workgroup that is already running. That still relies on
+//running workgroups making progress while another spins, which Vulkan does
+//not promise but every desktop driver provides.
+void main(){
+  if(gl_LocalInvocationIndex==0)
+    tileIndex=atomicAdd(status.tileCounter,1u);
+  barrier();
+  uint tile=tileIndex;
+  uint base=tile*TILE+Slot();
+
+  uint prefixes[ROUNDS];
+  uint aggregate=0;
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    uint total;
+    prefixes[iteration]=aggregate+WorkgroupExclusiveAdd(Load(base+iteration*WORKGROUP_SIZE),total);
+    aggregate+=total;
+  }
+
+  //The first subgroup publishes the tile's sum, then walks back over the
+  //predecessors one subgroup width at a time until it meets an inclusive
+  //prefix, adding up the sums on the way
+  if(gl_SubgroupID==0){
+    if(tile==0){
+      if(subgroupElect()){
+        atomicExchange(status.tiles[0],Publish(STATE_PREFIX,aggregate));
+        tilePrefix=0;
+      }
+    }else{
+      if(subgroupElect())
+        atomicExchange(status.tiles[tile],Publish(STATE_AGGREGATE,aggregate));
+      uint exclusive=0;
+      int window=int(tile)-1;
+      while(true){
+        int predecessor=window-int(gl_SubgroupInvocationID);
+        uint64_t published=predecessor>=0?atomicAdd(status.tiles[predecessor],0ul):Publish(STATE_PREFIX,0u);
+        uint state=uint(published>>32);
+        uvec4 prefixLanes=subgroupBallot(state==STATE_PREFIX);
+        bool found=subgroupAny(state==STATE_PREFIX);
+        uint last=found?subgroupBallotFindLSB(prefixLanes):gl_SubgroupSize-1;
+        if(subgroupAny(state==0&&gl_SubgroupInvocationID<=last))
+          continue;
+        exclusive+=subgroupAdd(gl_SubgroupInvocationID<=last?uint(published):0u);
+        if(found)
+          break;
+        window-=int(gl_SubgroupSize);
+      }
+      if(subgroupElect()){
+        atomicExchange(status.tiles[tile],Publish(STATE_PREFIX,exclusive+aggregate));
+        tilePrefix=exclusive;
+      }
+    }
+  }
+  barrier();
+
+  uint prefix=tilePrefix;
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    uint index=base+iteration*WORKGROUP_SIZE;
+    if(index<parameters.count)
+      outputData.values[index]=prefix+prefixes[iteration];
+  }
+}
+#endif
+
+#ifdef CLEAR
+//Zeroes the first parameters.count words of the extra buffer
+void main(){
+  uint index=gl_GlobalInvocationID.x;
+  if(index<parameters.count)
+    extra.values[index]=0;
+}
+#endif
+
+#ifdef COMPACT
+//Stable compaction, every tile writes its kept values from its offset on.
+//The last tile also writes how many were kept in total.
+void main(){
+  uint base=gl_WorkGroupID.x*TILE+Slot();
+  uint carry=offsets.values[gl_WorkGroupID.x];
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    uint index=base+iteration*WORKGROUP_SIZE;
+    uint value=index<parameters.count?inputData.values[index]:0u;
+    bool keep=index<parameters.count&&Keep(value);
+    uint total;
+    uint position=WorkgroupExclusiveAdd(keep?1u:0u,total);
+    if(keep)
+      outputData.values[carry+position]=value;
+    carry+=total;
+  }
+  if(gl_WorkGroupID.x==gl_NumWorkGroups.x-1&&gl_LocalInvocationIndex==0)
+    extra.values[0]=carry;
+}
+#endif
+
+#if defined(HISTOGRAM)||defined(SCATTER)
+uint Digit(uint key){
+  return (key>>parameters.shift)&(RADIX-1);
+}
+#endif
+
+#ifdef HISTOGRAM
+shared uint digitCounts[RADIX];
+
+//Per tile count of every digit, digit major so that one exclusive scan over
+//the whole histogram gives every tile the first position of each digit
+void main(){
+  if(gl_LocalInvocationIndex<RADIX)
+    digitCounts[gl_LocalInvocationIndex]=0;
+  barrier();
+  uint base=gl_WorkGroupID.x*TILE+Slot();
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    uint index=base+iteration*WORKGROUP_SIZE;
+    if(index<parameters.count)
+      atomicAdd(digitCounts[Digit(inputData.values[index])],1u);
+  }
+  barrier();
+  if(gl_LocalInvocationIndex<RADIX)
+    outputData.values[gl_LocalInvocationIndex*gl_NumWorkGroups.x+gl_WorkGroupID.x]=digitCounts[gl_LocalInvocationIndex];
+}
+#endif
+
+#ifdef SCATTER
+//Per subgroup and digit the count, replaced by the first position in place
+shared uint subgroupDigits[MAX_SUBGROUPS*RADIX];
+//Per digit the position the next round starts from
+shared uint digitPositions[RADIX];
+
+//The lanes holding the same digit, ballots over its bits
+uvec4 Peers(uint digit,bool valid){
+  uvec4 peers=subgroupBallot(valid);
+  for(uint bit=0;bit<RADIX_BITS;bit++){
+    bool bitSet=((digit>>bit)&1)!=0;
+    uvec4 lanes=subgroupBallot(bitSet);
+    peers&=bitSet?lanes:~lanes;
+  }
+  return peers;
+}
+
+//Stable scatter of one digit: a key goes to its digit's position for the
+//tile, plus the keys with the same digit before it in the tile
+void main(){
+  if(gl_LocalInvocationIndex<RADIX)
+    digitPositions[gl_LocalInvocationIndex]=offsets.values[gl_LocalInvocationIndex*gl_NumWorkGroups.x+gl_WorkGroupID.x];
+  uint base=gl_WorkGroupID.x*TILE+Slot();
+  for(uint iteration=0;iteration<ROUNDS;iteration++){
+    for(uint entry=gl_LocalInvocationIndex;entry<gl_NumSubgroups*RADIX;entry+=WORKGROUP_SIZE)
+      subgroupDigits[entry]=0;
+    barrier();
+
+    uint index=base+iteration*WORKGROUP_SIZE;
+    bool valid=index<parameters.count;
+    uint key=valid?inputData.values[index]:0u;
+    uint digit=Digit(key);
+    uvec4 peers=Peers(digit,valid);
+    uint rank=subgroupBallotExclusiveBitCount(peers);
+    if(valid&&rank==0)
+      subgroupDigits[gl_SubgroupID*RADIX+digit]=subgroupBallotBitCount(peers);
+    barrier();
+
+    if(gl_LocalInvocationIndex<RADIX){
+      uint position=digitPositions[gl_LocalInvocationIndex];
+      for(uint subgroup=0;subgroup<gl_NumSubgroups;subgroup++){
+        uint count=subgroupDigits[subgroup*RADIX+gl_LocalInvocationIndex];
+        subgroupDigits[subgroup*RADIX+gl_LocalInvocationIndex]=position;
+        position+=count;
+      }
+      digitPositions[gl_LocalInvocationIndex]=position;
+    }
+    barrier();
+
+    if(valid)
+      outputData.values[subgroupDigits[gl_SubgroupID*RADIX+digit]+rank]=key;
+    barrier();
+  }
+}
+#endif
@@ -0,0 +1,364 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<memory>
+#include<atomic>
+#include<cstring>
+#include<algorithm>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"FuzzCampaign.h"
+
+//Generalises the commented out /*+(32*1024*1024)*/ in DescriptorBuffer.cpp:
+//vkGetDescriptorEXT is fed every combination of a handful of address
+//offsets, ranges and descriptor types, written at a few offsets around the
+//binding, then dispatched with comp.spv with or without the descriptor
+//buffer bound.
+//
+//Every case in a batch gets its own set in one descriptor buffer and its own
+//dispatch in one command buffer, so a batch costs a single submission. Sets
+//are padded on both sides so misplaced writes stay inside the buffer.
+class DescriptorHarness:public FuzzHarness{
+public:
+  enum Field{
+    Address,
+    Range,
+    Type,
+    BindingOffset,
+    Bound
+  };
+
+  static FuzzTarget Target(){
+    return {
+      .name="descriptor",
+      .description="vkGetDescriptorEXT address, range, type and placement for comp.spv",
+      .fields={
+        {"address",{"exact","aligned","unaligned","end","far","high","null","below","top"}},
+        {"range",{"buffer","small","zero","past-end","whole","max","over-max"}},
+        {"type",{"storage-buffer","uniform-buffer","storage-texel","uniform-texel"}},
+        {"binding-offset",{"layout","unaligned","next-binding","past-layout","before"}},
+        {"bound",{"yes","no"}}
+      },
+      .create=[](HeadlessDevice &context,uint32_t capacity)->std::unique_ptr<FuzzHarness>{
+        return std::make_unique<DescriptorHarness>(context,capacity);
+      }
+    };
+  }
+
+private:
+  static constexpr VkDeviceSize InputSize=2048;
+  static constexpr VkDeviceSize OutputSize=4096;
+  //Room on both sides of every set for descriptors written out of place
+  static constexpr VkDeviceSize Padding=256;
+
+  static constexpr std::array<VkDescriptorType,4> Types={
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,
+    VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+  };
+
+  HeadlessDevice &context;
+  uint32_t capacity;
+  VkDescriptorSetLayout setLayout=nullptr;
+  VkPipelineLayout pipelineLayout=nullptr;
+  VkShaderEXT shader=nullptr;
+
+  VkBuffer descriptorBuffer=nullptr;
+  VmaAllocation descriptorAllocation=nullptr;
+  VmaAllocationInfo descriptorInfo={};
+  VkBuffer inputBuffer=nullptr;
+  VmaAllocation inputAllocation=nullptr;
+  VkBuffer outputBuffer=nullptr;
+  VmaAllocation outputAllocation=nullptr;
+  VkDeviceAddress descriptorBufferAddress=0;
+  VkDeviceAddress inputAddress=0;
+  VkDeviceAddress outputAddress=0;
+
+  VkPhysicalDeviceLimits limits={};
+  std::array<size_t,4> descriptorSizes={};
+  VkDeviceSize layoutSize=0;
+  std::array<VkDeviceSize,2> bindingOffsets={};
+  //Offset of the first set and distance between sets, both aligned to
+  //descriptorBufferOffsetAlignment
+  VkDeviceSize lead=0;
+  VkDeviceSize stride=0;
+
+  static VkDeviceSize AlignUp(VkDeviceSize value,VkDeviceSize alignment){
+    return (value+alignment-1)/alignment*alignment;
+  }
+
+  void WriteDescriptor(uint8_t *target,uint32_t type,VkDeviceAddress address,VkDeviceSize range){
+    VkDescriptorAddressInfoEXT addressInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+      .pNext=nullptr,
+      .address=address,
+      .range=range,
+      .format=type>=2?VK_FORMAT_R32_SFLOAT:VK_FORMAT_UNDEFINED
+    };
+    VkDescriptorGetInfoEXT descriptorGetInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=Types[type]
+    };
+    switch(Types[type]){
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      descriptorGetInfo.data.pUniformBuffer=&addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      descriptorGetInfo.data.pStorageTexelBuffer=&addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      descriptorGetInfo.data.pUniformTexelBuffer=&addressInfo;
+      break;
+    default:
+      descriptorGetInfo.data.pStorageBuffer=&addressInfo;
+      break;
+    }
+    context.dispatch.vkGetDescriptorEXT(context.device,&descriptorGetInfo,descriptorSizes[type],target);
+  }
+
+  VkDeviceAddress CaseAddress(uint8_t value)const{
+    switch(value){
+    case 1:
+      return inputAddress+limits.minStorageBufferOffsetAlignment;
+    case 2:
+      return inputAddress+4;
+    case 3:
+      return inputAddress+InputSize;
+    case 4:
+      return inputAddress+32*1024*1024;
+    case 5:
+      return inputAddress+(1ull<<40);
+    case 6:
+      return 0;
+    case 7:
+      return inputAddress-4096;
+    case 8:
+      return ~0ull&~255ull;
+    default:
+      return inputAddress;
+    }
+  }
+
+  VkDeviceSize CaseRange(uint8_t value)const{
+    switch(value){
+    case 1:
+      return 4;
+    case 2:
+      return 0;
+    case 3:
+      return InputSize+Padding;
+    case 4:
+      return VK_WHOLE_SIZE;
+    case 5:
+      return limits.maxStorageBufferRange;
+    case 6:
+      return (VkDeviceSize)limits.maxStorageBufferRange+1;
+    default:
+      return InputSize;
+    }
+  }
+
+  //Relative to the start of the set, "before" lands in the padding in front
+  int64_t CaseOffset(uint8_t value,uint32_t type)const{
+    switch(value){
+    case 1:
+      return (int64_t)bindingOffsets[0]+4;
+    case 2:
+      return (int64_t)bindingOffsets[1];
+    case 3:
+      return (int64_t)layoutSize;
+    case 4:
+      return (int64_t)bindingOffsets[0]-(int64_t)descriptorSizes[type];
+    default:
+      return (int64_t)bindingOffsets[0];
+    }
+  }
+
+  void Barrier(VkCommandBuffer CMDBuffer){
+    VkMemoryBarrier2 memoryBarrier={
+      .sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .pNext=nullptr,
+      .srcStageMask=VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .srcAccessMask=VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dstStageMask=VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .dstAccessMask=VK_ACCESS_2_SHADER_STORAGE_READ_BIT|VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    };
+    VkDependencyInfo dependencyInfo={
+      .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext=nullptr,
+      .dependencyFlags=0,
+      .memoryBarrierCount=1,
+      .pMemoryBarriers=&memoryBarrier,
+      .bufferMemoryBarrierCount=0,
+      .pBufferMemoryBarriers=nullptr,
+      .imageMemoryBarrierCount=0,
+      .pImageMemoryBarriers=nullptr
+    };
+    context.dispatch.vkCmdPipelineBarrier2(CMDBuffer,&dependencyInfo);
+  }
+
+public:
+  DescriptorHarness(HeadlessDevice &context,uint32_t capacity):context(context),capacity(capacity){
+    auto device=context.device;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    for(uint32_t binding=0;binding<2;binding++){
+      bindings[binding]={
+        .binding=binding,
+        .descriptorType=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount=1,
+        .stageFlags=VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers=nullptr
+      };
+    }
+    setLayout=context.CreateSetLayout(bindings,VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr
+    };
+    auto result=context.dispatch.vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&pipelineLayout);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create pipeline layout");
+
+    auto computeShaderCode=context.Shader("comp.spv");
+    VkShaderCreateInfoEXT shaderCreateInfo={
+      .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .pNext=nullptr,
+      .flags=0,
+      .stage=VK_SHADER_STAGE_COMPUTE_BIT,
+      .nextStage=0,
+      .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize=computeShaderCode.size()*sizeof(uint32_t),
+      .pCode=computeShaderCode.data(),
+      .pName="main",
+      .setLayoutCount=1,
+      .pSetLayouts=&setLayout,
+      .pushConstantRangeCount=0,
+      .pPushConstantRanges=nullptr,
+      .pSpecializationInfo=nullptr
+    };
+    result=context.dispatch.vkCreateShadersEXT(device,1,&shaderCreateInfo,nullptr,&shader);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create shader objects");
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceProperties2 deviceProperties={
+      .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext=&descriptorBufferProperties
+    };
+    vkGetPhysicalDeviceProperties2(context.physicalDevice,&deviceProperties);
+    limits=deviceProperties.properties.limits;
+    descriptorSizes={
+      descriptorBufferProperties.storageBufferDescriptorSize,
+      descriptorBufferProperties.uniformBufferDescriptorSize,
+      descriptorBufferProperties.storageTexelBufferDescriptorSize,
+      descriptorBufferProperties.uniformTexelBufferDescriptorSize
+    };
+    if(*std::max_element(descriptorSizes.begin(),descriptorSizes.end())>Padding)
+      throw std::runtime_error("Descriptors are larger than the padding between sets");
+
+    context.dispatch.vkGetDescriptorSetLayoutSizeEXT(device,setLayout,&layoutSize);
+    for(uint32_t binding=0;binding<2;binding++)
+      context.dispatch.vkGetDescriptorSetLayoutBindingOffsetEXT(device,setLayout,binding,&bindingOffsets[binding]);
+
+    auto alignment=std::max<VkDeviceSize>(descriptorBufferProperties.descriptorBufferOffsetAlignment,1);
+    lead=AlignUp(Padding,alignment);
+    stride=AlignUp(lead+layoutSize+Padding,alignment);
+
+    VmaAllocationInfo inputInfo={},outputInfo={};
+    descriptorBuffer=context.CreateBuffer(lead+stride*capacity,
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,descriptorAllocation,descriptorInfo);
+    //Every usage any of the fuzzed descriptor types could need
+    inputBuffer=context.CreateBuffer(InputSize,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT|
+      VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT|VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT,
+      inputAllocation,inputInfo);
+    outputBuffer=context.CreateBuffer(OutputSize,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,outputAllocation,outputInfo);
+    descriptorBufferAddress=context.BufferAddress(descriptorBuffer);
+    inputAddress=context.BufferAddress(inputBuffer);
+    outputAddress=context.BufferAddress(outputBuffer);
+
+    auto input=reinterpret_cast<float *>(inputInfo.pMappedData);
+    input[0]=2.5f;
+    input[1]=3.5f;
+    input[2]=4.5f;
+    input[3]=5.5f;
+  }
+
+  DescriptorHarness(const DescriptorHarness &)=delete;
+  DescriptorHarness &operator=(const DescriptorHarness &)=delete;
+
+  ~DescriptorHarness(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    context.DestroyBuffer(descriptorBuffer,descriptorAllocation);
+    context.DestroyBuffer(inputBuffer,inputAllocation);
+    context.DestroyBuffer(outputBuffer,outputAllocation);
+    context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    context.dispatch.vkDestroyPipelineLayout(context.device,pipelineLayout,nullptr);
+    context.dispatch.vkDestroyDescriptorSetLayout(context.device,setLayout,nullptr);
+  }
+
+  void Run(const std::vector<FuzzCase> &cases,std::atomic<uint32_t> &progress,int32_t *results)override{
+    if(cases.size()>capacity)
+      throw std::runtime_error("Batch is larger than the descriptor buffer");
+
+    auto descriptors=reinterpret_cast<uint8_t *>(descriptorInfo.pMappedData);
+    for(uint32_t index=0;index<cases.size();index++){
+      progress.store(index,std::memory_order_relaxed);
+      auto &fuzzCase=cases[index];
+      auto set=descriptors+lead+stride*index;
+      memset(set-Padding,0,Padding+layoutSize+Padding);
+
+      //Output first so next-binding overwrites it like the misplaced write would
+      WriteDescriptor(set+bindingOffsets[1],0,outputAddress,OutputSize);
+      uint32_t type=fuzzCase[Type];
+      WriteDescriptor(set+CaseOffset(fuzzCase[BindingOffset],type),type,
+        CaseAddress(fuzzCase[Address]),CaseRange(fuzzCase[Range]));
+    }
+    progress.store((uint32_t)cases.size(),std::memory_order_relaxed);
+
+    auto &queue=*context.queues->compute;
+    auto CMDBuffer=context.queues->Begin(queue);
+    VkShaderStageFlagBits stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+    context.dispatch.vkCmdBindShadersEXT(CMDBuffer,1,&stageFlags,&shader);
+
+    //Bindings stick for the rest of the command buffer, unbound cases go first
+    for(auto &fuzzCase:cases){
+      if(fuzzCase[Bound]==0)
+        continue;
+      context.dispatch.vkCmdDispatch(CMDBuffer,1,1,1);
+      Barrier(CMDBuffer);
+    }
+
+    VkDescriptorBufferBindingInfoEXT bufferBindingInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+      .pNext=nullptr,
+      .address=descriptorBufferAddress,
+      .usage=VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+    };
+    context.dispatch.vkCmdBindDescriptorBuffersEXT(CMDBuffer,1,&bufferBindingInfo);
+    for(uint32_t index=0;index<cases.size();index++){
+      if(cases[index][Bound]!=0)
+        continue;
+      uint32_t bufferIndice=0;
+      VkDeviceSize bufferOffset=lead+stride*index;
+      context.dispatch.vkCmdSetDescriptorBufferOffsetsEXT(CMDBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&bufferIndice,&bufferOffset);
+      context.dispatch.vkCmdDispatch(CMDBuffer,1,1,1);
+      Barrier(CMDBuffer);
+    }
+
+    context.queues->Wait(context.queues->Submit(queue,CMDBuffer));
+  }
+};
@@ -0,0 +1,318 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<memory>
+#include<atomic>
+#include<random>
+#include<functional>
+#include<unordered_set>
+#include<unordered_map>
+#include<format>
+#include<algorithm>
+#include<stdexcept>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/WorkerPool.h"
+
+//Structured fuzzing over a fixed case space. A target describes its cases as
+//a handful of fields with a few named values each, value 0 of every field is
+//the valid usage. A case is one value index per field, so the parent can
+//enumerate, sample, print and minimise cases without ever touching Vulkan;
+//only the harness inside the workers turns them into API calls.
+//
+//Cases run in batches through a WorkerPool, one device and one harness per
+//worker. When a batch does not pass, the case the harness was preparing when
+//the worker died is blamed if there is one, everything else in the batch is
+//rerun one case per job. Failing cases are grouped by signature and each
+//group is minimised by resetting fields to their valid value for as long as
+//the failure reproduces.
+//
+//Cases a target declares equivalent are run once: sampling and minimising
+//only ever use the canonical form.
+
+struct FuzzField{
+  const char *name;
+  std::vector<const char *> values;
+};
+
+using FuzzCase=std::vector<uint8_t>;
+
+//Lives in a worker for as long as its device does
+class FuzzHarness{
+public:
+  virtual ~FuzzHarness()=default;
+  //Runs the cases as one batch. progress holds the index of the case being
+  //prepared on the host and is set to cases.size() once the batch goes to
+  //the device, so a crash on the host side can be pinned on one case.
+  //results holds one VkResult per case, already VK_SUCCESS, for calls that
+  //reject a case without crashing.
+  virtual void Run(const std::vector<FuzzCase> &cases,std::atomic<uint32_t> &progress,int32_t *results)=0;
+};
+
+struct FuzzTarget{
+  const char *name;
+  const char *description;
+  std::vector<FuzzField> fields;
+  std::function<std::unique_ptr<FuzzHarness>(HeadlessDevice &context,uint32_t capacity)> create;
+  //Optional, rewrites a case into the representative of the cases that
+  //exercise exactly the same calls
+  std::function<void(FuzzCase &fuzzCase)> canonicalise;
+
+  uint64_t CaseCount()const{
+    uint64_t count=1;
+    for(auto &field:fields)
+      count*=field.values.size();
+    return count;
+  }
+
+  //Mixed radix, the first field varies fastest
+  FuzzCase FromIndex(uint64_t index)const{
+    FuzzCase fuzzCase(fields.size());
+    for(size_t field=0;field<fields.size();field++){
+      fuzzCase[field]=(uint8_t)(index%fields[field].values.size());
+      index/=fields[field].values.size();
+    }
+    return fuzzCase;
+  }
+
+  uint64_t Index(const FuzzCase &fuzzCase)const{
+    uint64_t index=0;
+    for(size_t field=fields.size();field-->0;)
+      index=index*fields[field].values.size()+fuzzCase[field];
+    return index;
+  }
+
+  uint64_t Canonical(uint64_t index)const{
+    if(!canonicalise)
+      return index;
+    auto fuzzCase=FromIndex(index);
+    canonicalise(fuzzCase);
+    return Index(fuzzCase);
+  }
+
+  //Only the fields that differ from valid usage
+  std::string Describe(const FuzzCase &fuzzCase)const{
+    std::string text;
+    for(size_t field=0;field<fields.size();field++){
+      if(fuzzCase[field]==0)
+        continue;
+      text+=std::format("{}{}={}",text.empty()?"":" ",fields[field].name,fields[field].values[fuzzCase[field]]);
+    }
+    return text.empty()?"valid":text;
+  }
+};
+
+struct CaseResult{
+  Outcome outcome=Outcome::Pending;
+  //VkResult the harness reported for a case that did not crash
+  int32_t code=0;
+  //Outcome plus what tells failures apart, equal signatures are treated as
+  //the same bug
+  std::string signature;
+  std::string message;
+};
+
+struct FailureGroup{
+  std::string signature;
+  std::vector<uint64_t> cases;
+  uint64_t minimal=0;
+  //Jobs spent minimising
+  uint32_t attempts=0;
+};
+
+class FuzzCampaign{
+  const FuzzTarget &target;
+  WorkerPool &pool;
+  std::function<std::shared_ptr<HeadlessDevice>()> openDevice;
+  //Largest batch, the harnesses are created with room for it
+  uint32_t batchSize;
+
+  static std::string Signature(const JobReport &report){
+    switch(report.outcome){
+    case Outcome::Crashed:
+      return std::format("crashed: {}",strsignal(report.status));
+    case Outcome::TimedOut:
+      return "timed-out";
+    default:
+      return std::format("{}: {}",OutcomeNames[(uint32_t)report.outcome],report.message);
+    }
+  }
+
+  //Members are destroyed in reverse, the harness goes before its device
+  struct Worker{
+    std::shared_ptr<HeadlessDevice> context;
+    std::unique_ptr<FuzzHarness> harness;
+    std::vector<FuzzCase> cases;
+  };
+
+  WorkerPool::JobFunction SetupWorker(const std::vector<std::vector<uint64_t>> &batches,
+    const std::vector<size_t> &offsets,int32_t *codes){
+    auto worker=std::make_shared<Worker>();
+    worker->context=openDevice();
+    worker->harness=target.create(*worker->context,batchSize);
+    worker->cases.reserve(batchSize);
+
+    return [worker,&batches,&offsets,codes,this](uint32_t job,std::atomic<uint32_t> &progress,std::string &message){
+      auto &cases=worker->cases;
+      cases.clear();
+      for(auto index:batches[job])
+        cases.push_back(target.FromIndex(index));
+      try{
+        worker->harness->Run(cases,progress,codes+offsets[job]);
+      }catch(const std::exception &exception){
+        message=exception.what();
+        return worker->context->Lost()?Outcome::DeviceLost:Outcome::Failed;
+      }
+      return Outcome::Passed;
+    };
+  }
+
+public:
+  FuzzCampaign(const FuzzTarget &target,WorkerPool &pool,std::function<std::shared_ptr<HeadlessDevice>()> openDevice,
+    uint32_t batchSize):target(target),pool(pool),openDevice(std::move(openDevice)),batchSize(batchSize){
+    if(batchSize==0)
+      throw std::runtime_error("Batch size has to be at least 1");
+  }
+
+  //Distinct canonical case indices, every one of them when count is 0 or
+  //covers most of the space
+  std::vector<uint64_t> Sample(uint64_t count,uint64_t seed)const{
+    uint64_t total=target.CaseCount();
+    std::mt19937_64 random(seed);
+    std::vector<uint64_t> indices;
+
+    if(count==0||count*2>=total){
+      for(uint64_t index=0;index<total;index++){
+        if(target.Canonical(index)==index)
+          indices.push_back(index);
+      }
+      std::shuffle(indices.begin(),indices.end(),random);
+      if(count>0&&count<indices.size())
+        indices.resize(count);
+      return indices;
+    }
+
+    //Gives up early when canonicalisation leaves fewer cases than asked for
+    std::unordered_set<uint64_t> seen;
+    std::uniform_int_distribution<uint64_t> distribution(0,total-1);
+    for(uint64_t draw=0;indices.size()<count&&draw<count*64;draw++){
+      auto index=target.Canonical(distribution(random));
+      if(seen.insert(index).second)
+        indices.push_back(index);
+    }
+    return indices;
+  }
+
+  //One result per case, in the order given. The first round runs batches of
+  //up to size cases, the reruns one case each.
+  std::vector<CaseResult> Run(const std::vector<uint64_t> &indices,uint32_t size){
+    std::vector<CaseResult> results(indices.size());
+    std::vector<uint32_t> pending(indices.size());
+    for(uint32_t index=0;index<pending.size();index++)
+      pending[index]=index;
+
+    size=std::clamp(size,1u,batchSize);
+    while(!pending.empty()){
+      std::vector<std::vector<uint64_t>> batches;
+      std::vector<std::vector<uint32_t>> members;
+      std::vector<size_t> offsets;
+      for(size_t begin=0;begin<pending.size();begin+=size){
+        auto end=std::min(pending.size(),begin+size);
+        offsets.push_back(begin);
+        batches.emplace_back();
+        members.emplace_back(pending.begin()+begin,pending.begin()+end);
+        for(auto member:members.back())
+          batches.back().push_back(indices[member]);
+      }
+
+      SharedArray<int32_t> codes(pending.size());
+      auto reports=pool.Run((uint32_t)batches.size(),[&](){
+        return SetupWorker(batches,offsets,codes.Data());
+      });
+
+      std::vector<uint32_t> retry;
+      for(size_t batch=0;batch<batches.size();batch++){
+        auto &report=reports[batch];
+        auto &batchMembers=members[batch];
+        auto Settle=[&](uint32_t position){
+          results[batchMembers[position]]={report.outcome,codes[offsets[batch]+position],Signature(report),report.message};
+        };
+
+        if(report.outcome==Outcome::Passed||batchMembers.size()==1){
+          for(uint32_t position=0;position<batchMembers.size();position++)
+            Settle(position);
+          continue;
+        }
+
+        //Died while the host was still preparing one of the cases
+        bool blamed=report.outcome!=Outcome::Skipped&&report.progress<batchMembers.size();
+        for(uint32_t position=0;position<batchMembers.size();position++){
+          if(blamed&&position==report.progress)
+            Settle(position);
+          else
+            retry.push_back(batchMembers[position]);
+        }
+      }
+
+      pending=std::move(retry);
+      size=1;
+    }
+    return results;
+  }
+
+  //Groups failing cases by signature, in order of first appearance
+  static std::vector<FailureGroup> Group(const std::vector<uint64_t> &indices,const std::vector<CaseResult> &results){
+    std::vector<FailureGroup> groups;
+    std::unordered_map<std::string,size_t> lookup;
+    for(size_t index=0;index<indices.size();index++){
+      auto &result=results[index];
+      if(result.outcome==Outcome::Passed||result.outcome==Outcome::Skipped)
+        continue;
+
+      auto [entry,inserted]=lookup.try_emplace(result.signature,groups.size());
+      if(inserted)
+        groups.push_back({result.signature,{},indices[index],0});
+      groups[entry->second].cases.push_back(indices[index]);
+    }
+    return groups;
+  }
+
+  //Greedy one field at a time: every round tries resetting each remaining
+  //field to its valid value in parallel and keeps the first candidate that
+  //still fails with the same signature
+  void Minimise(FailureGroup &group){
+    //Start from the case closest to valid usage
+    auto Distance=[&](uint64_t index){
+      auto fuzzCase=target.FromIndex(index);
+      return std::count_if(fuzzCase.begin(),fuzzCase.end(),[](uint8_t value){return value!=0;});
+    };
+    group.minimal=*std::min_element(group.cases.begin(),group.cases.end(),[&](uint64_t a,uint64_t b){
+      return Distance(a)<Distance(b);
+    });
+
+    for(;;){
+      auto current=target.FromIndex(group.minimal);
+      std::vector<uint64_t> candidates;
+      for(size_t field=0;field<current.size();field++){
+        if(current[field]==0)
+          continue;
+        auto candidate=current;
+        candidate[field]=0;
+        auto index=target.Canonical(target.Index(candidate));
+        if(index!=group.minimal&&std::find(candidates.begin(),candidates.end(),index)==candidates.end())
+          candidates.push_back(index);
+      }
+      if(candidates.empty())
+        return;
+
+      auto results=Run(candidates,1);
+      group.attempts+=(uint32_t)candidates.size();
+
+      auto reproduced=std::find_if(results.begin(),results.end(),[&](const CaseResult &result){
+        return result.signature==group.signature;
+      });
+      if(reproduced==results.end())
+        return;
+      group.minimal=candidates[reproduced-results.begin()];
+    }
+  }
+};
@@ -0,0 +1,293 @@
+#include<vector>
+#include<map>
+#include<string>
+#include<string_view>
+#include<memory>
+#include<cctype>
+#include<cstdlib>
+#include<algorithm>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<format>
+
+#include<vulkan/vulkan.h>
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Scenarios.h"
+#include"../Common/WorkerPool.h"
+#include"FuzzCampaign.h"
+#include"DescriptorTarget.h"
+#include"ShaderInterfaceTarget.h"
+
+//Structured fuzzer for the crash classes the scenarios reproduce one case
+//at a time, descriptor for DescriptorBuffer.cpp and shader-interface for
+//LinkShaderLayout.cpp. Each worker keeps its device for thousands of cases
+//instead of one process launch per trial, failures are grouped by signature
+//and every group is minimised to the fewest fields that still differ from
+//valid usage.
+
+static std::vector<FuzzTarget> Targets(){
+  return {DescriptorHarness::Target(),ShaderInterfaceHarness::Target()};
+}
+
+//*************** Options ***********************
+#pragma region Options
+struct Options{
+  std::string target="descriptor";
+  std::string deviceName;
+  std::string driver;
+  WorkerPool::Settings pool={.workers=std::max(1u,std::thread::hardware_concurrency()),.timeoutSeconds=5.0,.memoryLimitMiB=0};
+  uint64_t cases=0;
+  uint64_t seed=1;
+  uint32_t batch=64;
+  bool minimise=true;
+  std::filesystem::path shaderPath;
+  std::filesystem::path glslPath;
+  std::filesystem::path shaderCachePath;
+  std::filesystem::path jsonPath;
+  bool list=false;
+  bool validation=false;
+};
+
+static void PrintUsage(){
+  std::cout<<
+    "Usage: Fuzzer [options]\n"
+    "  --list                List the targets and their fields and exit\n"
+    "  --target <name>       descriptor or shader-interface, descriptor by default\n"
+    "  --cases <n>           Random distinct cases, the whole case space by default\n"
+    "  --seed <n>            Seed for sampling and case order, 1 by default\n"
+    "  --batch <n>           Cases per submission, 64 by default\n"
+    "  --no-minimise         Report failures without minimising them\n"
+    "  --workers <n>         Worker processes, one per core by default\n"
+    "  --timeout <seconds>   Watchdog timeout per batch, 5 by default\n"
+    "  --memory-limit <MiB>  Address space limit per worker, none by default\n"
+    "  --device <name>       First device whose name contains <name>, e.g. Mock for the mock ICD\n"
+    "  --driver <id>         VkDriverId number or lavapipe, radv, amdvlk, amd, nvidia, nvk, anv, venus\n"
+    "  --shaders <dir>       Directory holding the compiled .spv files\n"
+    "  --glsl <dir>          Compile the GLSL under <dir>, the repository root, instead\n"
+    "                        of loading the .spv files. SPIR-V is cached in ShaderCache\n"
+    "  --json <file>         Also write every failing case as JSON\n"
+    "  --validation          Enable VK_LAYER_KHRONOS_validation in the workers\n";
+}
+
+static Options ParseOptions(int argc,char **argv){
+  Options options;
+  options.shaderPath=std::filesystem::absolute(argv[0]).parent_path()/"Shaders";
+  options.shaderCachePath=std::filesystem::absolute(argv[0]).parent_path()/"ShaderCache";
+
+  for(int index=1;index<argc;index++){
+    std::string_view argument=argv[index];
+    auto Value=[&]()->std::string{
+      if(index+1>=argc)
+        throw std::runtime_error(std::format("Missing value for {}",argument));
+      return argv[++index];
+    };
+    auto Count=[&]()->uint64_t{
+      auto value=Value();
+      if(value.empty()||!std::all_of(value.begin(),value.end(),[](char c){return std::isdigit((unsigned char)c)!=0;}))
+        throw std::runtime_error(std::format("Expected a number for {}",argument));
+      return std::stoull(value);
+    };
+
+    if(argument=="--list")
+      options.list=true;
+    else if(argument=="--target")
+      options.target=Value();
+    else if(argument=="--cases")
+      options.cases=Count();
+    else if(argument=="--seed")
+      options.seed=Count();
+    else if(argument=="--batch")
+      options.batch=(uint32_t)Count();
+    else if(argument=="--no-minimise")
+      options.minimise=false;
+    else if(argument=="--workers")
+      options.pool.workers=(uint32_t)Count();
+    else if(argument=="--timeout")
+      options.pool.timeoutSeconds=std::stod(Value());
+    else if(argument=="--memory-limit")
+      options.pool.memoryLimitMiB=Count();
+    else if(argument=="--device")
+      options.deviceName=Value();
+    else if(argument=="--driver")
+      options.driver=Value();
+    else if(argument=="--shaders")
+      options.shaderPath=Value();
+    else if(argument=="--glsl")
+      options.glslPath=Value();
+    else if(argument=="--json")
+      options.jsonPath=Value();
+    else if(argument=="--validation")
+      options.validation=true;
+    else if(argument=="--help"||argument=="-h"){
+      PrintUsage();
+      std::exit(0);
+    }else{
+      PrintUsage();
+      throw std::runtime_error(std::format("Unknown option {}",argument));
+    }
+  }
+
+  if(options.batch==0)
+    throw std::runtime_error("Batch has to be at least 1");
+  return options;
+}
+#pragma endregion
+
+//*************** Results ***********************
+#pragma region Results
+static std::string Escape(std::string_view text){
+  std::string escaped;
+  for(char c:text){
+    if(c=='"'||c=='\\')
+      escaped+='\\';
+    if((unsigned char)c>=0x20)
+      escaped+=c;
+  }
+  return escaped;
+}
+
+static std::string ResultName(int32_t code){
+  switch(code){
+  case VK_SUCCESS:
+    return "VK_SUCCESS";
+  case VK_ERROR_OUT_OF_HOST_MEMORY:
+    return "VK_ERROR_OUT_OF_HOST_MEMORY";
+  case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+    return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+  case VK_ERROR_INITIALIZATION_FAILED:
+    return "VK_ERROR_INITIALIZATION_FAILED";
+  case VK_ERROR_INCOMPATIBLE_SHADER_BINARY_EXT:
+    return "VK_ERROR_INCOMPATIBLE_SHADER_BINARY_EXT";
+  default:
+    return std::format("VkResult {}",code);
+  }
+}
+
+//Results reported by cases that did not crash, a driver rejecting a
+//mismatch cleanly is the outcome hoped for
+static std::map<int32_t,uint64_t> TallyResults(const std::vector<CaseResult> &results){
+  std::map<int32_t,uint64_t> tally;
+  for(auto &result:results){
+    if(result.outcome==Outcome::Passed)
+      tally[result.code]++;
+  }
+  return tally;
+}
+
+static void PrintGroups(const FuzzTarget &target,const std::vector<FailureGroup> &groups){
+  for(auto &group:groups){
+    std::cout<<std::format("{} ({} cases)\n",group.signature,group.cases.size());
+    std::cout<<std::format("  minimal: {}\n",target.Describe(target.FromIndex(group.minimal)));
+    for(size_t index=0;index<std::min<size_t>(group.cases.size(),3);index++)
+      std::cout<<std::format("  e.g.     {}\n",target.Describe(target.FromIndex(group.cases[index])));
+  }
+}
+
+static void WriteJson(const std::filesystem::path &path,const FuzzTarget &target,const Options &options,
+  uint64_t caseCount,double seconds,const std::map<int32_t,uint64_t> &tally,const std::vector<FailureGroup> &groups){
+
+  std::ofstream file(path);
+  if(!file.is_open())
+    throw std::runtime_error("Unable to open fuzzer output");
+
+  file<<std::format("{{\"target\":\"{}\",\"seed\":{},\"cases\":{},\"seconds\":{},\"results\":{{",
+    target.name,options.seed,caseCount,seconds);
+  bool first=true;
+  for(auto [code,count]:tally){
+    file<<std::format("{}\"{}\":{}",first?"":",",ResultName(code),count);
+    first=false;
+  }
+  file<<"},\"groups\":[";
+  for(size_t index=0;index<groups.size();index++){
+    auto &group=groups[index];
+    file<<std::format("{}\n{{\"signature\":\"{}\",\"minimal\":\"{}\",\"attempts\":{},\"cases\":[",
+      index>0?",":"",Escape(group.signature),target.Describe(target.FromIndex(group.minimal)),group.attempts);
+    for(size_t fuzzCase=0;fuzzCase<group.cases.size();fuzzCase++)
+      file<<std::format("{}\"{}\"",fuzzCase>0?",":"",target.Describe(target.FromIndex(group.cases[fuzzCase])));
+    file<<"]}";
+  }
+  file<<"\n]}\n";
+}
+#pragma endregion
+
+int main(int argc,char **argv){
+  try{
+    auto options=ParseOptions(argc,argv);
+    auto targets=Targets();
+
+    if(options.list){
+      for(auto &target:targets){
+        std::cout<<std::format("{}: {}, {} cases\n",target.name,target.description,target.CaseCount());
+        for(auto &field:target.fields){
+          std::string values;
+          for(auto value:field.values)
+            values+=std::format(" {}",value);
+          std::cout<<std::format("  {}:{}\n",field.name,values);
+        }
+      }
+      return 0;
+    }
+
+    auto target=std::find_if(targets.begin(),targets.end(),[&](const FuzzTarget &target){
+      return options.target==target.name;
+    });
+    if(target==targets.end())
+      throw std::runtime_error(std::format("Unknown target {}, see --list",options.target));
+
+    //Compiled before the workers fork, they inherit the memory cache
+    std::unique_ptr<ShaderCompiler> compiler;
+    if(!options.glslPath.empty()){
+      compiler=std::make_unique<ShaderCompiler>(options.glslPath,options.shaderCachePath);
+      compiler->CompileScenarioShaders();
+      std::cout<<std::format("Shaders: {}\n",compiler->Stats());
+    }
+
+    WorkerPool pool(options.pool);
+    FuzzCampaign campaign(*target,pool,[&](){
+      auto context=std::make_shared<HeadlessDevice>(options.validation);
+      context->Open(options.deviceName,options.driver);
+      context->shaderPath=options.shaderPath;
+      context->compiler=compiler.get();
+      return context;
+    },options.batch);
+
+    auto indices=campaign.Sample(options.cases,options.seed);
+    std::cout<<std::format("Fuzzing {} with {} of {} cases, batches of {}\n",
+      target->name,indices.size(),target->CaseCount(),options.batch);
+
+    auto begin=Clock::now();
+    auto results=campaign.Run(indices,options.batch);
+    auto seconds=Milliseconds(begin,Clock::now())/1000.0;
+
+    auto passed=std::count_if(results.begin(),results.end(),[](const CaseResult &result){
+      return result.outcome==Outcome::Passed;
+    });
+    std::cout<<std::format("{} cases in {:.2f} s, {:.0f} cases/s, {} passed\n",
+      indices.size(),seconds,seconds>0.0?indices.size()/seconds:0.0,passed);
+
+    auto tally=TallyResults(results);
+    for(auto [code,count]:tally)
+      std::cout<<std::format("  {}: {}\n",ResultName(code),count);
+
+    auto groups=FuzzCampaign::Group(indices,results);
+    if(options.minimise){
+      for(auto &group:groups)
+        campaign.Minimise(group);
+    }else{
+      for(auto &group:groups)
+        group.minimal=group.cases.front();
+    }
+    PrintGroups(*target,groups);
+    if(!options.jsonPath.empty())
+      WriteJson(options.jsonPath,*target,options,indices.size(),seconds,tally,groups);
+  }catch(const std::exception &exception){
+    std::cerr<<exception.what()<<"\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+#pragma once
+#include<vector>
+#include<array>
+#include<memory>
+#include<atomic>
+#include<cstring>
+#include<algorithm>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Spirv.h"
+#include"FuzzCampaign.h"
+
+//Generalises the hand written mismatch in LinkShaderLayout.cpp: the
+//LinkedShaderLayout vertex and fragment shaders are created with set layouts
+//arranged, typed and staged in ways that disagree with their GLSL
+//declarations, and with the DescriptorSet, Binding and Location decorations
+//patched directly in the SPIR-V words. Every case is created linked or
+//unlinked.
+//
+//The modules are parsed once per worker. A case copies them into its own
+//slot of a pooled buffer and patches the recorded words in place, nothing
+//is recompiled or allocated per case. Linked pairs are created one call per
+//case; all unlinked cases of a batch go to a single vkCreateShadersEXT call,
+//which returns a handle or VK_NULL_HANDLE for every stage.
+class ShaderInterfaceHarness:public FuzzHarness{
+public:
+  enum Field{
+    Layouts,
+    BindingType,
+    StageFlags,
+    SpirvStage,
+    SpirvSet,
+    SpirvBinding,
+    Locations,
+    Link
+  };
+
+  static FuzzTarget Target(){
+    return {
+      .name="shader-interface",
+      .description="vkCreateShadersEXT with set layouts and SPIR-V decorations that disagree, for LinkedShaderLayout",
+      .fields={
+        {"layouts",{"matching","per-stage","swapped","missing-set","extra-set","differing"}},
+        {"binding-type",{"uniform-buffer","storage-buffer","uniform-buffer-dynamic","combined-image-sampler","sampled-image"}},
+        {"stage-flags",{"vertex-fragment","vertex","fragment","compute","all-graphics"}},
+        {"spirv-stage",{"both","vertex","fragment"}},
+        {"spirv-set",{"none","next","out-of-range","huge"}},
+        {"spirv-binding",{"none","next","huge"}},
+        {"locations",{"none","shift","separate","huge"}},
+        {"link",{"yes","no"}}
+      },
+      .create=[](HeadlessDevice &context,uint32_t capacity)->std::unique_ptr<FuzzHarness>{
+        return std::make_unique<ShaderInterfaceHarness>(context,capacity);
+      },
+      //Which stage gets patched only matters when something is patched
+      .canonicalise=[](FuzzCase &fuzzCase){
+        if(fuzzCase[SpirvSet]==0&&fuzzCase[SpirvBinding]==0)
+          fuzzCase[SpirvStage]=0;
+      }
+    };
+  }
+
+private:
+  static constexpr std::array<VkDescriptorType,5> BindingTypes={
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+  };
+
+  static constexpr std::array<VkShaderStageFlags,5> Stages={
+    VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT,
+    VK_SHADER_STAGE_VERTEX_BIT,
+    VK_SHADER_STAGE_FRAGMENT_BIT,
+    VK_SHADER_STAGE_COMPUTE_BIT,
+    VK_SHADER_STAGE_ALL_GRAPHICS
+  };
+
+  //Words of one stage's module worth patching, 0 when the module has none
+  struct Patchable{
+    uint32_t setWord=0;
+    uint32_t bindingWord=0;
+    std::vector<SpirvDecoration> outputLocations;
+  };
+
+  HeadlessDevice &context;
+  uint32_t capacity;
+  std::array<std::vector<uint32_t>,2> code;
+  std::array<Patchable,2> patchable;
+
+  //capacity slots of vertex then fragment words
+  std::vector<uint32_t> codePool;
+  std::vector<std::array<std::vector<VkDescriptorSetLayout>,2>> setLists;
+  std::vector<VkShaderCreateInfoEXT> createInfos;
+  std::vector<VkShaderEXT> shaders;
+  std::vector<VkShaderCreateInfoEXT> unlinkedInfos;
+  std::vector<VkShaderEXT> unlinkedShaders;
+  std::vector<uint32_t> unlinked;
+
+  //Created on first use, indexed by binding type, stage flags and whether
+  //the set also holds the fragment shader's sampler at binding 1
+  std::array<VkDescriptorSetLayout,BindingTypes.size()*Stages.size()*2> layouts={};
+  VkDescriptorSetLayout textureLayout=nullptr;
+
+  static Patchable FindPatchable(const std::vector<uint32_t> &words,bool vertex){
+    SpirvModule module(words);
+    Patchable found;
+    for(auto &decoration:module.All(SpirvModule::DecorationDescriptorSet)){
+      if(decoration.value==0){
+        found.setWord=decoration.word;
+        break;
+      }
+    }
+    auto bindings=module.All(SpirvModule::DecorationBinding);
+    if(!bindings.empty())
+      found.bindingWord=bindings.front().word;
+    if(vertex)
+      found.outputLocations=module.Locations(SpirvModule::StorageClassOutput);
+    return found;
+  }
+
+  VkDescriptorSetLayout Layout(uint8_t type,uint8_t stages,bool texture){
+    auto &layout=layouts[(type*Stages.size()+stages)*2+(texture?1:0)];
+    if(layout)
+      return layout;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings={{
+      .binding=0,
+      .descriptorType=BindingTypes[type],
+      .descriptorCount=1,
+      .stageFlags=Stages[stages],
+      .pImmutableSamplers=nullptr
+    }};
+    if(texture){
+      bindings.push_back({
+        .binding=1,
+        .descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount=1,
+        .stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers=nullptr
+      });
+    }
+    layout=context.CreateSetLayout(bindings);
+    return layout;
+  }
+
+  void ArrangeLayouts(const FuzzCase &fuzzCase,std::array<std::vector<VkDescriptorSetLayout>,2> &sets){
+    auto mutated=Layout(fuzzCase[BindingType],fuzzCase[StageFlags],false);
+    auto shared=Layout(0,0,false);
+    auto &vertex=sets[0];
+    auto &fragment=sets[1];
+
+    switch(fuzzCase[Layouts]){
+    case 1:
+      //Same shape as LinkShaderLayout.cpp
+      vertex.assign({mutated,shared});
+      fragment.assign({Layout(fuzzCase[BindingType],fuzzCase[StageFlags],true),shared});
+      break;
+    case 2:
+      vertex.assign({shared,mutated,textureLayout});
+      fragment=vertex;
+      break;
+    case 3:
+      vertex.assign({mutated,shared});
+      fragment=vertex;
+      break;
+    case 4:
+      vertex.assign({mutated,shared,textureLayout,shared});
+      fragment=vertex;
+      break;
+    case 5:
+      vertex.assign({mutated,shared,textureLayout});
+      fragment.assign({shared,mutated,textureLayout});
+      break;
+    default:
+      vertex.assign({mutated,shared,textureLayout});
+      fragment=vertex;
+      break;
+    }
+  }
+
+  static void PatchValue(uint32_t *words,uint32_t word,uint8_t mutation){
+    if(word==0)
+      return;
+    switch(mutation){
+    case 1:
+      words[word]++;
+      break;
+    case 2:
+      words[word]=7;
+      break;
+    case 3:
+      words[word]=1u<<20;
+      break;
+    }
+  }
+
+  void PatchCode(uint32_t *words,uint32_t stage,const FuzzCase &fuzzCase){
+    auto &found=patchable[stage];
+    bool patchStage=fuzzCase[SpirvStage]==0||fuzzCase[SpirvStage]==stage+1;
+    if(patchStage){
+      PatchValue(words,found.setWord,fuzzCase[SpirvSet]);
+      //Binding has no out-of-range value of its own, huge is value 2
+      PatchValue(words,found.bindingWord,fuzzCase[SpirvBinding]==2?3:fuzzCase[SpirvBinding]);
+    }
+
+    auto &outputs=found.outputLocations;
+    if(outputs.empty())
+      return;
+    switch(fuzzCase[Locations]){
+    case 1:
+      //Lands on the next output's location
+      words[outputs.front().word]++;
+      break;
+    case 2:
+      //Vertex outputs no longer line up with anything the fragment stage reads
+      for(auto &output:outputs)
+        words[output.word]+=8;
+      break;
+    case 3:
+      words[outputs.front().word]=1000;
+      break;
+    }
+  }
+
+  void Prepare(uint32_t index,const FuzzCase &fuzzCase){
+    auto &sets=setLists[index];
+    ArrangeLayouts(fuzzCase,sets);
+
+    auto slot=codePool.data()+index*(code[0].size()+code[1].size());
+    std::array<uint32_t *,2> words={slot,slot+code[0].size()};
+    for(uint32_t stage=0;stage<2;stage++){
+      memcpy(words[stage],code[stage].data(),code[stage].size()*sizeof(uint32_t));
+      PatchCode(words[stage],stage,fuzzCase);
+
+      createInfos[index*2+stage]={
+        .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+        .pNext=nullptr,
+        .flags=fuzzCase[Link]==0?(VkShaderCreateFlagsEXT)VK_SHADER_CREATE_LINK_STAGE_BIT_EXT:0u,
+        .stage=stage==0?VK_SHADER_STAGE_VERTEX_BIT:VK_SHADER_STAGE_FRAGMENT_BIT,
+        .nextStage=stage==0?(VkShaderStageFlags)VK_SHADER_STAGE_FRAGMENT_BIT:0u,
+        .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+        .codeSize=code[stage].size()*sizeof(uint32_t),
+        .pCode=words[stage],
+        .pName="main",
+        .setLayoutCount=(uint32_t)sets[stage].size(),
+        .pSetLayouts=sets[stage].data(),
+        .pushConstantRangeCount=0,
+        .pPushConstantRanges=nullptr,
+        .pSpecializationInfo=nullptr
+      };
+    }
+  }
+
+public:
+  ShaderInterfaceHarness(HeadlessDevice &context,uint32_t capacity):context(context),capacity(capacity){
+    code[0]=context.Shader("LinkedShaderLayoutVert.spv");
+    code[1]=context.Shader("LinkedShaderLayoutFrag.spv");
+    patchable[0]=FindPatchable(code[0],true);
+    patchable[1]=FindPatchable(code[1],false);
+
+    codePool.resize(capacity*(code[0].size()+code[1].size()));
+    setLists.resize(capacity);
+    for(auto &sets:setLists){
+      sets[0].reserve(4);
+      sets[1].reserve(4);
+    }
+    createInfos.resize(capacity*2);
+    shaders.resize(capacity*2);
+    unlinkedInfos.reserve(capacity*2);
+    unlinkedShaders.reserve(capacity*2);
+    unlinked.reserve(capacity);
+
+    textureLayout=context.CreateSetLayout({{
+      .binding=1,
+      .descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount=1,
+      .stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers=nullptr
+    }});
+  }
+
+  ShaderInterfaceHarness(const ShaderInterfaceHarness &)=delete;
+  ShaderInterfaceHarness &operator=(const ShaderInterfaceHarness &)=delete;
+
+  ~ShaderInterfaceHarness(){
+    for(auto layout:layouts){
+      if(layout)
+        context.dispatch.vkDestroyDescriptorSetLayout(context.device,layout,nullptr);
+    }
+    context.dispatch.vkDestroyDescriptorSetLayout(context.device,textureLayout,nullptr);
+  }
+
+  void Run(const std::vector<FuzzCase> &cases,std::atomic<uint32_t> &progress,int32_t *results)override{
+    if(cases.size()>capacity)
+      throw std::runtime_error("Batch is larger than the shader pool");
+
+    std::fill(shaders.begin(),shaders.end(),nullptr);
+    unlinked.clear();
+    for(uint32_t index=0;index<cases.size();index++){
+      progress.store(index,std::memory_order_relaxed);
+      Prepare(index,cases[index]);
+      if(cases[index][Link]!=0){
+        unlinked.push_back(index);
+        continue;
+      }
+      results[index]=context.dispatch.vkCreateShadersEXT(context.device,2,&createInfos[index*2],nullptr,&shaders[index*2]);
+    }
+
+    //Unlinked stages are independent, one call covers the whole batch
+    progress.store((uint32_t)cases.size(),std::memory_order_relaxed);
+    if(!unlinked.empty()){
+      unlinkedInfos.clear();
+      for(auto index:unlinked){
+        unlinkedInfos.push_back(createInfos[index*2]);
+        unlinkedInfos.push_back(createInfos[index*2+1]);
+      }
+      unlinkedShaders.assign(unlinkedInfos.size(),nullptr);
+      auto result=context.dispatch.vkCreateShadersEXT(context.device,(uint32_t)unlinkedInfos.size(),unlinkedInfos.data(),nullptr,unlinkedShaders.data());
+
+      for(size_t position=0;position<unlinked.size();position++){
+        auto index=unlinked[position];
+        shaders[index*2]=unlinkedShaders[position*2];
+        shaders[index*2+1]=unlinkedShaders[position*2+1];
+        bool created=shaders[index*2]&&shaders[index*2+1];
+        results[index]=created?VK_SUCCESS:(result!=VK_SUCCESS?result:VK_ERROR_INITIALIZATION_FAILED);
+      }
+    }
+
+    for(auto shader:shaders){
+      if(shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,shader,nullptr);
+    }
+  }
+};
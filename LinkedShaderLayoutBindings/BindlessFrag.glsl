@@ -0,0 +1,29 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// The texture lookup of LinkedShaderLayoutFrag.glsl without fixed bindings:
+// every resource comes out of the BindlessHeap arrays at the indices pushed
+// with the draw.
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(push_constant) uniform Material {
+  vec2 offset;
+  uint textureIndex;
+  uint samplerIndex;
+  uint bufferIndex;
+} material;
+
+layout(set=0, binding=0) uniform texture2D textures[];
+layout(set=0, binding=1) uniform sampler samplers[];
+layout(set=0, binding=2) readonly buffer MaterialData {
+  vec4 tint;
+} materials[];
+
+void main() {
+    vec4 texColor = texture(sampler2D(textures[material.textureIndex], samplers[material.samplerIndex]), fragTexCoord);
+
+    fragColor = texColor * materials[material.bufferIndex].tint;
+}
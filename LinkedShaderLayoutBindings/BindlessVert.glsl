@@ -0,0 +1,19 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+layout(push_constant) uniform Material {
+  vec2 offset;
+  uint textureIndex;
+  uint samplerIndex;
+  uint bufferIndex;
+} material;
+
+void main(){
+
+  gl_Position = vec4(inPosition.xy * 0.25 + material.offset, inPosition.z, 1.0);
+  fragTexCoord = inPosition.xy + 0.5;
+
+}
@@ -1,9 +1,11 @@
 #include<stdexcept>
 #include<array>
 #include<vector>
+#include<memory>
 #include<filesystem>
 #include<fstream>
 #include<vulkan/vulkan.h>
+#include"../Common/DescriptorLayout.h"
 
 
 static std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
@@ -132,65 +134,26 @@ int main(){
 
   //****** Vulkan function loading ****************
 #pragma region Functions
-  PFN_vkCreateShadersEXT pfCreateShader=reinterpret_cast<PFN_vkCreateShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCreateShadersEXT"));
-  PFN_vkDestroyShaderEXT pfDestroyShader=reinterpret_cast<PFN_vkDestroyShaderEXT>(
-    vkGetDeviceProcAddr(device,"vkDestroyShaderEXT"));
+  DeviceDispatch dispatch;
+  dispatch.Load(device,&vkGetDeviceProcAddr);
 #pragma endregion
 
   //*************** Layout ************************
 #pragma region Layout
-  auto CreateSetLayout=[&device](std::vector<VkDescriptorSetLayoutBinding> bindings)->VkDescriptorSetLayout{
-    VkDescriptorSetLayoutCreateInfo descriptorSetInfo={
-      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      .pNext=nullptr,
-      .flags=0,
-      .bindingCount=(uint32_t)bindings.size(),
-      .pBindings=bindings.data()
-    };
-    VkDescriptorSetLayout layout=nullptr;
-    auto result=vkCreateDescriptorSetLayout(device,&descriptorSetInfo,nullptr,&layout);
-    if(result!=VK_SUCCESS)
-      throw std::runtime_error("Failed to create descriptor set layout");
-
-    return layout;
-    };
-
-  VkDescriptorSetLayoutBinding bindingShared={
-    .binding=0,
-    .descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount=1,
-    .stageFlags=VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT,
-    .pImmutableSamplers=nullptr
-  };
-
-  VkDescriptorSetLayoutBinding bindingVertex={
-  .binding=0,
-  .descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-  .descriptorCount=1,
-  .stageFlags=VK_SHADER_STAGE_VERTEX_BIT,
-  .pImmutableSamplers=nullptr
-  };
-
-  VkDescriptorSetLayoutBinding bindingFragmentBuffer={
-  .binding=0,
-  .descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-  .descriptorCount=1,
-  .stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT,
-  .pImmutableSamplers=nullptr
-  };
-
-  VkDescriptorSetLayoutBinding bindingFragmentTexture={
-    .binding=1,
-    .descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-    .descriptorCount=1,
-    .stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT,
-    .pImmutableSamplers=nullptr
-  };
-
-  VkDescriptorSetLayout descriptorSetSharedLayout=CreateSetLayout({bindingShared});
-  VkDescriptorSetLayout descriptorSetVertexLayout=CreateSetLayout({bindingVertex});
-  VkDescriptorSetLayout descriptorSetFragmentLayout=CreateSetLayout({bindingFragmentBuffer,bindingFragmentTexture});
+  using SharedSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1,VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT>>;
+  using VertexSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1,VK_SHADER_STAGE_VERTEX_BIT>>;
+  using FragmentSet=DescriptorSet<
+    DescriptorBinding<0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1,VK_SHADER_STAGE_FRAGMENT_BIT>,
+    DescriptorBinding<1,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,1,VK_SHADER_STAGE_FRAGMENT_BIT>>;
+
+  auto sharedSetLayout=std::make_unique<DescriptorLayout<SharedSet>>(device,physicalDevices[0],0,&dispatch);
+  auto vertexSetLayout=std::make_unique<DescriptorLayout<VertexSet>>(device,physicalDevices[0],0,&dispatch);
+  auto fragmentSetLayout=std::make_unique<DescriptorLayout<FragmentSet>>(device,physicalDevices[0],0,&dispatch);
+  VkDescriptorSetLayout descriptorSetSharedLayout=sharedSetLayout->Handle();
+  VkDescriptorSetLayout descriptorSetVertexLayout=vertexSetLayout->Handle();
+  VkDescriptorSetLayout descriptorSetFragmentLayout=fragmentSetLayout->Handle();
 #pragma endregion
 
   //*************** Shader ************************
@@ -242,19 +205,19 @@ int main(){
   });
 
   std::vector<VkShaderEXT> shaders(ShaderCreateInfos.size(),nullptr);
-  result=pfCreateShader(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
+  result=dispatch.vkCreateShadersEXT(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create shader objects");
 
 #pragma endregion
 
   for(auto &shader:shaders)
-    pfDestroyShader(device,shader,nullptr);
+    dispatch.vkDestroyShaderEXT(device,shader,nullptr);
 
   ShaderCreateInfos.clear();
-  vkDestroyDescriptorSetLayout(device,descriptorSetSharedLayout,nullptr);
-  vkDestroyDescriptorSetLayout(device,descriptorSetVertexLayout,nullptr);
-  vkDestroyDescriptorSetLayout(device,descriptorSetFragmentLayout,nullptr);
+  sharedSetLayout.reset();
+  vertexSetLayout.reset();
+  fragmentSetLayout.reset();
   vetexLayout.clear();
   fragmentLayout.clear();
   vertexShaderCode.clear();
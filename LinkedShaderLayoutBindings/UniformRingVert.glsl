@@ -0,0 +1,16 @@
+#version 450
+
+// The SceneData transform of LinkedShaderLayoutVert.glsl on its own, each
+// draw gets its own UniformRing slot as set 0.
+
+layout(location = 0) in vec3 position;
+
+layout(set=0, binding=0) uniform SceneData {
+  mat4 modelMatrix;
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+} sceneUBO;
+
+void main(){
+  gl_Position = sceneUBO.projectionMatrix * sceneUBO.viewMatrix * sceneUBO.modelMatrix * vec4(position, 1.0);
+}
@@ -0,0 +1,224 @@
+#include<vector>
+#include<string>
+#include<string_view>
+#include<memory>
+#include<cctype>
+#include<cstdlib>
+#include<algorithm>
+#include<filesystem>
+#include<iostream>
+#include<format>
+
+#include<vulkan/vulkan.h>
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Scenarios.h"
+#include"../Common/Trace.h"
+#include"TraceFile.h"
+#include"TraceReplayer.h"
+
+//Captures a scenario variant into a trace and replays traces. A capture runs
+//the variant for the requested frames with the trace set on the context, the
+//trace is flushed record by record so variants that crash the driver still
+//leave a usable repro behind. A replay maps the trace, recreates its objects
+//and loops its frames, timing each one the way the benchmark times the
+//scenarios.
+
+//*************** Options ***********************
+#pragma region Options
+struct Options{
+  std::string deviceName;
+  std::string driver;
+  std::string capture;
+  std::filesystem::path tracePath;
+  uint32_t frames=1;
+  uint32_t loops=100;
+  uint32_t warmup=10;
+  std::filesystem::path shaderPath;
+  std::filesystem::path glslPath;
+  std::filesystem::path shaderCachePath;
+  bool list=false;
+  bool validation=false;
+};
+
+static void PrintUsage(){
+  std::cout<<
+    "Usage: Replay [options] <trace>\n"
+    "  --list                List the scenario variants and exit\n"
+    "  --capture <variant>   Capture scenario/variant into <trace> instead of replaying it\n"
+    "  --frames <n>          Frames to capture, 1 by default\n"
+    "  --loop <n>            Times every frame is replayed, 100 by default\n"
+    "  --warmup <n>          Untimed loops before timing, 10 by default\n"
+    "  --device <name>       First device whose name contains <name>, e.g. Mock for the mock ICD\n"
+    "  --driver <id>         VkDriverId number or lavapipe, radv, amdvlk, amd, nvidia, nvk, anv, venus\n"
+    "  --shaders <dir>       Directory holding the compiled .spv files, capture only\n"
+    "  --glsl <dir>          Compile the GLSL under <dir>, the repository root, instead\n"
+    "                        of loading the .spv files, capture only. SPIR-V is cached\n"
+    "                        in ShaderCache\n"
+    "  --validation          Enable VK_LAYER_KHRONOS_validation\n";
+}
+
+static Options ParseOptions(int argc,char **argv){
+  Options options;
+  options.shaderPath=std::filesystem::absolute(argv[0]).parent_path()/"Shaders";
+  options.shaderCachePath=std::filesystem::absolute(argv[0]).parent_path()/"ShaderCache";
+
+  for(int index=1;index<argc;index++){
+    std::string_view argument=argv[index];
+    auto Value=[&]()->std::string{
+      if(index+1>=argc)
+        throw std::runtime_error(std::format("Missing value for {}",argument));
+      return argv[++index];
+    };
+    auto Count=[&]()->uint32_t{
+      auto value=Value();
+      if(value.empty()||!std::all_of(value.begin(),value.end(),[](char c){return std::isdigit((unsigned char)c)!=0;}))
+        throw std::runtime_error(std::format("Expected a number for {}",argument));
+      return (uint32_t)std::stoul(value);
+    };
+
+    if(argument=="--list")
+      options.list=true;
+    else if(argument=="--capture")
+      options.capture=Value();
+    else if(argument=="--frames")
+      options.frames=Count();
+    else if(argument=="--loop")
+      options.loops=Count();
+    else if(argument=="--warmup")
+      options.warmup=Count();
+    else if(argument=="--device")
+      options.deviceName=Value();
+    else if(argument=="--driver")
+      options.driver=Value();
+    else if(argument=="--shaders")
+      options.shaderPath=Value();
+    else if(argument=="--glsl")
+      options.glslPath=Value();
+    else if(argument=="--validation")
+      options.validation=true;
+    else if(argument=="--help"||argument=="-h"){
+      PrintUsage();
+      std::exit(0);
+    }else if(!argument.starts_with("--")&&options.tracePath.empty()){
+      options.tracePath=std::string(argument);
+    }else{
+      PrintUsage();
+      throw std::runtime_error(std::format("Unknown option {}",argument));
+    }
+  }
+
+  if(!options.list&&options.tracePath.empty()){
+    PrintUsage();
+    throw std::runtime_error("No trace given");
+  }
+  if(options.frames==0||options.loops==0)
+    throw std::runtime_error("Frames and loops have to be at least 1");
+  return options;
+}
+#pragma endregion
+
+static void Capture(HeadlessDevice &context,const Options &options){
+  auto entries=ScenarioEntries();
+  auto entry=std::find_if(entries.begin(),entries.end(),[&](const ScenarioEntry &entry){
+    return options.capture==entry.scenario||options.capture==std::format("{}/{}",entry.scenario,entry.variant);
+  });
+  if(entry==entries.end())
+    throw std::runtime_error(std::format("Unknown variant {}, see --list",options.capture));
+
+  TraceWriter writer(options.tracePath,context.info.properties,context.info.driver.driverID);
+  context.trace=&writer;
+  {
+    auto scenario=entry->create(context);
+    for(uint32_t frame=0;frame<options.frames;frame++){
+      writer.BeginFrame();
+      scenario->Iterate();
+    }
+    //Teardown is not part of the repro
+    context.trace=nullptr;
+  }
+
+  std::cout<<std::format("Captured {} frames of {}/{} into {}, {} bytes\n",
+    options.frames,entry->scenario,entry->variant,options.tracePath.string(),std::filesystem::file_size(options.tracePath));
+}
+
+static void Replay(HeadlessDevice &context,const Options &options){
+  TraceFile file(options.tracePath);
+  auto &header=file.Header();
+  if(header.driverID!=(uint32_t)context.info.driver.driverID||header.deviceID!=context.info.properties.deviceID){
+    std::cerr<<std::format("Trace was captured on {} (driverID {}), descriptors may not match this device\n",
+      header.deviceName,header.driverID);
+  }
+
+  TraceReplayer replayer(context,file);
+  if(replayer.FrameCount()==0){
+    std::cout<<"Trace holds no frames, its setup has been replayed\n";
+    return;
+  }
+
+  for(uint32_t loop=0;loop<options.warmup;loop++){
+    for(size_t frame=0;frame<replayer.FrameCount();frame++)
+      replayer.Replay(frame);
+  }
+
+  std::vector<double> cpu,total;
+  auto begin=Clock::now();
+  for(uint32_t loop=0;loop<options.loops;loop++){
+    for(size_t frame=0;frame<replayer.FrameCount();frame++){
+      auto sample=replayer.Replay(frame);
+      cpu.push_back(sample.cpuMs);
+      total.push_back(sample.totalMs);
+    }
+  }
+  auto seconds=Milliseconds(begin,Clock::now())/1000.0;
+
+  auto Row=[](const char *label,std::vector<double> &samples){
+    std::sort(samples.begin(),samples.end());
+    double sum=0.0;
+    for(auto sample:samples)
+      sum+=sample;
+    std::cout<<std::format("  {:<6}{:>10.4f}{:>10.4f}{:>10.4f}{:>10.4f}\n",
+      label,samples.front(),sum/samples.size(),samples[samples.size()/2],samples.back());
+  };
+  std::cout<<std::format("{} frames in {:.3f} s, {:.1f} frames/s\n",cpu.size(),seconds,seconds>0.0?cpu.size()/seconds:0.0);
+  std::cout<<std::format("  {:<6}{:>10}{:>10}{:>10}{:>10}\n","ms","min","mean","p50","max");
+  Row("cpu",cpu);
+  Row("total",total);
+}
+
+int main(int argc,char **argv){
+  try{
+    auto options=ParseOptions(argc,argv);
+
+    if(options.list){
+      for(auto &entry:ScenarioEntries())
+        std::cout<<std::format("{}/{}{}\n",entry.scenario,entry.variant,entry.valid?"":" (repro)");
+      return 0;
+    }
+
+    std::unique_ptr<ShaderCompiler> compiler;
+    if(!options.glslPath.empty()){
+      compiler=std::make_unique<ShaderCompiler>(options.glslPath,options.shaderCachePath);
+      compiler->CompileScenarioShaders();
+      std::cout<<std::format("Shaders: {}\n",compiler->Stats());
+    }
+
+    HeadlessDevice context(options.validation);
+    context.Open(options.deviceName,options.driver);
+    context.shaderPath=options.shaderPath;
+    context.compiler=compiler.get();
+    std::cout<<std::format("Device: {}\n",Describe(context.info));
+
+    if(!options.capture.empty())
+      Capture(context,options);
+    else
+      Replay(context,options);
+  }catch(const std::exception &exception){
+    std::cerr<<exception.what()<<"\n";
+    return 1;
+  }
+  return 0;
+}
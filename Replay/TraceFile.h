@@ -0,0 +1,100 @@
+#pragma once
+#include<filesystem>
+#include<format>
+#include<stdexcept>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include"../Common/Trace.h"
+
+//A trace mapped read only. Records are used in place, nothing is copied or
+//decoded ahead of time.
+
+//Reads a record's payload and arrays in the order TraceWriter appended them
+class TraceReader{
+  const uint8_t *cursor;
+
+public:
+  TraceReader(const TraceRecord *record):
+    cursor(reinterpret_cast<const uint8_t *>(record)+sizeof(TraceRecord)){}
+
+  template<typename T>
+  const T &Payload(){
+    auto payload=reinterpret_cast<const T *>(cursor);
+    cursor+=TraceAlign(sizeof(T));
+    return *payload;
+  }
+
+  template<typename T>
+  const T *Array(size_t count){
+    auto array=reinterpret_cast<const T *>(cursor);
+    cursor+=TraceAlign(count*sizeof(T));
+    return array;
+  }
+};
+
+class TraceFile{
+  const uint8_t *data=nullptr;
+  size_t size=0;
+
+  const TraceRecord *Check(const uint8_t *position)const{
+    if(position+sizeof(TraceRecord)>data+size)
+      return nullptr;
+    auto record=reinterpret_cast<const TraceRecord *>(position);
+    if(record->size<sizeof(TraceRecord)||position+record->size>data+size)
+      return nullptr;
+    return record;
+  }
+
+public:
+  TraceFile(const std::filesystem::path &path){
+    int descriptor=open(path.c_str(),O_RDONLY);
+    if(descriptor<0)
+      throw std::runtime_error(std::format("Unable to open trace {}",path.string()));
+
+    struct stat status={};
+    fstat(descriptor,&status);
+    size=(size_t)status.st_size;
+    if(size<sizeof(TraceHeader)){
+      close(descriptor);
+      throw std::runtime_error("Trace is too short for its header");
+    }
+
+    auto mapping=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,descriptor,0);
+    close(descriptor);
+    if(mapping==MAP_FAILED)
+      throw std::runtime_error("Unable to map trace");
+    data=static_cast<const uint8_t *>(mapping);
+
+    if(Header().magic!=TraceMagic||Header().version!=TraceVersion){
+      munmap(const_cast<uint8_t *>(data),size);
+      throw std::runtime_error("Not a trace of this version");
+    }
+  }
+
+  TraceFile(const TraceFile &)=delete;
+  TraceFile &operator=(const TraceFile &)=delete;
+
+  ~TraceFile(){
+    munmap(const_cast<uint8_t *>(data),size);
+  }
+
+  const TraceHeader &Header()const{
+    return *reinterpret_cast<const TraceHeader *>(data);
+  }
+
+  size_t Size()const{
+    return size;
+  }
+
+  const TraceRecord *First()const{
+    return Check(data+sizeof(TraceHeader));
+  }
+
+  //nullptr at the end. A record cut short by a crash during capture ends the
+  //trace early.
+  const TraceRecord *Next(const TraceRecord *record)const{
+    return Check(reinterpret_cast<const uint8_t *>(record)+record->size);
+  }
+};
@@ -0,0 +1,715 @@
+#pragma once
+#include<vector>
+#include<unordered_map>
+#include<stdexcept>
+#include<vulkan/vulkan.h>
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Scenarios.h"
+#include"../Common/FrameGraph.h"
+#include"../Common/RenderTargetPool.h"
+#include"TraceFile.h"
+
+//Executes a trace on a HeadlessDevice. Everything up to the first frame is
+//created once by the constructor, Replay() then runs one frame: the objects
+//it creates or destroys, then its frame graphs, rebuilt from the recorded
+//declarations and submitted the way the scenario submitted them. Commands
+//are read straight from the mapped file, a frame can be looped any number of
+//times.
+class TraceReplayer{
+  struct Object{
+    VkDescriptorSetLayout setLayout=nullptr;
+    VkPipelineLayout pipelineLayout=nullptr;
+    VkBuffer buffer=nullptr;
+    VmaAllocation allocation=nullptr;
+    VmaAllocationInfo allocationInfo={};
+    VkDeviceAddress address=0;
+    RenderTarget *target=nullptr;
+    VkShaderEXT shader=nullptr;
+    VkSampler sampler=nullptr;
+  };
+
+  struct Pass{
+    const TraceRecord *pass;
+    std::vector<const TraceUse *> uses;
+    const TraceRecord *commands=nullptr;
+  };
+
+  HeadlessDevice &context;
+  const TraceFile &file;
+  std::vector<Object> objects;
+  //First id of every CreateShaders call, shaders are numbered by position in
+  //the trace so looping a frame reuses the same slots
+  std::unordered_map<const TraceRecord *,uint32_t> shaderIds;
+  std::vector<const TraceRecord *> frames;
+
+  ResourceTracker tracker{&context.dispatch};
+  RenderTargetPool renderTargets;
+  FrameGraph frameGraph;
+  bool building=false;
+  std::vector<bool> graphImages;
+  std::vector<Pass> passes;
+
+  //Scratch reused by every command
+  std::vector<VkShaderEXT> shaders;
+  std::vector<VkBuffer> buffers;
+  std::vector<VkDescriptorBufferBindingInfoEXT> bindingInfos;
+  std::vector<VkVertexInputBindingDescription2EXT> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes;
+  std::vector<VkRenderingAttachmentInfo> attachments;
+
+  VkDeviceAddress Resolve(const TraceAddress &address)const{
+    if(address.buffer==TraceNoObject)
+      return (VkDeviceAddress)address.offset;
+    return objects[address.buffer].address+address.offset;
+  }
+
+  VkImageView View(uint32_t id)const{
+    return id==TraceNoObject?VK_NULL_HANDLE:objects[id].target->view;
+  }
+
+  //*************** Objects ***********************
+  void CreateSetLayout(TraceReader reader){
+    auto &layout=reader.Payload<TraceSetLayout>();
+    auto entries=reader.Array<TraceBinding>(layout.bindingCount);
+    std::vector<VkDescriptorSetLayoutBinding> bindings(layout.bindingCount);
+    std::vector<VkDescriptorBindingFlags> bindingFlags(layout.bindingCount);
+    bool flagged=false;
+    for(uint32_t index=0;index<layout.bindingCount;index++){
+      bindings[index]={
+        .binding=entries[index].binding,
+        .descriptorType=(VkDescriptorType)entries[index].type,
+        .descriptorCount=entries[index].count,
+        .stageFlags=entries[index].stages,
+        .pImmutableSamplers=nullptr
+      };
+      bindingFlags[index]=entries[index].flags;
+      flagged|=entries[index].flags!=0;
+    }
+    if(!flagged)
+      bindingFlags.clear();
+    objects[layout.id].setLayout=context.CreateSetLayout(bindings,layout.flags,bindingFlags);
+  }
+
+  void CreatePipelineLayout(TraceReader reader){
+    auto &layout=reader.Payload<TracePipelineLayout>();
+    auto ids=reader.Array<uint32_t>(layout.setLayoutCount);
+    auto ranges=reader.Array<VkPushConstantRange>(layout.pushConstantCount);
+    std::vector<VkDescriptorSetLayout> setLayouts(layout.setLayoutCount);
+    for(uint32_t index=0;index<layout.setLayoutCount;index++)
+      setLayouts[index]=objects[ids[index]].setLayout;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo={
+      .sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=0,
+      .setLayoutCount=layout.setLayoutCount,
+      .pSetLayouts=setLayouts.data(),
+      .pushConstantRangeCount=layout.pushConstantCount,
+      .pPushConstantRanges=ranges
+    };
+    auto result=context.dispatch.vkCreatePipelineLayout(context.device,&pipelineLayoutInfo,nullptr,&objects[layout.id].pipelineLayout);
+    if(result!=VK_SUCCESS)
+      throw std::runtime_error("Failed to create pipeline layout");
+  }
+
+  void CreateBuffer(TraceReader reader){
+    auto &buffer=reader.Payload<TraceBuffer>();
+    auto &object=objects[buffer.id];
+    object.buffer=context.CreateBuffer(buffer.size,buffer.usage,object.allocation,object.allocationInfo);
+    object.address=context.BufferAddress(object.buffer);
+  }
+
+  void BufferData(TraceReader reader){
+    auto &data=reader.Payload<TraceBufferData>();
+    auto bytes=reader.Array<uint8_t>((size_t)data.size);
+    memcpy((uint8_t *)objects[data.id].allocationInfo.pMappedData+data.offset,bytes,(size_t)data.size);
+  }
+
+  void CreateImage(TraceReader reader){
+    auto &image=reader.Payload<TraceImage>();
+    objects[image.id].target=&renderTargets.Acquire({
+      .extent={image.width,image.height},
+      .format=(VkFormat)image.format,
+      .usage=image.usage,
+      .samples=(VkSampleCountFlagBits)image.samples
+    });
+  }
+
+  void CreateSampler(TraceReader reader){
+    auto &sampler=reader.Payload<TraceSampler>();
+    objects[sampler.id].sampler=context.CreateSampler({
+      .sType=VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .pNext=nullptr,
+      .flags=sampler.flags,
+      .magFilter=(VkFilter)sampler.magFilter,
+      .minFilter=(VkFilter)sampler.minFilter,
+      .mipmapMode=(VkSamplerMipmapMode)sampler.mipmapMode,
+      .addressModeU=(VkSamplerAddressMode)sampler.addressModeU,
+      .addressModeV=(VkSamplerAddressMode)sampler.addressModeV,
+      .addressModeW=(VkSamplerAddressMode)sampler.addressModeW,
+      .mipLodBias=sampler.mipLodBias,
+      .anisotropyEnable=sampler.anisotropyEnable,
+      .maxAnisotropy=sampler.maxAnisotropy,
+      .compareEnable=sampler.compareEnable,
+      .compareOp=(VkCompareOp)sampler.compareOp,
+      .minLod=sampler.minLod,
+      .maxLod=sampler.maxLod,
+      .borderColor=(VkBorderColor)sampler.borderColor,
+      .unnormalizedCoordinates=sampler.unnormalizedCoordinates
+    });
+  }
+
+  //The Shader records follow the call's record
+  const TraceRecord *CreateShaders(const TraceRecord *record){
+    auto count=TraceReader(record).Payload<TraceCreateShaders>().shaderCount;
+    auto first=shaderIds.at(record);
+
+    std::vector<VkShaderCreateInfoEXT> infos(count);
+    std::vector<std::vector<VkDescriptorSetLayout>> setLayouts(count);
+    for(uint32_t index=0;index<count;index++){
+      record=file.Next(record);
+      if(!record||record->op!=TraceOp::Shader)
+        throw std::runtime_error("Trace ends inside vkCreateShadersEXT");
+
+      TraceReader reader(record);
+      auto &shader=reader.Payload<TraceShader>();
+      auto ids=reader.Array<uint32_t>(shader.setLayoutCount);
+      auto ranges=reader.Array<VkPushConstantRange>(shader.pushConstantCount);
+      auto code=reader.Array<uint8_t>((size_t)shader.codeSize);
+      for(uint32_t layout=0;layout<shader.setLayoutCount;layout++)
+        setLayouts[index].push_back(objects[ids[layout]].setLayout);
+
+      infos[index]={
+        .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+        .pNext=nullptr,
+        .flags=shader.flags,
+        .stage=(VkShaderStageFlagBits)shader.stage,
+        .nextStage=shader.nextStage,
+        .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+        .codeSize=(size_t)shader.codeSize,
+        .pCode=code,
+        .pName=shader.name,
+        .setLayoutCount=shader.setLayoutCount,
+        .pSetLayouts=setLayouts[index].data(),
+        .pushConstantRangeCount=shader.pushConstantCount,
+        .pPushConstantRanges=ranges,
+        .pSpecializationInfo=nullptr
+      };
+    }
+
+    std::vector<VkShaderEXT> created(count,VK_NULL_HANDLE);
+    context.dispatch.vkCreateShadersEXT(context.device,count,infos.data(),nullptr,created.data());
+    for(uint32_t index=0;index<count;index++){
+      auto &object=objects[first+index];
+      if(object.shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,object.shader,nullptr);
+      object.shader=created[index];
+    }
+    return record;
+  }
+
+  void DestroyShader(TraceReader reader){
+    auto &object=objects[reader.Payload<TraceObject>().id];
+    if(object.shader)
+      context.dispatch.vkDestroyShaderEXT(context.device,object.shader,nullptr);
+    object.shader=nullptr;
+  }
+
+  void GetDescriptor(TraceReader reader){
+    auto &descriptor=reader.Payload<TraceDescriptor>();
+    VkDescriptorAddressInfoEXT addressInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+      .pNext=nullptr,
+      .address=Resolve(descriptor.address),
+      .range=descriptor.range,
+      .format=(VkFormat)descriptor.format
+    };
+    auto sampler=descriptor.sampler==TraceNoObject?VK_NULL_HANDLE:objects[descriptor.sampler].sampler;
+    VkDescriptorImageInfo imageInfo={
+      .sampler=sampler,
+      .imageView=View(descriptor.image),
+      .imageLayout=(VkImageLayout)descriptor.layout
+    };
+    VkDescriptorGetInfoEXT descriptorGetInfo={
+      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+      .pNext=nullptr,
+      .type=(VkDescriptorType)descriptor.type,
+      .data={}
+    };
+    switch(descriptorGetInfo.type){
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+      descriptorGetInfo.data.pSampler=&sampler;
+      break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      descriptorGetInfo.data.pCombinedImageSampler=&imageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      descriptorGetInfo.data.pSampledImage=&imageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      descriptorGetInfo.data.pStorageImage=&imageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      descriptorGetInfo.data.pUniformBuffer=&addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      descriptorGetInfo.data.pStorageBuffer=&addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      descriptorGetInfo.data.pUniformTexelBuffer=&addressInfo;
+      break;
+    default:
+      descriptorGetInfo.data.pStorageTexelBuffer=&addressInfo;
+      break;
+    }
+    context.dispatch.vkGetDescriptorEXT(context.device,&descriptorGetInfo,(size_t)descriptor.size,
+      (uint8_t *)objects[descriptor.buffer].allocationInfo.pMappedData+descriptor.offset);
+  }
+
+  //Runs the object records valid anywhere, false for everything else
+  bool ReplayObject(const TraceRecord *&record){
+    switch(record->op){
+    case TraceOp::CreateSetLayout:
+      CreateSetLayout(record);
+      return true;
+    case TraceOp::CreatePipelineLayout:
+      CreatePipelineLayout(record);
+      return true;
+    case TraceOp::CreateBuffer:
+      CreateBuffer(record);
+      return true;
+    case TraceOp::BufferData:
+      BufferData(record);
+      return true;
+    case TraceOp::CreateImage:
+      CreateImage(record);
+      return true;
+    case TraceOp::CreateShaders:
+      record=CreateShaders(record);
+      return true;
+    case TraceOp::DestroyShader:
+      DestroyShader(record);
+      return true;
+    case TraceOp::GetDescriptor:
+      GetDescriptor(record);
+      return true;
+    case TraceOp::CreateSampler:
+      CreateSampler(record);
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  //*************** Commands **********************
+  void SetState(VkCommandBuffer CMDBuffer,const TraceState &state){
+    switch((VkDynamicState)state.state){
+    case VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE:
+      context.dispatch.vkCmdSetRasterizerDiscardEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_CULL_MODE:
+      context.dispatch.vkCmdSetCullMode(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_FRONT_FACE:
+      context.dispatch.vkCmdSetFrontFace(CMDBuffer,(VkFrontFace)state.value);
+      break;
+    case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+      context.dispatch.vkCmdSetDepthTestEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+      context.dispatch.vkCmdSetDepthWriteEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE:
+      context.dispatch.vkCmdSetDepthBiasEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE:
+      context.dispatch.vkCmdSetDepthBoundsTestEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE:
+      context.dispatch.vkCmdSetStencilTestEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+      context.dispatch.vkCmdSetPrimitiveTopology(CMDBuffer,(VkPrimitiveTopology)state.value);
+      break;
+    case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+      context.dispatch.vkCmdSetPrimitiveRestartEnable(CMDBuffer,state.value);
+      break;
+    case VK_DYNAMIC_STATE_POLYGON_MODE_EXT:
+      context.dispatch.vkCmdSetPolygonModeEXT(CMDBuffer,(VkPolygonMode)state.value);
+      break;
+    case VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT:
+      context.dispatch.vkCmdSetRasterizationSamplesEXT(CMDBuffer,(VkSampleCountFlagBits)state.value);
+      break;
+    case VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT:
+      context.dispatch.vkCmdSetAlphaToCoverageEnableEXT(CMDBuffer,state.value);
+      break;
+    default:
+      throw std::runtime_error(std::format("Trace sets unknown dynamic state {}",state.state));
+    }
+  }
+
+  void BeginRendering(VkCommandBuffer CMDBuffer,TraceReader reader){
+    auto &rendering=reader.Payload<TraceRendering>();
+    uint32_t count=rendering.colorCount+rendering.hasDepth+rendering.hasStencil;
+    auto entries=reader.Array<TraceAttachment>(count);
+    attachments.resize(count);
+    for(uint32_t index=0;index<count;index++){
+      auto &entry=entries[index];
+      attachments[index]={
+        .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext=nullptr,
+        .imageView=View(entry.view),
+        .imageLayout=(VkImageLayout)entry.layout,
+        .resolveMode=(VkResolveModeFlagBits)entry.resolveMode,
+        .resolveImageView=View(entry.resolveView),
+        .resolveImageLayout=(VkImageLayout)entry.resolveLayout,
+        .loadOp=(VkAttachmentLoadOp)entry.loadOp,
+        .storeOp=(VkAttachmentStoreOp)entry.storeOp,
+        .clearValue=entry.clear
+      };
+    }
+    VkRenderingInfo renderingInfo={
+      .sType=VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .pNext=nullptr,
+      .flags=rendering.flags,
+      .renderArea=rendering.area,
+      .layerCount=rendering.layerCount,
+      .viewMask=rendering.viewMask,
+      .colorAttachmentCount=rendering.colorCount,
+      .pColorAttachments=attachments.data(),
+      .pDepthAttachment=rendering.hasDepth?&attachments[rendering.colorCount]:nullptr,
+      .pStencilAttachment=rendering.hasStencil?&attachments[rendering.colorCount+rendering.hasDepth]:nullptr
+    };
+    context.dispatch.vkCmdBeginRendering(CMDBuffer,&renderingInfo);
+  }
+
+  //Records the commands between a PassBegin and its PassEnd
+  void Execute(VkCommandBuffer CMDBuffer,const TraceRecord *record){
+    for(record=file.Next(record);record&&record->op!=TraceOp::PassEnd;record=file.Next(record)){
+      TraceReader reader(record);
+      switch(record->op){
+      case TraceOp::BindShaders:{
+        auto count=reader.Payload<TraceBindShaders>().count;
+        auto stages=reader.Array<VkShaderStageFlagBits>(count);
+        auto ids=reader.Array<uint32_t>(count);
+        shaders.resize(count);
+        for(uint32_t index=0;index<count;index++)
+          shaders[index]=ids[index]==TraceNoObject?VK_NULL_HANDLE:objects[ids[index]].shader;
+        context.dispatch.vkCmdBindShadersEXT(CMDBuffer,count,stages,shaders.data());
+        break;
+      }
+      case TraceOp::BindDescriptorBuffers:{
+        auto count=reader.Payload<TraceBindDescriptorBuffers>().count;
+        auto addresses=reader.Array<TraceAddress>(count);
+        auto usages=reader.Array<uint32_t>(count);
+        bindingInfos.resize(count);
+        for(uint32_t index=0;index<count;index++){
+          bindingInfos[index]={
+            .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+            .pNext=nullptr,
+            .address=Resolve(addresses[index]),
+            .usage=usages[index]
+          };
+        }
+        context.dispatch.vkCmdBindDescriptorBuffersEXT(CMDBuffer,count,bindingInfos.data());
+        break;
+      }
+      case TraceOp::SetDescriptorBufferOffsets:{
+        auto &offsets=reader.Payload<TraceDescriptorBufferOffsets>();
+        auto values=reader.Array<VkDeviceSize>(offsets.count);
+        auto indices=reader.Array<uint32_t>(offsets.count);
+        context.dispatch.vkCmdSetDescriptorBufferOffsetsEXT(CMDBuffer,(VkPipelineBindPoint)offsets.bindPoint,
+          objects[offsets.layout].pipelineLayout,offsets.firstSet,offsets.count,indices,values);
+        break;
+      }
+      case TraceOp::PushConstants:{
+        auto &pushConstants=reader.Payload<TracePushConstants>();
+        context.dispatch.vkCmdPushConstants(CMDBuffer,objects[pushConstants.layout].pipelineLayout,pushConstants.stages,
+          pushConstants.offset,pushConstants.size,reader.Array<uint8_t>(pushConstants.size));
+        break;
+      }
+      case TraceOp::SetVertexInput:{
+        auto &input=reader.Payload<TraceVertexInput>();
+        auto bindingEntries=reader.Array<TraceVertexBinding>(input.bindingCount);
+        auto attributeEntries=reader.Array<TraceVertexAttribute>(input.attributeCount);
+        vertexBindings.resize(input.bindingCount);
+        for(uint32_t index=0;index<input.bindingCount;index++){
+          vertexBindings[index]={
+            .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+            .pNext=nullptr,
+            .binding=bindingEntries[index].binding,
+            .stride=bindingEntries[index].stride,
+            .inputRate=(VkVertexInputRate)bindingEntries[index].inputRate,
+            .divisor=bindingEntries[index].divisor
+          };
+        }
+        vertexAttributes.resize(input.attributeCount);
+        for(uint32_t index=0;index<input.attributeCount;index++){
+          vertexAttributes[index]={
+            .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+            .pNext=nullptr,
+            .location=attributeEntries[index].location,
+            .binding=attributeEntries[index].binding,
+            .format=(VkFormat)attributeEntries[index].format,
+            .offset=attributeEntries[index].offset
+          };
+        }
+        context.dispatch.vkCmdSetVertexInputEXT(CMDBuffer,input.bindingCount,vertexBindings.data(),
+          input.attributeCount,vertexAttributes.data());
+        break;
+      }
+      case TraceOp::BindVertexBuffers:{
+        auto &vertexBuffers=reader.Payload<TraceVertexBuffers>();
+        auto ids=reader.Array<uint32_t>(vertexBuffers.count);
+        auto offsets=reader.Array<VkDeviceSize>(vertexBuffers.count);
+        auto sizes=vertexBuffers.hasSizes?reader.Array<VkDeviceSize>(vertexBuffers.count):nullptr;
+        auto strides=vertexBuffers.hasStrides?reader.Array<VkDeviceSize>(vertexBuffers.count):nullptr;
+        buffers.resize(vertexBuffers.count);
+        for(uint32_t index=0;index<vertexBuffers.count;index++)
+          buffers[index]=ids[index]==TraceNoObject?VK_NULL_HANDLE:objects[ids[index]].buffer;
+        context.dispatch.vkCmdBindVertexBuffers2(CMDBuffer,vertexBuffers.firstBinding,vertexBuffers.count,buffers.data(),offsets,sizes,strides);
+        break;
+      }
+      case TraceOp::BeginRendering:
+        BeginRendering(CMDBuffer,reader);
+        break;
+      case TraceOp::EndRendering:
+        context.dispatch.vkCmdEndRendering(CMDBuffer);
+        break;
+      case TraceOp::SetViewport:{
+        auto count=reader.Payload<TraceCount>().count;
+        context.dispatch.vkCmdSetViewportWithCount(CMDBuffer,count,reader.Array<VkViewport>(count));
+        break;
+      }
+      case TraceOp::SetScissor:{
+        auto count=reader.Payload<TraceCount>().count;
+        context.dispatch.vkCmdSetScissorWithCount(CMDBuffer,count,reader.Array<VkRect2D>(count));
+        break;
+      }
+      case TraceOp::SetState:
+        SetState(CMDBuffer,reader.Payload<TraceState>());
+        break;
+      case TraceOp::SetSampleMask:{
+        auto samples=reader.Payload<TraceSampleMask>().samples;
+        context.dispatch.vkCmdSetSampleMaskEXT(CMDBuffer,(VkSampleCountFlagBits)samples,reader.Array<VkSampleMask>((samples+31)/32));
+        break;
+      }
+      case TraceOp::SetColorBlendEnable:{
+        auto &range=reader.Payload<TraceAttachmentRange>();
+        context.dispatch.vkCmdSetColorBlendEnableEXT(CMDBuffer,range.first,range.count,reader.Array<VkBool32>(range.count));
+        break;
+      }
+      case TraceOp::SetColorWriteMask:{
+        auto &range=reader.Payload<TraceAttachmentRange>();
+        context.dispatch.vkCmdSetColorWriteMaskEXT(CMDBuffer,range.first,range.count,reader.Array<VkColorComponentFlags>(range.count));
+        break;
+      }
+      case TraceOp::Dispatch:{
+        auto &dispatch=reader.Payload<TraceDispatch>();
+        context.dispatch.vkCmdDispatch(CMDBuffer,dispatch.x,dispatch.y,dispatch.z);
+        break;
+      }
+      case TraceOp::Draw:{
+        auto &draw=reader.Payload<TraceDraw>();
+        context.dispatch.vkCmdDraw(CMDBuffer,draw.vertexCount,draw.instanceCount,draw.firstVertex,draw.firstInstance);
+        break;
+      }
+      case TraceOp::BindIndexBuffer:{
+        auto &indexBuffer=reader.Payload<TraceIndexBuffer>();
+        auto buffer=indexBuffer.buffer==TraceNoObject?VK_NULL_HANDLE:objects[indexBuffer.buffer].buffer;
+        if(context.dispatch.vkCmdBindIndexBuffer2KHR)
+          context.dispatch.vkCmdBindIndexBuffer2KHR(CMDBuffer,buffer,indexBuffer.offset,indexBuffer.size,(VkIndexType)indexBuffer.indexType);
+        else
+          context.dispatch.vkCmdBindIndexBuffer(CMDBuffer,buffer,indexBuffer.offset,(VkIndexType)indexBuffer.indexType);
+        break;
+      }
+      case TraceOp::DrawIndexed:{
+        auto &draw=reader.Payload<TraceDrawIndexed>();
+        context.dispatch.vkCmdDrawIndexed(CMDBuffer,draw.indexCount,draw.instanceCount,draw.firstIndex,draw.vertexOffset,draw.firstInstance);
+        break;
+      }
+      default:
+        throw std::runtime_error(std::format("Unexpected trace record {} inside a pass",(uint32_t)record->op));
+      }
+    }
+  }
+
+  //*************** Frame graph *******************
+  void BeginGraph(){
+    if(building)
+      return;
+    frameGraph.Reset();
+    graphImages.clear();
+    passes.clear();
+    building=true;
+  }
+
+  //Submits the graph built so far and waits for it like the scenarios do
+  void SubmitGraph(Clock::time_point &submitted){
+    if(!building)
+      return;
+    for(uint32_t index=0;index<passes.size();index++){
+      TraceReader reader(passes[index].pass);
+      auto &pass=reader.Payload<TracePass>();
+      auto name=reader.Array<char>(pass.nameSize);
+      frameGraph.AddPass(name,(QueueType)pass.queue,
+        [&](FrameGraph::PassBuilder &builder){
+          for(auto use:passes[index].uses){
+            FrameGraphResource resource={use->resource};
+            if(graphImages[use->resource])
+              builder.Image(resource,(VkImageLayout)use->layout,use->stage,use->access,use->discard!=0);
+            else if(use->access&ResourceTracker::WriteAccess)
+              builder.Write(resource,use->stage,use->access);
+            else
+              builder.Read(resource,use->stage,use->access);
+          }
+        },
+        [this,index](VkCommandBuffer CMDBuffer){
+          if(passes[index].commands)
+            Execute(CMDBuffer,passes[index].commands);
+        });
+    }
+
+    auto syncPoints=frameGraph.Submit(*context.queues);
+    submitted=Clock::now();
+    for(auto &point:syncPoints)
+      context.queues->Wait(point);
+    building=false;
+  }
+
+public:
+  TraceReplayer(HeadlessDevice &context,const TraceFile &file):
+    context(context),
+    file(file),
+    renderTargets(context.device,context.allocator,tracker,context.memory.get()),
+    frameGraph(context.device,context.allocator,tracker,&context.dispatch){
+
+    //Same numbering as TraceWriter: one id per object, every shader of a
+    //call included
+    uint32_t nextId=0;
+    for(auto record=file.First();record;record=file.Next(record)){
+      TraceReader reader(record);
+      switch(record->op){
+      case TraceOp::CreateSetLayout:
+      case TraceOp::CreatePipelineLayout:
+      case TraceOp::CreateBuffer:
+      case TraceOp::CreateImage:
+      case TraceOp::CreateSampler:
+        nextId=std::max(nextId,reader.Payload<TraceObject>().id+1);
+        break;
+      case TraceOp::CreateShaders:
+        shaderIds[record]=nextId;
+        nextId+=reader.Payload<TraceCreateShaders>().shaderCount;
+        break;
+      case TraceOp::Frame:
+        frames.push_back(record);
+        break;
+      default:
+        break;
+      }
+    }
+    objects.resize(nextId);
+
+    for(auto record=file.First();record&&record->op!=TraceOp::Frame;record=file.Next(record)){
+      if(!ReplayObject(record))
+        throw std::runtime_error("Trace records commands before its first frame");
+    }
+  }
+
+  TraceReplayer(const TraceReplayer &)=delete;
+  TraceReplayer &operator=(const TraceReplayer &)=delete;
+
+  ~TraceReplayer(){
+    context.dispatch.vkDeviceWaitIdle(context.device);
+    frameGraph.Reset();
+    for(auto &object:objects){
+      if(object.shader)
+        context.dispatch.vkDestroyShaderEXT(context.device,object.shader,nullptr);
+      if(object.buffer)
+        context.DestroyBuffer(object.buffer,object.allocation);
+      if(object.target)
+        renderTargets.Release(*object.target);
+      if(object.sampler)
+        context.dispatch.vkDestroySampler(context.device,object.sampler,nullptr);
+      if(object.pipelineLayout)
+        context.dispatch.vkDestroyPipelineLayout(context.device,object.pipelineLayout,nullptr);
+      if(object.setLayout)
+        context.dispatch.vkDestroyDescriptorSetLayout(context.device,object.setLayout,nullptr);
+    }
+    renderTargets.Clear();
+  }
+
+  size_t FrameCount()const{
+    return frames.size();
+  }
+
+  //Timed like Scenario::Iterate(), up to the last submission and until the
+  //device has finished
+  Sample Replay(size_t frame){
+    auto begin=Clock::now();
+    auto submitted=begin;
+
+    auto end=frame+1<frames.size()?frames[frame+1]:nullptr;
+    for(auto record=file.Next(frames[frame]);record!=end;record=file.Next(record)){
+      if(ReplayObject(record))
+        continue;
+
+      TraceReader reader(record);
+      switch(record->op){
+      case TraceOp::GraphBuffer:{
+        BeginGraph();
+        auto &buffer=reader.Payload<TraceGraphBuffer>();
+        if(buffer.id==TraceNoObject)
+          frameGraph.CreateBuffer("Transient",buffer.size,buffer.usage);
+        else
+          frameGraph.ImportBuffer("Buffer",objects[buffer.id].buffer);
+        graphImages.push_back(false);
+        break;
+      }
+      case TraceOp::GraphImage:{
+        BeginGraph();
+        auto &image=reader.Payload<TraceGraphImage>();
+        frameGraph.ImportImage("Image",objects[image.id].target->image,image.aspect);
+        graphImages.push_back(true);
+        break;
+      }
+      case TraceOp::Pass:
+        BeginGraph();
+        passes.push_back({.pass=record,.uses={},.commands=nullptr});
+        break;
+      case TraceOp::Use:
+        passes.back().uses.push_back(&reader.Payload<TraceUse>());
+        break;
+      case TraceOp::Export:{
+        auto &use=reader.Payload<TraceUse>();
+        frameGraph.Export({use.resource},use.stage,use.access,(VkImageLayout)use.layout);
+        break;
+      }
+      case TraceOp::PassBegin:{
+        auto pass=reader.Payload<TracePassBegin>().pass;
+        passes[pass].commands=record;
+        auto next=file.Next(record);
+        while(next&&next->op!=TraceOp::PassEnd)
+          next=file.Next(next);
+        //Cut short inside the pass, its commands run up to the faulting one
+        if(!next){
+          SubmitGraph(submitted);
+          return {Milliseconds(begin,submitted),Milliseconds(begin,Clock::now())};
+        }
+        record=next;
+        break;
+      }
+      case TraceOp::Submit:
+        SubmitGraph(submitted);
+        break;
+      default:
+        throw std::runtime_error(std::format("Unexpected trace record {} in a frame",(uint32_t)record->op));
+      }
+    }
+
+    //A capture that crashed mid submission has no Submit, replay what it has
+    SubmitGraph(submitted);
+    return {Milliseconds(begin,submitted),Milliseconds(begin,Clock::now())};
+  }
+};
@@ -0,0 +1,304 @@
+#include<vector>
+#include<array>
+#include<string>
+#include<string_view>
+#include<memory>
+#include<atomic>
+#include<cctype>
+#include<cstdlib>
+#include<cstring>
+#include<algorithm>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<format>
+
+#include<vulkan/vulkan.h>
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+#include<vma/vk_mem_alloc.h>
+#include"../Common/HeadlessDevice.h"
+#include"../Common/Scenarios.h"
+#include"../Common/WorkerPool.h"
+
+//Crash isolating sweep over the scenario variants. The variants exist to make
+//the driver fault, so every one runs as a job in a WorkerPool: each forked
+//worker opens a device of its own, and a crash, device loss or hang only
+//costs the job it hit. The parent never touches Vulkan.
+
+//*************** Options ***********************
+#pragma region Options
+struct Options{
+  std::string deviceName;
+  std::string driver;
+  std::vector<std::string> filters;
+  WorkerPool::Settings pool;
+  uint32_t repeat=1;
+  uint32_t iterations=1;
+  std::filesystem::path shaderPath;
+  std::filesystem::path glslPath;
+  std::filesystem::path shaderCachePath;
+  std::filesystem::path jsonPath;
+  bool list=false;
+  bool validation=false;
+};
+
+static void PrintUsage(){
+  std::cout<<
+    "Usage: Runner [options]\n"
+    "  --list                List the scenario variants and exit\n"
+    "  --scenario <filter>   scenario or scenario/variant, repeatable, everything by default\n"
+    "  --workers <n>         Worker processes, one per core by default\n"
+    "  --repeat <n>          Jobs per variant, 1 by default\n"
+    "  --iterations <n>      Frames per job, 1 by default\n"
+    "  --timeout <seconds>   Watchdog timeout per job, 10 by default\n"
+    "  --memory-limit <MiB>  Address space limit per worker, none by default\n"
+    "  --device <name>       First device whose name contains <name>, e.g. Mock for the mock ICD\n"
+    "  --driver <id>         VkDriverId number or lavapipe, radv, amdvlk, amd, nvidia, nvk, anv, venus\n"
+    "  --shaders <dir>       Directory holding the compiled .spv files\n"
+    "  --glsl <dir>          Compile the GLSL under <dir>, the repository root, instead\n"
+    "                        of loading the .spv files. SPIR-V is cached in ShaderCache\n"
+    "  --json <file>         Also write every job's outcome as JSON\n"
+    "  --validation          Enable VK_LAYER_KHRONOS_validation in the workers\n";
+}
+
+static Options ParseOptions(int argc,char **argv){
+  Options options;
+  options.shaderPath=std::filesystem::absolute(argv[0]).parent_path()/"Shaders";
+  options.shaderCachePath=std::filesystem::absolute(argv[0]).parent_path()/"ShaderCache";
+
+  for(int index=1;index<argc;index++){
+    std::string_view argument=argv[index];
+    auto Value=[&]()->std::string{
+      if(index+1>=argc)
+        throw std::runtime_error(std::format("Missing value for {}",argument));
+      return argv[++index];
+    };
+    auto Count=[&]()->uint32_t{
+      auto value=Value();
+      if(value.empty()||!std::all_of(value.begin(),value.end(),[](char c){return std::isdigit((unsigned char)c)!=0;}))
+        throw std::runtime_error(std::format("Expected a number for {}",argument));
+      return (uint32_t)std::stoul(value);
+    };
+
+    if(argument=="--list")
+      options.list=true;
+    else if(argument=="--scenario")
+      options.filters.push_back(Value());
+    else if(argument=="--workers")
+      options.pool.workers=Count();
+    else if(argument=="--repeat")
+      options.repeat=Count();
+    else if(argument=="--iterations")
+      options.iterations=Count();
+    else if(argument=="--timeout")
+      options.pool.timeoutSeconds=std::stod(Value());
+    else if(argument=="--memory-limit")
+      options.pool.memoryLimitMiB=Count();
+    else if(argument=="--device")
+      options.deviceName=Value();
+    else if(argument=="--driver")
+      options.driver=Value();
+    else if(argument=="--shaders")
+      options.shaderPath=Value();
+    else if(argument=="--glsl")
+      options.glslPath=Value();
+    else if(argument=="--json")
+      options.jsonPath=Value();
+    else if(argument=="--validation")
+      options.validation=true;
+    else if(argument=="--help"||argument=="-h"){
+      PrintUsage();
+      std::exit(0);
+    }else{
+      PrintUsage();
+      throw std::runtime_error(std::format("Unknown option {}",argument));
+    }
+  }
+
+  if(options.repeat==0||options.iterations==0)
+    throw std::runtime_error("Repeat and iterations have to be at least 1");
+  return options;
+}
+#pragma endregion
+
+//*************** Worker ************************
+#pragma region Worker
+struct Job{
+  uint32_t entry;
+  uint32_t repeat;
+};
+
+//One device per worker, every job creates its scenario variant on it
+static WorkerPool::JobFunction SetupWorker(const Options &options,const std::vector<ScenarioEntry> &entries,
+  const std::vector<Job> &jobs,ShaderCompiler *compiler){
+
+  auto context=std::make_shared<HeadlessDevice>(options.validation);
+  context->Open(options.deviceName,options.driver);
+  context->shaderPath=options.shaderPath;
+  context->compiler=compiler;
+
+  return [context,&options,&entries,&jobs](uint32_t job,std::atomic<uint32_t> &progress,std::string &message){
+    try{
+      auto scenario=entries[jobs[job].entry].create(*context);
+      for(uint32_t iteration=0;iteration<options.iterations;iteration++){
+        progress.store(iteration,std::memory_order_relaxed);
+        scenario->Iterate();
+      }
+    }catch(const std::exception &exception){
+      message=exception.what();
+      return context->Lost()?Outcome::DeviceLost:Outcome::Failed;
+    }
+    return Outcome::Passed;
+  };
+}
+#pragma endregion
+
+//*************** Results ***********************
+#pragma region Results
+struct Summary{
+  std::string name;
+  bool valid=false;
+  std::array<uint32_t,7> counts={};
+  double totalMs=0.0;
+  uint32_t timed=0;
+  std::string firstProblem;
+};
+
+static std::string Escape(std::string_view text){
+  std::string escaped;
+  for(char c:text){
+    if(c=='"'||c=='\\')
+      escaped+='\\';
+    if((unsigned char)c>=0x20)
+      escaped+=c;
+  }
+  return escaped;
+}
+
+static std::vector<Summary> Summarise(const std::vector<ScenarioEntry> &entries,const std::vector<Job> &jobs,const std::vector<JobReport> &reports){
+  std::vector<Summary> summaries(entries.size());
+  for(size_t index=0;index<entries.size();index++){
+    summaries[index].name=std::format("{}/{}",entries[index].scenario,entries[index].variant);
+    summaries[index].valid=entries[index].valid;
+  }
+
+  for(size_t index=0;index<jobs.size();index++){
+    auto &report=reports[index];
+    auto &summary=summaries[jobs[index].entry];
+    auto outcome=report.outcome;
+    summary.counts[(uint32_t)outcome]++;
+    if(outcome!=Outcome::Skipped){
+      summary.totalMs+=report.durationMs;
+      summary.timed++;
+    }
+    if(outcome!=Outcome::Passed&&outcome!=Outcome::Skipped&&summary.firstProblem.empty()){
+      summary.firstProblem=outcome==Outcome::Crashed?
+        std::format("{} ({})",OutcomeNames[(uint32_t)outcome],strsignal(report.status)):
+        std::format("{}: {}",OutcomeNames[(uint32_t)outcome],report.message);
+    }
+  }
+  return summaries;
+}
+
+static void PrintSummaries(const std::vector<Summary> &summaries){
+  std::cout<<std::format("{:<40}{:>8}{:>8}{:>8}{:>8}{:>8}{:>8}{:>10}\n",
+    "variant","passed","failed","lost","crashed","timeout","skipped","mean ms");
+  for(auto &summary:summaries){
+    auto &counts=summary.counts;
+    std::cout<<std::format("{:<40}{:>8}{:>8}{:>8}{:>8}{:>8}{:>8}{:>10.2f}\n",
+      summary.name,counts[(uint32_t)Outcome::Passed],counts[(uint32_t)Outcome::Failed],
+      counts[(uint32_t)Outcome::DeviceLost],counts[(uint32_t)Outcome::Crashed],
+      counts[(uint32_t)Outcome::TimedOut],counts[(uint32_t)Outcome::Skipped],
+      summary.timed>0?summary.totalMs/summary.timed:0.0);
+  }
+  for(auto &summary:summaries){
+    if(!summary.firstProblem.empty())
+      std::cout<<std::format("  {}: {}\n",summary.name,summary.firstProblem);
+  }
+}
+
+static void WriteJson(const std::filesystem::path &path,const std::vector<ScenarioEntry> &entries,
+  const std::vector<Job> &jobs,const std::vector<JobReport> &reports){
+
+  std::ofstream file(path);
+  if(!file.is_open())
+    throw std::runtime_error("Unable to open runner output");
+
+  file<<"{\"jobs\":[";
+  for(size_t index=0;index<jobs.size();index++){
+    auto &report=reports[index];
+    auto &entry=entries[jobs[index].entry];
+    file<<std::format("{}\n{{\"scenario\":\"{}\",\"variant\":\"{}\",\"repeat\":{},\"outcome\":\"{}\",\"worker\":{},\"status\":{},\"durationMs\":{},\"message\":\"{}\"}}",
+      index>0?",":"",entry.scenario,entry.variant,jobs[index].repeat,
+      OutcomeNames[(uint32_t)report.outcome],report.worker,report.status,
+      report.durationMs,Escape(report.message));
+  }
+  file<<"\n]}\n";
+}
+#pragma endregion
+
+int main(int argc,char **argv){
+  try{
+    auto options=ParseOptions(argc,argv);
+
+    auto entries=ScenarioEntries();
+    if(options.list){
+      for(auto &entry:entries)
+        std::cout<<std::format("{}/{}{}\n",entry.scenario,entry.variant,entry.valid?"":" (repro)");
+      return 0;
+    }
+
+    if(!options.filters.empty()){
+      std::erase_if(entries,[&](const ScenarioEntry &entry){
+        return std::none_of(options.filters.begin(),options.filters.end(),[&](const std::string &filter){
+          return filter==entry.scenario||filter==std::format("{}/{}",entry.scenario,entry.variant);
+        });
+      });
+      if(entries.empty())
+        throw std::runtime_error("No scenario variant matches --scenario, see --list");
+    }
+
+    //Variants interleaved so every worker's range holds a mix of them
+    std::vector<Job> jobs;
+    for(uint32_t repeat=0;repeat<options.repeat;repeat++){
+      for(uint32_t entry=0;entry<entries.size();entry++)
+        jobs.push_back({entry,repeat});
+    }
+
+    //Compiled before the workers fork, they inherit the memory cache
+    std::unique_ptr<ShaderCompiler> compiler;
+    if(!options.glslPath.empty()){
+      compiler=std::make_unique<ShaderCompiler>(options.glslPath,options.shaderCachePath);
+      compiler->CompileScenarioShaders();
+      std::cout<<std::format("Shaders: {}\n",compiler->Stats());
+    }
+
+    WorkerPool pool(options.pool);
+    std::cout<<std::format("Running {} jobs over {} variants on {} workers\n",
+      jobs.size(),entries.size(),pool.WorkerCount((uint32_t)jobs.size()));
+    auto begin=Clock::now();
+    auto reports=pool.Run((uint32_t)jobs.size(),[&](){
+      return SetupWorker(options,entries,jobs,compiler.get());
+    });
+    std::cout<<std::format("Finished in {:.2f} s, {} jobs stolen\n",Milliseconds(begin,Clock::now())/1000.0,pool.Stolen());
+
+    auto summaries=Summarise(entries,jobs,reports);
+    PrintSummaries(summaries);
+    if(!options.jsonPath.empty())
+      WriteJson(options.jsonPath,entries,jobs,reports);
+
+    //Repros are expected to fail, valid variants are not
+    bool validFailed=std::any_of(summaries.begin(),summaries.end(),[](const Summary &summary){
+      uint32_t runs=0;
+      for(auto count:summary.counts)
+        runs+=count;
+      return summary.valid&&summary.counts[(uint32_t)Outcome::Passed]!=runs;
+    });
+    return validFailed?1:0;
+  }catch(const std::exception &exception){
+    std::cerr<<exception.what()<<"\n";
+    return 1;
+  }
+}
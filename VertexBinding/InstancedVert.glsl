@@ -0,0 +1,20 @@
+#version 450
+
+// VertexBindingVert.glsl with per instance streams: an affine transform at
+// divisor 1 and a tint that may step slower.
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inTransform0;
+layout(location = 2) in vec4 inTransform1;
+layout(location = 3) in vec4 inTransform2;
+layout(location = 4) in vec4 inTint;
+
+layout(location = 0) out vec4 fragTint;
+
+void main(){
+
+  vec4 position = vec4(inPosition, 1.0);
+  gl_Position = vec4(dot(inTransform0, position), dot(inTransform1, position), dot(inTransform2, position), 1.0);
+  fragTint = inTint;
+
+}
@@ -1,5 +1,6 @@
 #include<array>
 #include<vector>
+#include<memory>
 #include<iostream>
 #include<fstream>
 #include<filesystem>
@@ -9,17 +10,12 @@
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
 #define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
 #include<vma/vk_mem_alloc.h>
-
-VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
-  VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-  VkDebugUtilsMessageTypeFlagsEXT messageType,
-  const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
-  void *pUserData){
-
-  std::cerr<<"Validation Layer: "<<pCallbackData->pMessage<<std::endl;
-
-  return VK_FALSE; // Return VK_TRUE to terminate the application
-}
+#include"../Common/RenderTargetPool.h"
+#include"../Common/FrameGraph.h"
+#include"../Common/DeviceQueues.h"
+#include"../Common/DebugMessenger.h"
+#include"../Common/GpuProfiler.h"
+#include"../Common/DescriptorLayout.h"
 
 
 static std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
@@ -47,7 +43,14 @@ static std::vector<uint32_t> LoadShader(std::filesystem::path filePath){
   return buffer;
 }
 
-int main(){
+int main(int argc,char **argv){
+  //The profile and trace are only written when asked for with --profile <directory>
+  std::filesystem::path profileDirectory;
+  for(int index=1;index+1<argc;index++){
+    if(std::string(argv[index])=="--profile")
+      profileDirectory=argv[++index];
+  }
+
   //************** Instance ***********************
 #pragma region Instance
   std::array<const char *,0> InstanceLayers={"VK_LAYER_KHRONOS_validation"};
@@ -85,6 +88,8 @@ int main(){
   PFN_vkCreateDebugUtilsMessengerEXT pfCreateDebugUtilsMessengerEXT=reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
     vkGetInstanceProcAddr(instance,"vkCreateDebugUtilsMessengerEXT"));
 
+  //Destroyed at the end of main, after the instance
+  auto debugSink=std::make_unique<DebugMessenger>();
   VkDebugUtilsMessengerEXT debugMessenger;
   VkDebugUtilsMessengerCreateInfoEXT createInfo={
     .sType=VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
@@ -96,8 +101,8 @@ int main(){
                  VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT|
                  VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT|
                  VK_DEBUG_UTILS_MESSAGE_TYPE_DEVICE_ADDRESS_BINDING_BIT_EXT,
-    .pfnUserCallback=&DebugCallback,
-    .pUserData=nullptr
+    .pfnUserCallback=&DebugMessenger::Callback,
+    .pUserData=debugSink.get()
   };
   pfCreateDebugUtilsMessengerEXT(instance,&createInfo,nullptr,&debugMessenger);
 
@@ -113,18 +118,44 @@ int main(){
 
   //*************** Device ************************
 #pragma region Device
-
-  VkPhysicalDeviceBufferDeviceAddressFeatures BufferDeviceAddressFeatures={
-    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR,
+  //DeviceQueues waits on timeline semaphores and GpuProfiler resets its
+  //queries from the host. Check both up front so a device without them
+  //says so instead of failing vkCreateDevice.
+  VkPhysicalDeviceVulkan12Features supported12={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .pNext=nullptr
+  };
+  VkPhysicalDeviceFeatures2 supported={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext=&supported12,
+    .features={}
+  };
+  vkGetPhysicalDeviceFeatures2(physicalDevices[0],&supported);
+  if(!supported12.timelineSemaphore)
+    throw std::runtime_error("Device does not support timelineSemaphore, DeviceQueues needs it");
+  if(!supported12.hostQueryReset)
+    throw std::runtime_error("Device does not support hostQueryReset, GpuProfiler needs it");
+
+  VkPhysicalDeviceVulkan13Features Vulkan13Features={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
     .pNext=nullptr,
-    .bufferDeviceAddress=VK_TRUE,
-    .bufferDeviceAddressCaptureReplay=VK_FALSE,
-    .bufferDeviceAddressMultiDevice=VK_FALSE
+    .synchronization2=VK_TRUE,
+    .dynamicRendering=VK_TRUE
+  };
+
+  //Buffer device address moves in here, the 1.2 struct cannot be chained
+  //together with VkPhysicalDeviceBufferDeviceAddressFeatures
+  VkPhysicalDeviceVulkan12Features Vulkan12Features={
+    .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .pNext=&Vulkan13Features,
+    .hostQueryReset=VK_TRUE,
+    .timelineSemaphore=VK_TRUE,
+    .bufferDeviceAddress=VK_TRUE
   };
 
   VkPhysicalDeviceDescriptorBufferFeaturesEXT DescriptorBufferFeatures={
     .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
-    .pNext=&BufferDeviceAddressFeatures,
+    .pNext=&Vulkan12Features,
     .descriptorBuffer=VK_TRUE,
     .descriptorBufferCaptureReplay=VK_FALSE,
     .descriptorBufferImageLayoutIgnored=VK_FALSE,
@@ -137,27 +168,23 @@ int main(){
     .shaderObject=VK_TRUE
   };
 
-  float queuePriorities=1.0;
-  const VkDeviceQueueCreateInfo queueCreateInfos={
-    .sType=VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-    .pNext=nullptr,
-    .flags=0,
-    .queueFamilyIndex=0,
-    .queueCount=1,
-    .pQueuePriorities=&queuePriorities,
+  DeviceQueues queues(physicalDevices[0]);
+
+  VkPhysicalDeviceFeatures deviceFeatures={
+    .pipelineStatisticsQuery=supported.features.pipelineStatisticsQuery
   };
 
   VkDeviceCreateInfo deviceInfo={
     .sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
     .pNext=&ShaderObjectFeatures,
     .flags=0,
-    .queueCreateInfoCount=1,
-    .pQueueCreateInfos=&queueCreateInfos,
+    .queueCreateInfoCount=(uint32_t)queues.CreateInfos().size(),
+    .pQueueCreateInfos=queues.CreateInfos().data(),
     .enabledLayerCount=0,
     .ppEnabledLayerNames=nullptr,
     .enabledExtensionCount=(uint32_t)DeviceExtensions.size(),
     .ppEnabledExtensionNames=DeviceExtensions.data(),
-    .pEnabledFeatures=nullptr,
+    .pEnabledFeatures=&deviceFeatures,
   };
 
   VkDevice device=nullptr;
@@ -168,48 +195,10 @@ int main(){
 
   //****** Vulkan function loading ****************
 #pragma region Functions
-  auto pfCreateShader=reinterpret_cast<PFN_vkCreateShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCreateShadersEXT"));
-  auto pfDestroyShader=reinterpret_cast<PFN_vkDestroyShaderEXT>(
-    vkGetDeviceProcAddr(device,"vkDestroyShaderEXT"));
-
-  auto pfCmdBindShaders=reinterpret_cast<PFN_vkCmdBindShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdBindShadersEXT"));
-
-  auto pfGetDescriptorSetLayoutSize=reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
-    vkGetDeviceProcAddr(device,"vkGetDescriptorSetLayoutSizeEXT"));
-
-  auto pfGetDescriptorSetLayoutBindingOffset=
-    reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
-      vkGetDeviceProcAddr(device,"vkGetDescriptorSetLayoutBindingOffsetEXT"));
-
-  auto pfnCmdBindDescriptorBuffersEXT=
-    reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
-      vkGetDeviceProcAddr(device,"vkCmdBindDescriptorBuffersEXT"));
-
-  auto pfnGetDescriptorEXT=
-    reinterpret_cast<PFN_vkGetDescriptorEXT>(
-      vkGetDeviceProcAddr(device,"vkGetDescriptorEXT"));
-
-  auto pfnCmdSetDescriptorBufferOffsetsEXT=
-    reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
-      vkGetDeviceProcAddr(device,"vkCmdSetDescriptorBufferOffsetsEXT"));
-
-  auto pfnCmdSetProvokingVertexModeEXT=reinterpret_cast<PFN_vkCmdSetProvokingVertexModeEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdSetProvokingVertexModeEXT"));
-
-  auto pfnCmdSetPolygonModeEXT=reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdSetPolygonModeEXT"));
-
-  auto pfnCmdSetDepthClampEnableEXT=reinterpret_cast<PFN_vkCmdSetDepthClampEnableEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdSetDepthClampEnableEXT"));
-
-  auto pfnCmdSetVertexInputEXT=reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdSetVertexInputEXT"));
-
-  auto pfnCmdBindShaders=reinterpret_cast<PFN_vkCmdBindShadersEXT>(
-    vkGetDeviceProcAddr(device,"vkCmdBindShadersEXT"));
-
+  //Everything after device creation records and calls through one table
+  DeviceDispatch dispatch;
+  dispatch.Load(device,&vkGetDeviceProcAddr);
+  queues.Create(device,&dispatch);
 #pragma endregion
 
   //*************** Layout ************************
@@ -225,23 +214,9 @@ int main(){
 
   vkGetPhysicalDeviceProperties2(physicalDevices[0],&DeviceProperties);*/
 
-  auto CreateSetLayout=[&device](std::vector<VkDescriptorSetLayoutBinding> bindings)->VkDescriptorSetLayout{
-    VkDescriptorSetLayoutCreateInfo descriptorSetInfo={
-      .sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      .pNext=nullptr,
-      .flags=0,
-      .bindingCount=(uint32_t)bindings.size(),
-      .pBindings=bindings.data()
-    };
-    VkDescriptorSetLayout layout=nullptr;
-    auto result=vkCreateDescriptorSetLayout(device,&descriptorSetInfo,nullptr,&layout);
-    if(result!=VK_SUCCESS)
-      throw std::runtime_error("Failed to create descriptor set layout");
-
-    return layout;
-    };
-
-  auto setLayout=CreateSetLayout({});
+  //The shaders use no descriptors, the set is empty
+  auto emptySetLayout=std::make_unique<DescriptorLayout<DescriptorSet<>>>(device,physicalDevices[0],0,&dispatch);
+  auto setLayout=emptySetLayout->Handle();
 #pragma endregion
 
   //*************** Shader ************************
@@ -283,7 +258,7 @@ int main(){
   }};
 
   std::vector<VkShaderEXT> shaders(ShaderCreateInfos.size(),nullptr);
-  result=pfCreateShader(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
+  result=dispatch.vkCreateShadersEXT(device,(uint32_t)ShaderCreateInfos.size(),ShaderCreateInfos.data(),nullptr,shaders.data());
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create shader objects");
 
@@ -314,68 +289,15 @@ int main(){
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create VMA allocator");
 
-  VkImage framebuffer=nullptr;
-  VkImageView framebufferView=nullptr;
-  VmaAllocationInfo framebufferAllocationInfo={};
-  VmaAllocation framebufferAllocation=nullptr;
-
-  VkImageCreateInfo imageInfo={
-    .sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-    .pNext=nullptr,
-    .imageType=VK_IMAGE_TYPE_2D,
+  //Framebuffer comes from the pool so repeated frames reuse the image and view
+  ResourceTracker resourceTracker(&dispatch);
+  RenderTargetPool renderTargets(device,allocator,resourceTracker);
+  RenderTarget &framebuffer=renderTargets.Acquire({
+    .extent={512,512},
     .format=VK_FORMAT_B8G8R8_SRGB,
-    .extent={512,512,1},
-    .mipLevels=1,
-    .arrayLayers=1,
-    .samples=VK_SAMPLE_COUNT_1_BIT,
-    .tiling=VK_IMAGE_TILING_OPTIMAL,
     .usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-    .sharingMode=VK_SHARING_MODE_EXCLUSIVE,
-    .queueFamilyIndexCount=0,
-    .pQueueFamilyIndices=nullptr,
-    .initialLayout=VK_IMAGE_LAYOUT_UNDEFINED
-  };
-  
-  VmaAllocationCreateInfo imageAllocateInfo={
-    .flags=0,
-    .usage=VMA_MEMORY_USAGE_AUTO,
-    .requiredFlags=VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    .preferredFlags=0,
-    .memoryTypeBits=0,
-    .pool=nullptr,
-    .pUserData=nullptr,
-    .priority=0.0f
-  };
-
-  result=vmaCreateImage(allocator,&imageInfo,&imageAllocateInfo,&framebuffer,&framebufferAllocation,&framebufferAllocationInfo);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to create framebuffer");
-
-  VkImageViewCreateInfo imageviewInfo={
-    .sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-    .pNext=nullptr,
-    .flags=0,
-    .image=framebuffer,
-    .viewType=VK_IMAGE_VIEW_TYPE_2D,
-    .format=VK_FORMAT_B8G8R8_SRGB,
-    .components={
-      .r=VK_COMPONENT_SWIZZLE_IDENTITY,
-      .g=VK_COMPONENT_SWIZZLE_IDENTITY,
-      .b=VK_COMPONENT_SWIZZLE_IDENTITY,
-      .a=VK_COMPONENT_SWIZZLE_IDENTITY
-    },
-    .subresourceRange={
-      .aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
-      .baseMipLevel=0,
-      .levelCount=1,
-      .baseArrayLayer=0,
-      .layerCount=1
-    }
-  };
-
-  result=vkCreateImageView(device,&imageviewInfo,nullptr,&framebufferView);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to create framebuffer view");
+    .samples=VK_SAMPLE_COUNT_1_BIT
+  });
 
   VmaAllocationInfo vertexAllocationInfo={};
   VkBuffer vertexBuffer=nullptr;
@@ -428,34 +350,6 @@ int main(){
   if(result!=VK_SUCCESS)
     throw std::runtime_error("Failed to create pipeline layout");
     */
-#pragma endregion
-
-  //*********** Command Buffer ********************
-#pragma region Command
-  VkCommandPool commandPool=nullptr;
-  VkCommandPoolCreateInfo commandPoolInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-    .pNext=nullptr,
-    .flags=0,
-    .queueFamilyIndex=0
-  };
-  result=vkCreateCommandPool(device,&commandPoolInfo,nullptr,&commandPool);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to create command pool");
-
-  VkCommandBuffer CMDBuffer;
-  VkCommandBufferAllocateInfo bufferAllocatorInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-    .pNext=nullptr,
-    .commandPool=commandPool,
-    .level=VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-    .commandBufferCount=1
-  };
-
-  result=vkAllocateCommandBuffers(device,&bufferAllocatorInfo,&CMDBuffer);
-  if(result!=VK_SUCCESS)
-    throw std::runtime_error("Failed to allocate command buffer");
-
 #pragma endregion
 
   /************************************************
@@ -464,13 +358,6 @@ int main(){
    *                                              *
    ************************************************/
 
-  VkCommandBufferBeginInfo bufferBeginInfo={
-    .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-    .pNext=nullptr,
-    .flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    .pInheritanceInfo=nullptr
-  };
-
   VkVertexInputBindingDescription2EXT vertexInputBinding={
     .sType=VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
     .pNext=nullptr,
@@ -506,8 +393,8 @@ int main(){
   VkRenderingAttachmentInfo attachmentInfo{
     .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
     .pNext=nullptr,
-    .imageView=framebufferView,
-    .imageLayout=VK_IMAGE_LAYOUT_GENERAL,
+    .imageView=framebuffer.view,
+    .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
     .resolveMode=VK_RESOLVE_MODE_NONE,
     .resolveImageView=VK_NULL_HANDLE,
     .resolveImageLayout=VK_IMAGE_LAYOUT_UNDEFINED,
@@ -532,72 +419,85 @@ int main(){
     .pStencilAttachment=nullptr
   };
 
-  vkBeginCommandBuffer(CMDBuffer,&bufferBeginInfo);
-
-  //Required graphic pipeline settings
-  vkCmdBeginRendering(CMDBuffer,&renderingInfo);
-  vkCmdSetDepthTestEnable(CMDBuffer,VK_FALSE);
-  vkCmdSetDepthBiasEnable(CMDBuffer,VK_FALSE);
-  pfnCmdSetDepthClampEnableEXT(CMDBuffer,VK_FALSE);
-  vkCmdSetDepthBoundsTestEnable(CMDBuffer,VK_FALSE);
-  vkCmdSetStencilTestEnable(CMDBuffer,VK_FALSE);
-  vkCmdSetCullMode(CMDBuffer,VK_CULL_MODE_BACK_BIT);
-  vkCmdSetRasterizerDiscardEnable(CMDBuffer,VK_FALSE);
-  vkCmdSetFrontFace(CMDBuffer,VK_FRONT_FACE_COUNTER_CLOCKWISE);
-  pfnCmdSetPolygonModeEXT(CMDBuffer,VK_POLYGON_MODE_FILL);
-  vkCmdSetPrimitiveTopology(CMDBuffer,VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  pfnCmdSetProvokingVertexModeEXT(CMDBuffer,VK_PROVOKING_VERTEX_MODE_FIRST_VERTEX_EXT);
-  vkCmdSetPrimitiveRestartEnable(CMDBuffer,VK_FALSE);
-
-  //Binding shader
-  std::array<VkShaderStageFlagBits,3> shaderStages={
-    VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT,
-    VK_SHADER_STAGE_GEOMETRY_BIT};
+  FrameGraph frameGraph(device,allocator,resourceTracker,&dispatch);
+  GpuProfiler profiler(device,physicalDevices[0],3,64,
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT|
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT|
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT|
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,&dispatch);
+  frameGraph.Profile(&profiler);
+  auto framebufferResource=frameGraph.ImportImage("Framebuffer",framebuffer.image,framebuffer.aspect);
 
   shaders.push_back(VK_NULL_HANDLE);
-  pfnCmdBindShaders(CMDBuffer,2,shaderStages.data(),shaders.data());
 
-  pfnCmdSetVertexInputEXT(CMDBuffer,1,&vertexInputBinding,1,&vertexInputAttribute);
+  //Contents are cleared on load, nothing from a previous frame needs to survive
+  frameGraph.AddPass("Draw",QueueType::Graphics,
+    [&](FrameGraph::PassBuilder &pass){
+      pass.Image(framebufferResource,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,true);
+    },
+    [&](VkCommandBuffer CMDBuffer){
+      //Required graphic pipeline settings
+      dispatch.vkCmdBeginRendering(CMDBuffer,&renderingInfo);
+      dispatch.vkCmdSetDepthTestEnable(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetDepthBiasEnable(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetDepthClampEnableEXT(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetDepthBoundsTestEnable(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetStencilTestEnable(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetCullMode(CMDBuffer,VK_CULL_MODE_BACK_BIT);
+      dispatch.vkCmdSetRasterizerDiscardEnable(CMDBuffer,VK_FALSE);
+      dispatch.vkCmdSetFrontFace(CMDBuffer,VK_FRONT_FACE_COUNTER_CLOCKWISE);
+      dispatch.vkCmdSetPolygonModeEXT(CMDBuffer,VK_POLYGON_MODE_FILL);
+      dispatch.vkCmdSetPrimitiveTopology(CMDBuffer,VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+      if(dispatch.vkCmdSetProvokingVertexModeEXT)
+        dispatch.vkCmdSetProvokingVertexModeEXT(CMDBuffer,VK_PROVOKING_VERTEX_MODE_FIRST_VERTEX_EXT);
+      dispatch.vkCmdSetPrimitiveRestartEnable(CMDBuffer,VK_FALSE);
+
+      //Binding shader
+      std::array<VkShaderStageFlagBits,3> shaderStages={
+        VK_SHADER_STAGE_VERTEX_BIT,VK_SHADER_STAGE_FRAGMENT_BIT,
+        VK_SHADER_STAGE_GEOMETRY_BIT};
+
+      dispatch.vkCmdBindShadersEXT(CMDBuffer,2,shaderStages.data(),shaders.data());
+
+      dispatch.vkCmdSetVertexInputEXT(CMDBuffer,1,&vertexInputBinding,1,&vertexInputAttribute);
  
-  VkDeviceSize offset=0;
-  VkDeviceSize stride=sizeof(glm::vec3);
-  //CRASH HERE - The AMD drivers will fail to check for bound vertex buffers.
-  //This is a soft crash the driver will recover from.
-  //vkCmdBindVertexBuffers2(CMDBuffer,0,1,&vertexBuffer,&offset,&vertexAllocationInfo.size,&stride);
-
-  vkCmdDraw(CMDBuffer,3,1,0,0);
-
-  vkCmdEndRendering(CMDBuffer);
-
-  vkEndCommandBuffer(CMDBuffer);
-  VkQueue queue=nullptr;
-  vkGetDeviceQueue(device,0,0,&queue);
-
-
-  VkSubmitInfo submitInfo={
-    .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO,
-    .pNext=nullptr,
-    .waitSemaphoreCount=0,
-    .pWaitSemaphores=nullptr,
-    .pWaitDstStageMask=nullptr,
-    .commandBufferCount=1,
-    .pCommandBuffers=&CMDBuffer,
-    .signalSemaphoreCount=0,
-    .pSignalSemaphores=nullptr
-  };
-
-  vkQueueSubmit(queue,1,&submitInfo,nullptr);
-  vkQueueWaitIdle(queue);
+      VkDeviceSize offset=0;
+      VkDeviceSize stride=sizeof(glm::vec3);
+      //CRASH HERE - The AMD drivers will fail to check for bound vertex buffers.
+      //This is a soft crash the driver will recover from.
+      //dispatch.vkCmdBindVertexBuffers2(CMDBuffer,0,1,&vertexBuffer,&offset,&vertexAllocationInfo.size,&stride);
+
+      dispatch.vkCmdDraw(CMDBuffer,3,1,0,0);
+
+      dispatch.vkCmdEndRendering(CMDBuffer);
+    });
+
+  profiler.BeginFrame();
+  frameGraph.Submit(queues);
+  profiler.Submitted();
+  queues.WaitIdle();
+
+  profiler.Collect();
+  if(!profileDirectory.empty()){
+    profiler.WriteJson((profileDirectory/"VertexBinding.profile.json").string());
+    profiler.WriteChromeTrace((profileDirectory/"VertexBinding.trace.json").string());
+  }
+  renderTargets.Release(framebuffer);
 
-  vkDestroyCommandPool(device,commandPool,nullptr);
+  queues.Destroy();
+  profiler.Destroy();
   vmaDestroyBuffer(allocator,vertexBuffer,vertexAllocation);
-  vmaDestroyImage(allocator,framebuffer,framebufferAllocation);
+  frameGraph.Reset();
+  renderTargets.Clear();
   vmaDestroyAllocator(allocator);
 
   for(auto &shader:shaders){
     if(shader)
-      pfDestroyShader(device,shader,nullptr);
+      dispatch.vkDestroyShaderEXT(device,shader,nullptr);
   }
+  emptySetLayout.reset();
   vkDestroyDevice(device,nullptr);
   vkDestroyInstance(instance,nullptr);
   return 0;